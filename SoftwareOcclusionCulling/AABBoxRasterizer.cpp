@@ -19,7 +19,10 @@
 
 AABBoxRasterizer::AABBoxRasterizer()
 	: mAABBoxDepthTest(TASKSETHANDLE_INVALID),
-	  mAABBoxInsideViewFrustum(TASKSETHANDLE_INVALID)
+	  mAABBoxInsideViewFrustum(TASKSETHANDLE_INVALID),
+	  mAABBoxBin(TASKSETHANDLE_INVALID),
+	  mpAABBoxDepthTestBand(NULL),
+	  mpDepthStripsDone(NULL)
 {
 
 }
@@ -20,6 +20,8 @@
 
 #include "CPUT_DX11.h"
 #include "TaskMgrTBB.h"
+#include "HiZBuffer.h"
+#include "DepthBufferDesc.h"
 
 class AABBoxRasterizer
 {
@@ -39,10 +41,17 @@ class AABBoxRasterizer
 		virtual void IsInsideViewFrustum(CPUTCamera *pCamera) = 0;
 		virtual void SetViewProjMatrix(float4x4 *viewMatrix, float4x4 *projMatrix) = 0;
 		virtual void SetCPURenderTargetPixels(UINT *pRenderTargetPixels) = 0;
+		virtual void SetDepthBufferDesc(const DepthBufferDesc &desc) = 0;
+		virtual void SetHiZBuffer(const HiZBuffer *pHiZBuffer) = 0;
+		virtual void SetTileTriangleCounts(const UINT *pTileTriangleCounts) = 0;
 		virtual void SetDepthTestTasks(UINT numTasks) = 0;
 		virtual void SetOccludeeSizeThreshold(float occludeeSizeThreshold) = 0;
 		virtual void SetCamera(CPUTCamera *pCamera) = 0;
 
+		// Task sets of the occluder pass in flight, see DepthBufferRasterizer::GetDepthStripsDone.
+		// When set the multi-threaded depth test only waits for the strips each occludee reads
+		inline void SetDepthStripsDone(const TASKSETHANDLE *pDepthStripsDone) {mpDepthStripsDone = pDepthStripsDone;}
+
 		virtual UINT GetNumOccludees() = 0;
 		virtual UINT GetNumCulled() = 0;
 		virtual double GetDepthTestTime() = 0;
@@ -52,6 +61,9 @@ class AABBoxRasterizer
 	protected:
 		TASKSETHANDLE mAABBoxDepthTest;
 		TASKSETHANDLE mAABBoxInsideViewFrustum;
+		TASKSETHANDLE mAABBoxBin;
+		TASKSETHANDLE *mpAABBoxDepthTestBand;	// one per occludee band, allocated by the rasterizers that use them
+		const TASKSETHANDLE *mpDepthStripsDone;
 
 };
 
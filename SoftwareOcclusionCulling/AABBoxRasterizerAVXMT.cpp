@@ -0,0 +1,203 @@
+//--------------------------------------------------------------------------------------
+// Copyright 2011 Intel Corporation
+// All Rights Reserved
+//
+// Permission is granted to use, copy, distribute and prepare derivative works of this
+// software for any purpose and without fee, provided, that the above copyright notice
+// and this statement appear in all copies.  Intel makes no representations about the
+// suitability of this software for any purpose.  THIS SOFTWARE IS PROVIDED "AS IS."
+// INTEL SPECIFICALLY DISCLAIMS ALL WARRANTIES, EXPRESS OR IMPLIED, AND ALL LIABILITY,
+// INCLUDING CONSEQUENTIAL AND OTHER INDIRECT DAMAGES, FOR THE USE OF THIS SOFTWARE,
+// INCLUDING LIABILITY FOR INFRINGEMENT OF ANY PROPRIETARY RIGHTS, AND INCLUDING THE
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  Intel does not
+// assume any responsibility for any errors which may appear in this software nor any
+// responsibility to update it.
+//
+//--------------------------------------------------------------------------------------
+
+#include "AABBoxRasterizerAVXMT.h"
+
+AABBoxRasterizerAVXMT::AABBoxRasterizerAVXMT()
+	: AABBoxRasterizerSSE()
+{
+	ASSERT(HelperSSE::IsAVX2Supported(), _L("AVX2 is not supported"));
+}
+
+AABBoxRasterizerAVXMT::~AABBoxRasterizerAVXMT()
+{
+
+}
+
+//--------------------------------------------------------------------
+// Create mNumDepthTestTasks tasks to determine if the occludee model 
+// AABox is within the viewing frustum 
+//--------------------------------------------------------------------
+void AABBoxRasterizerAVXMT::IsInsideViewFrustum(CPUTCamera *pCamera)
+{
+	mpCamera = pCamera;
+	gTaskMgr.CreateTaskSet(&AABBoxRasterizerAVXMT::IsInsideViewFrustum, this, mNumDepthTestTasks, NULL, 0, "Xform Vertices", &mAABBoxInsideViewFrustum);
+	// Wait for the task set
+	gTaskMgr.WaitForSet(mAABBoxInsideViewFrustum);
+	// Release the task set
+	gTaskMgr.ReleaseHandle(mAABBoxInsideViewFrustum);
+	mAABBoxInsideViewFrustum = TASKSETHANDLE_INVALID;
+}
+
+void AABBoxRasterizerAVXMT::IsInsideViewFrustum(VOID* taskData, INT context, UINT taskId, UINT taskCount)
+{
+	AABBoxRasterizerAVXMT *pAABB = (AABBoxRasterizerAVXMT*)taskData;
+	pAABB->IsInsideViewFrustum(taskId, taskCount);
+}
+
+//-----------------------------------------------------------------------------
+// * Determine the batch of occludee models each task should work on
+// * For each model in the batch determine is the AABBox is inside view frustum
+//-----------------------------------------------------------------------------
+void AABBoxRasterizerAVXMT::IsInsideViewFrustum(UINT taskId, UINT taskCount)
+{
+	UINT numRemainingModels = mNumModels % taskCount;
+
+	UINT numModelsPerTask1 = mNumModels / taskCount + 1;
+	UINT numModelsPerTask2 = mNumModels / taskCount;
+
+	UINT start, end;
+	
+	if(taskId < numRemainingModels)
+	{
+		start = taskId * numModelsPerTask1;
+		end   = start +  numModelsPerTask1;
+	}
+	else
+	{
+		start = (numRemainingModels * numModelsPerTask1) + ((taskId - numRemainingModels) * numModelsPerTask2);
+		end   = start +  numModelsPerTask2;
+	}
+
+	CalcInsideFrustum(&mpCamera->mFrustum, start, end);
+}
+
+//-------------------------------------------------------------------------------
+// Create mNumDepthTestTasks to tarnsform occludee AABBox, rasterize and depth test 
+// to determine if occludee is visible or occluded
+//-------------------------------------------------------------------------------
+void AABBoxRasterizerAVXMT::TransformAABBoxAndDepthTest()
+{
+	mDepthTestTimer.StartTimer();
+
+	if(mpDepthStripsDone)
+	{
+		// The occluders are still being rasterized, transform and bin the occludees meanwhile
+		// and depth test each band once the depth buffer strips it reads are done
+		CreateBandDepthTestTasks(&AABBoxRasterizerAVXMT::TransformAndBinAABBox, &AABBoxRasterizerAVXMT::DepthTestAABBoxBand);
+		WaitForBandDepthTestTasks();
+	}
+	else
+	{
+		gTaskMgr.CreateTaskSet(&AABBoxRasterizerAVXMT::TransformAABBoxAndDepthTest, this, mNumDepthTestTasks, NULL, 0, "Xform Vertices", &mAABBoxDepthTest);
+		// Wait for the task set
+		gTaskMgr.WaitForSet(mAABBoxDepthTest);
+		// Release the task set
+		gTaskMgr.ReleaseHandle(mAABBoxDepthTest);
+		mAABBoxDepthTest = TASKSETHANDLE_INVALID;
+	}
+	
+	mDepthTestTime[mTimeCounter++] = mDepthTestTimer.StopTimer();
+	mTimeCounter = mTimeCounter >= AVG_COUNTER ? 0 : mTimeCounter; 
+}
+
+//--------------------------------------------------------------------------------
+// Determine the batch of occludee models each task should work on
+// For each occludee model in the batch
+// * Transform the AABBox to screen space
+// * Rasterize the triangles that make up the AABBox
+// * Depth test the raterized triangles against the CPU rasterized depth buffer
+//--------------------------------------------------------------------------------
+void AABBoxRasterizerAVXMT::TransformAABBoxAndDepthTest(UINT taskId)
+{
+	UINT numRemainingModels = mNumModels % mNumDepthTestTasks;
+
+	UINT numModelsPerTask1 = mNumModels / mNumDepthTestTasks + 1;
+	UINT numModelsPerTask2 = mNumModels / mNumDepthTestTasks;
+
+	UINT start, end;
+	if(taskId < numRemainingModels)
+	{
+		start = taskId * numModelsPerTask1;
+		end   = start +  numModelsPerTask1;
+	}
+	else
+	{
+		start = (numRemainingModels * numModelsPerTask1) + ((taskId - numRemainingModels) * numModelsPerTask2);
+		end   = start +  numModelsPerTask2;
+	}
+
+	TransformAABBoxesAVX(start, end);
+	for(UINT i = start; i < end; i++)
+	{
+		if(mpOccludeeBand[i] != OCCLUDEE_NOT_TESTED)
+		{
+			mpTransformedAABBox[i].RasterizeAndDepthTestAABBoxAVX(mpRenderTargetPixels, mpHiZBuffer, mpTileTriangleCounts, mDesc);
+		}
+	}
+}
+
+void AABBoxRasterizerAVXMT::TransformAABBoxAndDepthTest(VOID* pTaskData, INT context, UINT taskId, UINT taskCount)
+{
+	AABBoxRasterizerAVXMT *pAabbox = (AABBoxRasterizerAVXMT*)pTaskData;
+	pAabbox->TransformAABBoxAndDepthTest(taskId);
+}
+
+void AABBoxRasterizerAVXMT::TransformAndBinAABBox(VOID* pTaskData, INT context, UINT taskId, UINT taskCount)
+{
+	AABBoxRasterizerAVXMT *pAabbox = (AABBoxRasterizerAVXMT*)pTaskData;
+	pAabbox->TransformAndBinAABBox(taskId);
+}
+
+//--------------------------------------------------------------------------------
+// Determine the batch of occludee models each task should work on
+// For each occludee model in the batch
+// * Transform the AABBox to screen space
+// * Find the band of depth buffer strips the AABBox is depth tested against
+//--------------------------------------------------------------------------------
+void AABBoxRasterizerAVXMT::TransformAndBinAABBox(UINT taskId)
+{
+	UINT numRemainingModels = mNumModels % mNumDepthTestTasks;
+
+	UINT numModelsPerTask1 = mNumModels / mNumDepthTestTasks + 1;
+	UINT numModelsPerTask2 = mNumModels / mNumDepthTestTasks;
+
+	UINT start, end;
+	if(taskId < numRemainingModels)
+	{
+		start = taskId * numModelsPerTask1;
+		end   = start +  numModelsPerTask1;
+	}
+	else
+	{
+		start = (numRemainingModels * numModelsPerTask1) + ((taskId - numRemainingModels) * numModelsPerTask2);
+		end   = start +  numModelsPerTask2;
+	}
+
+	TransformAABBoxesAVX(start, end);
+	SortOccludeesByBand(taskId, start, end);
+}
+
+void AABBoxRasterizerAVXMT::DepthTestAABBoxBand(VOID* pTaskData, INT context, UINT taskId, UINT taskCount)
+{
+	BandTaskData *pBand = (BandTaskData*)pTaskData;
+	AABBoxRasterizerAVXMT *pAabbox = (AABBoxRasterizerAVXMT*)pBand->mpRasterizer;
+	pAabbox->DepthTestAABBoxBand(pBand->mBand, taskId);
+}
+
+//--------------------------------------------------------------------------------
+// Rasterize and depth test the AABBoxes of one band that the task binned against 
+// the CPU rasterized depth buffer
+//--------------------------------------------------------------------------------
+void AABBoxRasterizerAVXMT::DepthTestAABBoxBand(UINT band, UINT taskId)
+{
+	const UINT *pBandStart = GetBandStart(taskId);
+	for(UINT i = pBandStart[band]; i < pBandStart[band + 1]; i++)
+	{
+		mpTransformedAABBox[mpBandOccludees[i]].RasterizeAndDepthTestAABBoxAVX(mpRenderTargetPixels, mpHiZBuffer, mpTileTriangleCounts, mDesc);
+	}
+}
\ No newline at end of file
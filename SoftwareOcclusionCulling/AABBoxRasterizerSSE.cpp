@@ -17,38 +17,110 @@
 
 #include "AABBoxRasterizerSSE.h"
 
+// Min (0) or max (1) of the box on each axis for each vertex, in the vertex order the
+// box triangles of TransformedAABBoxSSE are indexed with
+static const UINT AABB_VERTEX_CORNER[AABB_VERTICES][3] =
+{
+	{1, 1, 1}, {0, 1, 1}, {0, 1, 0}, {1, 1, 0},
+	{1, 0, 0}, {1, 0, 1}, {0, 0, 1}, {0, 0, 0},
+};
+
 AABBoxRasterizerSSE::AABBoxRasterizerSSE()
 	: mNumModels(0),
 	  mpTransformedAABBox(NULL),
 	  mpWorldBoxes(NULL),
 	  mpBBoxVisible(NULL),
 	  mpNumTriangles(NULL),
+	  mpBoxData(NULL),
+	  mpBoxRadiusSq(NULL),
+	  mSharesBoxes(false),
+	  mpXformedPos(NULL),
 	  mpRenderTargetPixels(NULL),
+	  mpHiZBuffer(NULL),
+	  mpTileTriangleCounts(NULL),
 	  mpCamera(NULL),
 	  mpVisible(NULL),
 	  mNumCulled(0),
+	  mpShadowVisible(NULL),
+	  mNumShadowCulled(0),
 	  mNumDepthTestTasks(0),
+	  mpOccludeeBand(NULL),
+	  mpBandOccludees(NULL),
+	  mNumBands(0),
+	  mpBandStart(NULL),
+	  mpBandNext(NULL),
+	  mpBandTaskData(NULL),
+	  mpBandDepends(NULL),
 	  mOccludeeSizeThreshold(0.0f),
 	  mTimeCounter(0)
 {
-	mViewMatrix = (__m128*)_aligned_malloc(sizeof(float) * 4 * 4, 16);
-	mProjMatrix = (__m128*)_aligned_malloc(sizeof(float) * 4 * 4, 16);
+	for(UINT i = 0; i < 3; i++)
+	{
+		mpBoxCenter[i] = NULL;
+		mpBoxHalf[i] = NULL;
+	}
+	for(UINT i = 0; i < 16; i++)
+	{
+		mpBoxWorld[i] = NULL;
+	}
+	mViewProjMatrix = float4x4Identity();
+	mViewProjViewportMatrix = mDesc.mViewportMatrix;
 
 	for(UINT i = 0; i < AVG_COUNTER; i++)
 	{
 		mDepthTestTime[i] = 0.0;
 	}
+
+	AllocBands();
 }
 
 AABBoxRasterizerSSE::~AABBoxRasterizerSSE()
 {
-	_aligned_free(mViewMatrix);
-	_aligned_free(mProjMatrix);
+	if(!mSharesBoxes)
+	{
+		_aligned_free(mpBoxData);
+		SAFE_DELETE_ARRAY(mpWorldBoxes);
+		SAFE_DELETE_ARRAY(mpNumTriangles);
+	}
+	_aligned_free(mpXformedPos);
 	SAFE_DELETE_ARRAY(mpVisible);
+	SAFE_DELETE_ARRAY(mpShadowVisible);
 	SAFE_DELETE_ARRAY(mpTransformedAABBox);
-	SAFE_DELETE_ARRAY(mpWorldBoxes);
 	SAFE_DELETE_ARRAY(mpBBoxVisible);
-	SAFE_DELETE_ARRAY(mpNumTriangles);
+	SAFE_DELETE_ARRAY(mpOccludeeBand);
+	SAFE_DELETE_ARRAY(mpBandOccludees);
+	ReleaseBands();
+}
+
+//--------------------------------------------------------------------
+// Allocates the per band data for the Hi-Z strips of mDesc
+//--------------------------------------------------------------------
+void AABBoxRasterizerSSE::AllocBands()
+{
+	ReleaseBands();
+
+	mNumBands = mDesc.GetNumOccludeeBands();
+	mpBandStart = new UINT[MAX_DEPTH_TEST_TASKS * (mNumBands + 1)];
+	mpBandNext = new UINT[MAX_DEPTH_TEST_TASKS * mNumBands];
+	mpBandTaskData = new BandTaskData[mNumBands];
+	mpBandDepends = new TASKSETHANDLE[mNumBands];
+	mpAABBoxDepthTestBand = new TASKSETHANDLE[mNumBands];
+	for(UINT i = 0; i < mNumBands; i++)
+	{
+		mpBandTaskData[i].mpRasterizer = this;
+		mpBandTaskData[i].mBand = i;
+		mpAABBoxDepthTestBand[i] = TASKSETHANDLE_INVALID;
+	}
+}
+
+void AABBoxRasterizerSSE::ReleaseBands()
+{
+	SAFE_DELETE_ARRAY(mpBandStart);
+	SAFE_DELETE_ARRAY(mpBandNext);
+	SAFE_DELETE_ARRAY(mpBandTaskData);
+	SAFE_DELETE_ARRAY(mpBandDepends);
+	SAFE_DELETE_ARRAY(mpAABBoxDepthTestBand);
+	mNumBands = 0;
 }
 
 //--------------------------------------------------------------------
@@ -58,6 +130,11 @@ AABBoxRasterizerSSE::~AABBoxRasterizerSSE()
 //   vertex and index list
 //--------------------------------------------------------------------
 void AABBoxRasterizerSSE::CreateTransformedAABBoxes(CPUTAssetSet **pAssetSet, UINT numAssetSets)
+{
+	CreateTransformedAABBoxes(pAssetSet, numAssetSets, NULL);
+}
+
+void AABBoxRasterizerSSE::CreateTransformedAABBoxes(CPUTAssetSet **pAssetSet, UINT numAssetSets, AABBoxRasterizerSSE *pSharedRasterizer)
 {
 	for(UINT assetId = 0;  assetId < numAssetSets; assetId++)
 	{
@@ -74,11 +151,58 @@ void AABBoxRasterizerSSE::CreateTransformedAABBoxes(CPUTAssetSet **pAssetSet, UI
 		}
 	}
 
+	ASSERT(!pSharedRasterizer || (pSharedRasterizer != this && pSharedRasterizer->mNumModels == mNumModels), _L("The shared rasterizer has other occludees"));
+
 	mpVisible = new bool[mNumModels];
+	mpShadowVisible = new bool[mNumModels];
 	mpTransformedAABBox = new TransformedAABBoxSSE[mNumModels];
-	mpWorldBoxes = new WorldBBox[mNumModels];
 	mpBBoxVisible = new bool[mNumModels];
+	mpOccludeeBand = new UINT[mNumModels];
+	mpBandOccludees = new UINT[mNumModels];
+	mpXformedPos = (__m128*)_aligned_malloc(sizeof(__m128) * AABB_VERTICES * mNumModels, 32);
+	for(UINT modelId = 0; modelId < mNumModels; modelId++)
+	{
+		mpTransformedAABBox[modelId].SetXformedPos(&mpXformedPos[modelId * AABB_VERTICES]);
+		mpTransformedAABBox[modelId].SetVisible(&mpVisible[modelId]);
+	}
+
+	// The boxes of the occludees don't depend on the view
+	if(pSharedRasterizer)
+	{
+		mSharesBoxes = true;
+		mpWorldBoxes = pSharedRasterizer->mpWorldBoxes;
+		mpNumTriangles = pSharedRasterizer->mpNumTriangles;
+		mpBoxData = pSharedRasterizer->mpBoxData;
+		for(UINT i = 0; i < 3; i++)
+		{
+			mpBoxCenter[i] = pSharedRasterizer->mpBoxCenter[i];
+			mpBoxHalf[i] = pSharedRasterizer->mpBoxHalf[i];
+		}
+		mpBoxRadiusSq = pSharedRasterizer->mpBoxRadiusSq;
+		for(UINT i = 0; i < 16; i++)
+		{
+			mpBoxWorld[i] = pSharedRasterizer->mpBoxWorld[i];
+		}
+		return;
+	}
+
+	mpWorldBoxes = new WorldBBox[mNumModels];
 	mpNumTriangles = new UINT[mNumModels];
+
+	// 3 + 3 + 1 + 16 arrays of box data, the padding boxes stay zero
+	UINT numPaddedModels = (mNumModels + 2 * AVX - 1) / AVX * AVX;
+	mpBoxData = (float*)_aligned_malloc(sizeof(float) * 23 * numPaddedModels, 32);
+	memset(mpBoxData, 0, sizeof(float) * 23 * numPaddedModels);
+	for(UINT i = 0; i < 3; i++)
+	{
+		mpBoxCenter[i] = mpBoxData + i * numPaddedModels;
+		mpBoxHalf[i] = mpBoxData + (3 + i) * numPaddedModels;
+	}
+	mpBoxRadiusSq = mpBoxData + 6 * numPaddedModels;
+	for(UINT i = 0; i < 16; i++)
+	{
+		mpBoxWorld[i] = mpBoxData + (7 + i) * numPaddedModels;
+	}
 	
 	for(UINT assetId = 0, modelId = 0; assetId < numAssetSets; assetId++)
 	{
@@ -92,7 +216,22 @@ void AABBoxRasterizerSSE::CreateTransformedAABBoxes(CPUTAssetSet **pAssetSet, UI
 				CPUTModelDX11 *pModel = (CPUTModelDX11*)pRenderNode;
 				pModel = (CPUTModelDX11*)pRenderNode;
 	
-				mpTransformedAABBox[modelId].CreateAABBVertexIndexList(pModel);
+				float3 center, half;
+				pModel->GetBoundsObjectSpace(&center, &half);
+				mpBoxCenter[0][modelId] = center.x;
+				mpBoxCenter[1][modelId] = center.y;
+				mpBoxCenter[2][modelId] = center.z;
+				mpBoxHalf[0][modelId] = half.x;
+				mpBoxHalf[1][modelId] = half.y;
+				mpBoxHalf[2][modelId] = half.z;
+				mpBoxRadiusSq[modelId] = half.lengthSq();
+
+				float *pWorld = (float*)pModel->GetWorldMatrix();
+				for(UINT i = 0; i < 16; i++)
+				{
+					mpBoxWorld[i][modelId] = pWorld[i];
+				}
+
 				pModel->GetBoundsWorldSpace(&mpWorldBoxes[modelId].mCenter, &mpWorldBoxes[modelId].mHalf);
 				mpNumTriangles[modelId] = 0;
 				for(int meshId = 0; meshId < pModel->GetMeshCount(); meshId++)
@@ -106,17 +245,28 @@ void AABBoxRasterizerSSE::CreateTransformedAABBoxes(CPUTAssetSet **pAssetSet, UI
 	}
 }
 
-void AABBoxRasterizerSSE::SetViewProjMatrix(float4x4 *viewMatrix, float4x4 *projMatrix)
+//-----------------------------------------------------------------------------
+// The occludee boxes are transformed with the viewport matrix of the new size
+// and the bands are allocated for its Hi-Z strips
+//-----------------------------------------------------------------------------
+void AABBoxRasterizerSSE::SetDepthBufferDesc(const DepthBufferDesc &desc)
 {
-	mViewMatrix[0] = _mm_loadu_ps((float*)&viewMatrix->r0);
-	mViewMatrix[1] = _mm_loadu_ps((float*)&viewMatrix->r1);
-	mViewMatrix[2] = _mm_loadu_ps((float*)&viewMatrix->r2);
-	mViewMatrix[3] = _mm_loadu_ps((float*)&viewMatrix->r3);
+	mDesc = desc;
+	mViewProjViewportMatrix = mViewProjMatrix * mDesc.mViewportMatrix;
+	if((UINT)desc.GetNumOccludeeBands() != mNumBands)
+	{
+		AllocBands();
+	}
+}
 
-	mProjMatrix[0] = _mm_loadu_ps((float*)&projMatrix->r0);
-	mProjMatrix[1] = _mm_loadu_ps((float*)&projMatrix->r1);
-	mProjMatrix[2] = _mm_loadu_ps((float*)&projMatrix->r2);
-	mProjMatrix[3] = _mm_loadu_ps((float*)&projMatrix->r3);
+//-----------------------------------------------------------------------------
+// The view, projection and viewport matrices are the same for all the boxes,
+// they are combined once here and each box only multiplies its world matrix
+//-----------------------------------------------------------------------------
+void AABBoxRasterizerSSE::SetViewProjMatrix(float4x4 *viewMatrix, float4x4 *projMatrix)
+{
+	mViewProjMatrix = *viewMatrix * *projMatrix;
+	mViewProjViewportMatrix = mViewProjMatrix * mDesc.mViewportMatrix;
 }
 
 //------------------------------------------------------------------------
@@ -163,6 +313,10 @@ void AABBoxRasterizerSSE::Render(CPUTAssetSet **pAssetSet,
 {
 	int count = 0;
 
+	// Size test all the boxes, a box that is too small gets OCCLUDEE_NOT_TESTED and is not visible
+	ResetInsideFrustum();
+	TransformAABBoxes(0, mNumModels);
+
 	for(UINT assetId = 0, modelId = 0; assetId < numAssetSets; assetId++)
 	{
 		for(UINT nodeId = 0; nodeId < pAssetSet[assetId]->GetAssetCount(); nodeId++)
@@ -172,7 +326,7 @@ void AABBoxRasterizerSSE::Render(CPUTAssetSet **pAssetSet,
 			ASSERT((CPUT_SUCCESS == result), _L ("Failed getting asset by index")); 
 			if(pRenderNode->IsModel())
 			{
-				if(!mpTransformedAABBox[modelId].IsTooSmall(mViewMatrix, mProjMatrix, mpCamera))
+				if(mpVisible[modelId] || mpOccludeeBand[modelId] != OCCLUDEE_NOT_TESTED)
 				{
 					CPUTModelDX11* model = (CPUTModelDX11*)pRenderNode;
 					model = (CPUTModelDX11*)pRenderNode;
@@ -193,4 +347,433 @@ void AABBoxRasterizerSSE::CalcInsideFrustum(CPUTFrustum *pFrustum, UINT start, U
 	{
 		mpBBoxVisible[i] = pFrustum->IsVisible(mpWorldBoxes[i].mCenter, mpWorldBoxes[i].mHalf);
 	}
+}
+
+//-----------------------------------------------------------------------------
+// Keeps the shadow casters whose shadow can be seen. The occludees have to be
+// depth tested from the light's view first, a caster that is hidden from the
+// light only shadows what hides it. The shadow volume of a visible caster is
+// its box swept away from the light up to the light's far plane, which lies in
+// the bounds of the box and of its projection from the light onto the far
+// plane. The caster is dropped when those bounds are outside the view frustum.
+// Casters that are not all in front of the light are kept
+//-----------------------------------------------------------------------------
+void AABBoxRasterizerSSE::CalcShadowVisible(CPUTCamera *pLight, CPUTFrustum *pViewFrustum)
+{
+	float3 lightPosition = pLight->GetPosition();
+	float3 lightLook = pLight->GetLook();
+	float farDistance = pLight->GetFarPlaneDistance();
+
+	mNumShadowCulled = 0;
+	for(UINT i = 0; i < mNumModels; i++)
+	{
+		mpShadowVisible[i] = mpVisible[i];
+		if(mpVisible[i])
+		{
+			float3 center = mpWorldBoxes[i].mCenter;
+			float3 half = mpWorldBoxes[i].mHalf;
+			float3 volumeMin = center - half;
+			float3 volumeMax = center + half;
+
+			bool inFront = true;
+			for(UINT corner = 0; corner < 8 && inFront; corner++)
+			{
+				float3 toCorner = center - lightPosition;
+				toCorner.x += (corner & 1) ? half.x : -half.x;
+				toCorner.y += (corner & 2) ? half.y : -half.y;
+				toCorner.z += (corner & 4) ? half.z : -half.z;
+
+				float distance = dot3(toCorner, lightLook);
+				inFront = distance > 0.0f;
+				if(inFront)
+				{
+					float3 projected = lightPosition + toCorner * (farDistance / distance);
+					volumeMin = Min(volumeMin, projected);
+					volumeMax = Max(volumeMax, projected);
+				}
+			}
+
+			if(inFront)
+			{
+				mpShadowVisible[i] = pViewFrustum->IsVisible((volumeMin + volumeMax) * 0.5f, (volumeMax - volumeMin) * 0.5f);
+			}
+		}
+		mNumShadowCulled += mpShadowVisible[i] ? 0 : 1;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Transforms the occludee boxes start to end - 1 to screen space SSE boxes at
+// a time, each lane works on one box. The size and near plane tests run on the
+// whole batch before the transformed vertices are written to the boxes in the
+// layout of the SSE depth test
+//-----------------------------------------------------------------------------
+void AABBoxRasterizerSSE::TransformAABBoxes(UINT start, UINT end)
+{
+	const float *pViewProjViewport = (const float*)&mViewProjViewportMatrix;
+	float tanOfHalfFov = tanf(mpCamera->GetFov() * 0.5f);
+
+	// A box is too small when radius^2 / w / tan(fov / 2) is less than threshold^2,
+	// the radius is compared against threshold^2 * tan(fov / 2) * w instead
+	__m128 sizeThreshold = _mm_set1_ps(mOccludeeSizeThreshold * mOccludeeSizeThreshold * tanOfHalfFov);
+	__m128 zero = _mm_setzero_ps();
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 lastRow = _mm_set1_ps((float)(mDesc.mHeight - 1));
+
+	for(UINT i = start; i < end; i += SSE)
+	{
+		// World * view * projection * viewport matrix of each box
+		__m128 matrix[16];
+		for(UINT row = 0; row < 4; row++)
+		{
+			__m128 world0 = _mm_loadu_ps(&mpBoxWorld[row * 4 + 0][i]);
+			__m128 world1 = _mm_loadu_ps(&mpBoxWorld[row * 4 + 1][i]);
+			__m128 world2 = _mm_loadu_ps(&mpBoxWorld[row * 4 + 2][i]);
+			__m128 world3 = _mm_loadu_ps(&mpBoxWorld[row * 4 + 3][i]);
+			for(UINT col = 0; col < 4; col++)
+			{
+				__m128 element = _mm_mul_ps(world0, _mm_set1_ps(pViewProjViewport[0 * 4 + col]));
+				element = _mm_add_ps(element, _mm_mul_ps(world1, _mm_set1_ps(pViewProjViewport[1 * 4 + col])));
+				element = _mm_add_ps(element, _mm_mul_ps(world2, _mm_set1_ps(pViewProjViewport[2 * 4 + col])));
+				element = _mm_add_ps(element, _mm_mul_ps(world3, _mm_set1_ps(pViewProjViewport[3 * 4 + col])));
+				matrix[row * 4 + col] = element;
+			}
+		}
+
+		__m128 center[3], half[3];
+		for(UINT axis = 0; axis < 3; axis++)
+		{
+			center[axis] = _mm_loadu_ps(&mpBoxCenter[axis][i]);
+			half[axis] = _mm_loadu_ps(&mpBoxHalf[axis][i]);
+		}
+
+		// Size test with the w of the box center, a box with w <= 1 is never too small
+		__m128 centerW = _mm_mul_ps(center[0], matrix[3]);
+		centerW = _mm_add_ps(centerW, _mm_mul_ps(center[1], matrix[7]));
+		centerW = _mm_add_ps(centerW, _mm_mul_ps(center[2], matrix[11]));
+		centerW = _mm_add_ps(centerW, matrix[15]);
+		__m128 tooSmall = _mm_and_ps(_mm_cmpgt_ps(centerW, one), _mm_cmplt_ps(_mm_loadu_ps(&mpBoxRadiusSq[i]), _mm_mul_ps(sizeThreshold, centerW)));
+
+		// Each vertex takes the min or the max of the box on each axis, the products with
+		// the matrix rows are shared by the vertices. [axis][min or max][component]
+		__m128 terms[3][2][4];
+		for(UINT axis = 0; axis < 3; axis++)
+		{
+			__m128 boxMin = _mm_sub_ps(center[axis], half[axis]);
+			__m128 boxMax = _mm_add_ps(center[axis], half[axis]);
+			for(UINT comp = 0; comp < 4; comp++)
+			{
+				terms[axis][0][comp] = _mm_mul_ps(boxMin, matrix[axis * 4 + comp]);
+				terms[axis][1][comp] = _mm_mul_ps(boxMax, matrix[axis * 4 + comp]);
+			}
+		}
+
+		UINT numBoxes = min(end - i, (UINT)SSE);
+		__m128 minY = _mm_set1_ps(FLT_MAX), maxY = _mm_set1_ps(-FLT_MAX);
+		__m128 minW = _mm_set1_ps(FLT_MAX), maxW = _mm_set1_ps(-FLT_MAX);
+		for(UINT v = 0; v < AABB_VERTICES; v++)
+		{
+			const UINT *pCorner = AABB_VERTEX_CORNER[v];
+			__m128 xformed[4];
+			for(UINT comp = 0; comp < 4; comp++)
+			{
+				xformed[comp] = _mm_add_ps(terms[0][pCorner[0]][comp], terms[1][pCorner[1]][comp]);
+				xformed[comp] = _mm_add_ps(xformed[comp], terms[2][pCorner[2]][comp]);
+				xformed[comp] = _mm_add_ps(xformed[comp], matrix[12 + comp]);
+			}
+
+			__m128 oneOverW = _mm_div_ps(one, _mm_max_ps(xformed[3], _mm_set1_ps(0.0000001f)));
+			xformed[0] = _mm_mul_ps(xformed[0], oneOverW);
+			xformed[1] = _mm_mul_ps(xformed[1], oneOverW);
+			xformed[2] = _mm_mul_ps(xformed[2], oneOverW);
+			xformed[3] = oneOverW;
+
+			minY = _mm_min_ps(minY, xformed[1]);
+			maxY = _mm_max_ps(maxY, xformed[1]);
+			minW = _mm_min_ps(minW, xformed[3]);
+			maxW = _mm_max_ps(maxW, xformed[3]);
+
+			// One X, Y, Z, 1/W row per box
+			_MM_TRANSPOSE4_PS(xformed[0], xformed[1], xformed[2], xformed[3]);
+			for(UINT lane = 0; lane < numBoxes; lane++)
+			{
+				mpXformedPos[(i + lane) * AABB_VERTICES + v] = xformed[lane];
+			}
+		}
+
+		// If W (holding 1/w in our case) is not between 0 and 1,
+		// then a vertex is behind near clip plane (1.0 in our case).
+		__m128 nearClip = _mm_or_ps(_mm_cmple_ps(minW, zero), _mm_cmpge_ps(maxW, one));
+
+		// Depth buffer rows the depth test can read. The rasterizer snaps vertices to whole
+		// pixels and walks 2x2 quads, so one row is added on each side
+		int startY[SSE], endY[SSE];
+		_mm_storeu_si128((__m128i*)startY, _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_sub_ps(_mm_floor_ps(minY), one), zero), lastRow)));
+		_mm_storeu_si128((__m128i*)endY, _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_ceil_ps(maxY), one), zero), lastRow)));
+
+		SetOccludeeBands(i, numBoxes, ~_mm_movemask_ps(tooSmall), _mm_movemask_ps(nearClip), startY, endY);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Transposes 8 rows of 8 floats in place
+//-----------------------------------------------------------------------------
+static inline void Transpose8x8(__m256 *pRows)
+{
+	__m256 t0 = _mm256_unpacklo_ps(pRows[0], pRows[1]);
+	__m256 t1 = _mm256_unpackhi_ps(pRows[0], pRows[1]);
+	__m256 t2 = _mm256_unpacklo_ps(pRows[2], pRows[3]);
+	__m256 t3 = _mm256_unpackhi_ps(pRows[2], pRows[3]);
+	__m256 t4 = _mm256_unpacklo_ps(pRows[4], pRows[5]);
+	__m256 t5 = _mm256_unpackhi_ps(pRows[4], pRows[5]);
+	__m256 t6 = _mm256_unpacklo_ps(pRows[6], pRows[7]);
+	__m256 t7 = _mm256_unpackhi_ps(pRows[6], pRows[7]);
+
+	__m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+	pRows[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+	pRows[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+	pRows[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+	pRows[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+	pRows[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+	pRows[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+	pRows[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+	pRows[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+//-----------------------------------------------------------------------------
+// AVX version of TransformAABBoxes. Transforms AVX boxes at a time and writes
+// the transformed vertices to the boxes in the layout of the AVX depth test
+//-----------------------------------------------------------------------------
+void AABBoxRasterizerSSE::TransformAABBoxesAVX(UINT start, UINT end)
+{
+	const float *pViewProjViewport = (const float*)&mViewProjViewportMatrix;
+	float tanOfHalfFov = tanf(mpCamera->GetFov() * 0.5f);
+
+	__m256 sizeThreshold = _mm256_set1_ps(mOccludeeSizeThreshold * mOccludeeSizeThreshold * tanOfHalfFov);
+	__m256 zero = _mm256_setzero_ps();
+	__m256 one = _mm256_set1_ps(1.0f);
+	__m256 lastRow = _mm256_set1_ps((float)(mDesc.mHeight - 1));
+
+	for(UINT i = start; i < end; i += AVX)
+	{
+		__m256 matrix[16];
+		for(UINT row = 0; row < 4; row++)
+		{
+			__m256 world0 = _mm256_loadu_ps(&mpBoxWorld[row * 4 + 0][i]);
+			__m256 world1 = _mm256_loadu_ps(&mpBoxWorld[row * 4 + 1][i]);
+			__m256 world2 = _mm256_loadu_ps(&mpBoxWorld[row * 4 + 2][i]);
+			__m256 world3 = _mm256_loadu_ps(&mpBoxWorld[row * 4 + 3][i]);
+			for(UINT col = 0; col < 4; col++)
+			{
+				__m256 element = _mm256_mul_ps(world0, _mm256_set1_ps(pViewProjViewport[0 * 4 + col]));
+				element = _mm256_add_ps(element, _mm256_mul_ps(world1, _mm256_set1_ps(pViewProjViewport[1 * 4 + col])));
+				element = _mm256_add_ps(element, _mm256_mul_ps(world2, _mm256_set1_ps(pViewProjViewport[2 * 4 + col])));
+				element = _mm256_add_ps(element, _mm256_mul_ps(world3, _mm256_set1_ps(pViewProjViewport[3 * 4 + col])));
+				matrix[row * 4 + col] = element;
+			}
+		}
+
+		__m256 center[3], half[3];
+		for(UINT axis = 0; axis < 3; axis++)
+		{
+			center[axis] = _mm256_loadu_ps(&mpBoxCenter[axis][i]);
+			half[axis] = _mm256_loadu_ps(&mpBoxHalf[axis][i]);
+		}
+
+		__m256 centerW = _mm256_mul_ps(center[0], matrix[3]);
+		centerW = _mm256_add_ps(centerW, _mm256_mul_ps(center[1], matrix[7]));
+		centerW = _mm256_add_ps(centerW, _mm256_mul_ps(center[2], matrix[11]));
+		centerW = _mm256_add_ps(centerW, matrix[15]);
+		__m256 tooSmall = _mm256_and_ps(_mm256_cmp_ps(centerW, one, _CMP_GT_OQ),
+										_mm256_cmp_ps(_mm256_loadu_ps(&mpBoxRadiusSq[i]), _mm256_mul_ps(sizeThreshold, centerW), _CMP_LT_OQ));
+
+		__m256 terms[3][2][4];
+		for(UINT axis = 0; axis < 3; axis++)
+		{
+			__m256 boxMin = _mm256_sub_ps(center[axis], half[axis]);
+			__m256 boxMax = _mm256_add_ps(center[axis], half[axis]);
+			for(UINT comp = 0; comp < 4; comp++)
+			{
+				terms[axis][0][comp] = _mm256_mul_ps(boxMin, matrix[axis * 4 + comp]);
+				terms[axis][1][comp] = _mm256_mul_ps(boxMax, matrix[axis * 4 + comp]);
+			}
+		}
+
+		// [component][vertex], the lanes are boxes until the transpose below
+		__m256 xformed[4][AABB_VERTICES];
+		__m256 minY = _mm256_set1_ps(FLT_MAX), maxY = _mm256_set1_ps(-FLT_MAX);
+		__m256 minW = _mm256_set1_ps(FLT_MAX), maxW = _mm256_set1_ps(-FLT_MAX);
+		for(UINT v = 0; v < AABB_VERTICES; v++)
+		{
+			const UINT *pCorner = AABB_VERTEX_CORNER[v];
+			for(UINT comp = 0; comp < 4; comp++)
+			{
+				xformed[comp][v] = _mm256_add_ps(terms[0][pCorner[0]][comp], terms[1][pCorner[1]][comp]);
+				xformed[comp][v] = _mm256_add_ps(xformed[comp][v], terms[2][pCorner[2]][comp]);
+				xformed[comp][v] = _mm256_add_ps(xformed[comp][v], matrix[12 + comp]);
+			}
+
+			__m256 oneOverW = _mm256_div_ps(one, _mm256_max_ps(xformed[3][v], _mm256_set1_ps(0.0000001f)));
+			xformed[0][v] = _mm256_mul_ps(xformed[0][v], oneOverW);
+			xformed[1][v] = _mm256_mul_ps(xformed[1][v], oneOverW);
+			xformed[2][v] = _mm256_mul_ps(xformed[2][v], oneOverW);
+			xformed[3][v] = oneOverW;
+
+			minY = _mm256_min_ps(minY, xformed[1][v]);
+			maxY = _mm256_max_ps(maxY, xformed[1][v]);
+			minW = _mm256_min_ps(minW, xformed[3][v]);
+			maxW = _mm256_max_ps(maxW, xformed[3][v]);
+		}
+
+		// One register of the 8 vertices per component and box
+		UINT numBoxes = min(end - i, (UINT)AVX);
+		for(UINT comp = 0; comp < 4; comp++)
+		{
+			Transpose8x8(xformed[comp]);
+			for(UINT lane = 0; lane < numBoxes; lane++)
+			{
+				((__m256*)&mpXformedPos[(i + lane) * AABB_VERTICES])[comp] = xformed[comp][lane];
+			}
+		}
+
+		__m256 nearClip = _mm256_or_ps(_mm256_cmp_ps(minW, zero, _CMP_LE_OQ), _mm256_cmp_ps(maxW, one, _CMP_GE_OQ));
+
+		int startY[AVX], endY[AVX];
+		_mm256_storeu_si256((__m256i*)startY, _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_floor_ps(minY), one), zero), lastRow)));
+		_mm256_storeu_si256((__m256i*)endY, _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_add_ps(_mm256_ceil_ps(maxY), one), zero), lastRow)));
+
+		SetOccludeeBands(i, numBoxes, ~_mm256_movemask_ps(tooSmall), _mm256_movemask_ps(nearClip), startY, endY);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Sets the visibility and the band of a batch of transformed boxes from the
+// lane masks of the boxes that are large enough and that cross the near plane
+//-----------------------------------------------------------------------------
+void AABBoxRasterizerSSE::SetOccludeeBands(UINT start, UINT numBoxes, int largeEnough, int nearClip, const int *pStartY, const int *pEndY)
+{
+	for(UINT lane = 0; lane < numBoxes; lane++)
+	{
+		UINT i = start + lane;
+		mpVisible[i] = false;
+		mpOccludeeBand[i] = OCCLUDEE_NOT_TESTED;
+		if(mpTransformedAABBox[i].IsInsideViewFrustum() && (largeEnough & (1 << lane)))
+		{
+			if(nearClip & (1 << lane))
+			{
+				mpVisible[i] = true;
+			}
+			else
+			{
+				mpOccludeeBand[i] = CalcOccludeeBand(pStartY[lane], pEndY[lane]);
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Returns the band of an occludee that reads the depth buffer rows startY to 
+// endY. The band of the bottom strip also waits for the strip above it
+//-----------------------------------------------------------------------------
+UINT AABBoxRasterizerSSE::CalcOccludeeBand(int startY, int endY)
+{
+	UINT firstStrip = startY / HIZ_STRIP_HEIGHT;
+	UINT lastStrip = endY / HIZ_STRIP_HEIGHT;
+	return lastStrip - firstStrip <= 1 ? lastStrip : mDesc.GetNumHiZStrips();
+}
+
+//-----------------------------------------------------------------------------
+// Sorts the occludees of a depth test task's range by band so that each band 
+// task set can go through its occludees without searching
+//-----------------------------------------------------------------------------
+void AABBoxRasterizerSSE::SortOccludeesByBand(UINT taskId, UINT start, UINT end)
+{
+	UINT *pBandStart = &mpBandStart[taskId * (mNumBands + 1)];
+	UINT *pNext = &mpBandNext[taskId * mNumBands];
+	for(UINT band = 0; band <= mNumBands; band++)
+	{
+		pBandStart[band] = 0;
+	}
+	for(UINT i = start; i < end; i++)
+	{
+		if(mpOccludeeBand[i] != OCCLUDEE_NOT_TESTED)
+		{
+			pBandStart[mpOccludeeBand[i] + 1]++;
+		}
+	}
+
+	pBandStart[0] = start;
+	for(UINT band = 0; band < mNumBands; band++)
+	{
+		pBandStart[band + 1] += pBandStart[band];
+		pNext[band] = pBandStart[band];
+	}
+
+	for(UINT i = start; i < end; i++)
+	{
+		if(mpOccludeeBand[i] != OCCLUDEE_NOT_TESTED)
+		{
+			mpBandOccludees[pNext[mpOccludeeBand[i]]++] = i;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Creates the task set that transforms and bins the occludees, which does not 
+// need the depth buffer, and one depth test task set per band that waits for 
+// it and for the depth buffer strips the band reads. There are more bands than
+// a task set can have successors, so the bands wait for the bin task set through
+// a fan out
+//-----------------------------------------------------------------------------
+void AABBoxRasterizerSSE::CreateBandDepthTestTasks(TASKSETFUNC transformAndBin, TASKSETFUNC depthTestBand)
+{
+	ASSERT(GetNumPassTaskSets() <= MAX_PASS_TASKSETS, _L("The occludee pass needs more task sets than the task manager has for it"));
+
+	gTaskMgr.CreateTaskSet(transformAndBin, this, mNumDepthTestTasks, NULL, 0, "Bin AABBox", &mAABBoxBin);
+	mAABBoxBinFanOut.Create(mAABBoxBin, mNumBands);
+
+	UINT numStrips = mNumBands - 1;
+	for(UINT band = 0; band < mNumBands; band++)
+	{
+		// The last band holds the tall occludees and waits for the whole depth buffer
+		UINT firstStrip = (band > 0 && band < numStrips) ? band - 1 : 0;
+		UINT lastStrip = band < numStrips ? band : numStrips - 1;
+
+		UINT numDepends = 0;
+		mpBandDepends[numDepends++] = mAABBoxBinFanOut.Get(band);
+		for(UINT strip = firstStrip; strip <= lastStrip; strip++)
+		{
+			mpBandDepends[numDepends++] = mpDepthStripsDone[strip];
+		}
+		gTaskMgr.CreateTaskSet(depthTestBand, &mpBandTaskData[band], mNumDepthTestTasks, mpBandDepends, numDepends, "AABBox Depth Test", &mpAABBoxDepthTestBand[band]);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Waits for the band depth test task sets and releases them
+//-----------------------------------------------------------------------------
+void AABBoxRasterizerSSE::WaitForBandDepthTestTasks()
+{
+	// Wait for the task sets
+	for(UINT band = 0; band < mNumBands; band++)
+	{
+		gTaskMgr.WaitForSet(mpAABBoxDepthTestBand[band]);
+	}
+	// Release the task sets
+	mAABBoxBinFanOut.Release();
+	gTaskMgr.ReleaseHandle(mAABBoxBin);
+	mAABBoxBin = TASKSETHANDLE_INVALID;
+	for(UINT band = 0; band < mNumBands; band++)
+	{
+		gTaskMgr.ReleaseHandle(mpAABBoxDepthTestBand[band]);
+		mpAABBoxDepthTestBand[band] = TASKSETHANDLE_INVALID;
+	}
 }
\ No newline at end of file
@@ -20,6 +20,7 @@
 
 #include "AABBoxRasterizer.h"
 #include "TransformedAABBoxSSE.h"
+#include "TaskSetFanOut.h"
 
 class AABBoxRasterizerSSE : public AABBoxRasterizer
 {
@@ -27,6 +28,9 @@ class AABBoxRasterizerSSE : public AABBoxRasterizer
 		AABBoxRasterizerSSE();
 		virtual ~AABBoxRasterizerSSE();
 		void CreateTransformedAABBoxes(CPUTAssetSet **pAssetSet, UINT numAssetSets);
+		// Creates the occludees of another view of the same asset sets, they share the
+		// boxes of pSharedRasterizer, which has to outlive them
+		void CreateTransformedAABBoxes(CPUTAssetSet **pAssetSet, UINT numAssetSets, AABBoxRasterizerSSE *pSharedRasterizer);
 		
 		void RenderVisible(CPUTAssetSet **pAssetSet,
 						   CPUTRenderParametersDX &renderParams,
@@ -46,18 +50,23 @@ class AABBoxRasterizerSSE : public AABBoxRasterizer
 
 		void SetViewProjMatrix(float4x4 *viewMatrix, float4x4 *projMatrix);
 		inline void SetCPURenderTargetPixels(UINT *pRenderTargetPixels){mpRenderTargetPixels = pRenderTargetPixels;}
-		inline void SetDepthTestTasks(UINT numTasks) {mNumDepthTestTasks = numTasks;}
-		inline void SetOccludeeSizeThreshold(float occludeeSizeThreshold)
+		void SetDepthBufferDesc(const DepthBufferDesc &desc);
+		inline void SetHiZBuffer(const HiZBuffer *pHiZBuffer){mpHiZBuffer = pHiZBuffer;}
+		inline void SetTileTriangleCounts(const UINT *pTileTriangleCounts){mpTileTriangleCounts = pTileTriangleCounts;}
+		inline void SetDepthTestTasks(UINT numTasks)
 		{
-			for(UINT i = 0; i < mNumModels; i++)
-			{
-				mpTransformedAABBox[i].SetOccludeeSizeThreshold(occludeeSizeThreshold);
-			}
+			ASSERT(numTasks > 0 && numTasks <= MAX_DEPTH_TEST_TASKS, _L("Invalid number of depth test tasks"));
+			mNumDepthTestTasks = numTasks;
 		}
+		inline void SetOccludeeSizeThreshold(float occludeeSizeThreshold){mOccludeeSizeThreshold = occludeeSizeThreshold;}
+		// Task sets the occludee pass holds at once for the bands of the depth buffer
+		inline UINT GetNumPassTaskSets() const {return 1 + TaskSetFanOut::GetNumRelays(mNumBands) + mNumBands;}
 		inline void SetCamera(CPUTCamera *pCamera) {mpCamera = pCamera;}
 
 		inline UINT GetNumOccludees() {return mNumModels;}
 		inline UINT GetNumCulled() {return mNumCulled;}
+		// Visibility of each occludee after the last depth test
+		inline const bool* GetVisible() {return mpVisible;}
 		inline double GetDepthTestTime()
 		{
 			double averageTime = 0.0;
@@ -90,6 +99,13 @@ class AABBoxRasterizerSSE : public AABBoxRasterizer
 
 		void CalcInsideFrustum(CPUTFrustum *pFrustum, UINT start, UINT end);
 
+		// Culls the shadow casters once the occludees were depth tested from the light's view
+		void CalcShadowVisible(CPUTCamera *pLight, CPUTFrustum *pViewFrustum);
+		// Shadow casters whose shadow can be seen, next to the occludees visible from the
+		// light. The sample renders no shadow map, it only counts the casters culled
+		inline const bool* GetShadowVisible() {return mpShadowVisible;}
+		inline UINT GetNumShadowCulled() {return mNumShadowCulled;}
+
 	protected:
 		struct WorldBBox
 		{
@@ -97,18 +113,65 @@ class AABBoxRasterizerSSE : public AABBoxRasterizer
 			float3 mHalf;
 		};
 
+		// Task data of the task sets that depth test one band of occludees
+		struct BandTaskData
+		{
+			AABBoxRasterizerSSE *mpRasterizer;
+			UINT mBand;
+		};
+
+		// Transform the occludee boxes start to end - 1 to screen space, SSE or AVX boxes per
+		// iteration straight from the SoA box arrays. A box that is depth tested gets its band,
+		// the others get OCCLUDEE_NOT_TESTED and are visible if they cross the near plane
+		void TransformAABBoxes(UINT start, UINT end);
+		void TransformAABBoxesAVX(UINT start, UINT end);
+		void SetOccludeeBands(UINT start, UINT numBoxes, int largeEnough, int nearClip, const int *pStartY, const int *pEndY);
+		UINT CalcOccludeeBand(int startY, int endY);
+		void SortOccludeesByBand(UINT taskId, UINT start, UINT end);
+		void CreateBandDepthTestTasks(TASKSETFUNC transformAndBin, TASKSETFUNC depthTestBand);
+		void WaitForBandDepthTestTasks();
+		void AllocBands();
+		void ReleaseBands();
+
+		// First sorted occludee of each band in a depth test task's range, and the end of the last band
+		inline const UINT* GetBandStart(UINT taskId) const {return &mpBandStart[taskId * (mNumBands + 1)];}
+
 		UINT mNumModels;
 		TransformedAABBoxSSE *mpTransformedAABBox;
 		WorldBBox* mpWorldBoxes;
 		bool *mpBBoxVisible;
 		UINT *mpNumTriangles;
-		__m128 *mViewMatrix;
-		__m128 *mProjMatrix;
+
+		// Occludee boxes in SoA form. Each array has room for AVX - 1 boxes past the last one
+		// so that a batch can be loaded from any box, the extra boxes are never written back
+		float *mpBoxData;
+		float *mpBoxCenter[3];		// object space center X, Y, Z
+		float *mpBoxHalf[3];		// object space half extents X, Y, Z
+		float *mpBoxRadiusSq;		// squared length of the half extents
+		float *mpBoxWorld[16];		// world matrix, row by row
+		bool mSharesBoxes;			// the boxes above are another rasterizer's
+		__m128 *mpXformedPos;		// AABB_VERTICES transformed vertices per box
+
+		float4x4 mViewProjMatrix;
+		float4x4 mViewProjViewportMatrix;
 		UINT *mpRenderTargetPixels;
+		DepthBufferDesc mDesc;
+		const HiZBuffer *mpHiZBuffer;
+		const UINT *mpTileTriangleCounts;
 		CPUTCamera *mpCamera;
 		bool *mpVisible;
 		UINT mNumCulled;
+		bool *mpShadowVisible;
+		UINT mNumShadowCulled;
 		UINT mNumDepthTestTasks;
+		UINT *mpOccludeeBand;		// band of each occludee, OCCLUDEE_NOT_TESTED if it is not depth tested
+		UINT *mpBandOccludees;		// occludees sorted by band within each depth test task's range
+		UINT mNumBands;				// occludee bands of the depth buffer size, one more than its Hi-Z strips
+		UINT *mpBandStart;			// mNumBands + 1 per depth test task
+		UINT *mpBandNext;			// mNumBands per depth test task, used while the occludees are sorted
+		BandTaskData *mpBandTaskData;
+		TASKSETHANDLE *mpBandDepends;	// dependencies of the band task set being created
+		TaskSetFanOut mAABBoxBinFanOut;	// the band task sets wait for the bin task set through it
 		float mOccludeeSizeThreshold;
 		UINT mTimeCounter;
 
@@ -84,17 +84,41 @@ void AABBoxRasterizerSSEMT::TransformAABBoxAndDepthTest()
 {
 	mDepthTestTimer.StartTimer();
 
-	gTaskMgr.CreateTaskSet(&AABBoxRasterizerSSEMT::TransformAABBoxAndDepthTest, this, mNumDepthTestTasks, NULL, 0, "Xform Vertices", &mAABBoxDepthTest);
-	// Wait for the task set
-	gTaskMgr.WaitForSet(mAABBoxDepthTest);
-	// Release the task set
-	gTaskMgr.ReleaseHandle(mAABBoxDepthTest);
-	mAABBoxDepthTest = TASKSETHANDLE_INVALID;
+	if(mpDepthStripsDone)
+	{
+		// The occluders are still being rasterized, transform and bin the occludees meanwhile
+		// and depth test each band once the depth buffer strips it reads are done
+		CreateBandDepthTestTasks(&AABBoxRasterizerSSEMT::TransformAndBinAABBox, &AABBoxRasterizerSSEMT::DepthTestAABBoxBand);
+		WaitForBandDepthTestTasks();
+	}
+	else
+	{
+		gTaskMgr.CreateTaskSet(&AABBoxRasterizerSSEMT::TransformAABBoxAndDepthTest, this, mNumDepthTestTasks, NULL, 0, "Xform Vertices", &mAABBoxDepthTest);
+		// Wait for the task set
+		gTaskMgr.WaitForSet(mAABBoxDepthTest);
+		// Release the task set
+		gTaskMgr.ReleaseHandle(mAABBoxDepthTest);
+		mAABBoxDepthTest = TASKSETHANDLE_INVALID;
+	}
 	
 	mDepthTestTime[mTimeCounter++] = mDepthTestTimer.StopTimer();
 	mTimeCounter = mTimeCounter >= AVG_COUNTER ? 0 : mTimeCounter; 
 }
 
+void AABBoxRasterizerSSEMT::StartTransformAABBoxAndDepthTest()
+{
+	ASSERT(mpDepthStripsDone, _L("The occluder pass has to be in flight"));
+	mDepthTestTimer.StartTimer();
+	CreateBandDepthTestTasks(&AABBoxRasterizerSSEMT::TransformAndBinAABBox, &AABBoxRasterizerSSEMT::DepthTestAABBoxBand);
+}
+
+void AABBoxRasterizerSSEMT::WaitForDepthTest()
+{
+	WaitForBandDepthTestTasks();
+	mDepthTestTime[mTimeCounter++] = mDepthTestTimer.StopTimer();
+	mTimeCounter = mTimeCounter >= AVG_COUNTER ? 0 : mTimeCounter;
+}
+
 //--------------------------------------------------------------------------------
 // Determine the batch of occludee models each task should work on
 // For each occludee model in the batch
@@ -121,15 +145,12 @@ void AABBoxRasterizerSSEMT::TransformAABBoxAndDepthTest(UINT taskId)
 		end   = start +  numModelsPerTask2;
 	}
 
+	TransformAABBoxes(start, end);
 	for(UINT i = start; i < end; i++)
 	{
-		mpVisible[i] = false;
-		mpTransformedAABBox[i].SetVisible(&mpVisible[i]);
-		
-		if(mpTransformedAABBox[i].IsInsideViewFrustum() && !mpTransformedAABBox[i].IsTooSmall(mViewMatrix, mProjMatrix, mpCamera))
+		if(mpOccludeeBand[i] != OCCLUDEE_NOT_TESTED)
 		{
-			mpTransformedAABBox[i].TransformAABBox();
-			mpTransformedAABBox[i].RasterizeAndDepthTestAABBox(mpRenderTargetPixels);
+			mpTransformedAABBox[i].RasterizeAndDepthTestAABBox(mpRenderTargetPixels, mpHiZBuffer, mpTileTriangleCounts, mDesc);
 		}
 	}
 }
@@ -138,4 +159,59 @@ void AABBoxRasterizerSSEMT::TransformAABBoxAndDepthTest(VOID* pTaskData, INT con
 {
 	AABBoxRasterizerSSEMT *pAabbox = (AABBoxRasterizerSSEMT*)pTaskData;
 	pAabbox->TransformAABBoxAndDepthTest(taskId);
+}
+
+void AABBoxRasterizerSSEMT::TransformAndBinAABBox(VOID* pTaskData, INT context, UINT taskId, UINT taskCount)
+{
+	AABBoxRasterizerSSEMT *pAabbox = (AABBoxRasterizerSSEMT*)pTaskData;
+	pAabbox->TransformAndBinAABBox(taskId);
+}
+
+//--------------------------------------------------------------------------------
+// Determine the batch of occludee models each task should work on
+// For each occludee model in the batch
+// * Transform the AABBox to screen space
+// * Find the band of depth buffer strips the AABBox is depth tested against
+//--------------------------------------------------------------------------------
+void AABBoxRasterizerSSEMT::TransformAndBinAABBox(UINT taskId)
+{
+	UINT numRemainingModels = mNumModels % mNumDepthTestTasks;
+
+	UINT numModelsPerTask1 = mNumModels / mNumDepthTestTasks + 1;
+	UINT numModelsPerTask2 = mNumModels / mNumDepthTestTasks;
+
+	UINT start, end;
+	if(taskId < numRemainingModels)
+	{
+		start = taskId * numModelsPerTask1;
+		end   = start +  numModelsPerTask1;
+	}
+	else
+	{
+		start = (numRemainingModels * numModelsPerTask1) + ((taskId - numRemainingModels) * numModelsPerTask2);
+		end   = start +  numModelsPerTask2;
+	}
+
+	TransformAABBoxes(start, end);
+	SortOccludeesByBand(taskId, start, end);
+}
+
+void AABBoxRasterizerSSEMT::DepthTestAABBoxBand(VOID* pTaskData, INT context, UINT taskId, UINT taskCount)
+{
+	BandTaskData *pBand = (BandTaskData*)pTaskData;
+	AABBoxRasterizerSSEMT *pAabbox = (AABBoxRasterizerSSEMT*)pBand->mpRasterizer;
+	pAabbox->DepthTestAABBoxBand(pBand->mBand, taskId);
+}
+
+//--------------------------------------------------------------------------------
+// Rasterize and depth test the AABBoxes of one band that the task binned against 
+// the CPU rasterized depth buffer
+//--------------------------------------------------------------------------------
+void AABBoxRasterizerSSEMT::DepthTestAABBoxBand(UINT band, UINT taskId)
+{
+	const UINT *pBandStart = GetBandStart(taskId);
+	for(UINT i = pBandStart[band]; i < pBandStart[band + 1]; i++)
+	{
+		mpTransformedAABBox[mpBandOccludees[i]].RasterizeAndDepthTestAABBox(mpRenderTargetPixels, mpHiZBuffer, mpTileTriangleCounts, mDesc);
+	}
 }
\ No newline at end of file
@@ -28,6 +28,11 @@ class AABBoxRasterizerSSEMT : public AABBoxRasterizerSSE
 
 		void IsInsideViewFrustum(CPUTCamera *pCamera);
 		void TransformAABBoxAndDepthTest();
+		// Creates the transform, bin and band depth test task sets against the depth
+		// strips of the occluder pass in flight and returns without waiting for them,
+		// WaitForDepthTest() waits for the depth test to be done
+		void StartTransformAABBoxAndDepthTest();
+		void WaitForDepthTest();
 
 	private:
 		static void IsInsideViewFrustum(VOID* taskData, INT context, UINT taskId, UINT taskCount);
@@ -35,6 +40,12 @@ class AABBoxRasterizerSSEMT : public AABBoxRasterizerSSE
 
 		static void TransformAABBoxAndDepthTest(VOID* pTaskData, INT context, UINT taskId, UINT taskCount);
 		void TransformAABBoxAndDepthTest(UINT taskId);
+
+		static void TransformAndBinAABBox(VOID* pTaskData, INT context, UINT taskId, UINT taskCount);
+		void TransformAndBinAABBox(UINT taskId);
+
+		static void DepthTestAABBoxBand(VOID* pTaskData, INT context, UINT taskId, UINT taskCount);
+		void DepthTestAABBoxBand(UINT band, UINT taskId);
 };
 
 #endif //AABBOXRASTERIZERSSEMT_H
\ No newline at end of file
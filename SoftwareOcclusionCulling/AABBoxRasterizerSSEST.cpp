@@ -36,7 +36,7 @@ void AABBoxRasterizerSSEST::IsInsideViewFrustum(CPUTCamera *pCamera)
 	mpCamera = pCamera;
 	for(UINT i = 0; i < mNumModels; i++)
 	{
-		mpTransformedAABBox[i].IsInsideViewFrustum(mpCamera);
+		mpTransformedAABBox[i].SetInsideViewFrustum(mpCamera->mFrustum.IsVisible(mpWorldBoxes[i].mCenter, mpWorldBoxes[i].mHalf));
 	}
 }
 
@@ -50,16 +50,13 @@ void AABBoxRasterizerSSEST::TransformAABBoxAndDepthTest()
 {
 	mDepthTestTimer.StartTimer();
 
+	TransformAABBoxes(0, mNumModels);
 	for(UINT i = 0; i < mNumModels; i++)
 	{
-		mpVisible[i] = false;
-		mpTransformedAABBox[i].SetVisible(&mpVisible[i]);
-	
-		if(mpTransformedAABBox[i].IsInsideViewFrustum() && !mpTransformedAABBox[i].IsTooSmall(mViewMatrix, mProjMatrix, mpCamera))
+		if(mpOccludeeBand[i] != OCCLUDEE_NOT_TESTED)
 		{
-			mpTransformedAABBox[i].TransformAABBox();
-			mpTransformedAABBox[i].RasterizeAndDepthTestAABBox(mpRenderTargetPixels);
-		}		
+			mpTransformedAABBox[i].RasterizeAndDepthTestAABBox(mpRenderTargetPixels, mpHiZBuffer, mpTileTriangleCounts, mDesc);
+		}
 	}
 	mDepthTestTime[mTimeCounter++] = mDepthTestTimer.StopTimer();
 	mTimeCounter = mTimeCounter >= AVG_COUNTER ? 0 : mTimeCounter;
@@ -84,6 +84,7 @@ void AABBoxRasterizerScalar::CreateTransformedAABBoxes(CPUTAssetSet **pAssetSet,
 				pModel = (CPUTModelDX11*)pRenderNode;
 		
 				mpTransformedAABBox[modelId].CreateAABBVertexIndexList(pModel);
+				mpTransformedAABBox[modelId].SetViewportMatrix(mDesc.mViewportMatrix);
 				mpNumTriangles[modelId] = 0;
 				for(int meshId = 0; meshId < pModel->GetMeshCount(); meshId++)
 				{
@@ -96,6 +97,18 @@ void AABBoxRasterizerScalar::CreateTransformedAABBoxes(CPUTAssetSet **pAssetSet,
 	}
 }
 
+//-----------------------------------------------------------------------------
+// The occludee boxes are transformed with the viewport matrix of the new size
+//-----------------------------------------------------------------------------
+void AABBoxRasterizerScalar::SetDepthBufferDesc(const DepthBufferDesc &desc)
+{
+	mDesc = desc;
+	for(UINT i = 0; i < mNumModels; i++)
+	{
+		mpTransformedAABBox[i].SetViewportMatrix(desc.mViewportMatrix);
+	}
+}
+
 void AABBoxRasterizerScalar::SetViewProjMatrix(float4x4 *viewMatrix, float4x4 *projMatrix)
 {
 	mViewMatrix = viewMatrix;
@@ -46,6 +46,10 @@ class AABBoxRasterizerScalar : public AABBoxRasterizer
 
 		void SetViewProjMatrix(float4x4 *viewMatrix, float4x4 *projMatrix);
 		inline void SetCPURenderTargetPixels(UINT *pRenderTargetPixels){mpRenderTargetPixels = pRenderTargetPixels;}
+		void SetDepthBufferDesc(const DepthBufferDesc &desc);
+		// The scalar depth test does not use a Hi-Z buffer
+		inline void SetHiZBuffer(const HiZBuffer *pHiZBuffer) {}
+		inline void SetTileTriangleCounts(const UINT *pTileTriangleCounts) {}
 		inline void SetDepthTestTasks(UINT numTasks){mNumDepthTestTasks = numTasks;}
 		inline void SetOccludeeSizeThreshold(float occludeeSizeThreshold)
 		{
@@ -96,6 +100,7 @@ class AABBoxRasterizerScalar : public AABBoxRasterizer
 		float4x4 *mViewMatrix;
 		float4x4 *mProjMatrix;
 		UINT *mpRenderTargetPixels;
+		DepthBufferDesc mDesc;
 		CPUTCamera *mpCamera;
 		bool *mpVisible;
 		UINT  mNumCulled;
@@ -133,7 +133,7 @@ void AABBoxRasterizerScalarMT::TransformAABBoxAndDepthTest(UINT taskId)
 		if(mpTransformedAABBox[i].IsInsideViewFrustum() && !mpTransformedAABBox[i].IsTooSmall(mViewMatrix, mProjMatrix, mpCamera))
 		{
 			mpTransformedAABBox[i].TransformAABBox();
-			mpTransformedAABBox[i].RasterizeAndDepthTestAABBox(mpRenderTargetPixels);
+			mpTransformedAABBox[i].RasterizeAndDepthTestAABBox(mpRenderTargetPixels, mDesc);
 		}
 	}
 }
@@ -60,7 +60,7 @@ void AABBoxRasterizerScalarST::TransformAABBoxAndDepthTest()
 		if(mpTransformedAABBox[i].IsInsideViewFrustum() && !mpTransformedAABBox[i].IsTooSmall(mViewMatrix, mProjMatrix, mpCamera))
 		{
 			mpTransformedAABBox[i].TransformAABBox();
-			mpTransformedAABBox[i].RasterizeAndDepthTestAABBox(mpRenderTargetPixels);
+			mpTransformedAABBox[i].RasterizeAndDepthTestAABBox(mpRenderTargetPixels, mDesc);
 		}		
 	}
 	mDepthTestTime[mTimeCounter++] = mDepthTestTimer.StopTimer();
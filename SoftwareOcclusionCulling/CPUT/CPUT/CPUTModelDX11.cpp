@@ -226,6 +226,7 @@ CPUTResult CPUTModelDX11::LoadModel(CPUTConfigBlock *pBlock, int *pParentID, CPU
     modelLocation = ((CPUTAssetLibraryDX11*)CPUTAssetLibrary::GetAssetLibrary())->GetModelDirectory();
     modelLocation = modelLocation+mName;
     CPUTOSServices::GetOSServices()->ResolveAbsolutePathAndFilename(modelLocation, &resolvedPathAndFile);	
+    mModelFileName = resolvedPathAndFile;
 
     // Get the parent ID.  Note: the caller will use this to set the parent.
     *pParentID = pBlock->GetValueByName(_L("parent"))->ValueAsInt();
@@ -46,6 +46,7 @@ class CPUTModelDX11 : public CPUTModel
 protected:
     ID3D11Buffer      *mpModelConstantBuffer;
     CPUTBuffer        *mpCPUTConstantBuffer;
+    cString            mModelFileName;
 
     // Destructor is not public.  Must release instead of delete.
     ~CPUTModelDX11();
@@ -65,6 +66,8 @@ public:
     void          DrawBoundingBox(CPUTRenderParameters &renderParams);
     void          CreateBoundingBoxMesh();
     CPUTBuffer   *GetModelConstantBuffer() const;
+    // Full path of the .mdl file the model (or its master model) was loaded from
+    const cString &GetModelFileName() const { return mModelFileName; }
 };
 
 
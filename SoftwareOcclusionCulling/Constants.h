@@ -23,6 +23,10 @@ extern int gVisualizeDepthBuffer;
 
 #define PI 3.1415926535f
 
+// Default size of the CPU depth buffer and its tile grid. The size actually used
+// is set at runtime with a DepthBufferDesc and the buffers are allocated for it.
+// The tile grid can be at most SCREENW_IN_TILES x SCREENH_IN_TILES, the scalar
+// rasterizers lay out their bins for it
 const int SCREENW = 1280;
 const int SCREENH = 720;
 
@@ -36,6 +40,18 @@ const int NUM_XFORMVERTS_TASKS = 16;
 
 const int NUM_TILES = (SCREENW/TILE_WIDTH_IN_PIXELS) * (SCREENH/TILE_HEIGHT_IN_PIXELS);
 
+// Data written by different tasks is kept on separate cache lines
+const int CACHE_LINE_SIZE = 64;
+
+// The transform and bin tasks claim the vertices and triangles of the occluders
+// rasterized this frame in chunks of this size, multiples of AVX
+const int XFORM_VERTS_PER_CHUNK = 1024;
+const int BIN_TRIS_PER_CHUNK = 512;
+
+// Number of triangle setup indices in each chunk of the growable triangle bins
+const int BIN_CHUNK_SIZE = 256;
+
+// Fixed size bins of the scalar rasterizers.
 // depending upon the scene the max #of tris in the bin should be changed.
 const int MAX_TRIS_IN_BIN_MT = 1024 * 16;
 const int MAX_TRIS_IN_BIN_ST = 1024 * 16;
@@ -53,17 +69,74 @@ const int YOFFSET2_MT = SCREENW_IN_TILES * NUM_XFORMVERTS_TASKS * MAX_TRIS_IN_BI
 const int XOFFSET2_MT = NUM_XFORMVERTS_TASKS * MAX_TRIS_IN_BIN_MT;
 
 const int SSE = 4;
+const int AVX = 8;
+
+// Occluder triangles that cross the near plane or have a vert outside a guard band
+// of this many pixels around the origin are clipped against the near plane and the
+// guard band. The fixed point verts have SUBPIXEL_BITS fractional bits, inside the
+// guard band the edge functions of a tile fit in 32 bit
+const int NUM_CLIP_PLANES = 5;
+const float GUARD_BAND = 16384.0f;
+const int SUBPIXEL_BITS = 4;
+
+// The occluder rasterizers walk the bounding box of a triangle in a tile in blocks
+// of this many pixels squared. Blocks outside an edge are skipped and blocks inside
+// all three are filled without edge tests. Power of 2, multiple of 4
+const int RASTER_BLOCK_SIZE = 8;
+
+// Occluders rasterized last frame score this much higher when the occluders are
+// selected under a budget, so that the selection does not flicker between frames
+const float OCCLUDER_SCORE_HYSTERESIS = 1.5f;
+
+// When the depth buffer is seeded with last frame's depth reprojected to the new
+// view, only this fraction of the occluder triangles is rasterized on top. The
+// score of an occluder grows with the frames since it was last rasterized, up to
+// REPROJECTION_MAX_AGE, so that the ones left out are refreshed in turn
+const float REPROJECTION_OCCLUDER_FRACTION = 0.25f;
+const int REPROJECTION_MAX_AGE = 8;
 
 const int AABB_VERTICES = 8;
 const int AABB_INDICES  = 36;
 const int AABB_TRIANGLES = 12;
 
-const float4x4 viewportMatrix(
-    0.5f*(float)SCREENW,                 0.0f,  0.0f, 0.0f,
-                   0.0f, -0.5f*(float)SCREENH,  0.0f, 0.0f,
-                   0.0f,                 0.0f, -1.0f, 0.0f,
-    0.5f*(float)SCREENW,  0.5f*(float)SCREENH,  1.0f, 1.0f
-);
+// Hi-Z pyramid. Level 0 holds the min/max depth of 8x8 pixel blocks, each
+// coarser level halves the resolution. The pyramid is built in horizontal
+// strips, one strip per coarsest level block row
+const int HIZ_BLOCK_SIZE = 8;
+const int HIZ_BLOCK_SHIFT = 3;
+const int HIZ_LEVELS = 4;
+const int HIZ_STRIP_HEIGHT = HIZ_BLOCK_SIZE << (HIZ_LEVELS - 1);
+
+// The multi-threaded occludee depth test is split in bands that each start as
+// soon as the Hi-Z strips they read are built, one band per strip and a last
+// one. Occludees spanning one or two strips go to the band of their bottom
+// strip, taller ones to the last band that waits for the whole depth buffer.
+// Occludees that are not depth tested get OCCLUDEE_NOT_TESTED
+const UINT OCCLUDEE_NOT_TESTED = 0xFFFFFFFF;
+const int MAX_DEPTH_TEST_TASKS = 50;
+
+// Masked depth buffer tiles. Each tile holds a 32x2 pixel coverage mask and
+// two depth values. The tile height has to divide TILE_HEIGHT_IN_PIXELS so
+// that each raster task owns whole tiles
+const int MASKED_TILE_WIDTH = 32;
+const int MASKED_TILE_HEIGHT = 2;
+
+// Occluder proxies are built from the interior of each occluder model voxelized
+// on a grid of this many voxels along each axis of its bounding box. A proxy has
+// up to OCCLUDER_PROXY_MAX_BOXES inner boxes of 12 triangles each
+const int OCCLUDER_PROXY_GRID = 32;
+const int OCCLUDER_PROXY_MAX_BOXES = 16;
+
+// Occluders have up to OCCLUDER_LODS levels of detail, their meshes or proxy and
+// then the biggest boxes of the proxy, a quarter as many at each level. The
+// coarsest level is rasterized down to the occluder size threshold and each finer
+// level from OCCLUDER_LOD_SIZE_STEP times the size of the previous one
+const int OCCLUDER_LODS = 4;
+const float OCCLUDER_LOD_SIZE_STEP = 8.0f;
+
+// Views the multi-view culling runs side by side, for split screen or a main view
+// and its reflection. Each view has its own depth buffer and occludee visibility
+const int MAX_CULLING_VIEWS = 4;
 
 const int OCCLUDER_SETS = 2;
 const int OCCLUDEE_SETS = 4;
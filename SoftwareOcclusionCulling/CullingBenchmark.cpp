@@ -0,0 +1,622 @@
+//--------------------------------------------------------------------------------------
+// Copyright 2011 Intel Corporation
+// All Rights Reserved
+//
+// Permission is granted to use, copy, distribute and prepare derivative works of this
+// software for any purpose and without fee, provided, that the above copyright notice
+// and this statement appear in all copies.  Intel makes no representations about the
+// suitability of this software for any purpose.  THIS SOFTWARE IS PROVIDED "AS IS."
+// INTEL SPECIFICALLY DISCLAIMS ALL WARRANTIES, EXPRESS OR IMPLIED, AND ALL LIABILITY,
+// INCLUDING CONSEQUENTIAL AND OTHER INDIRECT DAMAGES, FOR THE USE OF THIS SOFTWARE,
+// INCLUDING LIABILITY FOR INFRINGEMENT OF ANY PROPRIETARY RIGHTS, AND INCLUDING THE
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  Intel does not
+// assume any responsibility for any errors which may appear in this software nor any
+// responsibility to update it.
+//
+//--------------------------------------------------------------------------------------
+
+#include "CullingBenchmark.h"
+
+// Names of the BENCHMARK_TECHNIQUE values
+static const wchar_t * const BENCHMARK_TECHNIQUE_NAMES[NUM_BENCHMARK_TECHNIQUES] = {L"SSE", L"AVX2", L"Masked"};
+// Names of the DEPTH_BUFFER_LAYOUT values
+static const wchar_t * const BENCHMARK_LAYOUT_NAMES[NUM_DEPTH_BUFFER_LAYOUTS] = {L"Linear", L"Quad", L"Block8x8"};
+
+CullingBenchmark::CullingBenchmark(CPUTAssetSet **pOccluderSets, CPUTAssetSet **pOccludeeSets, CPUTCamera *pSceneCamera, float farClipDistance)
+	: mpOccluderSets(pOccluderSets),
+	  mpOccludeeSets(pOccludeeSets),
+	  mpCamera(NULL),
+	  mFarClipDistance(farClipDistance),
+	  mNumCloseUpBoxes(0),
+	  mCloseUp(false),
+	  mOccluderSizeThreshold(1.5f),
+	  mOccludeeSizeThreshold(0.01f),
+	  mNumDepthTestTasks(20),
+	  mNumThreads(0),
+	  mpFile(NULL)
+{
+	mpCamera = new CPUTCamera();
+	mpCamera->SetFov(pSceneCamera->GetFov());
+	mpCamera->SetAspectRatio(pSceneCamera->GetAspectRatio());
+
+	// The path circles the middle of the occluders at the height of the scene camera
+	float3 half;
+	mpOccluderSets[0]->GetBoundingBox(&mPathCenter, &half);
+	mPathCenter.y = pSceneCamera->GetPosition().y;
+	mPathRadius = half * 0.5f;
+
+	for(UINT assetId = 0; assetId < OCCLUDER_SETS; assetId++)
+	{
+		for(UINT nodeId = 0; nodeId < mpOccluderSets[assetId]->GetAssetCount(); nodeId++)
+		{
+			CPUTRenderNode* pRenderNode = NULL;
+			CPUTResult result = mpOccluderSets[assetId]->GetAssetByIndex(nodeId, &pRenderNode);
+			ASSERT((CPUT_SUCCESS == result), _L("Failed getting asset by index"));
+			if(pRenderNode->IsModel())
+			{
+				AddCloseUpBox((CPUTModelDX11*)pRenderNode);
+			}
+			pRenderNode->Release();
+		}
+	}
+
+	// The task manager starts with a thread per logical processor
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	mNumThreads = (int)info.dwNumberOfProcessors;
+}
+
+CullingBenchmark::~CullingBenchmark()
+{
+	SAFE_RELEASE(mpCamera);
+}
+
+//-------------------------------------------------------------------------------
+// Restarts the task manager with the given number of threads, main thread
+// included. -1 lets it pick the number of threads. No task set may be in flight
+//-------------------------------------------------------------------------------
+void CullingBenchmark::SetWorkerThreadCount(int threadCount)
+{
+	gTaskMgr.Shutdown();
+	gTaskMgr.miDemoModeThreadCountOverride = threadCount;
+	gTaskMgr.Init();
+}
+
+void CullingBenchmark::ReleaseRasterizers(Rasterizers *pRasterizers)
+{
+	SAFE_DELETE(pRasterizers->mpDBR);
+	SAFE_DELETE(pRasterizers->mpAABB);
+}
+
+//-------------------------------------------------------------------------------
+// Creates the rasterizers of the configuration's technique with its depth buffer
+// size and the other settings the sample starts with
+//-------------------------------------------------------------------------------
+void CullingBenchmark::CreateRasterizers(const Config &config, Rasterizers *pRasterizers)
+{
+	DepthBufferRasterizerMaskedMT *pDBRMasked;
+	AABBoxRasterizerMaskedMT *pAABBMasked;
+	switch(config.mTechnique)
+	{
+		case BENCHMARK_SSE:
+			pRasterizers->mpDBR = new DepthBufferRasterizerSSEMT;
+			pRasterizers->mpAABB = new AABBoxRasterizerSSEMT;
+			break;
+		case BENCHMARK_AVX2:
+			pRasterizers->mpDBR = new DepthBufferRasterizerAVXMT;
+			pRasterizers->mpAABB = new AABBoxRasterizerAVXMT;
+			break;
+		case BENCHMARK_MASKED:
+			pDBRMasked = new DepthBufferRasterizerMaskedMT;
+			pAABBMasked = new AABBoxRasterizerMaskedMT;
+			pAABBMasked->SetMaskedDepthBuffer(pDBRMasked->GetMaskedDepthBuffer());
+			pRasterizers->mpDBR = pDBRMasked;
+			pRasterizers->mpAABB = pAABBMasked;
+			break;
+	}
+
+	DepthBufferRasterizerSSE *pDBR = pRasterizers->mpDBR;
+	pDBR->SetOccluderProxies(config.mUseProxies);
+	pDBR->CreateTransformedModels(mpOccluderSets, OCCLUDER_SETS);
+	pDBR->SetOccluderSizeThreshold(mOccluderSizeThreshold);
+	pDBR->SetDepthBufferDesc(config.mDesc);
+
+	AABBoxRasterizerSSE *pAABB = pRasterizers->mpAABB;
+	pAABB->CreateTransformedAABBoxes(mpOccludeeSets, OCCLUDEE_SETS);
+	pAABB->SetOccludeeSizeThreshold(mOccludeeSizeThreshold);
+	pAABB->SetDepthTestTasks(mNumDepthTestTasks);
+	pAABB->SetDepthBufferDesc(config.mDesc);
+}
+
+//-------------------------------------------------------------------------------
+// Keeps the world bounding box of the occluder if its surface is among the
+// BENCHMARK_CLOSE_UP_OCCLUDERS biggest so far
+//-------------------------------------------------------------------------------
+void CullingBenchmark::AddCloseUpBox(CPUTModelDX11 *pModel)
+{
+	CloseUpBox box;
+	pModel->GetBoundsWorldSpace(&box.mCenter, &box.mHalf);
+	box.mArea = box.mHalf.x * box.mHalf.y + box.mHalf.y * box.mHalf.z + box.mHalf.z * box.mHalf.x;
+
+	UINT i = mNumCloseUpBoxes;
+	while(i > 0 && mCloseUpBoxes[i - 1].mArea < box.mArea)
+	{
+		i--;
+	}
+	if(i == BENCHMARK_CLOSE_UP_OCCLUDERS)
+	{
+		return;
+	}
+
+	mNumCloseUpBoxes = min(mNumCloseUpBoxes + 1, BENCHMARK_CLOSE_UP_OCCLUDERS);
+	for(UINT j = mNumCloseUpBoxes - 1; j > i; j--)
+	{
+		mCloseUpBoxes[j] = mCloseUpBoxes[j - 1];
+	}
+	mCloseUpBoxes[i] = box;
+}
+
+//-------------------------------------------------------------------------------
+// Moves the camera to a frame of the path. The camera goes once around an ellipse
+// over the occluders and looks at their middle, across as many of them as it can
+//-------------------------------------------------------------------------------
+void CullingBenchmark::SetPathCamera(UINT frame)
+{
+	if(mCloseUp)
+	{
+		SetCloseUpCamera(frame);
+		return;
+	}
+
+	float angle = 2.0f * PI * (float)frame / (float)BENCHMARK_PATH_FRAMES;
+	mpCamera->SetPosition(mPathCenter.x + mPathRadius.x * cosf(angle), mPathCenter.y, mPathCenter.z + mPathRadius.z * sinf(angle));
+	mpCamera->LookAt(mPathCenter.x, mPathCenter.y, mPathCenter.z);
+}
+
+//-------------------------------------------------------------------------------
+// Moves the camera to the close-up pose of the frame. The frames go over the
+// biggest occluders first, then over their faces. Next to a side the camera
+// stands at the height of the scene camera, kept within the occluder, near one
+// end and looks at the other end of the side. On the top it stands over one
+// corner and looks at the opposite one. Either way the face the camera is next
+// to crosses the near plane
+//-------------------------------------------------------------------------------
+void CullingBenchmark::SetCloseUpCamera(UINT frame)
+{
+	const CloseUpBox &box = mCloseUpBoxes[frame % mNumCloseUpBoxes];
+	UINT face = (frame / mNumCloseUpBoxes) % BENCHMARK_CLOSE_UP_FACES;
+	float3 center = box.mCenter;
+	float3 offset = box.mHalf * 0.75f;
+	float3 position, target;
+	if(face == BENCHMARK_CLOSE_UP_FACES - 1)
+	{
+		float top = box.mCenter.y + box.mHalf.y;
+		position = float3(center.x - offset.x, top + BENCHMARK_CLOSE_UP_DISTANCE, center.z - offset.z);
+		target = float3(center.x + offset.x, top, center.z + offset.z);
+	}
+	else
+	{
+		float side = (face & 1) ? 1.0f : -1.0f;
+		float height = min(max(mPathCenter.y, center.y - box.mHalf.y), center.y + box.mHalf.y);
+		if(face < 2)
+		{
+			float x = center.x + side * box.mHalf.x;
+			position = float3(x + side * BENCHMARK_CLOSE_UP_DISTANCE, height, center.z - offset.z);
+			target = float3(x, height, center.z + offset.z);
+		}
+		else
+		{
+			float z = center.z + side * box.mHalf.z;
+			position = float3(center.x - offset.x, height, z + side * BENCHMARK_CLOSE_UP_DISTANCE);
+			target = float3(center.x + offset.x, height, z);
+		}
+	}
+
+	mpCamera->SetPosition(position.x, position.y, position.z);
+	mpCamera->LookAt(target.x, target.y, target.z);
+}
+
+//-------------------------------------------------------------------------------
+// Culls the scene from the camera like MySample::Render does and returns the time
+// from the start of the occluder pass until the depth buffer and the occludee
+// visibility are done
+//-------------------------------------------------------------------------------
+double CullingBenchmark::CullFrame(const Rasterizers &rasterizers)
+{
+	DepthBufferRasterizerSSE *pDBR = rasterizers.mpDBR;
+	AABBoxRasterizerSSE *pAABB = rasterizers.mpAABB;
+
+	mpCamera->SetNearPlaneDistance(1.0f);
+	mpCamera->SetFarPlaneDistance(mFarClipDistance);
+	mpCamera->Update();
+	pDBR->IsVisible(mpCamera);
+	pAABB->IsInsideViewFrustum(mpCamera);
+
+	mpCamera->SetNearPlaneDistance(mFarClipDistance);
+	mpCamera->SetFarPlaneDistance(1.0f);
+	mpCamera->Update();
+
+	mCullTimer.StartTimer();
+	pDBR->SetViewProj(mpCamera->GetViewMatrix(), (float4x4*)mpCamera->GetProjectionMatrix());
+	pDBR->StartTransformModelsAndRasterizeToDepthBuffer();
+
+	pAABB->SetViewProjMatrix(mpCamera->GetViewMatrix(), (float4x4*)mpCamera->GetProjectionMatrix());
+	pAABB->SetCPURenderTargetPixels(pDBR->GetCPURenderTargetPixels());
+	pAABB->SetHiZBuffer(pDBR->GetHiZBuffer());
+	pAABB->SetTileTriangleCounts(pDBR->GetTileTriangleCounts());
+	pAABB->SetDepthStripsDone(pDBR->GetDepthStripsDone());
+	pAABB->TransformAABBoxAndDepthTest();
+	pAABB->SetDepthStripsDone(NULL);
+	pDBR->WaitForDepthBuffer();
+	return mCullTimer.StopTimer();
+}
+
+//-------------------------------------------------------------------------------
+// Adds a measured frame to the sums of the result. The rasterize and depth test
+// times of the rasterizers are averages of their last AVG_COUNTER frames, the mean
+// of those over the path is kept. GetNumCulled is only updated when the visible
+// occludees are rendered, so the culled ones are counted here
+//-------------------------------------------------------------------------------
+void CullingBenchmark::AddFrame(const Rasterizers &rasterizers, double cullTime, Result *pResult)
+{
+	pResult->mCullTime += cullTime;
+	pResult->mMaxCullTime = max(pResult->mMaxCullTime, cullTime);
+	pResult->mRasterizeTime += rasterizers.mpDBR->GetRasterizeTime() * 1000.0;
+	pResult->mBinTime += rasterizers.mpDBR->GetBinTime() * 1000.0;
+	pResult->mDepthTestTime += rasterizers.mpAABB->GetDepthTestTime() * 1000.0;
+	pResult->mNumRasterizedTris += rasterizers.mpDBR->GetNumRasterizedTriangles();
+	pResult->mNumDropped += rasterizers.mpDBR->GetNumDroppedTriangles();
+
+	const bool *pVisible = rasterizers.mpAABB->GetVisible();
+	for(UINT i = 0; i < rasterizers.mpAABB->GetNumOccludees(); i++)
+	{
+		pResult->mNumCulled += pVisible[i] ? 0 : 1;
+	}
+}
+
+void CullingBenchmark::EndRun(Result *pResult)
+{
+	double numFrames = (double)(BENCHMARK_PASSES * BENCHMARK_PATH_FRAMES);
+	pResult->mCullTime /= numFrames;
+	pResult->mRasterizeTime /= numFrames;
+	pResult->mBinTime /= numFrames;
+	pResult->mDepthTestTime /= numFrames;
+	pResult->mNumCulled /= numFrames;
+	pResult->mNumCulledOnly /= numFrames;
+	pResult->mNumRasterizedTris /= numFrames;
+	pResult->mNumDropped /= numFrames;
+}
+
+//-------------------------------------------------------------------------------
+// Culls every frame of the path over all the passes and averages the measured
+// passes
+//-------------------------------------------------------------------------------
+void CullingBenchmark::RunConfig(const Config &config, Result *pResult)
+{
+	Rasterizers rasterizers;
+	CreateRasterizers(config, &rasterizers);
+	memset(pResult, 0, sizeof(Result));
+
+	for(UINT pass = 0; pass < BENCHMARK_WARMUP_PASSES + BENCHMARK_PASSES; pass++)
+	{
+		for(UINT frame = 0; frame < BENCHMARK_PATH_FRAMES; frame++)
+		{
+			SetPathCamera(frame);
+			double cullTime = CullFrame(rasterizers) * 1000.0;
+			if(pass >= BENCHMARK_WARMUP_PASSES)
+			{
+				AddFrame(rasterizers, cullTime, pResult);
+			}
+		}
+	}
+
+	EndRun(pResult);
+	ReleaseRasterizers(&rasterizers);
+}
+
+void CullingBenchmark::WriteResult(const Config &config, const Result &result, double speedup)
+{
+	fwprintf(mpFile, L"%s,%s,%d,%d,%s,%d,%d,%d,%d,%0.3f,%0.3f,%0.3f,%0.3f,%0.3f,%0.1f,%0.1f,",
+			 config.mpSection, BENCHMARK_TECHNIQUE_NAMES[config.mTechnique],
+			 config.mDesc.mWidth, config.mDesc.mHeight, BENCHMARK_LAYOUT_NAMES[config.mDesc.mLayout], config.mDesc.mClipNearPlane ? 1 : 0, config.mUseProxies ? 1 : 0, mNumThreads, NUM_XFORMVERTS_TASKS,
+			 result.mCullTime, result.mMaxCullTime, result.mRasterizeTime, result.mBinTime, result.mDepthTestTime, result.mNumRasterizedTris, result.mNumCulled);
+	if(result.mCompared)
+	{
+		fwprintf(mpFile, L"%0.1f", result.mNumCulledOnly);
+	}
+	fwprintf(mpFile, L",%0.1f,%0.2f\n", result.mNumDropped, speedup);
+	fflush(mpFile);
+}
+
+//-------------------------------------------------------------------------------
+// Compares the multi-threaded techniques at the default depth buffer settings,
+// the speedup is the SSE cull time over the technique's. The AVX2 rasterizers
+// are skipped when the CPU or the OS do not support AVX2
+//-------------------------------------------------------------------------------
+void CullingBenchmark::RunTechniques()
+{
+	Config config;
+	config.mpSection = L"technique";
+
+	Result sseResult;
+	for(UINT technique = 0; technique < NUM_BENCHMARK_TECHNIQUES; technique++)
+	{
+		if(technique == BENCHMARK_AVX2 && !HelperSSE::IsAVX2Supported())
+		{
+			continue;
+		}
+
+		config.mTechnique = (BENCHMARK_TECHNIQUE)technique;
+		Result result;
+		RunConfig(config, &result);
+		if(technique == BENCHMARK_SSE)
+		{
+			sseResult = result;
+		}
+		WriteResult(config, result, sseResult.mCullTime / result.mCullTime);
+	}
+}
+
+//-------------------------------------------------------------------------------
+// Culls every frame of the path with two configurations one after the other and
+// compares the visibility of each occludee. Each result counts the occludees that
+// only its configuration culled
+//-------------------------------------------------------------------------------
+void CullingBenchmark::RunPair(const Config &config, const Config &otherConfig, Result *pResult, Result *pOtherResult)
+{
+	Rasterizers rasterizers, otherRasterizers;
+	CreateRasterizers(config, &rasterizers);
+	CreateRasterizers(otherConfig, &otherRasterizers);
+
+	memset(pResult, 0, sizeof(Result));
+	memset(pOtherResult, 0, sizeof(Result));
+	pResult->mCompared = pOtherResult->mCompared = true;
+
+	UINT numOccludees = rasterizers.mpAABB->GetNumOccludees();
+	for(UINT pass = 0; pass < BENCHMARK_WARMUP_PASSES + BENCHMARK_PASSES; pass++)
+	{
+		for(UINT frame = 0; frame < BENCHMARK_PATH_FRAMES; frame++)
+		{
+			SetPathCamera(frame);
+			double cullTime = CullFrame(rasterizers) * 1000.0;
+			double otherCullTime = CullFrame(otherRasterizers) * 1000.0;
+			if(pass < BENCHMARK_WARMUP_PASSES)
+			{
+				continue;
+			}
+
+			AddFrame(rasterizers, cullTime, pResult);
+			AddFrame(otherRasterizers, otherCullTime, pOtherResult);
+
+			const bool *pVisible = rasterizers.mpAABB->GetVisible();
+			const bool *pOtherVisible = otherRasterizers.mpAABB->GetVisible();
+			for(UINT i = 0; i < numOccludees; i++)
+			{
+				pResult->mNumCulledOnly += (!pVisible[i] && pOtherVisible[i]) ? 1 : 0;
+				pOtherResult->mNumCulledOnly += (pVisible[i] && !pOtherVisible[i]) ? 1 : 0;
+			}
+		}
+	}
+
+	EndRun(pResult);
+	EndRun(pOtherResult);
+	ReleaseRasterizers(&rasterizers);
+	ReleaseRasterizers(&otherRasterizers);
+}
+
+//-------------------------------------------------------------------------------
+// Compares the float SSE and the masked rasterizers. The masked depth buffer keeps
+// two depths per tile instead of one per pixel, so the two may not agree on every
+// occludee. The masked line's speedup is the SSE cull time over the masked one
+//-------------------------------------------------------------------------------
+void CullingBenchmark::RunMaskedParity()
+{
+	Config sseConfig;
+	sseConfig.mpSection = L"masked_parity";
+	sseConfig.mTechnique = BENCHMARK_SSE;
+	Config maskedConfig = sseConfig;
+	maskedConfig.mTechnique = BENCHMARK_MASKED;
+
+	Result sseResult, maskedResult;
+	RunPair(sseConfig, maskedConfig, &sseResult, &maskedResult);
+	WriteResult(sseConfig, sseResult, 1.0);
+	WriteResult(maskedConfig, maskedResult, sseResult.mCullTime / maskedResult.mCullTime);
+}
+
+//-------------------------------------------------------------------------------
+// Takes the close-up poses instead of the path, where the occluder next to the
+// camera crosses the near plane, and compares each technique with and without
+// near clipping. Without it the triangles that cross the near plane are not
+// rasterized, so the clipped line's culled_only counts the occludees clipping
+// culls in addition. Its dropped column counts the parts of clipped triangles
+// that had no setup left. The speedup is the cull time without clipping over
+// the one with it
+//-------------------------------------------------------------------------------
+void CullingBenchmark::RunNearClip()
+{
+	if(mNumCloseUpBoxes == 0)
+	{
+		return;
+	}
+	mCloseUp = true;
+
+	Config config;
+	config.mpSection = L"near_clip";
+	for(UINT technique = 0; technique < NUM_BENCHMARK_TECHNIQUES; technique++)
+	{
+		if(technique == BENCHMARK_AVX2 && !HelperSSE::IsAVX2Supported())
+		{
+			continue;
+		}
+
+		config.mTechnique = (BENCHMARK_TECHNIQUE)technique;
+		Config clipConfig = config;
+		config.mDesc.mClipNearPlane = false;
+		clipConfig.mDesc.mClipNearPlane = true;
+
+		Result result, clipResult;
+		RunPair(config, clipConfig, &result, &clipResult);
+		WriteResult(config, result, 1.0);
+		WriteResult(clipConfig, clipResult, result.mCullTime / clipResult.mCullTime);
+	}
+
+	mCloseUp = false;
+}
+
+//-------------------------------------------------------------------------------
+// Compares each technique with the full occluder meshes and with their proxies.
+// The proxies lie inside the models, so the full line's culled_only counts the
+// occludees the proxies no longer cull. The raster_tris column shows the
+// triangles they save. The speedup is the cull time with the full meshes over
+// the one with the proxies. The proxies of the models are built or loaded from
+// their cache files when the first configuration is created
+//-------------------------------------------------------------------------------
+void CullingBenchmark::RunProxies()
+{
+	Config config;
+	config.mpSection = L"proxies";
+	for(UINT technique = 0; technique < NUM_BENCHMARK_TECHNIQUES; technique++)
+	{
+		if(technique == BENCHMARK_AVX2 && !HelperSSE::IsAVX2Supported())
+		{
+			continue;
+		}
+
+		config.mTechnique = (BENCHMARK_TECHNIQUE)technique;
+		Config proxyConfig = config;
+		proxyConfig.mUseProxies = true;
+
+		Result result, proxyResult;
+		RunPair(config, proxyConfig, &result, &proxyResult);
+		WriteResult(config, result, 1.0);
+		WriteResult(proxyConfig, proxyResult, result.mCullTime / proxyResult.mCullTime);
+	}
+}
+
+//-------------------------------------------------------------------------------
+// Trades the culling rate against the cost of the SSE rasterizers over the depth
+// buffer sizes, the tile grid stays the same. The speedup is the cull time at
+// SCREENW x SCREENH over the one at the size
+//-------------------------------------------------------------------------------
+void CullingBenchmark::RunResolutions()
+{
+	Config configs[NUM_BENCHMARK_RESOLUTIONS];
+	Result results[NUM_BENCHMARK_RESOLUTIONS];
+	double defaultCullTime = 0.0;
+	for(UINT i = 0; i < NUM_BENCHMARK_RESOLUTIONS; i++)
+	{
+		configs[i].mpSection = L"resolution";
+		configs[i].mTechnique = BENCHMARK_SSE;
+		configs[i].mDesc.Set(BENCHMARK_RESOLUTIONS[i][0], BENCHMARK_RESOLUTIONS[i][1], SCREENW_IN_TILES, SCREENH_IN_TILES);
+		RunConfig(configs[i], &results[i]);
+		if(BENCHMARK_RESOLUTIONS[i][0] == SCREENW && BENCHMARK_RESOLUTIONS[i][1] == SCREENH)
+		{
+			defaultCullTime = results[i].mCullTime;
+		}
+	}
+
+	for(UINT i = 0; i < NUM_BENCHMARK_RESOLUTIONS; i++)
+	{
+		WriteResult(configs[i], results[i], defaultCullTime / results[i].mCullTime);
+	}
+}
+
+//-------------------------------------------------------------------------------
+// Culls the path with the depth buffer in each layout, with the SSE and the AVX2
+// rasterizers, at SCREENW x SCREENH and at the biggest size of the resolution
+// section where the layout matters most. The masked rasterizers keep their own
+// layout and are skipped. The speedup is the linear cull time over the layout's
+//-------------------------------------------------------------------------------
+void CullingBenchmark::RunLayouts()
+{
+	int sizes[2][2] = {{SCREENW, SCREENH}, {BENCHMARK_RESOLUTIONS[NUM_BENCHMARK_RESOLUTIONS - 1][0], BENCHMARK_RESOLUTIONS[NUM_BENCHMARK_RESOLUTIONS - 1][1]}};
+	Config config;
+	config.mpSection = L"layout";
+	for(UINT technique = 0; technique < BENCHMARK_MASKED; technique++)
+	{
+		if(technique == BENCHMARK_AVX2 && !HelperSSE::IsAVX2Supported())
+		{
+			continue;
+		}
+
+		config.mTechnique = (BENCHMARK_TECHNIQUE)technique;
+		for(UINT size = 0; size < 2; size++)
+		{
+			config.mDesc.Set(sizes[size][0], sizes[size][1], SCREENW_IN_TILES, SCREENH_IN_TILES);
+			double linearCullTime = 0.0;
+			for(UINT layout = 0; layout < NUM_DEPTH_BUFFER_LAYOUTS; layout++)
+			{
+				config.mDesc.mLayout = (DEPTH_BUFFER_LAYOUT)layout;
+				Result result;
+				RunConfig(config, &result);
+				if(layout == DEPTH_BUFFER_LINEAR)
+				{
+					linearCullTime = result.mCullTime;
+				}
+				WriteResult(config, result, linearCullTime / result.mCullTime);
+			}
+		}
+	}
+}
+
+//-------------------------------------------------------------------------------
+// Restarts the task manager with more and more threads and culls the path with
+// each technique. The bin time is the one of the slowest bin task, it shows how
+// well the bin stage is split over the threads. The transform and bin stages
+// always run in bin_tasks tasks, so they do not scale past that many threads. The
+// speedup is the cull time with one thread over the one with the thread count.
+// The task manager is given its default thread count back at the end
+//-------------------------------------------------------------------------------
+void CullingBenchmark::RunThreads()
+{
+	int numProcessors = mNumThreads;
+	Config config;
+	config.mpSection = L"threads";
+	for(UINT technique = 0; technique < NUM_BENCHMARK_TECHNIQUES; technique++)
+	{
+		if(technique == BENCHMARK_AVX2 && !HelperSSE::IsAVX2Supported())
+		{
+			continue;
+		}
+
+		config.mTechnique = (BENCHMARK_TECHNIQUE)technique;
+		double oneThreadCullTime = 0.0;
+		for(UINT i = 0; i < NUM_BENCHMARK_THREAD_COUNTS && BENCHMARK_THREAD_COUNTS[i] <= numProcessors; i++)
+		{
+			mNumThreads = BENCHMARK_THREAD_COUNTS[i];
+			SetWorkerThreadCount(mNumThreads);
+
+			Result result;
+			RunConfig(config, &result);
+			if(i == 0)
+			{
+				oneThreadCullTime = result.mCullTime;
+			}
+			WriteResult(config, result, oneThreadCullTime / result.mCullTime);
+		}
+	}
+
+	mNumThreads = numProcessors;
+	SetWorkerThreadCount(-1);
+}
+
+bool CullingBenchmark::Run(const wchar_t *pFileName)
+{
+	if(_wfopen_s(&mpFile, pFileName, L"w") != 0)
+	{
+		return false;
+	}
+
+	fwprintf(mpFile, L"section,technique,width,height,layout,near_clip,proxies,threads,bin_tasks,cull_ms,max_cull_ms,raster_ms,bin_ms,depth_test_ms,raster_tris,culled,culled_only,dropped,speedup\n");
+	RunTechniques();
+	RunMaskedParity();
+	RunNearClip();
+	RunProxies();
+	RunResolutions();
+	RunLayouts();
+	RunThreads();
+
+	fclose(mpFile);
+	mpFile = NULL;
+	return true;
+}
@@ -0,0 +1,167 @@
+//--------------------------------------------------------------------------------------
+// Copyright 2011 Intel Corporation
+// All Rights Reserved
+//
+// Permission is granted to use, copy, distribute and prepare derivative works of this
+// software for any purpose and without fee, provided, that the above copyright notice
+// and this statement appear in all copies.  Intel makes no representations about the
+// suitability of this software for any purpose.  THIS SOFTWARE IS PROVIDED "AS IS."
+// INTEL SPECIFICALLY DISCLAIMS ALL WARRANTIES, EXPRESS OR IMPLIED, AND ALL LIABILITY,
+// INCLUDING CONSEQUENTIAL AND OTHER INDIRECT DAMAGES, FOR THE USE OF THIS SOFTWARE,
+// INCLUDING LIABILITY FOR INFRINGEMENT OF ANY PROPRIETARY RIGHTS, AND INCLUDING THE
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  Intel does not
+// assume any responsibility for any errors which may appear in this software nor any
+// responsibility to update it.
+//
+//--------------------------------------------------------------------------------------
+
+#ifndef CULLINGBENCHMARK_H
+#define CULLINGBENCHMARK_H
+
+#include <stdio.h>
+#include "DepthBufferRasterizerSSEMT.h"
+#include "DepthBufferRasterizerAVXMT.h"
+#include "DepthBufferRasterizerMaskedMT.h"
+#include "AABBoxRasterizerSSEMT.h"
+#include "AABBoxRasterizerAVXMT.h"
+#include "AABBoxRasterizerMaskedMT.h"
+
+// Multi-threaded rasterizer pairs the benchmark compares
+enum BENCHMARK_TECHNIQUE
+{
+	BENCHMARK_SSE,
+	BENCHMARK_AVX2,
+	BENCHMARK_MASKED,
+	NUM_BENCHMARK_TECHNIQUES
+};
+
+// Camera positions on the benchmark path and the passes made over it. The first
+// passes only warm up the caches and the averaged timers
+const UINT BENCHMARK_PATH_FRAMES = 240;
+const UINT BENCHMARK_WARMUP_PASSES = 1;
+const UINT BENCHMARK_PASSES = 3;
+
+// Worker thread counts of the thread section, main thread included. Counts above
+// the number of logical processors are skipped. The transform and bin stages are
+// split in NUM_XFORMVERTS_TASKS tasks, so they stop scaling past that count
+const UINT NUM_BENCHMARK_THREAD_COUNTS = 8;
+const int BENCHMARK_THREAD_COUNTS[NUM_BENCHMARK_THREAD_COUNTS] = {1, 2, 4, 8, 12, 16, 24, 32};
+
+// Poses of the near clip section. The camera stands next to each of the 4 sides
+// and on the top of the biggest occluders, one pose per frame, closer to them
+// than the near plane distance of 1
+const UINT BENCHMARK_CLOSE_UP_FACES = 5;
+const UINT BENCHMARK_CLOSE_UP_OCCLUDERS = BENCHMARK_PATH_FRAMES / BENCHMARK_CLOSE_UP_FACES;
+const float BENCHMARK_CLOSE_UP_DISTANCE = 0.5f;
+
+// Depth buffer sizes of the resolution section, it includes SCREENW x SCREENH
+const UINT NUM_BENCHMARK_RESOLUTIONS = 6;
+const int BENCHMARK_RESOLUTIONS[NUM_BENCHMARK_RESOLUTIONS][2] = {{320, 180}, {640, 360}, {1280, 720}, {1920, 1080}, {2560, 1440}, {3840, 2160}};
+
+//-------------------------------------------------------------------------------
+// Occlusion culls the scene from a fixed camera path, without rendering it, with
+// one rasterizer configuration after another and writes one CSV line of timings
+// and culling results per configuration. The path and the close-up poses are
+// derived from the bounding boxes of the occluders and the scene camera, so two
+// runs on the same scene and machine cull the same frames. Each configuration
+// gets its own rasterizers so that the settings of the sample are not touched,
+// the thread section gives the task manager its default thread count back when
+// it is done
+//-------------------------------------------------------------------------------
+class CullingBenchmark
+{
+	public:
+		CullingBenchmark(CPUTAssetSet **pOccluderSets, CPUTAssetSet **pOccludeeSets, CPUTCamera *pSceneCamera, float farClipDistance);
+		~CullingBenchmark();
+
+		inline void SetOccluderSizeThreshold(float occluderSizeThreshold) {mOccluderSizeThreshold = occluderSizeThreshold;}
+		inline void SetOccludeeSizeThreshold(float occludeeSizeThreshold) {mOccludeeSizeThreshold = occludeeSizeThreshold;}
+		inline void SetDepthTestTasks(UINT numTasks) {mNumDepthTestTasks = numTasks;}
+
+		// Runs all the configurations and writes the results to the file, false if
+		// the file cannot be written
+		bool Run(const wchar_t *pFileName);
+
+	private:
+		struct Config
+		{
+			const wchar_t *mpSection;
+			BENCHMARK_TECHNIQUE mTechnique;
+			DepthBufferDesc mDesc;
+			bool mUseProxies;
+
+			Config() : mpSection(NULL), mTechnique(BENCHMARK_SSE), mUseProxies(false) {}
+		};
+
+		struct Rasterizers
+		{
+			DepthBufferRasterizerSSE *mpDBR;
+			AABBoxRasterizerSSE *mpAABB;
+		};
+
+		// Averages over the measured passes, times in milliseconds. When two configurations
+		// are compared, mNumCulledOnly counts the occludees only this one culls.
+		// mNumRasterizedTris counts the occluder triangles binned to the tiles,
+		// mNumDropped the parts of clipped triangles the bin stage dropped
+		struct Result
+		{
+			double mCullTime;
+			double mMaxCullTime;
+			double mRasterizeTime;
+			double mBinTime;
+			double mDepthTestTime;
+			double mNumCulled;
+			double mNumCulledOnly;
+			double mNumRasterizedTris;
+			double mNumDropped;
+			bool mCompared;
+		};
+
+		struct CloseUpBox
+		{
+			float3 mCenter;
+			float3 mHalf;
+			float mArea;
+		};
+
+		CPUTAssetSet **mpOccluderSets;
+		CPUTAssetSet **mpOccludeeSets;
+		CPUTCamera *mpCamera;
+		float mFarClipDistance;
+		float3 mPathCenter;
+		float3 mPathRadius;
+		CloseUpBox mCloseUpBoxes[BENCHMARK_CLOSE_UP_OCCLUDERS];	// biggest occluders first
+		UINT mNumCloseUpBoxes;
+		bool mCloseUp;				// the camera takes the close-up poses instead of the path
+
+		float mOccluderSizeThreshold;
+		float mOccludeeSizeThreshold;
+		UINT mNumDepthTestTasks;
+		int mNumThreads;			// worker threads of the task manager, main thread included
+
+		CPUTTimerWin mCullTimer;
+		FILE *mpFile;
+
+		void SetWorkerThreadCount(int threadCount);
+		void CreateRasterizers(const Config &config, Rasterizers *pRasterizers);
+		void ReleaseRasterizers(Rasterizers *pRasterizers);
+		void AddCloseUpBox(CPUTModelDX11 *pModel);
+		void SetPathCamera(UINT frame);
+		void SetCloseUpCamera(UINT frame);
+		double CullFrame(const Rasterizers &rasterizers);
+		void AddFrame(const Rasterizers &rasterizers, double cullTime, Result *pResult);
+		void EndRun(Result *pResult);
+		void RunConfig(const Config &config, Result *pResult);
+		void RunPair(const Config &config, const Config &otherConfig, Result *pResult, Result *pOtherResult);
+		void WriteResult(const Config &config, const Result &result, double speedup);
+
+		void RunTechniques();
+		void RunMaskedParity();
+		void RunNearClip();
+		void RunProxies();
+		void RunResolutions();
+		void RunLayouts();
+		void RunThreads();
+};
+
+#endif //CULLINGBENCHMARK_H
@@ -0,0 +1,98 @@
+//--------------------------------------------------------------------------------------
+// Copyright 2011 Intel Corporation
+// All Rights Reserved
+//
+// Permission is granted to use, copy, distribute and prepare derivative works of this
+// software for any purpose and without fee, provided, that the above copyright notice
+// and this statement appear in all copies.  Intel makes no representations about the
+// suitability of this software for any purpose.  THIS SOFTWARE IS PROVIDED "AS IS."
+// INTEL SPECIFICALLY DISCLAIMS ALL WARRANTIES, EXPRESS OR IMPLIED, AND ALL LIABILITY,
+// INCLUDING CONSEQUENTIAL AND OTHER INDIRECT DAMAGES, FOR THE USE OF THIS SOFTWARE,
+// INCLUDING LIABILITY FOR INFRINGEMENT OF ANY PROPRIETARY RIGHTS, AND INCLUDING THE
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  Intel does not
+// assume any responsibility for any errors which may appear in this software nor any
+// responsibility to update it.
+//
+//--------------------------------------------------------------------------------------
+
+#ifndef DEPTHBUFFERDESC_H
+#define DEPTHBUFFERDESC_H
+
+#include "CPUT_DX11.h"
+#include "Constants.h"
+#include "DepthBufferLayout.h"
+
+//-------------------------------------------------------------------------------
+// Runtime resolution of the CPU depth buffer and the tile grid it is binned and
+// rasterized in. The rasterizers allocate their buffers for the size they are
+// given, the tile grid can be at most SCREENW_IN_TILES x SCREENH_IN_TILES.
+// Tiles are rounded up to whole masked depth buffer tiles so that
+// a raster task always owns whole 32x2 tiles, the last tile in a row or column 
+// may be smaller than the others. The layout only applies to the SSE rasterizers,
+// the depth buffer has to be linear to be viewed. The SSE rasterizers clip the
+// occluder triangles that cross the near plane unless near clipping is off, then
+// they reject them
+//-------------------------------------------------------------------------------
+struct DepthBufferDesc
+{
+	int mWidth;
+	int mHeight;
+	int mTileWidth;
+	int mTileHeight;
+	int mWidthInTiles;
+	int mHeightInTiles;
+	float4x4 mViewportMatrix;
+	DEPTH_BUFFER_LAYOUT mLayout;
+	bool mClipNearPlane;
+
+	DepthBufferDesc()
+		: mLayout(DEPTH_BUFFER_QUAD),
+		  mClipNearPlane(true)
+	{
+		Set(SCREENW, SCREENH, SCREENW_IN_TILES, SCREENH_IN_TILES);
+	}
+
+	DepthBufferDesc(int width, int height, int widthInTiles, int heightInTiles)
+		: mLayout(DEPTH_BUFFER_QUAD),
+		  mClipNearPlane(true)
+	{
+		Set(width, height, widthInTiles, heightInTiles);
+	}
+
+	inline void Set(int width, int height, int widthInTiles, int heightInTiles)
+	{
+		ASSERT(width > 0 && (width % MASKED_TILE_WIDTH) == 0, _L("Invalid depth buffer width"));
+		ASSERT(height > 0 && (height % MASKED_TILE_HEIGHT) == 0, _L("Invalid depth buffer height"));
+		ASSERT(widthInTiles > 0 && widthInTiles <= SCREENW_IN_TILES, _L("Invalid tile grid width"));
+		ASSERT(heightInTiles > 0 && heightInTiles <= SCREENH_IN_TILES, _L("Invalid tile grid height"));
+
+		mWidth = width;
+		mHeight = height;
+		mTileWidth = RoundUp((width + widthInTiles - 1) / widthInTiles, MASKED_TILE_WIDTH);
+		mTileHeight = RoundUp((height + heightInTiles - 1) / heightInTiles, MASKED_TILE_HEIGHT);
+		mWidthInTiles = (width + mTileWidth - 1) / mTileWidth;
+		mHeightInTiles = (height + mTileHeight - 1) / mTileHeight;
+
+		mViewportMatrix = float4x4(
+			0.5f*(float)width,                0.0f,  0.0f, 0.0f,
+			             0.0f, -0.5f*(float)height,  0.0f, 0.0f,
+			             0.0f,                0.0f, -1.0f, 0.0f,
+			0.5f*(float)width,  0.5f*(float)height,  1.0f, 1.0f);
+	}
+
+	inline int GetNumTiles() const {return mWidthInTiles * mHeightInTiles;}
+	// Floats the depth buffers of the rasterizers hold. The 8x8 block layout pads
+	// its last block row to 8 pixel rows, so the height is rounded up for any layout
+	inline int GetNumPixels() const {return mWidth * RoundUp(mHeight, 8);}
+	inline int GetNumHiZStrips() const {return (mHeight + HIZ_STRIP_HEIGHT - 1) / HIZ_STRIP_HEIGHT;}
+	inline int GetNumOccludeeBands() const {return GetNumHiZStrips() + 1;}
+	inline bool IsSameSize(const DepthBufferDesc &desc) const
+	{
+		return mWidth == desc.mWidth && mHeight == desc.mHeight && mWidthInTiles == desc.mWidthInTiles && mHeightInTiles == desc.mHeightInTiles;
+	}
+
+	private:
+		static inline int RoundUp(int x, int multiple) {return ((x + multiple - 1) / multiple) * multiple;}
+};
+
+#endif //DEPTHBUFFERDESC_H
\ No newline at end of file
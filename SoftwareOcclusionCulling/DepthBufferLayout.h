@@ -0,0 +1,189 @@
+//--------------------------------------------------------------------------------------
+// Copyright 2011 Intel Corporation
+// All Rights Reserved
+//
+// Permission is granted to use, copy, distribute and prepare derivative works of this
+// software for any purpose and without fee, provided, that the above copyright notice
+// and this statement appear in all copies.  Intel makes no representations about the
+// suitability of this software for any purpose.  THIS SOFTWARE IS PROVIDED "AS IS."
+// INTEL SPECIFICALLY DISCLAIMS ALL WARRANTIES, EXPRESS OR IMPLIED, AND ALL LIABILITY,
+// INCLUDING CONSEQUENTIAL AND OTHER INDIRECT DAMAGES, FOR THE USE OF THIS SOFTWARE,
+// INCLUDING LIABILITY FOR INFRINGEMENT OF ANY PROPRIETARY RIGHTS, AND INCLUDING THE
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  Intel does not
+// assume any responsibility for any errors which may appear in this software nor any
+// responsibility to update it.
+//
+//--------------------------------------------------------------------------------------
+#ifndef DEPTHBUFFERLAYOUT_H
+#define DEPTHBUFFERLAYOUT_H
+
+#include "CPUT_DX11.h"
+#include "immintrin.h"
+#include <float.h>
+
+//-------------------------------------------------------------------------------
+// Order the pixels of the CPU depth buffer are stored in. The SSE rasterizers and
+// occludee depth tests walk 2x2 pixel quads starting on even rows and columns
+// (4x2 pixels with AVX), their kernels are templated on one of the layout policies
+// below so the addressing is resolved at compile time.
+// A quad is found at RowPairOffset(y) + QuadOffset(x), its lanes are ordered
+// (x+1, y+1), (x, y+1), (x+1, y), (x, y) from lane 0 to lane 3
+//-------------------------------------------------------------------------------
+enum DEPTH_BUFFER_LAYOUT
+{
+	DEPTH_BUFFER_LINEAR,
+	DEPTH_BUFFER_QUAD,
+	DEPTH_BUFFER_BLOCK8X8,
+	NUM_DEPTH_BUFFER_LAYOUTS
+};
+
+// Rows are stored one after another. This is the layout the depth buffer is viewed
+// in and the only one the scalar rasterizers use. Quads are gathered and scattered
+// one pixel at a time
+struct DepthBufferLinear
+{
+	static inline int RowPairOffset(int y, int width) {return y * width;}
+	static inline int QuadOffset(int x) {return x;}
+	static inline int PixelOffset(int x, int y, int width) {return y * width + x;}
+
+	static inline __m128 LoadQuad(const float *pQuad, int width)
+	{
+		return _mm_set_ps(pQuad[0], pQuad[1], pQuad[width], pQuad[width + 1]);
+	}
+
+	// Writes the pixels of the quad selected by mask
+	static inline void StoreQuad(float *pQuad, int width, __m128 previousDepth, __m128 depth, __m128i mask)
+	{
+		if(mask.m128i_i32[3]) pQuad[0] = depth.m128_f32[3];
+		if(mask.m128i_i32[2]) pQuad[1] = depth.m128_f32[2];
+		if(mask.m128i_i32[1]) pQuad[width] = depth.m128_f32[1];
+		if(mask.m128i_i32[0]) pQuad[width + 1] = depth.m128_f32[0];
+	}
+
+	// Two adjacent quads, the one at x in lanes 0-3 and the one at x+2 in lanes 4-7
+	static inline __m256 Load2Quads(const float *pQuads, int width)
+	{
+		return _mm256_set_ps(pQuads[2], pQuads[3], pQuads[width + 2], pQuads[width + 3],
+							 pQuads[0], pQuads[1], pQuads[width], pQuads[width + 1]);
+	}
+
+	static inline void Store2Quads(float *pQuads, int width, __m256 previousDepth, __m256 depth, __m256i mask)
+	{
+		if(mask.m256i_i32[7]) pQuads[2] = depth.m256_f32[7];
+		if(mask.m256i_i32[6]) pQuads[3] = depth.m256_f32[6];
+		if(mask.m256i_i32[5]) pQuads[width + 2] = depth.m256_f32[5];
+		if(mask.m256i_i32[4]) pQuads[width + 3] = depth.m256_f32[4];
+		if(mask.m256i_i32[3]) pQuads[0] = depth.m256_f32[3];
+		if(mask.m256i_i32[2]) pQuads[1] = depth.m256_f32[2];
+		if(mask.m256i_i32[1]) pQuads[width] = depth.m256_f32[1];
+		if(mask.m256i_i32[0]) pQuads[width + 1] = depth.m256_f32[0];
+	}
+
+	static inline void ClearRowPair(float *pDepthBuffer, int width, int y, int startX, int endX)
+	{
+		memset(&pDepthBuffer[y * width + startX], 0, (endX - startX) * sizeof(float));
+		memset(&pDepthBuffer[(y + 1) * width + startX], 0, (endX - startX) * sizeof(float));
+	}
+};
+
+// Each pair of rows is stored as 2x2 quads, a quad is one aligned SSE load
+struct DepthBufferQuad
+{
+	static inline int RowPairOffset(int y, int width) {return y * width;}
+	static inline int QuadOffset(int x) {return 2 * x;}
+	static inline int PixelOffset(int x, int y, int width)
+	{
+		return RowPairOffset(y & ~1, width) + QuadOffset(x & ~1) + 3 - ((y & 1) << 1) - (x & 1);
+	}
+
+	static inline __m128 LoadQuad(const float *pQuad, int width)
+	{
+		return _mm_load_ps(pQuad);
+	}
+
+	static inline void StoreQuad(float *pQuad, int width, __m128 previousDepth, __m128 depth, __m128i mask)
+	{
+		_mm_store_ps(pQuad, _mm_blendv_ps(previousDepth, depth, _mm_castsi128_ps(mask)));
+	}
+
+	static inline __m256 Load2Quads(const float *pQuads, int width)
+	{
+		return _mm256_loadu_ps(pQuads);
+	}
+
+	static inline void Store2Quads(float *pQuads, int width, __m256 previousDepth, __m256 depth, __m256i mask)
+	{
+		_mm256_storeu_ps(pQuads, _mm256_blendv_ps(previousDepth, depth, _mm256_castsi256_ps(mask)));
+	}
+
+	static inline void ClearRowPair(float *pDepthBuffer, int width, int y, int startX, int endX)
+	{
+		memset(&pDepthBuffer[y * width + 2 * startX], 0, 2 * (endX - startX) * sizeof(float));
+	}
+};
+
+// 8x8 pixel blocks are stored one after another in rows of blocks, each made of
+// 2x2 quads in the quad order. The part of a block in a row pair is one cache line
+// and a block is one Hi-Z level 0 block. The width has to be a multiple of 8, the
+// block rows are padded to 8 pixel rows, see DepthBufferDesc::GetNumPixels
+struct DepthBufferBlock8x8 : public DepthBufferQuad
+{
+	static inline int RowPairOffset(int y, int width) {return (y >> 3) * (width << 3) + ((y & 6) << 3);}
+	static inline int QuadOffset(int x) {return ((x >> 3) << 6) + ((x & 6) << 1);}
+	static inline int PixelOffset(int x, int y, int width)
+	{
+		return RowPairOffset(y & ~1, width) + QuadOffset(x & ~1) + 3 - ((y & 1) << 1) - (x & 1);
+	}
+
+	// startX and endX have to be multiples of 8
+	static inline void ClearRowPair(float *pDepthBuffer, int width, int y, int startX, int endX)
+	{
+		float *pRowPair = &pDepthBuffer[RowPairOffset(y, width)];
+		for(int x = startX; x < endX; x += 8)
+		{
+			memset(&pRowPair[QuadOffset(x)], 0, 16 * sizeof(float));
+		}
+	}
+};
+
+//-------------------------------------------------------------------------------
+// Clears the depth buffer pixels of one tile to the far plane. The raster tasks 
+// clear their own tile on first use instead of clearing the whole buffer up front.
+// The tile has to start and end on even rows and columns
+//-------------------------------------------------------------------------------
+template<class Layout>
+inline void ClearDepthBufferTile(float *pDepthBuffer, int width, int startX, int startY, int endX, int endY)
+{
+	for(int y = startY; y < endY; y += 2)
+	{
+		Layout::ClearRowPair(pDepthBuffer, width, y, startX, endX);
+	}
+}
+
+//-------------------------------------------------------------------------------
+// Seeds the depth buffer pixels of one tile with the depth reprojected from last
+// frame instead of clearing them. The pixels no reprojected depth landed on are
+// FLT_MAX in the seed buffer and are cleared to the far plane, the seed pixels are
+// set back to FLT_MAX for the next frame. The tile has to start and end on even
+// rows and columns
+//-------------------------------------------------------------------------------
+template<class Layout>
+inline void SeedDepthBufferTile(float *pDepthBuffer, float *pSeed, int width, int startX, int startY, int endX, int endY)
+{
+	__m128 empty = _mm_set1_ps(FLT_MAX);
+	__m128i allPixels = _mm_set1_epi32(-1);
+	for(int y = startY; y < endY; y += 2)
+	{
+		int rowPair = Layout::RowPairOffset(y, width);
+		for(int x = startX; x < endX; x += 2)
+		{
+			int quad = rowPair + Layout::QuadOffset(x);
+			__m128 seed = Layout::LoadQuad(&pSeed[quad], width);
+			__m128 depth = _mm_andnot_ps(_mm_cmpeq_ps(seed, empty), seed);
+			Layout::StoreQuad(&pDepthBuffer[quad], width, depth, depth, allPixels);
+			Layout::StoreQuad(&pSeed[quad], width, empty, empty, allPixels);
+		}
+	}
+}
+
+#endif //DEPTHBUFFERLAYOUT_H
@@ -17,9 +17,14 @@
 
 DepthBufferRasterizer::DepthBufferRasterizer()
 	: mIsVisible(TASKSETHANDLE_INVALID),
+	  mOccluderSize(TASKSETHANDLE_INVALID),
+	  mCompact(TASKSETHANDLE_INVALID),
+	  mReproject(TASKSETHANDLE_INVALID),
 	  mXformMesh(TASKSETHANDLE_INVALID),
 	  mBinMesh(TASKSETHANDLE_INVALID),
-	  mRasterize(TASKSETHANDLE_INVALID)
+	  mRasterize(TASKSETHANDLE_INVALID),
+	  mpRasterizeRow(NULL),
+	  mpBuildHiZStrip(NULL)
 {
 
 }
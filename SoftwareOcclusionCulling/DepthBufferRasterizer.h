@@ -18,6 +18,8 @@
 
 #include "CPUT_DX11.h"
 #include "TaskMgrTBB.h"
+#include "HiZBuffer.h"
+#include "DepthBufferDesc.h"
 
 
 class DepthBufferRasterizer
@@ -28,24 +30,60 @@ class DepthBufferRasterizer
 		virtual void CreateTransformedModels(CPUTAssetSet **pAssetSet, UINT numAssetSets) = 0;
 		virtual void TransformModelsAndRasterizeToDepthBuffer() = 0;
 
+		// Starts transforming and rasterizing the occluders without waiting for the depth buffer.
+		// While the pass is in flight GetDepthStripsDone() returns one task set per Hi-Z strip that
+		// completes once the depth buffer and Hi-Z rows of the strip are final, NULL when the pass
+		// is already done. WaitForDepthBuffer() waits for the whole pass and ends it
+		virtual void StartTransformModelsAndRasterizeToDepthBuffer() {TransformModelsAndRasterizeToDepthBuffer();}
+		virtual void WaitForDepthBuffer() {}
+		virtual const TASKSETHANDLE* GetDepthStripsDone() {return NULL;}
+
 		virtual void ResetInsideFrustum() = 0;
 		virtual void IsVisible(CPUTCamera *pCamera) = 0;
 		virtual void SetViewProj(float4x4 *viewMatrix, float4x4 *projMatrix) = 0;
-		virtual void SetCPURenderTargetPixels(UINT *pRenderTargetPixels) = 0;
+		virtual void SetDepthBufferDesc(const DepthBufferDesc &desc) = 0;
 		virtual void SetOccluderSizeThreshold(float occluderSizeThreshold) = 0;
+		// Caps the occluder triangles rasterized per frame, the occluders are picked by
+		// score until the budget is used up. The time budget in seconds is turned into
+		// triangles with the raster time per triangle of the last frame. 0 turns a budget
+		// off. The scalar rasterizers rasterize all the occluders
+		virtual void SetOccluderBudget(UINT maxTriangles, float maxTime) {}
+		// Rasterizes the occluder proxies instead of the occluder meshes from the next
+		// CreateTransformedModels on. The scalar rasterizers always use the meshes
+		virtual void SetOccluderProxies(bool useProxies) {}
+		// Picks a level of detail for each occluder every frame from its size, from the
+		// next CreateTransformedModels on. The scalar rasterizers always use the meshes
+		virtual void SetOccluderLods(bool useLods) {}
+		// Seeds the depth buffer with last frame's depth reprojected to the new view and
+		// rasterizes only the best scored occluders on top. The scalar and masked rasterizers
+		// always start from a cleared depth buffer
+		virtual void SetDepthReprojection(bool useReprojection) {}
 		virtual inline void SetCamera(CPUTCamera *pCamera) = 0;
 
 		virtual UINT GetNumOccluders() = 0;
 		virtual UINT GetNumOccludersR2DB() = 0;
 		virtual double GetRasterizeTime() = 0;
+		virtual double GetBinTime() = 0;
 		virtual UINT GetNumTriangles() = 0;
 		virtual UINT GetNumRasterizedTriangles() = 0;
+		virtual const HiZBuffer* GetHiZBuffer() = 0;
+		// Number of occluder triangles binned to each tile, a tile without any keeps its cleared depth.
+		// NULL when the depth buffer was seeded by reprojection and the tiles are not cleared
+		virtual const UINT* GetTileTriangleCounts() = 0;
+		virtual const DepthBufferDesc& GetDepthBufferDesc() = 0;
+		// Depth buffer the occluders are rasterized to, valid after WaitForDepthBuffer()
+		virtual UINT* GetCPURenderTargetPixels() = 0;
 
 	protected:
 		TASKSETHANDLE mIsVisible;
+		TASKSETHANDLE mOccluderSize;
+		TASKSETHANDLE mCompact;
+		TASKSETHANDLE mReproject;
 		TASKSETHANDLE mXformMesh;
 		TASKSETHANDLE mBinMesh;
 		TASKSETHANDLE mRasterize;
+		TASKSETHANDLE *mpRasterizeRow;	 // one per row of tiles, allocated by the rasterizers that use them
+		TASKSETHANDLE *mpBuildHiZStrip;	 // one per Hi-Z strip, allocated likewise
 };
 
 
@@ -0,0 +1,371 @@
+//--------------------------------------------------------------------------------------
+// Copyright 2011 Intel Corporation
+// All Rights Reserved
+//
+// Permission is granted to use, copy, distribute and prepare derivative works of this
+// software for any purpose and without fee, provided, that the above copyright notice
+// and this statement appear in all copies.  Intel makes no representations about the
+// suitability of this software for any purpose.  THIS SOFTWARE IS PROVIDED "AS IS."
+// INTEL SPECIFICALLY DISCLAIMS ALL WARRANTIES, EXPRESS OR IMPLIED, AND ALL LIABILITY,
+// INCLUDING CONSEQUENTIAL AND OTHER INDIRECT DAMAGES, FOR THE USE OF THIS SOFTWARE,
+// INCLUDING LIABILITY FOR INFRINGEMENT OF ANY PROPRIETARY RIGHTS, AND INCLUDING THE
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  Intel does not
+// assume any responsibility for any errors which may appear in this software nor any
+// responsibility to update it.
+//
+//--------------------------------------------------------------------------------------
+
+#include "DepthBufferRasterizerAVXMT.h"
+
+DepthBufferRasterizerAVXMT::DepthBufferRasterizerAVXMT()
+	: DepthBufferRasterizerSSE()
+{
+	// The AVX2 kernels are compiled into the shared SSE files too, they must only run on CPUs that have it
+	ASSERT(HelperSSE::IsAVX2Supported(), _L("AVX2 is not supported"));
+	mpBins = new TriangleBins(NUM_XFORMVERTS_TASKS, mDesc.GetNumTiles());
+}
+
+DepthBufferRasterizerAVXMT::~DepthBufferRasterizerAVXMT()
+{
+	SAFE_DELETE(mpBins);
+}
+
+//-------------------------------------------------------------------------------
+// Create tasks to determine if the occluder model is within the viewing frustum 
+//-------------------------------------------------------------------------------
+void DepthBufferRasterizerAVXMT::IsVisible(CPUTCamera* pCamera)
+{
+	mpCamera = pCamera;
+	
+	gTaskMgr.CreateTaskSet(&DepthBufferRasterizerAVXMT::IsVisible, this, mNumModels1, NULL, 0, "Is Visible", &mIsVisible);
+	// Wait for the task set
+	gTaskMgr.WaitForSet(mIsVisible);
+	// Release the task set
+	gTaskMgr.ReleaseHandle(mIsVisible);
+	mIsVisible = TASKSETHANDLE_INVALID;
+	
+}
+
+void DepthBufferRasterizerAVXMT::IsVisible(VOID *taskData, INT context, UINT taskId, UINT taskCount)
+{
+	DepthBufferRasterizerAVXMT *pSOCSSE =  (DepthBufferRasterizerAVXMT*)taskData;
+	pSOCSSE->IsVisible(taskId, taskCount);
+}
+
+//------------------------------------------------------------
+// * Determine if the occluder model is inside view frustum
+//------------------------------------------------------------
+void DepthBufferRasterizerAVXMT::IsVisible(UINT taskId, UINT taskCount)
+{
+	mpTransformedModels1[taskId].IsVisible(mpCamera);
+}
+
+//------------------------------------------------------------------------------
+// Transforms and rasterizes the occluders and waits for the depth buffer
+//------------------------------------------------------------------------------
+void DepthBufferRasterizerAVXMT::TransformModelsAndRasterizeToDepthBuffer()
+{
+	StartTransformModelsAndRasterizeToDepthBuffer();
+	WaitForDepthBuffer();
+}
+
+//------------------------------------------------------------------------------
+// Create NUM_XFORMVERTS_TASKS to:
+// * Transform the occluder models on the CPU
+// * Bin the occluder triangles into tiles that the frame buffer is divided into
+// and then the task sets that rasterize the occluder triangles to the CPU depth 
+// buffer one row of tiles at a time and build the Hi-Z strips. Returns without
+// waiting for the raster and Hi-Z task sets
+//-------------------------------------------------------------------------------
+void DepthBufferRasterizerAVXMT::StartTransformModelsAndRasterizeToDepthBuffer()
+{
+	mRasterizeTimer.StartTimer();
+
+	// Reproject last frame's depth while the occluders are transformed and binned, the raster tasks wait for it
+	StartReprojection();
+	if(mReprojecting)
+	{
+		gTaskMgr.CreateTaskSet(&DepthBufferRasterizerSSE::Reproject, this, NUM_XFORMVERTS_TASKS, NULL, 0, "Reproject Depth", &mReproject);
+	}
+
+	// Size test the occluders and gather the ones left so that the transform and bin work is split evenly
+	gTaskMgr.CreateTaskSet(&DepthBufferRasterizerSSE::CalcOccluderSizes, this, NUM_XFORMVERTS_TASKS, NULL, 0, "Occluder Size", &mOccluderSize);
+	gTaskMgr.WaitForSet(mOccluderSize);
+	gTaskMgr.ReleaseHandle(mOccluderSize);
+	mOccluderSize = TASKSETHANDLE_INVALID;
+	CompactLiveOccluders();
+	
+	gTaskMgr.CreateTaskSet(&DepthBufferRasterizerAVXMT::TransformMeshes, this, NUM_XFORMVERTS_TASKS, NULL, 0, "Xform Vertices", &mXformMesh);
+	gTaskMgr.CreateTaskSet(&DepthBufferRasterizerAVXMT::BinTransformedMeshes, this, NUM_XFORMVERTS_TASKS, &mXformMesh, 1, "Bin Meshes", &mBinMesh);
+	
+	CreateRasterizeTasks(&DepthBufferRasterizerAVXMT::RasterizeBinnedTrianglesToDepthBuffer);
+}
+
+void DepthBufferRasterizerAVXMT::TransformMeshes(VOID* taskData, INT context, UINT taskId, UINT taskCount)
+{
+	DepthBufferRasterizerAVXMT *pSOCSSE =  (DepthBufferRasterizerAVXMT*)taskData;
+	pSOCSSE->TransformMeshes(taskId, taskCount);
+}
+
+//------------------------------------------------------------------------------------------------------------
+// Transforms the vertices of the occluders rasterized this frame. The tasks claim chunks of the live 
+// vertices until all of them are transformed, a chunk can span several occluders
+//------------------------------------------------------------------------------------------------------------
+void DepthBufferRasterizerAVXMT::TransformMeshes(UINT taskId, UINT taskCount)
+{
+	UINT start, end;
+	while(ClaimChunk(mNextXformChunk, XFORM_VERTS_PER_CHUNK, mNumLiveVertices, start, end))
+	{
+		for(UINT i = FindLiveOccluder(mpLiveVertexStart, start); start <= end; i++)
+		{
+			UINT occluderEnd = min(end + 1, mpLiveVertexStart[i + 1]);
+			if(start < occluderEnd)
+			{
+				mpTransformedModels1[mpLiveOccluders[i]].TransformMeshesAVX(start - mpLiveVertexStart[i], occluderEnd - 1 - mpLiveVertexStart[i]);
+			}
+			start = occluderEnd;
+		}
+	}
+}
+
+void DepthBufferRasterizerAVXMT::BinTransformedMeshes(VOID* taskData, INT context, UINT taskId, UINT taskCount)
+{
+	DepthBufferRasterizerAVXMT* sample =  (DepthBufferRasterizerAVXMT*)taskData;
+	sample->BinTransformedMeshes(taskId, taskCount);
+}
+
+//--------------------------------------------------------------------------------------
+// Bins the triangles of the occluders rasterized this frame into tiles. The tasks claim
+// chunks of the live triangles until all of them are binned, the triangles a task sets
+// up go to its own bins whichever chunks it processed
+//--------------------------------------------------------------------------------------
+void DepthBufferRasterizerAVXMT::BinTransformedMeshes(UINT taskId, UINT taskCount)
+{
+	CPUTTimerWin binTimer;
+	binTimer.StartTimer();
+
+	// Empty this task's bins and recycle their chunks
+	mpBins->Reset(taskId);
+	mNumDroppedTris[taskId] = 0;
+
+	UINT start, end;
+	while(ClaimChunk(mNextBinChunk, BIN_TRIS_PER_CHUNK, mNumLiveTriangles, start, end))
+	{
+		// The chunk's triangle setups are stored from its first triangle on, the parts of
+		// the clipped triangles have NUM_CLIP_PLANES setups per triangle after those of
+		// all the triangles
+		TriangleSetupSlots slots = {mpTriangleSetup, start, mNumTriangles1 + NUM_CLIP_PLANES * start, mNumTriangles1 + NUM_CLIP_PLANES * (end + 1), 0};
+		for(UINT i = FindLiveOccluder(mpLiveTriangleStart, start); start <= end; i++)
+		{
+			UINT occluderEnd = min(end + 1, mpLiveTriangleStart[i + 1]);
+			if(start < occluderEnd)
+			{
+				mpTransformedModels1[mpLiveOccluders[i]].BinTransformedTrianglesAVX(taskId, start - mpLiveTriangleStart[i], occluderEnd - 1 - mpLiveTriangleStart[i], slots, mpBins, mDesc);
+			}
+			start = occluderEnd;
+		}
+		mNumDroppedTris[taskId] += slots.mNumDropped;
+	}
+
+	mBinTaskTime[taskId] = binTimer.StopTimer();
+}
+
+void DepthBufferRasterizerAVXMT::RasterizeBinnedTrianglesToDepthBuffer(VOID* taskData, INT context, UINT taskId, UINT taskCount)
+{
+	// The tasks of a row set each rasterize one tile of the row
+	BandTaskData *pRow = (BandTaskData*)taskData;
+	DepthBufferRasterizerAVXMT* sample =  (DepthBufferRasterizerAVXMT*)pRow->mpRasterizer;
+	sample->RasterizeBinnedTrianglesToDepthBuffer(pRow->mBand * taskCount + taskId, sample->mDesc.GetNumTiles());
+}
+
+//-------------------------------------------------------------------------------
+// For each tile go through all the bins and process all the triangles in it.
+// Rasterize each triangle to the CPU depth buffer. 
+//-------------------------------------------------------------------------------
+template<class Layout>
+void DepthBufferRasterizerAVXMT::RasterizeTile(UINT taskId)
+{
+	// Set DAZ and FZ MXCSR bits to flush denormals to zero (i.e., make it faster)
+	// Denormal are zero (DAZ) is bit 6 and Flush to zero (FZ) is bit 15. 
+	// so to enable the two to have to set bits 6 and 15 which 1000 0000 0100 0000 = 0x8040
+	_mm_setcsr( _mm_getcsr() | 0x8040 );
+
+	// Lanes 0-3 hold the 2x2 quad at column c and lanes 4-7 the quad at column c+2,
+	// in the same order the SSE rasterizer uses for a single quad
+	__m256i colOffset = _mm256_set_epi32(2, 3, 2, 3, 0, 1, 0, 1);
+	__m256i rowOffset = _mm256_set_epi32(0, 0, 1, 1, 0, 0, 1, 1);
+
+	__m256i fxptMinusOne = _mm256_set1_epi32(-1);
+	float* pDepthBuffer = (float*)mpRenderTargetPixels; 
+
+	// Based on TaskId determine which tile to process
+	UINT screenWidthInTiles = mDesc.mWidthInTiles;
+    UINT tileX = taskId % screenWidthInTiles;
+    UINT tileY = taskId / screenWidthInTiles;
+
+    int tileStartX = tileX * mDesc.mTileWidth;
+	int tileEndX   = min(tileStartX + mDesc.mTileWidth, mDesc.mWidth);
+	
+	int tileStartY = tileY * mDesc.mTileHeight;
+	int tileEndY   = min(tileStartY + mDesc.mTileHeight, mDesc.mHeight);
+
+	// Clear or seed the tile here instead of the whole depth buffer before the raster tasks start
+	StartTile<Layout>(pDepthBuffer, tileStartX, tileStartY, tileEndX, tileEndY);
+
+	UINT tileId = tileY * screenWidthInTiles + tileX;
+
+	mpNumRasterizedTris[taskId] = 0;
+	for(UINT bin = 0; bin < mpBins->GetNumTasks(); bin++)
+	{
+		mpNumRasterizedTris[taskId] += mpBins->GetNumTris(tileId, bin);
+
+		// The triangles were set up in the bin stage, only clip their bounding box to the tile
+		for(const TriangleBins::Chunk *pChunk = mpBins->GetFirstChunk(tileId, bin); pChunk != NULL; pChunk = pChunk->mpNext)
+		{
+			for(UINT binIndex = 0; binIndex < pChunk->mNumTris; binIndex++)
+			{
+				const TriangleSetup &setup = mpTriangleSetup[pChunk->mTris[binIndex]];
+
+				// startX is aligned to the 4 pixel wide blocks
+				int startXx = max((int)setup.mStartX, tileStartX) & 0xFFFFFFFC;
+				int endXx	= min((int)setup.mEndX, tileEndX);
+				int startYy = max((int)setup.mStartY, tileStartY) & 0xFFFFFFFE;
+				int endYy	= min((int)setup.mEndY, tileEndY);
+
+				// Set up the edge functions relative to the first pair of quads, over the pairs that cover the bounding box in the tile
+				int endXq = (endXx + 3) & 0xFFFFFFFC;
+				int endYq = (endYy + 1) & 0xFFFFFFFE;
+				int edgeA[3], edgeB[3], edgeC[3];
+				if(!setup.GetEdges(startXx, startYy, endXq - 1, endYq - 1, edgeA, edgeB, edgeC))
+				{
+					continue;
+				}
+
+				// Edge functions and depth of the pixels of a pair of quads relative to its first
+				// pixel, and their steps to the next pair and row pair
+				__m256i quad0 = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_set1_epi32(edgeA[0]), colOffset), _mm256_mullo_epi32(_mm256_set1_epi32(edgeB[0]), rowOffset));
+				__m256i quad1 = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_set1_epi32(edgeA[1]), colOffset), _mm256_mullo_epi32(_mm256_set1_epi32(edgeB[1]), rowOffset));
+				__m256i quad2 = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_set1_epi32(edgeA[2]), colOffset), _mm256_mullo_epi32(_mm256_set1_epi32(edgeB[2]), rowOffset));
+
+				__m256i aa0Inc = _mm256_set1_epi32(edgeA[0] * 4);
+				__m256i aa1Inc = _mm256_set1_epi32(edgeA[1] * 4);
+				__m256i aa2Inc = _mm256_set1_epi32(edgeA[2] * 4);
+
+				__m256i bb0Inc = _mm256_set1_epi32(edgeB[0] * 2);
+				__m256i bb1Inc = _mm256_set1_epi32(edgeB[1] * 2);
+				__m256i bb2Inc = _mm256_set1_epi32(edgeB[2] * 2);
+
+				__m256 zdx = _mm256_set1_ps(setup.mZ[1]);
+				__m256 zdy = _mm256_set1_ps(setup.mZ[2]);
+				__m256 quadZ = _mm256_add_ps(_mm256_mul_ps(zdx, _mm256_cvtepi32_ps(colOffset)), _mm256_mul_ps(zdy, _mm256_cvtepi32_ps(rowOffset)));
+				__m256 zdxInc = _mm256_mul_ps(zdx, _mm256_set1_ps(4.0f));
+				__m256 zdyInc = _mm256_add_ps(zdy, zdy);
+
+				// Walk the bounding box in blocks aligned to RASTER_BLOCK_SIZE
+				for(int blockY = startYy; blockY < endYq; blockY = (blockY + RASTER_BLOCK_SIZE) & ~(RASTER_BLOCK_SIZE - 1))
+				{
+					int blockEndY = min((blockY + RASTER_BLOCK_SIZE) & ~(RASTER_BLOCK_SIZE - 1), endYq);
+					for(int blockX = startXx; blockX < endXq; blockX = (blockX + RASTER_BLOCK_SIZE) & ~(RASTER_BLOCK_SIZE - 1))
+					{
+						int blockEndX = min((blockX + RASTER_BLOCK_SIZE) & ~(RASTER_BLOCK_SIZE - 1), endXq);
+
+						// The edge functions are largest and smallest over the block at its corners
+						int blockC[3];
+						bool outside = false, inside = true;
+						for(int i = 0; i < 3; i++)
+						{
+							blockC[i] = edgeA[i] * (blockX - startXx) + edgeB[i] * (blockY - startYy) + edgeC[i];
+							int dx = edgeA[i] * (blockEndX - 1 - blockX);
+							int dy = edgeB[i] * (blockEndY - 1 - blockY);
+							outside |= blockC[i] + max(dx, 0) + max(dy, 0) < 0;
+							inside &= blockC[i] + min(dx, 0) + min(dy, 0) >= 0;
+						}
+
+						// Skip the block if all of its pixels are outside an edge
+						if(outside)
+						{
+							continue;
+						}
+
+						__m256 zRow = _mm256_add_ps(_mm256_set1_ps(setup.mZ[0] + setup.mZ[1] * blockX + setup.mZ[2] * blockY), quadZ);
+
+						// Fill the block without edge tests if all of its pixels are inside the triangle
+						if(inside)
+						{
+							for(int r = blockY; r < blockEndY; r += 2, zRow = _mm256_add_ps(zRow, zdyInc))
+							{
+								float *pRow = &pDepthBuffer[Layout::RowPairOffset(r, mDesc.mWidth)];
+								__m256 depth = zRow;
+								for(int c = blockX; c < blockEndX; c += 4, depth = _mm256_add_ps(depth, zdxInc))
+								{
+									float *pQuads = &pRow[Layout::QuadOffset(c)];
+									__m256 previousDepthValue = Layout::Load2Quads(pQuads, mDesc.mWidth);
+
+									__m256 depthMask = _mm256_cmp_ps(depth, previousDepthValue, _CMP_GE_OQ);
+
+									Layout::Store2Quads(pQuads, mDesc.mWidth, previousDepthValue, depth, _mm256_castps_si256(depthMask));
+								}//for each column
+							}// for each row
+							continue;
+						}
+
+						__m256i alphaRow = _mm256_add_epi32(_mm256_set1_epi32(blockC[0]), quad0);
+						__m256i betaRow  = _mm256_add_epi32(_mm256_set1_epi32(blockC[1]), quad1);
+						__m256i gamaRow  = _mm256_add_epi32(_mm256_set1_epi32(blockC[2]), quad2);
+
+						// Incrementally compute Fab(x, y) for all the pixels inside the block
+						for(int r = blockY; r < blockEndY; r += 2,
+														  alphaRow = _mm256_add_epi32(alphaRow, bb0Inc),
+														  betaRow  = _mm256_add_epi32(betaRow, bb1Inc),
+														  gamaRow  = _mm256_add_epi32(gamaRow, bb2Inc),
+														  zRow     = _mm256_add_ps(zRow, zdyInc))
+						{
+							float *pRow = &pDepthBuffer[Layout::RowPairOffset(r, mDesc.mWidth)];
+							__m256i alpha = alphaRow;
+							__m256i beta = betaRow;
+							__m256i gama = gamaRow;
+							__m256 depth = zRow;
+
+							for(int c = blockX; c < blockEndX; c += 4,
+															  alpha = _mm256_add_epi32(alpha, aa0Inc),
+															  beta  = _mm256_add_epi32(beta, aa1Inc),
+															  gama  = _mm256_add_epi32(gama, aa2Inc),
+															  depth = _mm256_add_ps(depth, zdxInc))
+							{
+								//Test Pixel inside triangle
+								__m256i mask = _mm256_cmpgt_epi32(_mm256_or_si256(_mm256_or_si256(alpha, beta), gama), fxptMinusOne);
+					
+								// Early out if all of these quads' pixels are outside the triangle.
+								if(_mm256_testz_si256(mask, mask))
+								{
+									continue;
+								}
+					
+								float *pQuads = &pRow[Layout::QuadOffset(c)];
+								__m256 previousDepthValue = Layout::Load2Quads(pQuads, mDesc.mWidth);
+
+								__m256 depthMask = _mm256_cmp_ps(depth, previousDepthValue, _CMP_GE_OQ);
+								__m256i finalMask = _mm256_and_si256(mask, _mm256_castps_si256(depthMask));
+
+								Layout::Store2Quads(pQuads, mDesc.mWidth, previousDepthValue, depth, finalMask);
+							}//for each column
+						}// for each row
+					}// for each block column
+				}// for each block row
+			}// for each triangle
+		}// for each chunk
+	}// for each bin
+}
+
+//-------------------------------------------------------------------------------
+// Rasterizes the tile with the kernel specialized for the depth buffer layout
+//-------------------------------------------------------------------------------
+void DepthBufferRasterizerAVXMT::RasterizeBinnedTrianglesToDepthBuffer(UINT taskId, UINT taskCount)
+{
+	switch(mDesc.mLayout)
+	{
+		case DEPTH_BUFFER_LINEAR:   RasterizeTile<DepthBufferLinear>(taskId); break;
+		case DEPTH_BUFFER_QUAD:     RasterizeTile<DepthBufferQuad>(taskId); break;
+		case DEPTH_BUFFER_BLOCK8X8: RasterizeTile<DepthBufferBlock8x8>(taskId); break;
+	}
+}
\ No newline at end of file
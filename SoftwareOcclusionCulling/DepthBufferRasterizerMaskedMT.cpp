@@ -0,0 +1,246 @@
+//--------------------------------------------------------------------------------------
+// Copyright 2011 Intel Corporation
+// All Rights Reserved
+//
+// Permission is granted to use, copy, distribute and prepare derivative works of this
+// software for any purpose and without fee, provided, that the above copyright notice
+// and this statement appear in all copies.  Intel makes no representations about the
+// suitability of this software for any purpose.  THIS SOFTWARE IS PROVIDED "AS IS."
+// INTEL SPECIFICALLY DISCLAIMS ALL WARRANTIES, EXPRESS OR IMPLIED, AND ALL LIABILITY,
+// INCLUDING CONSEQUENTIAL AND OTHER INDIRECT DAMAGES, FOR THE USE OF THIS SOFTWARE,
+// INCLUDING LIABILITY FOR INFRINGEMENT OF ANY PROPRIETARY RIGHTS, AND INCLUDING THE
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  Intel does not
+// assume any responsibility for any errors which may appear in this software nor any
+// responsibility to update it.
+//
+//--------------------------------------------------------------------------------------
+
+#include "DepthBufferRasterizerMaskedMT.h"
+
+DepthBufferRasterizerMaskedMT::DepthBufferRasterizerMaskedMT()
+	: DepthBufferRasterizerSSE()
+{
+	mpBins = new TriangleBins(NUM_XFORMVERTS_TASKS, mDesc.GetNumTiles());
+	mpMaskedDepthBuffer = new MaskedDepthBuffer;
+}
+
+DepthBufferRasterizerMaskedMT::~DepthBufferRasterizerMaskedMT()
+{
+	SAFE_DELETE(mpBins);
+	SAFE_DELETE(mpMaskedDepthBuffer);
+}
+
+//-------------------------------------------------------------------------------
+// The masked depth buffer is allocated for the new size like the float one
+//-------------------------------------------------------------------------------
+void DepthBufferRasterizerMaskedMT::SetDepthBufferDesc(const DepthBufferDesc &desc)
+{
+	DepthBufferRasterizerSSE::SetDepthBufferDesc(desc);
+	mpMaskedDepthBuffer->SetSize(desc.mWidth, desc.mHeight);
+}
+
+//-------------------------------------------------------------------------------
+// Create tasks to determine if the occluder model is within the viewing frustum 
+//-------------------------------------------------------------------------------
+void DepthBufferRasterizerMaskedMT::IsVisible(CPUTCamera* pCamera)
+{
+	mpCamera = pCamera;
+	
+	gTaskMgr.CreateTaskSet(&DepthBufferRasterizerMaskedMT::IsVisible, this, mNumModels1, NULL, 0, "Is Visible", &mIsVisible);
+	// Wait for the task set
+	gTaskMgr.WaitForSet(mIsVisible);
+	// Release the task set
+	gTaskMgr.ReleaseHandle(mIsVisible);
+	mIsVisible = TASKSETHANDLE_INVALID;
+	
+}
+
+void DepthBufferRasterizerMaskedMT::IsVisible(VOID *taskData, INT context, UINT taskId, UINT taskCount)
+{
+	DepthBufferRasterizerMaskedMT *pSOCSSE =  (DepthBufferRasterizerMaskedMT*)taskData;
+	pSOCSSE->IsVisible(taskId, taskCount);
+}
+
+//------------------------------------------------------------
+// * Determine if the occluder model is inside view frustum
+//------------------------------------------------------------
+void DepthBufferRasterizerMaskedMT::IsVisible(UINT taskId, UINT taskCount)
+{
+	mpTransformedModels1[taskId].IsVisible(mpCamera);
+}
+
+//------------------------------------------------------------------------------
+// Create NUM_XFORMVERTS_TASKS to:
+// * Transform the occluder models on the CPU
+// * Bin the occluder triangles into tiles that the frame buffer is divided into
+// * Rasterize the occluder triangles to the masked depth buffer
+//-------------------------------------------------------------------------------
+void DepthBufferRasterizerMaskedMT::TransformModelsAndRasterizeToDepthBuffer()
+{
+	mRasterizeTimer.StartTimer();
+
+	// Size test the occluders and gather the ones left so that the transform and bin work is split evenly
+	gTaskMgr.CreateTaskSet(&DepthBufferRasterizerSSE::CalcOccluderSizes, this, NUM_XFORMVERTS_TASKS, NULL, 0, "Occluder Size", &mOccluderSize);
+	gTaskMgr.WaitForSet(mOccluderSize);
+	gTaskMgr.ReleaseHandle(mOccluderSize);
+	mOccluderSize = TASKSETHANDLE_INVALID;
+	CompactLiveOccluders();
+	
+	gTaskMgr.CreateTaskSet(&DepthBufferRasterizerMaskedMT::TransformMeshes, this, NUM_XFORMVERTS_TASKS, NULL, 0, "Xform Vertices", &mXformMesh);
+	gTaskMgr.CreateTaskSet(&DepthBufferRasterizerMaskedMT::BinTransformedMeshes, this, NUM_XFORMVERTS_TASKS, &mXformMesh, 1, "Bin Meshes", &mBinMesh);
+	
+	gTaskMgr.CreateTaskSet(&DepthBufferRasterizerMaskedMT::RasterizeBinnedTrianglesToDepthBuffer, this, mDesc.GetNumTiles(), &mBinMesh, 1, "Raster Tris to DB", &mRasterize);	
+
+	// Wait for the task set
+	gTaskMgr.WaitForSet(mRasterize);
+	// Release the task set
+	gTaskMgr.ReleaseHandle(mXformMesh);
+	gTaskMgr.ReleaseHandle(mBinMesh);
+	gTaskMgr.ReleaseHandle(mRasterize);
+	mXformMesh = mBinMesh = mRasterize = TASKSETHANDLE_INVALID;
+
+	EndBinTime();
+	mRasterizeTime[mTimeCounter++] = mRasterizeTimer.StopTimer();
+	mTimeCounter = mTimeCounter >= AVG_COUNTER ? 0 : mTimeCounter;
+}
+
+void DepthBufferRasterizerMaskedMT::TransformMeshes(VOID* taskData, INT context, UINT taskId, UINT taskCount)
+{
+	DepthBufferRasterizerMaskedMT *pSOCSSE =  (DepthBufferRasterizerMaskedMT*)taskData;
+	pSOCSSE->TransformMeshes(taskId, taskCount);
+}
+
+//------------------------------------------------------------------------------------------------------------
+// Transforms the vertices of the occluders rasterized this frame. The tasks claim chunks of the live 
+// vertices until all of them are transformed, a chunk can span several occluders
+//------------------------------------------------------------------------------------------------------------
+void DepthBufferRasterizerMaskedMT::TransformMeshes(UINT taskId, UINT taskCount)
+{
+	UINT start, end;
+	while(ClaimChunk(mNextXformChunk, XFORM_VERTS_PER_CHUNK, mNumLiveVertices, start, end))
+	{
+		for(UINT i = FindLiveOccluder(mpLiveVertexStart, start); start <= end; i++)
+		{
+			UINT occluderEnd = min(end + 1, mpLiveVertexStart[i + 1]);
+			if(start < occluderEnd)
+			{
+				mpTransformedModels1[mpLiveOccluders[i]].TransformMeshes(start - mpLiveVertexStart[i], occluderEnd - 1 - mpLiveVertexStart[i]);
+			}
+			start = occluderEnd;
+		}
+	}
+}
+
+void DepthBufferRasterizerMaskedMT::BinTransformedMeshes(VOID* taskData, INT context, UINT taskId, UINT taskCount)
+{
+	DepthBufferRasterizerMaskedMT* sample =  (DepthBufferRasterizerMaskedMT*)taskData;
+	sample->BinTransformedMeshes(taskId, taskCount);
+}
+
+//--------------------------------------------------------------------------------------
+// Bins the triangles of the occluders rasterized this frame into tiles. The tasks claim
+// chunks of the live triangles until all of them are binned, the triangles a task sets
+// up go to its own bins whichever chunks it processed
+//--------------------------------------------------------------------------------------
+void DepthBufferRasterizerMaskedMT::BinTransformedMeshes(UINT taskId, UINT taskCount)
+{
+	CPUTTimerWin binTimer;
+	binTimer.StartTimer();
+
+	// Empty this task's bins and recycle their chunks
+	mpBins->Reset(taskId);
+	mNumDroppedTris[taskId] = 0;
+
+	UINT start, end;
+	while(ClaimChunk(mNextBinChunk, BIN_TRIS_PER_CHUNK, mNumLiveTriangles, start, end))
+	{
+		// The chunk's triangle setups are stored from its first triangle on, the parts of
+		// the clipped triangles have NUM_CLIP_PLANES setups per triangle after those of
+		// all the triangles
+		TriangleSetupSlots slots = {mpTriangleSetup, start, mNumTriangles1 + NUM_CLIP_PLANES * start, mNumTriangles1 + NUM_CLIP_PLANES * (end + 1), 0};
+		for(UINT i = FindLiveOccluder(mpLiveTriangleStart, start); start <= end; i++)
+		{
+			UINT occluderEnd = min(end + 1, mpLiveTriangleStart[i + 1]);
+			if(start < occluderEnd)
+			{
+				mpTransformedModels1[mpLiveOccluders[i]].BinTransformedTriangles(taskId, start - mpLiveTriangleStart[i], occluderEnd - 1 - mpLiveTriangleStart[i], slots, mpBins, mDesc);
+			}
+			start = occluderEnd;
+		}
+		mNumDroppedTris[taskId] += slots.mNumDropped;
+	}
+
+	mBinTaskTime[taskId] = binTimer.StopTimer();
+}
+
+void DepthBufferRasterizerMaskedMT::RasterizeBinnedTrianglesToDepthBuffer(VOID* taskData, INT context, UINT taskId, UINT taskCount)
+{
+	DepthBufferRasterizerMaskedMT* sample =  (DepthBufferRasterizerMaskedMT*)taskData;
+	sample->RasterizeBinnedTrianglesToDepthBuffer(taskId, taskCount);
+}
+
+//-------------------------------------------------------------------------------
+// For each tile go through all the bins and process all the triangles in it.
+// Rasterize each triangle to the masked depth buffer. Each task owns the masked 
+// tiles of its screen tile, so it clears them first.
+//-------------------------------------------------------------------------------
+void DepthBufferRasterizerMaskedMT::RasterizeBinnedTrianglesToDepthBuffer(UINT taskId, UINT taskCount)
+{
+	// Set DAZ and FZ MXCSR bits to flush denormals to zero (i.e., make it faster)
+	// Denormal are zero (DAZ) is bit 6 and Flush to zero (FZ) is bit 15. 
+	// so to enable the two to have to set bits 6 and 15 which 1000 0000 0100 0000 = 0x8040
+	_mm_setcsr( _mm_getcsr() | 0x8040 );
+
+	// Based on TaskId determine which tile to process
+	UINT screenWidthInTiles = mDesc.mWidthInTiles;
+    UINT tileX = taskId % screenWidthInTiles;
+    UINT tileY = taskId / screenWidthInTiles;
+
+    int tileStartX = tileX * mDesc.mTileWidth;
+	int tileEndX   = min(tileStartX + mDesc.mTileWidth, mDesc.mWidth);
+	
+	int tileStartY = tileY * mDesc.mTileHeight;
+	int tileEndY   = min(tileStartY + mDesc.mTileHeight, mDesc.mHeight);
+
+	mpMaskedDepthBuffer->ClearTiles(tileStartX, tileStartY, tileEndX, tileEndY);
+
+	UINT tileId = tileY * screenWidthInTiles + tileX;
+
+	mpNumRasterizedTris[taskId] = 0;
+	for(UINT bin = 0; bin < mpBins->GetNumTasks(); bin++)
+	{
+		mpNumRasterizedTris[taskId] += mpBins->GetNumTris(tileId, bin);
+
+		// The triangles were set up in the bin stage, only clip their bounding box to the tile
+		for(const TriangleBins::Chunk *pChunk = mpBins->GetFirstChunk(tileId, bin); pChunk != NULL; pChunk = pChunk->mpNext)
+		{
+			for(UINT binIndex = 0; binIndex < pChunk->mNumTris; binIndex++)
+			{
+				const TriangleSetup &setup = mpTriangleSetup[pChunk->mTris[binIndex]];
+
+				int startXx = max((int)setup.mStartX, tileStartX);
+				int endXx	= min((int)setup.mEndX, tileEndX);
+				int startYy = max((int)setup.mStartY, tileStartY);
+				int endYy	= min((int)setup.mEndY, tileEndY);
+
+				// Edge functions relative to the first pixel of the bounding box in the tile
+				int edgeA[3], edgeB[3], edgeC[3];
+				if(!setup.GetEdges(startXx, startYy, endXx - 1, endYy - 1, edgeA, edgeB, edgeC))
+				{
+					continue;
+				}
+
+				// Depth plane at the first pixel
+				float z0 = setup.mZ[0] + setup.mZ[1] * startXx + setup.mZ[2] * startYy;
+
+				mpMaskedDepthBuffer->RasterizeTriangle(edgeA, edgeB, edgeC, z0, setup.mZ[1], setup.mZ[2], setup.mZMin,
+													   startXx, startYy, endXx, endYy);
+			}// for each triangle
+		}// for each chunk
+	}// for each bin
+
+	if(gVisualizeDepthBuffer)
+	{
+		mpMaskedDepthBuffer->ResolveToDepthBuffer((float*)mpRenderTargetPixels, mDesc.mWidth, tileStartX, tileStartY, tileEndX, tileEndY);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+//--------------------------------------------------------------------------------------
+// Copyright 2011 Intel Corporation
+// All Rights Reserved
+//
+// Permission is granted to use, copy, distribute and prepare derivative works of this
+// software for any purpose and without fee, provided, that the above copyright notice
+// and this statement appear in all copies.  Intel makes no representations about the
+// suitability of this software for any purpose.  THIS SOFTWARE IS PROVIDED "AS IS."
+// INTEL SPECIFICALLY DISCLAIMS ALL WARRANTIES, EXPRESS OR IMPLIED, AND ALL LIABILITY,
+// INCLUDING CONSEQUENTIAL AND OTHER INDIRECT DAMAGES, FOR THE USE OF THIS SOFTWARE,
+// INCLUDING LIABILITY FOR INFRINGEMENT OF ANY PROPRIETARY RIGHTS, AND INCLUDING THE
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  Intel does not
+// assume any responsibility for any errors which may appear in this software nor any
+// responsibility to update it.
+//--------------------------------------------------------------------------------------
+#ifndef DEPTHBUFFERRASTERIZERMASKEDMT_H
+#define DEPTHBUFFERRASTERIZERMASKEDMT_H
+
+#include "DepthBufferRasterizerSSE.h"
+#include "MaskedDepthBuffer.h"
+
+// Transforms and bins the occluders like DepthBufferRasterizerSSEMT but rasterizes
+// them to a MaskedDepthBuffer instead of the float depth buffer. The float depth
+// buffer is only written when it is visualized
+class DepthBufferRasterizerMaskedMT : public DepthBufferRasterizerSSE
+{
+	public:
+		DepthBufferRasterizerMaskedMT();
+		~DepthBufferRasterizerMaskedMT();
+
+		void IsVisible(CPUTCamera *pCamera);
+		void TransformModelsAndRasterizeToDepthBuffer();
+		void SetDepthBufferDesc(const DepthBufferDesc &desc);
+
+		// The masked engine does not build a Hi-Z buffer
+		inline const HiZBuffer* GetHiZBuffer() {return NULL;}
+		inline const MaskedDepthBuffer* GetMaskedDepthBuffer() {return mpMaskedDepthBuffer;}
+
+	private:
+		MaskedDepthBuffer *mpMaskedDepthBuffer;
+
+		static void IsVisible(VOID* taskData, INT context, UINT taskId, UINT taskCount);
+		void IsVisible(UINT taskId, UINT taskCount);
+
+		static void TransformMeshes(VOID* taskData, INT context, UINT taskId, UINT taskCount);
+		void TransformMeshes(UINT taskId, UINT taskCount);
+
+		static void BinTransformedMeshes(VOID* taskData, INT context, UINT taskId, UINT taskCount);
+		void BinTransformedMeshes(UINT taskId, UINT taskCount); 
+
+		static void RasterizeBinnedTrianglesToDepthBuffer(VOID* taskData, INT context, UINT taskId, UINT taskCount);
+		void RasterizeBinnedTrianglesToDepthBuffer(UINT taskId, UINT taskCount);
+};
+
+#endif  //DEPTHBUFFERRASTERIZERMASKEDMT_H
\ No newline at end of file
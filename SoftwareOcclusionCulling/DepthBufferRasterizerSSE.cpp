@@ -14,6 +14,9 @@
 // responsibility to update it.
 //-------------------------------------------------------------------------------------
 #include "DepthBufferRasterizerSSE.h"
+#include <limits.h>
+#include <float.h>
+#include <malloc.h>
 
 DepthBufferRasterizerSSE::DepthBufferRasterizerSSE()
 	: DepthBufferRasterizer(),
@@ -26,32 +29,136 @@ DepthBufferRasterizerSSE::DepthBufferRasterizerSSE()
 	  mNumTriangles1(0),
 	  mpXformedPos1(NULL),
 	  mpCamera(NULL),
+	  mpNumRasterizedTris(NULL),
 	  mpRenderTargetPixels(NULL),
 	  mNumRasterized(NULL),
-	  mpBin(NULL),
-	  mpBinModel(NULL),
-	  mpBinMesh(NULL),
-	  mpNumTrisInBin(NULL),
+	  mpLiveOccluders(NULL),
+	  mpLiveVertexStart(NULL),
+	  mpLiveTriangleStart(NULL),
+	  mNumLiveVertices(0),
+	  mNumLiveTriangles(0),
+	  mOccluderTriBudget(0),
+	  mOccluderTimeBudget(0.0f),
+	  mTimePerTriangle(0.0),
+	  mUseOccluderProxies(false),
+	  mUseOccluderLods(false),
+	  mUseReprojection(false),
+	  mReprojecting(false),
+	  mDepthBufferValid(false),
+	  mpReprojectedPixels(NULL),
+	  mpOccluderScores(NULL),
+	  mNextXformChunk(0),
+	  mNextBinChunk(0),
+	  mpTriangleSetup(NULL),
+	  mpBins(NULL),
+	  mpHiZBuffer(NULL),
+	  mpTileRowTaskData(NULL),
+	  mpHiZStripTaskData(NULL),
+	  mNumHiZStrips(0),
 	  mTimeCounter(0)
 {
 	mViewMatrix = (__m128*)_aligned_malloc(sizeof(float) * 4 * 4, 16);
 	mProjMatrix = (__m128*)_aligned_malloc(sizeof(float) * 4 * 4, 16);
+	mpHiZBuffer = new HiZBuffer;
+	AllocDepthBuffer();
 
 	for(UINT i = 0; i < AVG_COUNTER; i++)
 	{
 		mRasterizeTime[i] = 0.0;
+		mBinTime[i] = 0.0;
+	}
+	for(UINT i = 0; i < NUM_XFORMVERTS_TASKS; i++)
+	{
+		mBinTaskTime[i] = 0.0;
+		mNumDroppedTris[i] = 0;
 	}
 }
 
 DepthBufferRasterizerSSE::~DepthBufferRasterizerSSE()
+{
+	ReleaseTransformedModels();
+	ReleaseDepthBuffer();
+	_aligned_free(mViewMatrix);
+	_aligned_free(mProjMatrix);
+	SAFE_DELETE(mpHiZBuffer);
+}
+
+//--------------------------------------------------------------------
+// Frees the transformed models so that they can be created again
+//--------------------------------------------------------------------
+void DepthBufferRasterizerSSE::ReleaseTransformedModels()
 {
 	SAFE_DELETE_ARRAY(mpTransformedModels1);
 	SAFE_DELETE_ARRAY(mpXformedPosOffset1);
 	SAFE_DELETE_ARRAY(mpStartV1);
 	SAFE_DELETE_ARRAY(mpStartT1)
+	SAFE_DELETE_ARRAY(mpLiveOccluders);
+	SAFE_DELETE_ARRAY(mpLiveVertexStart);
+	SAFE_DELETE_ARRAY(mpLiveTriangleStart);
+	SAFE_DELETE_ARRAY(mpOccluderScores);
 	_aligned_free(mpXformedPos1);
-	_aligned_free(mViewMatrix);
-	_aligned_free(mProjMatrix);
+	_aligned_free(mpTriangleSetup);
+	mpXformedPos1 = NULL;
+	mpTriangleSetup = NULL;
+	mNumModels1 = mNumVertices1 = mNumTriangles1 = 0;
+	mNumRasterized = mNumLiveVertices = mNumLiveTriangles = 0;
+}
+
+//--------------------------------------------------------------------
+// Allocates the depth buffer and the task data of the tile rows and the
+// Hi-Z strips for the size and tile grid of mDesc
+//--------------------------------------------------------------------
+void DepthBufferRasterizerSSE::AllocDepthBuffer()
+{
+	ReleaseDepthBuffer();
+
+	UINT numPixels = mDesc.GetNumPixels();
+	mpRenderTargetPixels = (UINT*)_aligned_malloc(sizeof(float) * numPixels, CACHE_LINE_SIZE);
+	mpReprojectedPixels = (float*)_aligned_malloc(sizeof(float) * numPixels, CACHE_LINE_SIZE);
+	ASSERT(mpRenderTargetPixels != NULL && mpReprojectedPixels != NULL, _L("Failed allocating the depth buffer"));
+
+	// No reprojected depth has landed anywhere yet
+	for(UINT i = 0; i < numPixels; i++)
+	{
+		mpReprojectedPixels[i] = FLT_MAX;
+	}
+
+	mpNumRasterizedTris = new UINT[mDesc.GetNumTiles()];
+	for(int i = 0; i < mDesc.GetNumTiles(); i++)
+	{
+		mpNumRasterizedTris[i] = 0;
+	}
+
+	mpTileRowTaskData = new BandTaskData[mDesc.mHeightInTiles];
+	mpRasterizeRow = new TASKSETHANDLE[mDesc.mHeightInTiles];
+	for(int i = 0; i < mDesc.mHeightInTiles; i++)
+	{
+		mpTileRowTaskData[i].mpRasterizer = this;
+		mpTileRowTaskData[i].mBand = i;
+		mpRasterizeRow[i] = TASKSETHANDLE_INVALID;
+	}
+
+	mpHiZStripTaskData = new BandTaskData[mDesc.GetNumHiZStrips()];
+	mpBuildHiZStrip = new TASKSETHANDLE[mDesc.GetNumHiZStrips()];
+	for(int i = 0; i < mDesc.GetNumHiZStrips(); i++)
+	{
+		mpHiZStripTaskData[i].mpRasterizer = this;
+		mpHiZStripTaskData[i].mBand = i;
+		mpBuildHiZStrip[i] = TASKSETHANDLE_INVALID;
+	}
+}
+
+void DepthBufferRasterizerSSE::ReleaseDepthBuffer()
+{
+	_aligned_free(mpRenderTargetPixels);
+	_aligned_free(mpReprojectedPixels);
+	mpRenderTargetPixels = NULL;
+	mpReprojectedPixels = NULL;
+	SAFE_DELETE_ARRAY(mpNumRasterizedTris);
+	SAFE_DELETE_ARRAY(mpTileRowTaskData);
+	SAFE_DELETE_ARRAY(mpRasterizeRow);
+	SAFE_DELETE_ARRAY(mpHiZStripTaskData);
+	SAFE_DELETE_ARRAY(mpBuildHiZStrip);
 }
 
 //--------------------------------------------------------------------
@@ -61,6 +168,13 @@ DepthBufferRasterizerSSE::~DepthBufferRasterizerSSE()
 //--------------------------------------------------------------------
 void DepthBufferRasterizerSSE::CreateTransformedModels(CPUTAssetSet **mpAssetSet, UINT numAssetSets)
 {
+	CreateTransformedModels(mpAssetSet, numAssetSets, NULL);
+}
+
+void DepthBufferRasterizerSSE::CreateTransformedModels(CPUTAssetSet **mpAssetSet, UINT numAssetSets, DepthBufferRasterizerSSE *pSharedRasterizer)
+{
+	ReleaseTransformedModels();
+
 	for(UINT assetId = 0; assetId < numAssetSets; assetId++)
 	{
 		for(UINT nodeId = 0; nodeId < mpAssetSet[assetId]->GetAssetCount(); nodeId++)
@@ -76,10 +190,16 @@ void DepthBufferRasterizerSSE::CreateTransformedModels(CPUTAssetSet **mpAssetSet
 		}
 	}
 
+	ASSERT(!pSharedRasterizer || (pSharedRasterizer != this && pSharedRasterizer->mNumModels1 == mNumModels1), _L("The shared rasterizer has other models"));
+
 	mpTransformedModels1 = new TransformedModelSSE[mNumModels1];
 	mpXformedPosOffset1 = new UINT[mNumModels1];
 	mpStartV1 = new UINT[mNumModels1];
 	mpStartT1 = new UINT[mNumModels1];
+	mpLiveOccluders = new UINT[mNumModels1];
+	mpLiveVertexStart = new UINT[mNumModels1 + 1];
+	mpLiveTriangleStart = new UINT[mNumModels1 + 1];
+	mpOccluderScores = new OccluderScore[mNumModels1];
 
 	mpStartV1[0] = mpStartT1[0] = 0;
 	
@@ -94,7 +214,8 @@ void DepthBufferRasterizerSSE::CreateTransformedModels(CPUTAssetSet **mpAssetSet
 			{
 				CPUTModelDX11* model = (CPUTModelDX11*)pRenderNode;
 				model = (CPUTModelDX11*)pRenderNode;
-				mpTransformedModels1[modelId].CreateTransformedMeshes(model);
+				const TransformedModelSSE *pSource = pSharedRasterizer ? &pSharedRasterizer->mpTransformedModels1[modelId] : NULL;
+				mpTransformedModels1[modelId].CreateTransformedMeshes(model, mUseOccluderProxies, mUseOccluderLods, pSource);
 			
 				mpXformedPosOffset1[modelId] = mpTransformedModels1[modelId].GetNumVertices();
 
@@ -120,9 +241,40 @@ void DepthBufferRasterizerSSE::CreateTransformedModels(CPUTAssetSet **mpAssetSet
 		
 	//for x, y, z, w
 	mpXformedPos1 = (__m128*)_aligned_malloc(sizeof(float )* 4 * mNumVertices1, 16);
+
+	// Each bin chunk writes the setup of its triangles from the chunk's first triangle
+	// on, a triangle has one setup at most. The parts of the clipped triangles go
+	// after those, each chunk has NUM_CLIP_PLANES clip setups per triangle there
+	mpTriangleSetup = (TriangleSetup*)_aligned_malloc(sizeof(TriangleSetup) * (1 + NUM_CLIP_PLANES) * mNumTriangles1, 64);
 	for(UINT i = 0; i < mNumModels1; i++)
 	{
 		mpTransformedModels1[i].SetXformedPos(&mpXformedPos1[mpStartV1[i]], mpStartV1[i]);
+		mpTransformedModels1[i].SetViewportMatrix(mDesc.mViewportMatrix);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// The occluders are transformed with the viewport matrix of the new size, the 
+// Hi-Z pyramid only covers the part of the depth buffer that is in use. The depth
+// buffer of the last pass is not reprojected to a different size or layout
+//-----------------------------------------------------------------------------
+void DepthBufferRasterizerSSE::SetDepthBufferDesc(const DepthBufferDesc &desc)
+{
+	bool resize = !desc.IsSameSize(mDesc);
+	mDesc = desc;
+	mDepthBufferValid = false;
+	if(resize)
+	{
+		AllocDepthBuffer();
+		if(mpBins != NULL)
+		{
+			mpBins->SetNumTiles(desc.GetNumTiles());
+		}
+	}
+	mpHiZBuffer->SetSize(desc.mWidth, desc.mHeight, desc.mLayout);
+	for(UINT i = 0; i < mNumModels1; i++)
+	{
+		mpTransformedModels1[i].SetViewportMatrix(desc.mViewportMatrix);
 	}
 }
 
@@ -137,4 +289,516 @@ void DepthBufferRasterizerSSE::SetViewProj(float4x4 *viewMatrix, float4x4 *projM
 	mProjMatrix[1] = _mm_loadu_ps((float*)&projMatrix->r1);
 	mProjMatrix[2] = _mm_loadu_ps((float*)&projMatrix->r2);
 	mProjMatrix[3] = _mm_loadu_ps((float*)&projMatrix->r3);
+
+	mViewProj = *viewMatrix * *projMatrix;
+}
+
+void DepthBufferRasterizerSSE::CalcOccluderSizes(VOID* taskData, INT context, UINT taskId, UINT taskCount)
+{
+	DepthBufferRasterizerSSE *pSOCSSE = (DepthBufferRasterizerSSE*)taskData;
+	pSOCSSE->CalcOccluderSizes(taskId, taskCount);
+}
+
+//-----------------------------------------------------------------------------
+// Size tests the occluders in the view frustum and computes their object to 
+// screen space matrix. Each task processes a contiguous range of occluders
+//-----------------------------------------------------------------------------
+void DepthBufferRasterizerSSE::CalcOccluderSizes(UINT taskId, UINT taskCount)
+{
+	UINT modelsPerTask = (mNumModels1 + taskCount - 1) / taskCount;
+	UINT start = taskId * modelsPerTask;
+	UINT end   = min(start + modelsPerTask, mNumModels1);
+	for(UINT i = start; i < end; i++)
+	{
+		mpTransformedModels1[i].CalcCumulativeMatrixAndSize(mViewMatrix, mProjMatrix, mpCamera);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Keeps the occluders that passed the frustum and size tests within the budget.
+// When they have more triangles than the budget they are taken in order of their
+// score, an occluder that doesn't fit is skipped and the next ones are tried.
+// The budget is the smaller of the triangle budget and the triangles the time
+// budget allows at last frame's raster time per triangle. When the depth buffer
+// is seeded by reprojection only a fraction of the triangles is rasterized, the
+// occluders that were left out for longer score higher since the reprojected
+// depth has less and less of them
+//-----------------------------------------------------------------------------
+void DepthBufferRasterizerSSE::SelectOccluders()
+{
+	// Keep the last estimate when no triangles were rasterized so the time budget does not switch off every other frame
+	if(mNumLiveTriangles > 0)
+	{
+		mTimePerTriangle = mRasterizeTime[(mTimeCounter + AVG_COUNTER - 1) % AVG_COUNTER] / mNumLiveTriangles;
+	}
+
+	UINT numCandidates = 0;
+	mNumLiveTriangles = 0;
+	for(UINT i = 0; i < mNumModels1; i++)
+	{
+		mpTransformedModels1[i].SetOverBudget(false);
+		if(mpTransformedModels1[i].IsRasterized2DB())
+		{
+			mpOccluderScores[numCandidates].mScore = mpTransformedModels1[i].GetScore();
+			if(mReprojecting)
+			{
+				mpOccluderScores[numCandidates].mScore *= (float)(1 + mpTransformedModels1[i].GetFramesNotRasterized());
+			}
+			mpOccluderScores[numCandidates].mModel = i;
+			mNumLiveTriangles += mpTransformedModels1[i].GetNumTriangles();
+			numCandidates++;
+		}
+	}
+
+	UINT budget = mOccluderTriBudget > 0 ? mOccluderTriBudget : UINT_MAX;
+	if(mOccluderTimeBudget > 0.0f && mTimePerTriangle > 0.0)
+	{
+		double timeBudgetTris = mOccluderTimeBudget / mTimePerTriangle;
+		budget = timeBudgetTris < (double)budget ? (UINT)timeBudgetTris : budget;
+	}
+	if(mReprojecting)
+	{
+		budget = min(budget, (UINT)(mNumLiveTriangles * REPROJECTION_OCCLUDER_FRACTION));
+	}
+
+	if(mNumLiveTriangles > budget)
+	{
+		qsort(mpOccluderScores, numCandidates, sizeof(OccluderScore), CompareOccluderScores);
+
+		mNumLiveTriangles = 0;
+		for(UINT i = 0; i < numCandidates; i++)
+		{
+			TransformedModelSSE &model = mpTransformedModels1[mpOccluderScores[i].mModel];
+			if(mNumLiveTriangles + model.GetNumTriangles() <= budget)
+			{
+				mNumLiveTriangles += model.GetNumTriangles();
+			}
+			else
+			{
+				model.SetOverBudget(true);
+			}
+		}
+	}
+
+	for(UINT i = 0; i < mNumModels1; i++)
+	{
+		mpTransformedModels1[i].SetRasterizedLastFrame(mpTransformedModels1[i].IsRasterized2DB());
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Orders occluder scores from the highest to the lowest
+//-----------------------------------------------------------------------------
+int DepthBufferRasterizerSSE::CompareOccluderScores(const void *pScore0, const void *pScore1)
+{
+	float score0 = ((const OccluderScore*)pScore0)->mScore;
+	float score1 = ((const OccluderScore*)pScore1)->mScore;
+	return score0 > score1 ? -1 : (score0 < score1 ? 1 : 0);
+}
+
+void DepthBufferRasterizerSSE::CompactLiveOccluders(VOID* taskData, INT context, UINT taskId, UINT taskCount)
+{
+	DepthBufferRasterizerSSE *pSOCSSE = (DepthBufferRasterizerSSE*)taskData;
+	pSOCSSE->CompactLiveOccluders();
+}
+
+//-----------------------------------------------------------------------------
+// Gathers the occluders that passed the frustum and size tests and fit in the
+// budget and builds the prefix sums of their vertex and triangle counts, so that the transform and bin
+// tasks can split the work that is left evenly instead of by total model size
+//-----------------------------------------------------------------------------
+void DepthBufferRasterizerSSE::CompactLiveOccluders()
+{
+	SelectOccluders();
+
+	mNumRasterized = 0;
+	mNumLiveVertices = mNumLiveTriangles = 0;
+	for(UINT i = 0; i < mNumModels1; i++)
+	{
+		if(mpTransformedModels1[i].IsRasterized2DB())
+		{
+			mpLiveOccluders[mNumRasterized] = i;
+			mpLiveVertexStart[mNumRasterized] = mNumLiveVertices;
+			mpLiveTriangleStart[mNumRasterized] = mNumLiveTriangles;
+			mNumLiveVertices += mpTransformedModels1[i].GetNumVertices();
+			mNumLiveTriangles += mpTransformedModels1[i].GetNumTriangles();
+			mNumRasterized++;
+		}
+	}
+	mpLiveVertexStart[mNumRasterized] = mNumLiveVertices;
+	mpLiveTriangleStart[mNumRasterized] = mNumLiveTriangles;
+
+	mNextXformChunk = mNextBinChunk = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Returns the live occluder that holds the vertex or triangle index, given the
+// prefix sums of the live occluder vertex or triangle counts
+//-----------------------------------------------------------------------------
+UINT DepthBufferRasterizerSSE::FindLiveOccluder(const UINT *pLiveStart, UINT index)
+{
+	UINT first = 0, last = mNumRasterized - 1;
+	while(first < last)
+	{
+		UINT mid = (first + last + 1) / 2;
+		if(pLiveStart[mid] <= index)
+		{
+			first = mid;
+		}
+		else
+		{
+			last = mid - 1;
+		}
+	}
+	return first;
+}
+
+//-----------------------------------------------------------------------------
+// Keeps the farther of the depth at pDepth and depth when several tasks reproject
+// to the same pixel. The depths are positive so their bits compare like integers
+//-----------------------------------------------------------------------------
+static inline void InterlockedMinDepth(float *pDepth, float depth)
+{
+	LONG newDepth = *(LONG*)&depth;
+	LONG oldDepth = *(volatile LONG*)pDepth;
+	while(newDepth < oldDepth)
+	{
+		LONG seenDepth = InterlockedCompareExchange((volatile LONG*)pDepth, newDepth, oldDepth);
+		if(seenDepth == oldDepth)
+		{
+			break;
+		}
+		oldDepth = seenDepth;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Decides if this frame's depth buffer is seeded with the depth of the last pass
+// reprojected to the new view, and sets up the matrix that takes last frame's
+// screen space to this frame's. Has to be called at the start of every pass
+//-----------------------------------------------------------------------------
+void DepthBufferRasterizerSSE::StartReprojection()
+{
+	float4x4 viewProj = mViewProj * mDesc.mViewportMatrix;
+
+	mReprojecting = mUseReprojection && mDepthBufferValid;
+	if(mReprojecting)
+	{
+		float4x4 inverseDepthBufferViewProj = mDepthBufferViewProj;
+		inverseDepthBufferViewProj.invert();
+		mReprojectMatrix = inverseDepthBufferViewProj * viewProj;
+	}
+
+	mDepthBufferViewProj = viewProj;
+	mDepthBufferValid = true;
+}
+
+void DepthBufferRasterizerSSE::Reproject(VOID* taskData, INT context, UINT taskId, UINT taskCount)
+{
+	DepthBufferRasterizerSSE *pSOCSSE = (DepthBufferRasterizerSSE*)taskData;
+	pSOCSSE->Reproject(taskId, taskCount);
+}
+
+//-----------------------------------------------------------------------------
+// Reprojects last frame's depth buffer to this frame, each task a contiguous
+// range of row pairs. Has to be done before the raster tasks overwrite it
+//-----------------------------------------------------------------------------
+void DepthBufferRasterizerSSE::Reproject(UINT taskId, UINT taskCount)
+{
+	int numRowPairs = mDesc.mHeight / 2;
+	int rowPairsPerTask = (numRowPairs + taskCount - 1) / taskCount;
+	int startY = 2 * min((int)taskId * rowPairsPerTask, numRowPairs);
+	int endY   = 2 * min((int)(taskId + 1) * rowPairsPerTask, numRowPairs);
+
+	switch(mDesc.mLayout)
+	{
+		case DEPTH_BUFFER_LINEAR:   ReprojectRows<DepthBufferLinear>(startY, endY, taskCount > 1); break;
+		case DEPTH_BUFFER_QUAD:     ReprojectRows<DepthBufferQuad>(startY, endY, taskCount > 1); break;
+		case DEPTH_BUFFER_BLOCK8X8: ReprojectRows<DepthBufferBlock8x8>(startY, endY, taskCount > 1); break;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Farthest depth of each quad of the row pair at y, 0 for the quads with an empty
+// pixel and for the row pairs outside the depth buffer
+//-----------------------------------------------------------------------------
+template<class Layout>
+static void GetFarthestQuadDepths(const float *pDepthBuffer, int width, int height, int y, float *pFarthest)
+{
+	if(y < 0 || y >= height)
+	{
+		memset(pFarthest, 0, (width / 2) * sizeof(float));
+		return;
+	}
+
+	const float *pRow = &pDepthBuffer[Layout::RowPairOffset(y, width)];
+	for(int x = 0; x < width; x += 2)
+	{
+		__m128 depth = Layout::LoadQuad(&pRow[Layout::QuadOffset(x)], width);
+		depth = _mm_min_ps(depth, _mm_shuffle_ps(depth, depth, _MM_SHUFFLE(2, 3, 0, 1)));
+		depth = _mm_min_ps(depth, _mm_shuffle_ps(depth, depth, _MM_SHUFFLE(1, 0, 3, 2)));
+		pFarthest[x / 2] = _mm_cvtss_f32(depth);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Forward reprojects the pixels of the rows to the pixel nearest to where they
+// land this frame. A pixel lands up to half a pixel from the one it is written
+// to, so it is reprojected with the farthest depth of the quads around its own
+// and dropped when one of their pixels is empty. Where several land on the same
+// pixel the farthest depth is kept, and the pixels none lands on are holes that
+// stay empty. Pixels that land behind the camera, outside the frustum or off
+// screen are dropped. When shared is set the other tasks write to the reprojected
+// buffer at the same time
+//-----------------------------------------------------------------------------
+template<class Layout>
+void DepthBufferRasterizerSSE::ReprojectRows(int startY, int endY, bool shared)
+{
+	const float *pDepthBuffer = (const float*)mpRenderTargetPixels;
+	const float *pMatrix = (const float*)&mReprojectMatrix;
+	int numQuads = mDesc.mWidth / 2;
+
+	__m128 colOffset = _mm_set_ps(0.0f, 1.0f, 0.0f, 1.0f);
+	__m128 rowOffset = _mm_set_ps(0.0f, 0.0f, 1.0f, 1.0f);
+	__m128 zero = _mm_setzero_ps();
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 half = _mm_set1_ps(0.5f);
+	__m128 width = _mm_set1_ps((float)mDesc.mWidth);
+	__m128 height = _mm_set1_ps((float)mDesc.mHeight);
+
+	// Column c of the matrix, each element broadcast
+	__m128 column[4][4];
+	for(int c = 0; c < 4; c++)
+	{
+		for(int r = 0; r < 4; r++)
+		{
+			column[c][r] = _mm_set1_ps(pMatrix[r * 4 + c]);
+		}
+	}
+
+	// Farthest quad depths of the row pairs above, at and below the one reprojected,
+	// with an empty quad at both ends
+	float *pFarthestQuads = (float*)_alloca(sizeof(float) * 3 * (numQuads + 2));
+	float *pAbove = pFarthestQuads, *pRow = pAbove + numQuads + 2, *pBelow = pRow + numQuads + 2;
+	for(int i = 0; i < 3; i++)
+	{
+		pFarthestQuads[i * (numQuads + 2)] = pFarthestQuads[i * (numQuads + 2) + numQuads + 1] = 0.0f;
+	}
+	GetFarthestQuadDepths<Layout>(pDepthBuffer, mDesc.mWidth, mDesc.mHeight, startY - 2, &pAbove[1]);
+	GetFarthestQuadDepths<Layout>(pDepthBuffer, mDesc.mWidth, mDesc.mHeight, startY, &pRow[1]);
+
+	for(int y = startY; y < endY; y += 2)
+	{
+		GetFarthestQuadDepths<Layout>(pDepthBuffer, mDesc.mWidth, mDesc.mHeight, y + 2, &pBelow[1]);
+
+		// Part of the transform that is the same along the row pair
+		__m128 rowY = _mm_add_ps(_mm_set1_ps((float)y), rowOffset);
+		__m128 rowPos[4];
+		for(int c = 0; c < 4; c++)
+		{
+			rowPos[c] = _mm_add_ps(_mm_mul_ps(rowY, column[c][1]), column[c][3]);
+		}
+
+		for(int q = 0; q < numQuads; q++)
+		{
+			float farthest = min(min(min(pAbove[q], pAbove[q + 1]), min(pAbove[q + 2], pRow[q])),
+								 min(min(pRow[q + 1], pRow[q + 2]), min(min(pBelow[q], pBelow[q + 1]), pBelow[q + 2])));
+			if(farthest <= 0.0f)
+			{
+				continue;
+			}
+
+			__m128 depth = _mm_set1_ps(farthest);
+			__m128 quadX = _mm_add_ps(_mm_set1_ps((float)(2 * q)), colOffset);
+			__m128 pos[4];
+			for(int c = 0; c < 4; c++)
+			{
+				pos[c] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(quadX, column[c][0]), _mm_mul_ps(depth, column[c][2])), rowPos[c]);
+			}
+
+			__m128 valid = _mm_cmpgt_ps(pos[3], zero);
+			__m128 invW = _mm_div_ps(one, pos[3]);
+			__m128 screenX = _mm_add_ps(_mm_mul_ps(pos[0], invW), half);
+			__m128 screenY = _mm_add_ps(_mm_mul_ps(pos[1], invW), half);
+			__m128 screenZ = _mm_mul_ps(pos[2], invW);
+			valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpgt_ps(screenZ, zero), _mm_cmple_ps(screenZ, one)));
+			valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(screenX, zero), _mm_cmplt_ps(screenX, width)));
+			valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(screenY, zero), _mm_cmplt_ps(screenY, height)));
+
+			int mask = _mm_movemask_ps(valid);
+			if(mask == 0)
+			{
+				continue;
+			}
+
+			__m128i pixelX = _mm_cvttps_epi32(screenX);
+			__m128i pixelY = _mm_cvttps_epi32(screenY);
+			for(int i = 0; i < 4; i++)
+			{
+				if(mask & (1 << i))
+				{
+					float *pPixel = &mpReprojectedPixels[Layout::PixelOffset(pixelX.m128i_i32[i], pixelY.m128i_i32[i], mDesc.mWidth)];
+					if(shared)
+					{
+						InterlockedMinDepth(pPixel, screenZ.m128_f32[i]);
+					}
+					else
+					{
+						*pPixel = min(*pPixel, screenZ.m128_f32[i]);
+					}
+				}
+			}
+		}
+
+		float *pFree = pAbove;
+		pAbove = pRow;
+		pRow = pBelow;
+		pBelow = pFree;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Creates one raster task set per row of tiles that starts once the triangles are
+// binned and last frame's depth is reprojected, and one Hi-Z task set per strip
+// that only waits for the rows of tiles the strip overlaps. The tasks of a row set
+// rasterize the tiles of that row. A task set can only have MAX_SUCCESSORS
+// successors, so the rows and the strips wait through fan outs
+//-----------------------------------------------------------------------------
+void DepthBufferRasterizerSSE::CreateRasterizeTasks(TASKSETFUNC rasterizeTileRow)
+{
+	ASSERT(GetNumPassTaskSets() <= MAX_PASS_TASKSETS, _L("The occluder pass needs more task sets than the task manager has for it"));
+
+	mBinFanOut.Create(mBinMesh, mDesc.mHeightInTiles);
+	if(mReproject != TASKSETHANDLE_INVALID)
+	{
+		mReprojectFanOut.Create(mReproject, mDesc.mHeightInTiles);
+	}
+
+	TASKSETHANDLE dependencies[SCREENH_IN_TILES];
+	UINT numDependencies = mReproject != TASKSETHANDLE_INVALID ? 2 : 1;
+	for(int row = 0; row < mDesc.mHeightInTiles; row++)
+	{
+		dependencies[0] = mBinFanOut.Get(row);
+		dependencies[1] = mReprojectFanOut.Get(row);
+		gTaskMgr.CreateTaskSet(rasterizeTileRow, &mpTileRowTaskData[row], mDesc.mWidthInTiles, dependencies, numDependencies, "Raster Tris to DB", &mpRasterizeRow[row]);
+
+		int firstStrip = (row * mDesc.mTileHeight) / HIZ_STRIP_HEIGHT;
+		int lastStrip  = (min((row + 1) * mDesc.mTileHeight, mDesc.mHeight) - 1) / HIZ_STRIP_HEIGHT;
+		mRasterizeRowFanOut[row].Create(mpRasterizeRow[row], lastStrip - firstStrip + 1);
+	}
+
+	mNumHiZStrips = mDesc.GetNumHiZStrips();
+	for(UINT strip = 0; strip < mNumHiZStrips; strip++)
+	{
+		int firstRow = (strip * HIZ_STRIP_HEIGHT) / mDesc.mTileHeight;
+		int lastRow  = (min((int)(strip + 1) * HIZ_STRIP_HEIGHT, mDesc.mHeight) - 1) / mDesc.mTileHeight;
+		for(int row = firstRow; row <= lastRow; row++)
+		{
+			// The strip is one of the strips the row overlaps, counted from its first one
+			int rowFirstStrip = (row * mDesc.mTileHeight) / HIZ_STRIP_HEIGHT;
+			dependencies[row - firstRow] = mRasterizeRowFanOut[row].Get(strip - rowFirstStrip);
+		}
+		gTaskMgr.CreateTaskSet(&DepthBufferRasterizerSSE::BuildHiZBuffer, &mpHiZStripTaskData[strip], 1, dependencies, lastRow - firstRow + 1, "Build HiZ", &mpBuildHiZStrip[strip]);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Counts the task sets CreateRasterizeTasks and the task sets before it create,
+// with the occluder size, compact and reprojection task sets that are optional
+//-----------------------------------------------------------------------------
+UINT DepthBufferRasterizerSSE::GetNumPassTaskSets() const
+{
+	UINT numTaskSets = 5;
+	numTaskSets += 2 * TaskSetFanOut::GetNumRelays(mDesc.mHeightInTiles);
+	for(int row = 0; row < mDesc.mHeightInTiles; row++)
+	{
+		int firstStrip = (row * mDesc.mTileHeight) / HIZ_STRIP_HEIGHT;
+		int lastStrip  = (min((row + 1) * mDesc.mTileHeight, mDesc.mHeight) - 1) / HIZ_STRIP_HEIGHT;
+		numTaskSets += 1 + TaskSetFanOut::GetNumRelays(lastStrip - firstStrip + 1);
+	}
+	return numTaskSets + mDesc.GetNumHiZStrips();
+}
+
+//-----------------------------------------------------------------------------
+// Waits for the occluder pass started by StartTransformModelsAndRasterizeToDepthBuffer
+// and releases its task sets. The rasterize time runs until here, so it includes
+// the work done while the occludees were depth tested
+//-----------------------------------------------------------------------------
+void DepthBufferRasterizerSSE::WaitForDepthBuffer()
+{
+	if(mNumHiZStrips == 0)
+	{
+		return;
+	}
+
+	for(UINT strip = 0; strip < mNumHiZStrips; strip++)
+	{
+		gTaskMgr.WaitForSet(mpBuildHiZStrip[strip]);
+	}
+
+	// Release the task sets
+	mBinFanOut.Release();
+	mReprojectFanOut.Release();
+	for(int row = 0; row < SCREENH_IN_TILES; row++)
+	{
+		mRasterizeRowFanOut[row].Release();
+	}
+	gTaskMgr.ReleaseHandle(mXformMesh);
+	gTaskMgr.ReleaseHandle(mBinMesh);
+	mXformMesh = mBinMesh = TASKSETHANDLE_INVALID;
+	if(mCompact != TASKSETHANDLE_INVALID)
+	{
+		gTaskMgr.ReleaseHandle(mOccluderSize);
+		gTaskMgr.ReleaseHandle(mCompact);
+		mOccluderSize = mCompact = TASKSETHANDLE_INVALID;
+	}
+	if(mReproject != TASKSETHANDLE_INVALID)
+	{
+		gTaskMgr.ReleaseHandle(mReproject);
+		mReproject = TASKSETHANDLE_INVALID;
+	}
+	for(int row = 0; row < mDesc.mHeightInTiles; row++)
+	{
+		gTaskMgr.ReleaseHandle(mpRasterizeRow[row]);
+		mpRasterizeRow[row] = TASKSETHANDLE_INVALID;
+	}
+	for(UINT strip = 0; strip < mNumHiZStrips; strip++)
+	{
+		gTaskMgr.ReleaseHandle(mpBuildHiZStrip[strip]);
+		mpBuildHiZStrip[strip] = TASKSETHANDLE_INVALID;
+	}
+	mNumHiZStrips = 0;
+
+	EndBinTime();
+	mRasterizeTime[mTimeCounter++] = mRasterizeTimer.StopTimer();
+	mTimeCounter = mTimeCounter >= AVG_COUNTER ? 0 : mTimeCounter;
+}
+
+//-----------------------------------------------------------------------------
+// The bin tasks time themselves, so that the bin stage is timed without the
+// main thread waiting between the transform and the bin task sets
+//-----------------------------------------------------------------------------
+void DepthBufferRasterizerSSE::EndBinTime()
+{
+	double binTime = 0.0;
+	for(UINT i = 0; i < NUM_XFORMVERTS_TASKS; i++)
+	{
+		binTime = max(binTime, mBinTaskTime[i]);
+	}
+	mBinTime[mTimeCounter] = binTime;
+}
+
+void DepthBufferRasterizerSSE::BuildHiZBuffer(VOID* taskData, INT context, UINT taskId, UINT taskCount)
+{
+	BandTaskData *pStrip = (BandTaskData*)taskData;
+	pStrip->mpRasterizer->BuildHiZBuffer(pStrip->mBand);
+}
+
+//-----------------------------------------------------------------------------
+// Builds one strip of the Hi-Z pyramid from the rasterized depth buffer. The
+// strip only reads its own depth buffer rows
+//-----------------------------------------------------------------------------
+void DepthBufferRasterizerSSE::BuildHiZBuffer(UINT taskId)
+{
+	mpHiZBuffer->Build((float*)mpRenderTargetPixels, taskId);
 }
\ No newline at end of file
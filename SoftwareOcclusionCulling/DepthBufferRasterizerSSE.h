@@ -19,6 +19,7 @@
 #include "DepthBufferRasterizer.h"
 #include "TransformedModelSSE.h"
 #include "HelperSSE.h"
+#include "TaskSetFanOut.h"
 
 class DepthBufferRasterizerSSE : public DepthBufferRasterizer, public HelperSSE
 {
@@ -27,6 +28,10 @@ class DepthBufferRasterizerSSE : public DepthBufferRasterizer, public HelperSSE
 		virtual ~DepthBufferRasterizerSSE();
 		
 		void CreateTransformedModels(CPUTAssetSet **pAssetSet, UINT numAssetSets);
+		// Creates the models of another view of the same asset sets, they share the
+		// meshes and occluder proxies of the models of pSharedRasterizer, which has
+		// to outlive them. Only the transformed vertices are per view
+		void CreateTransformedModels(CPUTAssetSet **pAssetSet, UINT numAssetSets, DepthBufferRasterizerSSE *pSharedRasterizer);
 		
 		// Reset all models to be visible when frustum culling is disabled 
 		inline void ResetInsideFrustum()
@@ -37,10 +42,23 @@ class DepthBufferRasterizerSSE : public DepthBufferRasterizer, public HelperSSE
 			}
 		}
 
+		// Frustum tests the occluders start to end - 1 against the camera's frustum
+		inline void CalcInsideFrustum(CPUTCamera *pCamera, UINT start, UINT end)
+		{
+			for(UINT i = start; i < end; i++)
+			{
+				mpTransformedModels1[i].IsVisible(pCamera);
+			}
+		}
+
 		// Set the view and projection matrices
-		inline void SetViewProj(float4x4 *viewMatrix, float4x4 *projMatrix);
+		void SetViewProj(float4x4 *viewMatrix, float4x4 *projMatrix);
 		
-		inline void SetCPURenderTargetPixels(UINT *pRenderTargetPixels){mpRenderTargetPixels = pRenderTargetPixels;}
+		// The depth buffer is owned by the rasterizer, one float per pixel of the desc aligned to a cache line
+		inline UINT* GetCPURenderTargetPixels(){return mpRenderTargetPixels;}
+
+		// Set the depth buffer size and tile grid, the depth buffer is allocated again when the size changes
+		void SetDepthBufferDesc(const DepthBufferDesc &desc);
 		
 		inline void SetCamera(CPUTCamera *pCamera) {mpCamera = pCamera;}
 
@@ -52,6 +70,16 @@ class DepthBufferRasterizerSSE : public DepthBufferRasterizer, public HelperSSE
 			}
 		}
 
+		inline void SetOccluderBudget(UINT maxTriangles, float maxTime)
+		{
+			mOccluderTriBudget = maxTriangles;
+			mOccluderTimeBudget = maxTime;
+		}
+
+		inline void SetOccluderProxies(bool useProxies) {mUseOccluderProxies = useProxies;}
+		inline void SetOccluderLods(bool useLods) {mUseOccluderLods = useLods;}
+		inline void SetDepthReprojection(bool useReprojection) {mUseReprojection = useReprojection;}
+
 		inline UINT GetNumOccluders() {return mNumModels1;}
 		inline UINT GetNumOccludersR2DB(){return mNumRasterized;}
 		inline double GetRasterizeTime()
@@ -63,18 +91,111 @@ class DepthBufferRasterizerSSE : public DepthBufferRasterizer, public HelperSSE
 			}
 			return averageTime / AVG_COUNTER;
 		}
+		// Time spent in the bin stage alone, part of the rasterize time
+		inline double GetBinTime()
+		{
+			double averageTime = 0.0;
+			for(UINT i = 0; i < AVG_COUNTER; i++)
+			{
+				averageTime += mBinTime[i];
+			}
+			return averageTime / AVG_COUNTER;
+		}
 		inline UINT GetNumTriangles(){return mNumTriangles1;}
+		inline const DepthBufferDesc& GetDepthBufferDesc() {return mDesc;}
+		inline const HiZBuffer* GetHiZBuffer() {return mpHiZBuffer;}
+		inline const UINT* GetTileTriangleCounts() {return mReprojecting ? NULL : mpNumRasterizedTris;}
+		inline const TASKSETHANDLE* GetDepthStripsDone() {return mNumHiZStrips > 0 ? mpBuildHiZStrip : NULL;}
 		inline UINT GetNumRasterizedTriangles() 
 		{
 			UINT numRasterizedTris = 0;
-			for(UINT i = 0; i < NUM_TILES; i++)
+			for(UINT i = 0; i < (UINT)mDesc.GetNumTiles(); i++)
 			{
-				numRasterizedTris += mNumRasterizedTris[i];
+				numRasterizedTris += mpNumRasterizedTris[i];
 			}
 			return numRasterizedTris;
 		}
+		// Parts of clipped triangles the last frame dropped, they did not fit in the
+		// clip setups of their bin chunk
+		inline UINT GetNumDroppedTriangles()
+		{
+			UINT numDroppedTris = 0;
+			for(UINT i = 0; i < NUM_XFORMVERTS_TASKS; i++)
+			{
+				numDroppedTris += mNumDroppedTris[i];
+			}
+			return numDroppedTris;
+		}
+
+		void WaitForDepthBuffer();
+		// Task sets the occluder pass holds at once for the depth buffer size
+		UINT GetNumPassTaskSets() const;
 		
 	protected:
+		// Task data of the task sets that work on one row of tiles or one Hi-Z strip
+		struct BandTaskData
+		{
+			DepthBufferRasterizerSSE *mpRasterizer;
+			UINT mBand;
+		};
+
+		void CreateRasterizeTasks(TASKSETFUNC rasterizeTileRow);
+		void ReleaseTransformedModels();
+		void AllocDepthBuffer();
+		void ReleaseDepthBuffer();
+
+		void StartReprojection();
+		static void Reproject(VOID* taskData, INT context, UINT taskId, UINT taskCount);
+		void Reproject(UINT taskId, UINT taskCount);
+		template<class Layout> void ReprojectRows(int startY, int endY, bool shared);
+
+		// Clears the pixels of a tile before its triangles are rasterized, or seeds them
+		// with the reprojected depth of last frame
+		template<class Layout>
+		inline void StartTile(float *pDepthBuffer, int startX, int startY, int endX, int endY)
+		{
+			if(mReprojecting)
+			{
+				SeedDepthBufferTile<Layout>(pDepthBuffer, mpReprojectedPixels, mDesc.mWidth, startX, startY, endX, endY);
+			}
+			else
+			{
+				ClearDepthBufferTile<Layout>(pDepthBuffer, mDesc.mWidth, startX, startY, endX, endY);
+			}
+		}
+
+		static void BuildHiZBuffer(VOID* taskData, INT context, UINT taskId, UINT taskCount);
+		void BuildHiZBuffer(UINT taskId);
+
+		static void CalcOccluderSizes(VOID* taskData, INT context, UINT taskId, UINT taskCount);
+		void CalcOccluderSizes(UINT taskId, UINT taskCount);
+		void SelectOccluders();
+		static void CompactLiveOccluders(VOID* taskData, INT context, UINT taskId, UINT taskCount);
+		void CompactLiveOccluders();
+		UINT FindLiveOccluder(const UINT *pLiveStart, UINT index);
+
+		// Sort key of an occluder when the occluders are selected under a budget
+		struct OccluderScore
+		{
+			float mScore;
+			UINT  mModel;
+		};
+		static int CompareOccluderScores(const void *pScore0, const void *pScore1);
+
+		// Hands out the next chunk of [0, count) to the calling task. The tasks keep
+		// claiming chunks until none is left, so the ones that finish early take over
+		// the remaining work
+		inline bool ClaimChunk(volatile LONG &nextChunk, UINT chunkSize, UINT count, UINT &start, UINT &end)
+		{
+			start = (UINT)(InterlockedIncrement(&nextChunk) - 1) * chunkSize;
+			if(start >= count)
+			{
+				return false;
+			}
+			end = min(start + chunkSize, count) - 1;
+			return true;
+		}
+
 		TransformedModelSSE *mpTransformedModels1;
 		UINT mNumModels1;
 		UINT *mpXformedPosOffset1;
@@ -82,21 +203,54 @@ class DepthBufferRasterizerSSE : public DepthBufferRasterizer, public HelperSSE
 		UINT *mpStartT1;
 		UINT mNumVertices1;
 		UINT mNumTriangles1;
-		UINT mNumRasterizedTris[NUM_TILES];
+		UINT *mpNumRasterizedTris;	 // one per tile
 		__m128 *mpXformedPos1;
 		CPUTCamera *mpCamera;
 		__m128 *mViewMatrix;
 		__m128 *mProjMatrix;
 		UINT *mpRenderTargetPixels;
+		DepthBufferDesc mDesc;
 		UINT mNumRasterized;
-		UINT *mpBin;				 // triangle index
-		USHORT *mpBinModel;			 // model index
-		USHORT *mpBinMesh;			 // mesh index
-		USHORT *mpNumTrisInBin;      // number of triangles in the bin
+		UINT *mpLiveOccluders;		 // occluders rasterized this frame
+		UINT *mpLiveVertexStart;	 // prefix sums of their vertex and triangle counts,
+		UINT *mpLiveTriangleStart;	 // mNumRasterized + 1 entries
+		UINT mNumLiveVertices;
+		UINT mNumLiveTriangles;
+		UINT mOccluderTriBudget;	 // 0 when there is no triangle budget
+		float mOccluderTimeBudget;	 // seconds, 0 when there is no time budget
+		double mTimePerTriangle;	 // last measured rasterize time per live triangle
+		bool mUseOccluderProxies;
+		bool mUseOccluderLods;
+		bool mUseReprojection;
+		bool mReprojecting;			 // the depth buffer is seeded by reprojection this frame
+		bool mDepthBufferValid;		 // the depth buffer holds the depth of the last pass at the current size
+		float *mpReprojectedPixels;	 // last frame's depth reprojected to this frame, FLT_MAX where none landed
+		float4x4 mViewProj;
+		float4x4 mDepthBufferViewProj; // view, projection and viewport matrix the depth buffer was rasterized with
+		float4x4 mReprojectMatrix;	 // takes last frame's screen space to this frame's
+		OccluderScore *mpOccluderScores;
+		volatile LONG mNextXformChunk;
+		volatile LONG mNextBinChunk;
+		TriangleSetup *mpTriangleSetup; // setup of the binned triangles
+		TriangleBins *mpBins;		 // triangle setup indices binned per tile
+		HiZBuffer *mpHiZBuffer;
+		BandTaskData *mpTileRowTaskData; // one per row of tiles
+		BandTaskData *mpHiZStripTaskData; // one per Hi-Z strip
+		TaskSetFanOut mBinFanOut;	 // the raster row task sets wait for the bin and
+		TaskSetFanOut mReprojectFanOut; // reprojection task sets through these
+		TaskSetFanOut mRasterizeRowFanOut[SCREENH_IN_TILES]; // and the Hi-Z strips for the rows through these
+		UINT mNumHiZStrips;			 // Hi-Z strips of the pass in flight, 0 when there is none
 		UINT mTimeCounter;
 
 		double mRasterizeTime[AVG_COUNTER];
 		CPUTTimerWin mRasterizeTimer;
+		double mBinTime[AVG_COUNTER];
+		CPUTTimerWin mBinTimer;
+		double mBinTaskTime[NUM_XFORMVERTS_TASKS]; // time each bin task took this frame
+		UINT mNumDroppedTris[NUM_XFORMVERTS_TASKS]; // clipped triangles each bin task had no setup for
+
+		// The bin time of the frame is the time of the slowest bin task
+		void EndBinTime();
 };
 
 #endif  //DEPTHBUFFERRASTERIZERSSE_H
\ No newline at end of file
@@ -20,19 +20,12 @@
 DepthBufferRasterizerSSEMT::DepthBufferRasterizerSSEMT()
 	: DepthBufferRasterizerSSE()
 {
-	int size = SCREENH_IN_TILES * SCREENW_IN_TILES *  NUM_XFORMVERTS_TASKS;
-	mpBin = new UINT[size * MAX_TRIS_IN_BIN_MT];
-	mpBinModel = new USHORT[size * MAX_TRIS_IN_BIN_MT];
-	mpBinMesh = new USHORT[size * MAX_TRIS_IN_BIN_MT];
-	mpNumTrisInBin = new USHORT[size];
+	mpBins = new TriangleBins(NUM_XFORMVERTS_TASKS, mDesc.GetNumTiles());
 }
 
 DepthBufferRasterizerSSEMT::~DepthBufferRasterizerSSEMT()
 {
-	SAFE_DELETE_ARRAY(mpBin);
-	SAFE_DELETE_ARRAY(mpBinModel);
-	SAFE_DELETE_ARRAY(mpBinMesh);
-	SAFE_DELETE_ARRAY(mpNumTrisInBin);
+	SAFE_DELETE(mpBins);
 }
 
 //-------------------------------------------------------------------------------
@@ -65,38 +58,69 @@ void DepthBufferRasterizerSSEMT::IsVisible(UINT taskId, UINT taskCount)
 	mpTransformedModels1[taskId].IsVisible(mpCamera);
 }
 
+//------------------------------------------------------------------------------
+// Transforms and rasterizes the occluders and waits for the depth buffer
+//------------------------------------------------------------------------------
+void DepthBufferRasterizerSSEMT::TransformModelsAndRasterizeToDepthBuffer()
+{
+	StartTransformModelsAndRasterizeToDepthBuffer();
+	WaitForDepthBuffer();
+}
+
 //------------------------------------------------------------------------------
 // Create NUM_XFORMVERTS_TASKS to:
 // * Transform the occluder models on the CPU
 // * Bin the occluder triangles into tiles that the frame buffer is divided into
-// * Rasterize the occluder triangles to the CPU depth buffer
+// and then the task sets that rasterize the occluder triangles to the CPU depth 
+// buffer one row of tiles at a time and build the Hi-Z strips. Returns without
+// waiting for the raster and Hi-Z task sets
 //-------------------------------------------------------------------------------
-void DepthBufferRasterizerSSEMT::TransformModelsAndRasterizeToDepthBuffer()
+void DepthBufferRasterizerSSEMT::StartTransformModelsAndRasterizeToDepthBuffer()
 {
 	mRasterizeTimer.StartTimer();
+
+	// Reproject last frame's depth while the occluders are transformed and binned, the raster tasks wait for it
+	StartReprojection();
+	if(mReprojecting)
+	{
+		gTaskMgr.CreateTaskSet(&DepthBufferRasterizerSSE::Reproject, this, NUM_XFORMVERTS_TASKS, NULL, 0, "Reproject Depth", &mReproject);
+	}
+
+	// Size test the occluders and gather the ones left so that the transform and bin work is split evenly
+	gTaskMgr.CreateTaskSet(&DepthBufferRasterizerSSE::CalcOccluderSizes, this, NUM_XFORMVERTS_TASKS, NULL, 0, "Occluder Size", &mOccluderSize);
+	gTaskMgr.WaitForSet(mOccluderSize);
+	gTaskMgr.ReleaseHandle(mOccluderSize);
+	mOccluderSize = TASKSETHANDLE_INVALID;
+	CompactLiveOccluders();
 	
 	gTaskMgr.CreateTaskSet(&DepthBufferRasterizerSSEMT::TransformMeshes, this, NUM_XFORMVERTS_TASKS, NULL, 0, "Xform Vertices", &mXformMesh);
-
 	gTaskMgr.CreateTaskSet(&DepthBufferRasterizerSSEMT::BinTransformedMeshes, this, NUM_XFORMVERTS_TASKS, &mXformMesh, 1, "Bin Meshes", &mBinMesh);
 	
-	gTaskMgr.CreateTaskSet(&DepthBufferRasterizerSSEMT::RasterizeBinnedTrianglesToDepthBuffer, this, NUM_TILES, &mBinMesh, 1, "Raster Tris to DB", &mRasterize);	
-
-	// Wait for the task set
-	gTaskMgr.WaitForSet(mRasterize);
-	// Release the task set
-	gTaskMgr.ReleaseHandle(mXformMesh);
-	gTaskMgr.ReleaseHandle(mBinMesh);
-	gTaskMgr.ReleaseHandle(mRasterize);
-	mXformMesh = mBinMesh = mRasterize = TASKSETHANDLE_INVALID;
+	CreateRasterizeTasks(&DepthBufferRasterizerSSEMT::RasterizeBinnedTrianglesToDepthBuffer);
+}
 
-	mRasterizeTime[mTimeCounter++] = mRasterizeTimer.StopTimer();
-	mTimeCounter = mTimeCounter >= AVG_COUNTER ? 0 : mTimeCounter;
+//------------------------------------------------------------------------------
+// Create the task sets of the occluder pass, each stage depending on the one
+// before it: the size test, the compaction of the live occluders, the transform,
+// the bin and then the raster and Hi-Z task sets. Returns without waiting for
+// any of them
+//-------------------------------------------------------------------------------
+void DepthBufferRasterizerSSEMT::CreateTransformModelsAndRasterizeTasks()
+{
+	mRasterizeTimer.StartTimer();
 
-	mNumRasterized = 0;
-	for(UINT i = 0; i < mNumModels1; i++)
+	StartReprojection();
+	if(mReprojecting)
 	{
-		mNumRasterized += mpTransformedModels1[i].IsRasterized2DB() ? 1 : 0;
+		gTaskMgr.CreateTaskSet(&DepthBufferRasterizerSSE::Reproject, this, NUM_XFORMVERTS_TASKS, NULL, 0, "Reproject Depth", &mReproject);
 	}
+
+	gTaskMgr.CreateTaskSet(&DepthBufferRasterizerSSE::CalcOccluderSizes, this, NUM_XFORMVERTS_TASKS, NULL, 0, "Occluder Size", &mOccluderSize);
+	gTaskMgr.CreateTaskSet(&DepthBufferRasterizerSSE::CompactLiveOccluders, this, 1, &mOccluderSize, 1, "Compact Occluders", &mCompact);
+	gTaskMgr.CreateTaskSet(&DepthBufferRasterizerSSEMT::TransformMeshes, this, NUM_XFORMVERTS_TASKS, &mCompact, 1, "Xform Vertices", &mXformMesh);
+	gTaskMgr.CreateTaskSet(&DepthBufferRasterizerSSEMT::BinTransformedMeshes, this, NUM_XFORMVERTS_TASKS, &mXformMesh, 1, "Bin Meshes", &mBinMesh);
+
+	CreateRasterizeTasks(&DepthBufferRasterizerSSEMT::RasterizeBinnedTrianglesToDepthBuffer);
 }
 
 void DepthBufferRasterizerSSEMT::TransformMeshes(VOID* taskData, INT context, UINT taskId, UINT taskCount)
@@ -106,43 +130,24 @@ void DepthBufferRasterizerSSEMT::TransformMeshes(VOID* taskData, INT context, UI
 }
 
 //------------------------------------------------------------------------------------------------------------
-// This function combines the vertices of all the occluder models in the scene and processes the models/meshes 
-// that contain the task's triangle range. It trsanform the occluder vertices once every frame
+// Transforms the vertices of the occluders rasterized this frame. The tasks claim chunks of the live 
+// vertices until all of them are transformed, a chunk can span several occluders
 //------------------------------------------------------------------------------------------------------------
 void DepthBufferRasterizerSSEMT::TransformMeshes(UINT taskId, UINT taskCount)
 {
-	UINT verticesPerTask  = mNumVertices1/taskCount;
-	verticesPerTask		  = (mNumVertices1 % taskCount) > 0 ? verticesPerTask + 1 : verticesPerTask;
-	UINT startIndex		  = taskId * verticesPerTask;
-	//UINT endIndex		  = taskId == NUM_XFORMVERTS_TASKS - 1 ? mNumVertices1 : startIndex + verticesPerTask;
-
-	UINT remainingVerticesPerTask = verticesPerTask;
-
-	// Now, process all of the surfaces that contain this task's triangle range.
-	UINT runningVertexCount = 0;
-	for(UINT ss = 0; ss < mNumModels1; ss++)
-    {
-		UINT thisSurfaceVertexCount = mpTransformedModels1[ss].GetNumVertices();
-        
-        UINT newRunningVertexCount = runningVertexCount + thisSurfaceVertexCount;
-        if( newRunningVertexCount < startIndex )
-        {
-            // We haven't reached the first surface in our range yet.  Skip to the next surface.
-            runningVertexCount = newRunningVertexCount;
-            continue;
-        }
-
-        // If we got this far, then we need to process this surface.
-        UINT thisSurfaceStartIndex = max( 0, (int)startIndex - (int)runningVertexCount );
-        UINT thisSurfaceEndIndex   = min( thisSurfaceStartIndex + remainingVerticesPerTask, thisSurfaceVertexCount) - 1;
-
-		mpTransformedModels1[ss].TransformMeshes(mViewMatrix, mProjMatrix, thisSurfaceStartIndex, thisSurfaceEndIndex, mpCamera);
-
-		remainingVerticesPerTask -= (thisSurfaceEndIndex + 1 - thisSurfaceStartIndex);
-        if( remainingVerticesPerTask <= 0 ) break;
-
-		runningVertexCount = newRunningVertexCount;
-    }
+	UINT start, end;
+	while(ClaimChunk(mNextXformChunk, XFORM_VERTS_PER_CHUNK, mNumLiveVertices, start, end))
+	{
+		for(UINT i = FindLiveOccluder(mpLiveVertexStart, start); start <= end; i++)
+		{
+			UINT occluderEnd = min(end + 1, mpLiveVertexStart[i + 1]);
+			if(start < occluderEnd)
+			{
+				mpTransformedModels1[mpLiveOccluders[i]].TransformMeshes(start - mpLiveVertexStart[i], occluderEnd - 1 - mpLiveVertexStart[i]);
+			}
+			start = occluderEnd;
+		}
+	}
 }
 
 void DepthBufferRasterizerSSEMT::BinTransformedMeshes(VOID* taskData, INT context, UINT taskId, UINT taskCount)
@@ -152,71 +157,55 @@ void DepthBufferRasterizerSSEMT::BinTransformedMeshes(VOID* taskData, INT contex
 }
 
 //--------------------------------------------------------------------------------------
-// This function combines the triangles of all the occluder models in the scene and processes 
-// the models/meshes that contain the task's triangle range. It bins the occluder triangles 
-// into tiles once every frame
+// Bins the triangles of the occluders rasterized this frame into tiles. The tasks claim
+// chunks of the live triangles until all of them are binned, the triangles a task sets
+// up go to its own bins whichever chunks it processed
 //--------------------------------------------------------------------------------------
 void DepthBufferRasterizerSSEMT::BinTransformedMeshes(UINT taskId, UINT taskCount)
 {
-	// Reset the bin count.  Note the data layout makes this traversal a bit awkward.
-    // We can't just use memset() because the last array index isn't what's varying.
-    // However, this should make the real use of this structure go faster.
-	for(UINT yy = 0; yy < SCREENH_IN_TILES; yy++)
-    {
-		UINT offset = YOFFSET1_MT * yy;
-        for(UINT xx = 0; xx < SCREENW_IN_TILES; xx++)
-        {
-			UINT index = offset + (XOFFSET1_MT * xx) + taskId;
-            mpNumTrisInBin[index] = 0;
-	    }
-    }
-
-	// Making sure that the #of Tris in each task (except the last one) is a multiple of 4 
-	UINT trianglesPerTask  = (mNumTriangles1 + taskCount - 1)/taskCount;
-	trianglesPerTask      += (trianglesPerTask % SSE) != 0 ? SSE - (trianglesPerTask % SSE) : 0;
-	
-	UINT startIndex		   = taskId * trianglesPerTask;
-	
-	UINT remainingTrianglesPerTask = trianglesPerTask;
-
-	// Now, process all of the surfaces that contain this task's triangle range.
-	UINT runningTriangleCount = 0;
-	for(UINT ss = 0; ss < mNumModels1; ss++)
-    {
-		UINT thisSurfaceTriangleCount = mpTransformedModels1[ss].GetNumTriangles();
-        
-        UINT newRunningTriangleCount = runningTriangleCount + thisSurfaceTriangleCount;
-        if( newRunningTriangleCount < startIndex )
-        {
-            // We haven't reached the first surface in our range yet.  Skip to the next surface.
-            runningTriangleCount = newRunningTriangleCount;
-            continue;
-        }
-
-        // If we got this far, then we need to process this surface.
-        UINT thisSurfaceStartIndex = max( 0, (int)startIndex - (int)runningTriangleCount );
-        UINT thisSurfaceEndIndex   = min( thisSurfaceStartIndex + remainingTrianglesPerTask, thisSurfaceTriangleCount) - 1;
-
-       	mpTransformedModels1[ss].BinTransformedTrianglesMT(taskId, ss, thisSurfaceStartIndex, thisSurfaceEndIndex, mpBin, mpBinModel, mpBinMesh, mpNumTrisInBin);
-
-		remainingTrianglesPerTask -= ( thisSurfaceEndIndex + 1 - thisSurfaceStartIndex);
-        if( remainingTrianglesPerTask <= 0 ) break;
-				
-		runningTriangleCount = newRunningTriangleCount;
-    }
+	CPUTTimerWin binTimer;
+	binTimer.StartTimer();
+
+	// Empty this task's bins and recycle their chunks
+	mpBins->Reset(taskId);
+	mNumDroppedTris[taskId] = 0;
+
+	UINT start, end;
+	while(ClaimChunk(mNextBinChunk, BIN_TRIS_PER_CHUNK, mNumLiveTriangles, start, end))
+	{
+		// The chunk's triangle setups are stored from its first triangle on, the parts of
+		// the clipped triangles have NUM_CLIP_PLANES setups per triangle after those of
+		// all the triangles
+		TriangleSetupSlots slots = {mpTriangleSetup, start, mNumTriangles1 + NUM_CLIP_PLANES * start, mNumTriangles1 + NUM_CLIP_PLANES * (end + 1), 0};
+		for(UINT i = FindLiveOccluder(mpLiveTriangleStart, start); start <= end; i++)
+		{
+			UINT occluderEnd = min(end + 1, mpLiveTriangleStart[i + 1]);
+			if(start < occluderEnd)
+			{
+				mpTransformedModels1[mpLiveOccluders[i]].BinTransformedTriangles(taskId, start - mpLiveTriangleStart[i], occluderEnd - 1 - mpLiveTriangleStart[i], slots, mpBins, mDesc);
+			}
+			start = occluderEnd;
+		}
+		mNumDroppedTris[taskId] += slots.mNumDropped;
+	}
+
+	mBinTaskTime[taskId] = binTimer.StopTimer();
 }
 
 void DepthBufferRasterizerSSEMT::RasterizeBinnedTrianglesToDepthBuffer(VOID* taskData, INT context, UINT taskId, UINT taskCount)
 {
-	DepthBufferRasterizerSSEMT* sample =  (DepthBufferRasterizerSSEMT*)taskData;
-	sample->RasterizeBinnedTrianglesToDepthBuffer(taskId, taskCount);
+	// The tasks of a row set each rasterize one tile of the row
+	BandTaskData *pRow = (BandTaskData*)taskData;
+	DepthBufferRasterizerSSEMT* sample =  (DepthBufferRasterizerSSEMT*)pRow->mpRasterizer;
+	sample->RasterizeBinnedTrianglesToDepthBuffer(pRow->mBand * taskCount + taskId, sample->mDesc.GetNumTiles());
 }
 
 //-------------------------------------------------------------------------------
 // For each tile go through all the bins and process all the triangles in it.
 // Rasterize each triangle to the CPU depth buffer. 
 //-------------------------------------------------------------------------------
-void DepthBufferRasterizerSSEMT::RasterizeBinnedTrianglesToDepthBuffer(UINT taskId, UINT taskCount)
+template<class Layout>
+void DepthBufferRasterizerSSEMT::RasterizeTile(UINT taskId)
 {
 	// Set DAZ and FZ MXCSR bits to flush denormals to zero (i.e., make it faster)
 	// Denormal are zero (DAZ) is bit 6 and Flush to zero (FZ) is bit 15. 
@@ -226,250 +215,176 @@ void DepthBufferRasterizerSSEMT::RasterizeBinnedTrianglesToDepthBuffer(UINT task
 	__m128i colOffset = _mm_set_epi32(0, 1, 0, 1);
 	__m128i rowOffset = _mm_set_epi32(0, 0, 1, 1);
 
-	__m128i fxptZero = _mm_setzero_si128();
+	__m128i fxptMinusOne = _mm_set1_epi32(-1);
 	float* pDepthBuffer = (float*)mpRenderTargetPixels; 
 
 	// Based on TaskId determine which tile to process
-	UINT screenWidthInTiles = SCREENW/TILE_WIDTH_IN_PIXELS;
+	UINT screenWidthInTiles = mDesc.mWidthInTiles;
     UINT tileX = taskId % screenWidthInTiles;
     UINT tileY = taskId / screenWidthInTiles;
 
-    int tileStartX = tileX * TILE_WIDTH_IN_PIXELS;
-	int tileEndX   = tileStartX + TILE_WIDTH_IN_PIXELS;
+    int tileStartX = tileX * mDesc.mTileWidth;
+	int tileEndX   = min(tileStartX + mDesc.mTileWidth, mDesc.mWidth);
 	
-	int tileStartY = tileY * TILE_HEIGHT_IN_PIXELS;
-	int tileEndY   = tileStartY + TILE_HEIGHT_IN_PIXELS;
-
-	UINT bin = 0;
-	UINT binIndex = 0;
-	UINT offset1 = YOFFSET1_MT * tileY + XOFFSET1_MT * tileX;
-	UINT offset2 = YOFFSET2_MT * tileY + XOFFSET2_MT * tileX;
-	UINT numTrisInBin = mpNumTrisInBin[offset1 + bin];
-
-	vFloat4 xformedPos[3];
-	bool done = false;
-	bool allBinsEmpty = true;
-	mNumRasterizedTris[taskId] = numTrisInBin;
-	while(!done)
+	int tileStartY = tileY * mDesc.mTileHeight;
+	int tileEndY   = min(tileStartY + mDesc.mTileHeight, mDesc.mHeight);
+
+	// Clear or seed the tile here instead of the whole depth buffer before the raster tasks start
+	StartTile<Layout>(pDepthBuffer, tileStartX, tileStartY, tileEndX, tileEndY);
+
+	UINT tileId = tileY * screenWidthInTiles + tileX;
+
+	mpNumRasterizedTris[taskId] = 0;
+	for(UINT bin = 0; bin < mpBins->GetNumTasks(); bin++)
 	{
-		// Loop through all the bins and process the 4 binned traingles at a time
-		UINT ii;
-		int numSimdTris = 0;
-		for(ii = 0; ii < SSE; ii++)
+		mpNumRasterizedTris[taskId] += mpBins->GetNumTris(tileId, bin);
+
+		// The triangles were set up in the bin stage, only clip their bounding box to the tile
+		for(const TriangleBins::Chunk *pChunk = mpBins->GetFirstChunk(tileId, bin); pChunk != NULL; pChunk = pChunk->mpNext)
 		{
-			while(numTrisInBin <= 0)
+			for(UINT binIndex = 0; binIndex < pChunk->mNumTris; binIndex++)
 			{
-				 // This bin is empty.  Move to next bin.
-				if(++bin >= NUM_XFORMVERTS_TASKS)
+				const TriangleSetup &setup = mpTriangleSetup[pChunk->mTris[binIndex]];
+
+				int startXx = max((int)setup.mStartX, tileStartX) & 0xFFFFFFFE;
+				int endXx	= min((int)setup.mEndX, tileEndX);
+				int startYy = max((int)setup.mStartY, tileStartY) & 0xFFFFFFFE;
+				int endYy	= min((int)setup.mEndY, tileEndY);
+
+				// Set up the edge functions relative to the first quad, over the quads that cover the bounding box in the tile
+				int endXq = (endXx + 1) & 0xFFFFFFFE;
+				int endYq = (endYy + 1) & 0xFFFFFFFE;
+				int edgeA[3], edgeB[3], edgeC[3];
+				if(!setup.GetEdges(startXx, startYy, endXq - 1, endYq - 1, edgeA, edgeB, edgeC))
 				{
-					break;
+					continue;
 				}
-				numTrisInBin = mpNumTrisInBin[offset1 + bin];
-				mNumRasterizedTris[taskId] += numTrisInBin;
-				binIndex = 0;
-			}
-			if(!numTrisInBin)
-			{
-				 break; // No more tris in the bins
-			}
-			USHORT modelId = mpBinModel[offset2 + bin * MAX_TRIS_IN_BIN_MT + binIndex];
-			USHORT meshId = mpBinMesh[offset2 + bin * MAX_TRIS_IN_BIN_MT + binIndex];
-			UINT triIdx = mpBin[offset2 + bin * MAX_TRIS_IN_BIN_MT + binIndex];
-			mpTransformedModels1[modelId].Gather((float*)&xformedPos, meshId, triIdx, ii);
-			allBinsEmpty = false;
-			numSimdTris++; 
-
-			++binIndex;
-			--numTrisInBin;
-		}
-		done = bin >= NUM_XFORMVERTS_TASKS;
-		
-		if(allBinsEmpty)
-		{
-			return;
-		}
 
-		vFloat4* xformedvPos = (vFloat4*)&xformedPos;
+				// Edge functions and depth of the pixels of a quad relative to its first pixel,
+				// and their steps to the next quad and row pair
+				__m128i quad0 = _mm_add_epi32(_mm_mullo_epi32(_mm_set1_epi32(edgeA[0]), colOffset), _mm_mullo_epi32(_mm_set1_epi32(edgeB[0]), rowOffset));
+				__m128i quad1 = _mm_add_epi32(_mm_mullo_epi32(_mm_set1_epi32(edgeA[1]), colOffset), _mm_mullo_epi32(_mm_set1_epi32(edgeB[1]), rowOffset));
+				__m128i quad2 = _mm_add_epi32(_mm_mullo_epi32(_mm_set1_epi32(edgeA[2]), colOffset), _mm_mullo_epi32(_mm_set1_epi32(edgeB[2]), rowOffset));
 
-		// use fixed-point only for X and Y.  Avoid work for Z and W.
-        vFxPt4 xFormedFxPtPos[3];
-		for(int i = 0; i < 3; i++)
-		{
-			xFormedFxPtPos[i].X = _mm_cvtps_epi32(xformedvPos[i].X);
-			xFormedFxPtPos[i].Y = _mm_cvtps_epi32(xformedvPos[i].Y);
-			xFormedFxPtPos[i].Z = _mm_cvtps_epi32(xformedvPos[i].Z);
-			xFormedFxPtPos[i].W = _mm_cvtps_epi32(xformedvPos[i].W);
-		}
+				__m128i aa0Inc = _mm_set1_epi32(edgeA[0] * 2);
+				__m128i aa1Inc = _mm_set1_epi32(edgeA[1] * 2);
+				__m128i aa2Inc = _mm_set1_epi32(edgeA[2] * 2);
 
-		// Fab(x, y) =     Ax       +       By     +      C              = 0
-		// Fab(x, y) = (ya - yb)x   +   (xb - xa)y + (xa * yb - xb * ya) = 0
-		// Compute A = (ya - yb) for the 3 line segments that make up each triangle
-		__m128i A0 = _mm_sub_epi32(xFormedFxPtPos[1].Y, xFormedFxPtPos[2].Y);
-		__m128i A1 = _mm_sub_epi32(xFormedFxPtPos[2].Y, xFormedFxPtPos[0].Y);
-		__m128i A2 = _mm_sub_epi32(xFormedFxPtPos[0].Y, xFormedFxPtPos[1].Y);
-
-		// Compute B = (xb - xa) for the 3 line segments that make up each triangle
-		__m128i B0 = _mm_sub_epi32(xFormedFxPtPos[2].X, xFormedFxPtPos[1].X);
-		__m128i B1 = _mm_sub_epi32(xFormedFxPtPos[0].X, xFormedFxPtPos[2].X);
-		__m128i B2 = _mm_sub_epi32(xFormedFxPtPos[1].X, xFormedFxPtPos[0].X);
-
-		// Compute C = (xa * yb - xb * ya) for the 3 line segments that make up each triangle
-		__m128i C0 = _mm_sub_epi32(_mm_mullo_epi32(xFormedFxPtPos[1].X, xFormedFxPtPos[2].Y), _mm_mullo_epi32(xFormedFxPtPos[2].X, xFormedFxPtPos[1].Y));
-		__m128i C1 = _mm_sub_epi32(_mm_mullo_epi32(xFormedFxPtPos[2].X, xFormedFxPtPos[0].Y), _mm_mullo_epi32(xFormedFxPtPos[0].X, xFormedFxPtPos[2].Y));
-		__m128i C2 = _mm_sub_epi32(_mm_mullo_epi32(xFormedFxPtPos[0].X, xFormedFxPtPos[1].Y), _mm_mullo_epi32(xFormedFxPtPos[1].X, xFormedFxPtPos[0].Y));
-
-		// Compute triangle area
-		__m128i triArea = _mm_mullo_epi32(A0, xFormedFxPtPos[0].X);
-		triArea = _mm_add_epi32(triArea, _mm_mullo_epi32(B0, xFormedFxPtPos[0].Y));
-		triArea = _mm_add_epi32(triArea, C0);
-
-		__m128 oneOverTriArea = _mm_div_ps(_mm_set1_ps(1.0f), _mm_cvtepi32_ps(triArea));
-
-		// Use bounding box traversal strategy to determine which pixels to rasterize 
-		__m128i startX = _mm_and_si128(Max(Min(Min(xFormedFxPtPos[0].X, xFormedFxPtPos[1].X), xFormedFxPtPos[2].X), _mm_set1_epi32(tileStartX)), _mm_set1_epi32(0xFFFFFFFE));
-		__m128i endX   = Min(_mm_add_epi32(Max(Max(xFormedFxPtPos[0].X, xFormedFxPtPos[1].X), xFormedFxPtPos[2].X), _mm_set1_epi32(1)), _mm_set1_epi32(tileEndX));
-
-		__m128i startY = _mm_and_si128(Max(Min(Min(xFormedFxPtPos[0].Y, xFormedFxPtPos[1].Y), xFormedFxPtPos[2].Y), _mm_set1_epi32(tileStartY)), _mm_set1_epi32(0xFFFFFFFE));
-		__m128i endY   = Min(_mm_add_epi32(Max(Max(xFormedFxPtPos[0].Y, xFormedFxPtPos[1].Y), xFormedFxPtPos[2].Y), _mm_set1_epi32(1)), _mm_set1_epi32(tileEndY));
-
-        // Now we have 4 triangles set up.  Rasterize them each individually.
-        for(int lane=0; lane < numSimdTris; lane++)
-        {
-			// Extract this triangle's properties from the SIMD versions
-            __m128 zz[3], oneOverW[3];
-			for(int vv = 0; vv < 3; vv++)
-			{
-				zz[vv] = _mm_set1_ps(xformedvPos[vv].Z.m128_f32[lane]);
-				oneOverW[vv] = _mm_set1_ps(xformedvPos[vv].W.m128_f32[lane]);
-			}
+				__m128i bb0Inc = _mm_set1_epi32(edgeB[0] * 2);
+				__m128i bb1Inc = _mm_set1_epi32(edgeB[1] * 2);
+				__m128i bb2Inc = _mm_set1_epi32(edgeB[2] * 2);
 
-			__m128 oneOverTotalArea = _mm_set1_ps(oneOverTriArea.m128_f32[lane]);
-			zz[0] *= oneOverTotalArea;
-			zz[1] *= oneOverTotalArea;
-			zz[2] *= oneOverTotalArea;
-			
-			int startXx = startX.m128i_i32[lane];
-			int endXx	= endX.m128i_i32[lane];
-			int startYy = startY.m128i_i32[lane];
-			int endYy	= endY.m128i_i32[lane];
-		
-			 // Incrementally compute Fab(x, y) for all the pixels inside the bounding box formed by (startX, endX) and (startY, endY) 
-			__m128i aa0 = _mm_set1_epi32(A0.m128i_i32[lane]);
-			__m128i aa1 = _mm_set1_epi32(A1.m128i_i32[lane]);
-			__m128i aa2 = _mm_set1_epi32(A2.m128i_i32[lane]);
-
-			__m128i bb0 = _mm_set1_epi32(B0.m128i_i32[lane]);
-			__m128i bb1 = _mm_set1_epi32(B1.m128i_i32[lane]);
-			__m128i bb2 = _mm_set1_epi32(B2.m128i_i32[lane]);
-
-			__m128i cc0 = _mm_set1_epi32(C0.m128i_i32[lane]);
-			__m128i cc1 = _mm_set1_epi32(C1.m128i_i32[lane]);
-			__m128i cc2 = _mm_set1_epi32(C2.m128i_i32[lane]);
-
-			__m128i aa0Inc = _mm_slli_epi32(aa0, 1);
-			__m128i aa1Inc = _mm_slli_epi32(aa1, 1);
-			__m128i aa2Inc = _mm_slli_epi32(aa2, 1);
-
-			__m128i row, col;
-
-			int rowIdx;
-			// To avoid this branching, choose one method to traverse and store the pixel depth
-			if(gVisualizeDepthBuffer)
-			{
-				// Sequentially traverse and store pixel depths contiguously
-				rowIdx = (startYy * SCREENW + startXx);
-			}
-			else
-			{
-				// Tranverse pixels in 2x2 blocks and store 2x2 pixel quad depthscontiguously in memory ==> 2*X
-				// This method provides better perfromance
-				rowIdx = (startYy * SCREENW + 2 * startXx);
-			}
+				__m128 zdx = _mm_set1_ps(setup.mZ[1]);
+				__m128 zdy = _mm_set1_ps(setup.mZ[2]);
+				__m128 quadZ = _mm_add_ps(_mm_mul_ps(zdx, _mm_cvtepi32_ps(colOffset)), _mm_mul_ps(zdy, _mm_cvtepi32_ps(rowOffset)));
+				__m128 zdxInc = _mm_add_ps(zdx, zdx);
+				__m128 zdyInc = _mm_add_ps(zdy, zdy);
 
-			col = _mm_add_epi32(colOffset, _mm_set1_epi32(startXx));
-			__m128i aa0Col = _mm_mullo_epi32(aa0, col);
-			__m128i aa1Col = _mm_mullo_epi32(aa1, col);
-			__m128i aa2Col = _mm_mullo_epi32(aa2, col);
-
-			row = _mm_add_epi32(rowOffset, _mm_set1_epi32(startYy));
-			__m128i bb0Row = _mm_add_epi32(_mm_mullo_epi32(bb0, row), cc0);
-			__m128i bb1Row = _mm_add_epi32(_mm_mullo_epi32(bb1, row), cc1);
-			__m128i bb2Row = _mm_add_epi32(_mm_mullo_epi32(bb2, row), cc2);
-
-			__m128i bb0Inc = _mm_slli_epi32(bb0, 1);
-			__m128i bb1Inc = _mm_slli_epi32(bb1, 1);
-			__m128i bb2Inc = _mm_slli_epi32(bb2, 1);
-
-			for(int r = startYy; r < endYy; r += 2,
-											row  = _mm_add_epi32(row, _mm_set1_epi32(2)),
-											rowIdx = rowIdx + 2 * SCREENW,
-											bb0Row = _mm_add_epi32(bb0Row, bb0Inc),
-											bb1Row = _mm_add_epi32(bb1Row, bb1Inc),
-											bb2Row = _mm_add_epi32(bb2Row, bb2Inc))
-			{
-				// Compute barycentric coordinates 
-				int idx = rowIdx;
-				__m128i alpha = _mm_add_epi32(aa0Col, bb0Row);
-				__m128i beta = _mm_add_epi32(aa1Col, bb1Row);
-				__m128i gama = _mm_add_epi32(aa2Col, bb2Row);
-
-				int idxIncr;
-				if(gVisualizeDepthBuffer)
-				{
-					idxIncr = 2;
-				}
-				else
-				{
-					idxIncr = 4;
-				}
-				for(int c = startXx; c < endXx; c += 2,
-												idx = idx + idxIncr,
-												alpha = _mm_add_epi32(alpha, aa0Inc),
-												beta  = _mm_add_epi32(beta, aa1Inc),
-												gama  = _mm_add_epi32(gama, aa2Inc))
+				// Walk the bounding box in blocks aligned to RASTER_BLOCK_SIZE
+				for(int blockY = startYy; blockY < endYq; blockY = (blockY + RASTER_BLOCK_SIZE) & ~(RASTER_BLOCK_SIZE - 1))
 				{
-					//Test Pixel inside triangle
-					__m128i mask = _mm_cmplt_epi32(fxptZero, _mm_or_si128(_mm_or_si128(alpha, beta), gama));
-					
-					// Early out if all of this quad's pixels are outside the triangle.
-					if(_mm_test_all_zeros(mask, mask))
+					int blockEndY = min((blockY + RASTER_BLOCK_SIZE) & ~(RASTER_BLOCK_SIZE - 1), endYq);
+					for(int blockX = startXx; blockX < endXq; blockX = (blockX + RASTER_BLOCK_SIZE) & ~(RASTER_BLOCK_SIZE - 1))
 					{
-						continue;
-					}
+						int blockEndX = min((blockX + RASTER_BLOCK_SIZE) & ~(RASTER_BLOCK_SIZE - 1), endXq);
+
+						// The edge functions are largest and smallest over the block at its corners
+						int blockC[3];
+						bool outside = false, inside = true;
+						for(int i = 0; i < 3; i++)
+						{
+							blockC[i] = edgeA[i] * (blockX - startXx) + edgeB[i] * (blockY - startYy) + edgeC[i];
+							int dx = edgeA[i] * (blockEndX - 1 - blockX);
+							int dy = edgeB[i] * (blockEndY - 1 - blockY);
+							outside |= blockC[i] + max(dx, 0) + max(dy, 0) < 0;
+							inside &= blockC[i] + min(dx, 0) + min(dy, 0) >= 0;
+						}
+
+						// Skip the block if all of its pixels are outside an edge
+						if(outside)
+						{
+							continue;
+						}
+
+						__m128 zRow = _mm_add_ps(_mm_set1_ps(setup.mZ[0] + setup.mZ[1] * blockX + setup.mZ[2] * blockY), quadZ);
+
+						// Fill the block without edge tests if all of its pixels are inside the triangle
+						if(inside)
+						{
+							for(int r = blockY; r < blockEndY; r += 2, zRow = _mm_add_ps(zRow, zdyInc))
+							{
+								float *pRow = &pDepthBuffer[Layout::RowPairOffset(r, mDesc.mWidth)];
+								__m128 depth = zRow;
+								for(int c = blockX; c < blockEndX; c += 2, depth = _mm_add_ps(depth, zdxInc))
+								{
+									float *pQuad = &pRow[Layout::QuadOffset(c)];
+									__m128 previousDepthValue = Layout::LoadQuad(pQuad, mDesc.mWidth);
+
+									__m128 depthMask = _mm_cmpge_ps(depth, previousDepthValue);
+
+									Layout::StoreQuad(pQuad, mDesc.mWidth, previousDepthValue, depth, _mm_castps_si128(depthMask));
+								}//for each column
+							}// for each row
+							continue;
+						}
+
+						__m128i alphaRow = _mm_add_epi32(_mm_set1_epi32(blockC[0]), quad0);
+						__m128i betaRow  = _mm_add_epi32(_mm_set1_epi32(blockC[1]), quad1);
+						__m128i gamaRow  = _mm_add_epi32(_mm_set1_epi32(blockC[2]), quad2);
+
+						// Incrementally compute Fab(x, y) for all the pixels inside the block
+						for(int r = blockY; r < blockEndY; r += 2,
+														  alphaRow = _mm_add_epi32(alphaRow, bb0Inc),
+														  betaRow  = _mm_add_epi32(betaRow, bb1Inc),
+														  gamaRow  = _mm_add_epi32(gamaRow, bb2Inc),
+														  zRow     = _mm_add_ps(zRow, zdyInc))
+						{
+							float *pRow = &pDepthBuffer[Layout::RowPairOffset(r, mDesc.mWidth)];
+							__m128i alpha = alphaRow;
+							__m128i beta = betaRow;
+							__m128i gama = gamaRow;
+							__m128 depth = zRow;
+
+							for(int c = blockX; c < blockEndX; c += 2,
+															  alpha = _mm_add_epi32(alpha, aa0Inc),
+															  beta  = _mm_add_epi32(beta, aa1Inc),
+															  gama  = _mm_add_epi32(gama, aa2Inc),
+															  depth = _mm_add_ps(depth, zdxInc))
+							{
+								//Test Pixel inside triangle
+								__m128i mask = _mm_cmpgt_epi32(_mm_or_si128(_mm_or_si128(alpha, beta), gama), fxptMinusOne);
 					
-					// Compute barycentric-interpolated depth
-			        __m128 depth = _mm_mul_ps(_mm_cvtepi32_ps(alpha), zz[0]);
-					depth = _mm_add_ps(depth, _mm_mul_ps(_mm_cvtepi32_ps(beta), zz[1]));
-					depth = _mm_add_ps(depth, _mm_mul_ps(_mm_cvtepi32_ps(gama), zz[2]));
-
-					__m128 previousDepthValue;
-					if(gVisualizeDepthBuffer)
-					{
-						previousDepthValue = _mm_set_ps(pDepthBuffer[idx], pDepthBuffer[idx + 1], pDepthBuffer[idx + SCREENW], pDepthBuffer[idx + SCREENW + 1]);
-					}
-					else
-					{
-						previousDepthValue = *(__m128*)&pDepthBuffer[idx];
-					}
-
-					__m128 depthMask = _mm_cmpge_ps(depth, previousDepthValue);
-					__m128i finalMask = _mm_and_si128(mask, _mm_castps_si128(depthMask));
-										
+								// Early out if all of this quad's pixels are outside the triangle.
+								if(_mm_test_all_zeros(mask, mask))
+								{
+									continue;
+								}
+					
+								float *pQuad = &pRow[Layout::QuadOffset(c)];
+								__m128 previousDepthValue = Layout::LoadQuad(pQuad, mDesc.mWidth);
+
+								__m128 depthMask = _mm_cmpge_ps(depth, previousDepthValue);
+								__m128i finalMask = _mm_and_si128(mask, _mm_castps_si128(depthMask));
+
+								Layout::StoreQuad(pQuad, mDesc.mWidth, previousDepthValue, depth, finalMask);
+							}//for each column
+						}// for each row
+					}// for each block column
+				}// for each block row
+			}// for each triangle
+		}// for each chunk
+	}// for each bin
+}
 
-					if(gVisualizeDepthBuffer)
-					{
-						if(finalMask.m128i_i32[3]) pDepthBuffer[idx] = depth.m128_f32[3];
-						if(finalMask.m128i_i32[2]) pDepthBuffer[idx + 1] = depth.m128_f32[2];
-						if(finalMask.m128i_i32[1]) pDepthBuffer[idx + SCREENW] = depth.m128_f32[1];
-						if(finalMask.m128i_i32[0]) pDepthBuffer[idx + SCREENW + 1] = depth.m128_f32[0];
-					}
-					else
-					{
-						depth = _mm_blendv_ps(previousDepthValue, depth, _mm_castsi128_ps(finalMask));
-						_mm_store_ps(&pDepthBuffer[idx], depth);
-					}
-				}//for each column											
-			}// for each row
-		}// for each triangle
-	}// for each set of SIMD# triangles
+//-------------------------------------------------------------------------------
+// Rasterizes the tile with the kernel specialized for the depth buffer layout
+//-------------------------------------------------------------------------------
+void DepthBufferRasterizerSSEMT::RasterizeBinnedTrianglesToDepthBuffer(UINT taskId, UINT taskCount)
+{
+	switch(mDesc.mLayout)
+	{
+		case DEPTH_BUFFER_LINEAR:   RasterizeTile<DepthBufferLinear>(taskId); break;
+		case DEPTH_BUFFER_QUAD:     RasterizeTile<DepthBufferQuad>(taskId); break;
+		case DEPTH_BUFFER_BLOCK8X8: RasterizeTile<DepthBufferBlock8x8>(taskId); break;
+	}
 }
\ No newline at end of file
@@ -26,6 +26,11 @@ class DepthBufferRasterizerSSEMT : public DepthBufferRasterizerSSE
 
 		void IsVisible(CPUTCamera *pCamera);
 		void TransformModelsAndRasterizeToDepthBuffer();
+		void StartTransformModelsAndRasterizeToDepthBuffer();
+		// Creates the whole occluder pass as a chain of dependent task sets without waiting
+		// for any of them, so that the passes of several views run side by side.
+		// WaitForDepthBuffer() ends the pass
+		void CreateTransformModelsAndRasterizeTasks();
 
 	private:
 		static void IsVisible(VOID* taskData, INT context, UINT taskId, UINT taskCount);
@@ -39,6 +44,7 @@ class DepthBufferRasterizerSSEMT : public DepthBufferRasterizerSSE
 
 		static void RasterizeBinnedTrianglesToDepthBuffer(VOID* taskData, INT context, UINT taskId, UINT taskCount);
 		void RasterizeBinnedTrianglesToDepthBuffer(UINT taskId, UINT taskCount);
+		template<class Layout> void RasterizeTile(UINT taskId);
 };
 
 #endif  //DEPTHBUFFERRASTERIZERSSEMT_H
\ No newline at end of file
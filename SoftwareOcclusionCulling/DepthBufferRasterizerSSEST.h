@@ -31,6 +31,7 @@ class DepthBufferRasterizerSSEST : public DepthBufferRasterizerSSE
 		void TransformMeshes();
 		void BinTransformedMeshes();
 		void RasterizeBinnedTrianglesToDepthBuffer(UINT tileId);
+		template<class Layout> void RasterizeTile(UINT tileId);
 
 };
 
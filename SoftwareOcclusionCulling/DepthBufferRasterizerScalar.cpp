@@ -28,7 +28,7 @@ DepthBufferRasterizerScalar::DepthBufferRasterizerScalar()
 	  mpCamera(NULL),
 	  mViewMatrix(NULL),
 	  mProjMatrix(NULL),
-	  mpRenderTargetPixels(NULL),
+	  mpRenderTargetPixels((UINT*)_aligned_malloc(sizeof(float) * SCREENW * SCREENH, CACHE_LINE_SIZE)),
 	  mNumRasterized(NULL),
 	  mpBin(NULL),
 	  mpBinModel(NULL),
@@ -39,6 +39,11 @@ DepthBufferRasterizerScalar::DepthBufferRasterizerScalar()
 	for(UINT i = 0; i < AVG_COUNTER; i++)
 	{
 		mRasterizeTime[i] = 0.0;
+		mBinTime[i] = 0.0;
+	}
+	for(UINT i = 0; i < NUM_XFORMVERTS_TASKS; i++)
+	{
+		mBinTaskTime[i] = 0.0;
 	}
 }
 
@@ -49,6 +54,7 @@ DepthBufferRasterizerScalar::~DepthBufferRasterizerScalar()
 	SAFE_DELETE_ARRAY(mpStartV1);
 	SAFE_DELETE_ARRAY(mpStartT1)
 	SAFE_DELETE_ARRAY(mpXformedPos1);
+	_aligned_free(mpRenderTargetPixels);
 }
 
 //--------------------------------------------------------------------
@@ -120,6 +126,26 @@ void DepthBufferRasterizerScalar::CreateTransformedModels(CPUTAssetSet **mpAsset
 	for(UINT i = 0; i < mNumModels1; i++)
 	{
 		mpTransformedModels1[i].SetXformedPos((float4*)&mpXformedPos1[mpStartV1[i] * 4], mpStartV1[i]);
+		mpTransformedModels1[i].SetViewportMatrix(mDesc.mViewportMatrix);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// The occluders are transformed with the viewport matrix of the new size, the
+// depth buffer is allocated again when the size changes
+//-----------------------------------------------------------------------------
+void DepthBufferRasterizerScalar::SetDepthBufferDesc(const DepthBufferDesc &desc)
+{
+	if(desc.mWidth != mDesc.mWidth || desc.mHeight != mDesc.mHeight)
+	{
+		_aligned_free(mpRenderTargetPixels);
+		mpRenderTargetPixels = (UINT*)_aligned_malloc(sizeof(float) * desc.GetNumPixels(), CACHE_LINE_SIZE);
+		ASSERT(mpRenderTargetPixels != NULL, _L("Failed allocating the depth buffer"));
+	}
+	mDesc = desc;
+	for(UINT i = 0; i < mNumModels1; i++)
+	{
+		mpTransformedModels1[i].SetViewportMatrix(desc.mViewportMatrix);
 	}
 }
 
@@ -127,4 +153,18 @@ void DepthBufferRasterizerScalar::SetViewProj(float4x4 *viewMatrix, float4x4 *pr
 {
 	mViewMatrix = viewMatrix;
 	mProjMatrix = projMatrix;
-}
\ No newline at end of file
+}
+
+//-----------------------------------------------------------------------------
+// The bin tasks time themselves, so that the bin stage is timed without the
+// main thread waiting between the transform and the bin task sets
+//-----------------------------------------------------------------------------
+void DepthBufferRasterizerScalar::EndBinTime()
+{
+	double binTime = 0.0;
+	for(UINT i = 0; i < NUM_XFORMVERTS_TASKS; i++)
+	{
+		binTime = max(binTime, mBinTaskTime[i]);
+	}
+	mBinTime[mTimeCounter] = binTime;
+}
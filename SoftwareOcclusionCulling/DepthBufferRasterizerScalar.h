@@ -40,7 +40,11 @@ class DepthBufferRasterizerScalar : public DepthBufferRasterizer, public HelperS
 		// Set the view and projection matrices
 		inline void SetViewProj(float4x4 *viewMatrix, float4x4 *projMatrix);
 		
-		inline void SetCPURenderTargetPixels(UINT *pRenderTargetPixels){mpRenderTargetPixels = pRenderTargetPixels;}
+		// The depth buffer is owned by the rasterizer, one float per pixel of the desc aligned to a cache line
+		inline UINT* GetCPURenderTargetPixels(){return mpRenderTargetPixels;}
+
+		// Set the depth buffer size and tile grid
+		void SetDepthBufferDesc(const DepthBufferDesc &desc);
 		
 		inline void SetOccluderSizeThreshold(float occluderSizeThreshold)
 		{
@@ -63,11 +67,25 @@ class DepthBufferRasterizerScalar : public DepthBufferRasterizer, public HelperS
 			}
 			return averageTime / AVG_COUNTER;
 		}
+		// Time spent in the bin stage alone, part of the rasterize time
+		inline double GetBinTime()
+		{
+			double averageTime = 0.0;
+			for(UINT i = 0; i < AVG_COUNTER; i++)
+			{
+				averageTime += mBinTime[i];
+			}
+			return averageTime / AVG_COUNTER;
+		}
 		inline UINT GetNumTriangles(){return mNumTriangles1;}
+		inline const DepthBufferDesc& GetDepthBufferDesc() {return mDesc;}
+		// The scalar depth test does not use a Hi-Z buffer
+		inline const HiZBuffer* GetHiZBuffer() {return NULL;}
+		inline const UINT* GetTileTriangleCounts() {return NULL;}
 		inline UINT GetNumRasterizedTriangles() 
 		{
 			UINT numRasterizedTris = 0;
-			for(UINT i = 0; i < NUM_TILES; i++)
+			for(UINT i = 0; i < (UINT)mDesc.GetNumTiles(); i++)
 			{
 				numRasterizedTris += mNumRasterizedTris[i];
 			}
@@ -88,6 +106,7 @@ class DepthBufferRasterizerScalar : public DepthBufferRasterizer, public HelperS
 		float4x4 *mViewMatrix;
 		float4x4 *mProjMatrix;
 		UINT *mpRenderTargetPixels;
+		DepthBufferDesc mDesc;
 		UINT mNumRasterized;
 		UINT	*mpBin;				 // triangle index
 		USHORT  *mpBinModel;		 // model Index	
@@ -97,6 +116,12 @@ class DepthBufferRasterizerScalar : public DepthBufferRasterizer, public HelperS
 
 		double mRasterizeTime[AVG_COUNTER];
 		CPUTTimerWin mRasterizeTimer;
+		double mBinTime[AVG_COUNTER];
+		CPUTTimerWin mBinTimer;
+		double mBinTaskTime[NUM_XFORMVERTS_TASKS]; // time each bin task took this frame
+
+		// The bin time of the frame is the time of the slowest bin task
+		void EndBinTime();
 };
 
 #endif  //DEPTHBUFFERRASTERIZERSCALAR_H
\ No newline at end of file
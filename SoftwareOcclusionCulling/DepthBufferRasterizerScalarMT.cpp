@@ -78,7 +78,7 @@ void DepthBufferRasterizerScalarMT::TransformModelsAndRasterizeToDepthBuffer()
 
 	gTaskMgr.CreateTaskSet(&DepthBufferRasterizerScalarMT::BinTransformedMeshes, this, NUM_XFORMVERTS_TASKS, &mXformMesh, 1, "Bin Meshes", &mBinMesh);
 	
-	gTaskMgr.CreateTaskSet(&DepthBufferRasterizerScalarMT::RasterizeBinnedTrianglesToDepthBuffer, this, NUM_TILES, &mBinMesh, 1, "Raster Tris to DB", &mRasterize);	
+	gTaskMgr.CreateTaskSet(&DepthBufferRasterizerScalarMT::RasterizeBinnedTrianglesToDepthBuffer, this, mDesc.GetNumTiles(), &mBinMesh, 1, "Raster Tris to DB", &mRasterize);	
 
 	// Wait for the task set
 	gTaskMgr.WaitForSet(mRasterize);
@@ -88,6 +88,7 @@ void DepthBufferRasterizerScalarMT::TransformModelsAndRasterizeToDepthBuffer()
 	gTaskMgr.ReleaseHandle(mRasterize);
 	mXformMesh = mBinMesh = mRasterize = TASKSETHANDLE_INVALID;
 
+	EndBinTime();
 	mRasterizeTime[mTimeCounter++] = mRasterizeTimer.StopTimer();
 	mTimeCounter = mTimeCounter >= AVG_COUNTER ? 0 : mTimeCounter;
 
@@ -156,13 +157,16 @@ void DepthBufferRasterizerScalarMT::BinTransformedMeshes(VOID* taskData, INT con
 //--------------------------------------------------------------------------------------
 void DepthBufferRasterizerScalarMT::BinTransformedMeshes(UINT taskId, UINT taskCount)
 {
+	CPUTTimerWin binTimer;
+	binTimer.StartTimer();
+
 	// Reset the bin count.  Note the data layout makes this traversal a bit awkward.
     // We can't just use memset() because the last array index isn't what's varying.
     // However, this should make the real use of this structure go faster.
-	for(UINT yy = 0; yy < SCREENH_IN_TILES; yy++)
+	for(UINT yy = 0; yy < (UINT)mDesc.mHeightInTiles; yy++)
     {
 		UINT offset = YOFFSET1_MT * yy;
-        for(UINT xx = 0; xx < SCREENW_IN_TILES; xx++)
+        for(UINT xx = 0; xx < (UINT)mDesc.mWidthInTiles; xx++)
         {
 			UINT index = offset + (XOFFSET1_MT * xx) + taskId;
             mpNumTrisInBin[index] = 0;
@@ -196,13 +200,15 @@ void DepthBufferRasterizerScalarMT::BinTransformedMeshes(UINT taskId, UINT taskC
         UINT thisSurfaceStartIndex = max( 0, (int)startIndex - (int)runningTriangleCount );
         UINT thisSurfaceEndIndex   = min( thisSurfaceStartIndex + remainingTrianglesPerTask, thisSurfaceTriangleCount) - 1;
 
-       	mpTransformedModels1[ss].BinTransformedTrianglesMT(taskId, ss, thisSurfaceStartIndex, thisSurfaceEndIndex, mpBin, mpBinModel, mpBinMesh, mpNumTrisInBin);
+       	mpTransformedModels1[ss].BinTransformedTrianglesMT(taskId, ss, thisSurfaceStartIndex, thisSurfaceEndIndex, mpBin, mpBinModel, mpBinMesh, mpNumTrisInBin, mDesc);
 
 		remainingTrianglesPerTask -= ( thisSurfaceEndIndex + 1 - thisSurfaceStartIndex);
         if( remainingTrianglesPerTask <= 0 ) break;
 				
 		runningTriangleCount = newRunningTriangleCount;
     }
+
+	mBinTaskTime[taskId] = binTimer.StopTimer();
 }
 
 
@@ -222,15 +228,18 @@ void DepthBufferRasterizerScalarMT::RasterizeBinnedTrianglesToDepthBuffer(UINT t
 	float* pDepthBuffer = (float*)mpRenderTargetPixels; 
 
 	// Based on TaskId determine which tile to process
-	UINT screenWidthInTiles = SCREENW/TILE_WIDTH_IN_PIXELS;
+	UINT screenWidthInTiles = mDesc.mWidthInTiles;
     UINT tileX = taskId % screenWidthInTiles;
     UINT tileY = taskId / screenWidthInTiles;
 
-    int tileStartX = tileX * TILE_WIDTH_IN_PIXELS;
-	int tileEndX   = tileStartX + TILE_WIDTH_IN_PIXELS;
+    int tileStartX = tileX * mDesc.mTileWidth;
+	int tileEndX   = min(tileStartX + mDesc.mTileWidth, mDesc.mWidth);
 	
-	int tileStartY = tileY * TILE_HEIGHT_IN_PIXELS;
-	int tileEndY   = tileStartY + TILE_HEIGHT_IN_PIXELS;
+	int tileStartY = tileY * mDesc.mTileHeight;
+	int tileEndY   = min(tileStartY + mDesc.mTileHeight, mDesc.mHeight);
+
+	// Clear the tile here instead of clearing the whole depth buffer before the raster tasks start
+	ClearDepthBufferTile<DepthBufferLinear>(pDepthBuffer, mDesc.mWidth, tileStartX, tileStartY, tileEndX, tileEndY);
 
 	UINT bin = 0;
 	UINT binIndex = 0;
@@ -325,7 +334,7 @@ void DepthBufferRasterizerScalarMT::RasterizeBinnedTrianglesToDepthBuffer(UINT t
 		zz[1] *= oneOverTriArea;
 		zz[2] *= oneOverTriArea;
 			
-		int rowIdx = (startY * SCREENW + startX);
+		int rowIdx = (startY * mDesc.mWidth + startX);
 		int col = startX;
 		int row = startY;
 		
@@ -336,7 +345,7 @@ void DepthBufferRasterizerScalarMT::RasterizeBinnedTrianglesToDepthBuffer(UINT t
 				
 		for(int r = startY; r < endY; r++,
 									  row++,
-									  rowIdx = rowIdx + SCREENW,
+									  rowIdx = rowIdx + mDesc.mWidth,
 									  alpha0 += B0,
 									  beta0 += B1,
 									  gama0 += B2)									 
@@ -58,8 +58,10 @@ void DepthBufferRasterizerScalarST::TransformModelsAndRasterizeToDepthBuffer()
 	mRasterizeTimer.StartTimer();
 	
 	TransformMeshes();
+	mBinTimer.StartTimer();
 	BinTransformedMeshes();
-	for(UINT i = 0; i < NUM_TILES; i++)
+	mBinTime[mTimeCounter] = mBinTimer.StopTimer();
+	for(UINT i = 0; i < (UINT)mDesc.GetNumTiles(); i++)
 	{
 		RasterizeBinnedTrianglesToDepthBuffer(i);
 	}
@@ -95,10 +97,10 @@ void DepthBufferRasterizerScalarST::BinTransformedMeshes()
 	// Reset the bin count.  Note the data layout makes this traversal a bit awkward.
     // We can't just use memset() because the last array index isn't what's varying.
     // However, this should make the real use of this structure go faster.
-	for(UINT yy = 0; yy < SCREENH_IN_TILES; yy++)
+	for(UINT yy = 0; yy < (UINT)mDesc.mHeightInTiles; yy++)
     {
 		UINT offset = YOFFSET1_ST * yy;
-        for(UINT xx = 0; xx < SCREENW_IN_TILES; xx++)
+        for(UINT xx = 0; xx < (UINT)mDesc.mWidthInTiles; xx++)
         {
 			UINT index = offset + (XOFFSET1_ST * xx);
             mpNumTrisInBin[index] = 0;
@@ -110,7 +112,7 @@ void DepthBufferRasterizerScalarST::BinTransformedMeshes()
     {
 		UINT thisSurfaceTriangleCount = mpTransformedModels1[ss].GetNumTriangles();
         
-        mpTransformedModels1[ss].BinTransformedTrianglesST(0, ss, 0, thisSurfaceTriangleCount - 1, mpBin, mpBinModel, mpBinMesh, mpNumTrisInBin);
+        mpTransformedModels1[ss].BinTransformedTrianglesST(0, ss, 0, thisSurfaceTriangleCount - 1, mpBin, mpBinModel, mpBinMesh, mpNumTrisInBin, mDesc);
 	}
 }
 
@@ -124,15 +126,18 @@ void DepthBufferRasterizerScalarST::RasterizeBinnedTrianglesToDepthBuffer(UINT t
 	float* pDepthBuffer = (float*)mpRenderTargetPixels; 
 
 	// Based on TaskId determine which tile to process
-	UINT screenWidthInTiles = SCREENW/TILE_WIDTH_IN_PIXELS;
+	UINT screenWidthInTiles = mDesc.mWidthInTiles;
     UINT tileX = tileId % screenWidthInTiles;
     UINT tileY = tileId / screenWidthInTiles;
 
-    int tileStartX = tileX * TILE_WIDTH_IN_PIXELS;
-	int tileEndX   = tileStartX + TILE_WIDTH_IN_PIXELS;
+    int tileStartX = tileX * mDesc.mTileWidth;
+	int tileEndX   = min(tileStartX + mDesc.mTileWidth, mDesc.mWidth);
 	
-	int tileStartY = tileY * TILE_HEIGHT_IN_PIXELS;
-	int tileEndY   = tileStartY + TILE_HEIGHT_IN_PIXELS;
+	int tileStartY = tileY * mDesc.mTileHeight;
+	int tileEndY   = min(tileStartY + mDesc.mTileHeight, mDesc.mHeight);
+
+	// Clear the tile here instead of clearing the whole depth buffer before the raster tasks start
+	ClearDepthBufferTile<DepthBufferLinear>(pDepthBuffer, mDesc.mWidth, tileStartX, tileStartY, tileEndX, tileEndY);
 
 	UINT bin = 0;
 	UINT binIndex = 0;
@@ -226,7 +231,7 @@ void DepthBufferRasterizerScalarST::RasterizeBinnedTrianglesToDepthBuffer(UINT t
 		zz[1] *= oneOverTriArea;
 		zz[2] *= oneOverTriArea;
 			
-		int rowIdx = (startY * SCREENW + startX);
+		int rowIdx = (startY * mDesc.mWidth + startX);
 		int col = startX;
 		int row = startY;
 		
@@ -237,7 +242,7 @@ void DepthBufferRasterizerScalarST::RasterizeBinnedTrianglesToDepthBuffer(UINT t
 		// Incrementally compute Fab(x, y) for all the pixels inside the bounding box formed by (startX, endX) and (startY, endY)
 		for(int r = startY; r < endY; r++,
 									  row++,
-									  rowIdx = rowIdx + SCREENW,
+									  rowIdx = rowIdx + mDesc.mWidth,
 									  alpha0 += B0,
 									  beta0 += B1,
 									  gama0 += B2)									 
@@ -16,6 +16,7 @@
 //--------------------------------------------------------------------------------------
 
 #include "HelperSSE.h"
+#include <intrin.h>
 
 HelperSSE::HelperSSE()
 {
@@ -25,6 +26,30 @@ HelperSSE::~HelperSSE()
 {
 }
 
+bool HelperSSE::IsAVX2Supported()
+{
+	int cpuInfo[4];
+	__cpuid(cpuInfo, 0);
+	if(cpuInfo[0] < 7)
+	{
+		return false;
+	}
+
+	// AVX and OSXSAVE, then make sure the OS saves the YMM state on context switches
+	__cpuid(cpuInfo, 1);
+	if((cpuInfo[2] & (1 << 28)) == 0 || (cpuInfo[2] & (1 << 27)) == 0)
+	{
+		return false;
+	}
+	if((_xgetbv(0) & 0x6) != 0x6)
+	{
+		return false;
+	}
+
+	__cpuidex(cpuInfo, 7, 0);
+	return (cpuInfo[1] & (1 << 5)) != 0;
+}
+
 __m128 HelperSSE::TransformCoords(__m128 *v, __m128 *m)
 {
 	__m128 vResult = _mm_shuffle_ps(*v, *v, _MM_SHUFFLE(0,0,0,0));
@@ -25,6 +25,9 @@ class HelperSSE
 		HelperSSE();
 		~HelperSSE();
 
+		// Check that both the CPU and the OS support the AVX2 instruction set
+		static bool IsAVX2Supported();
+
 	protected:
 		struct vFloat4
 		{
@@ -42,6 +45,22 @@ class HelperSSE
 			__m128i W;
 		};
 
+		struct vFloat8
+		{
+			__m256 X;
+			__m256 Y;
+			__m256 Z;
+			__m256 W;
+		};
+
+		struct vFxPt8
+		{
+			__m256i X;
+			__m256i Y;
+			__m256i Z;
+			__m256i W;
+		};
+
 		__m128 TransformCoords(__m128 *v, __m128 *m);
 		void MatrixMultiply(__m128 *m1, __m128 *m2, __m128 *result);
 
@@ -58,6 +77,20 @@ class HelperSSE
 			tmp = _mm_max_epi32(v0, v1);
 			return tmp;
 		}
+
+		__forceinline __m256i Min(const __m256i &v0, const __m256i &v1)
+		{
+			__m256i tmp;
+			tmp = _mm256_min_epi32(v0, v1);
+			return tmp;
+		}
+
+		__forceinline __m256i Max(const __m256i &v0, const __m256i &v1)
+		{
+			__m256i tmp;
+			tmp = _mm256_max_epi32(v0, v1);
+			return tmp;
+		}
 };
 
 #endif 
\ No newline at end of file
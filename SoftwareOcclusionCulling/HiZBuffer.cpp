@@ -0,0 +1,251 @@
+//--------------------------------------------------------------------------------------
+// Copyright 2011 Intel Corporation
+// All Rights Reserved
+//
+// Permission is granted to use, copy, distribute and prepare derivative works of this
+// software for any purpose and without fee, provided, that the above copyright notice
+// and this statement appear in all copies.  Intel makes no representations about the
+// suitability of this software for any purpose.  THIS SOFTWARE IS PROVIDED "AS IS."
+// INTEL SPECIFICALLY DISCLAIMS ALL WARRANTIES, EXPRESS OR IMPLIED, AND ALL LIABILITY,
+// INCLUDING CONSEQUENTIAL AND OTHER INDIRECT DAMAGES, FOR THE USE OF THIS SOFTWARE,
+// INCLUDING LIABILITY FOR INFRINGEMENT OF ANY PROPRIETARY RIGHTS, AND INCLUDING THE
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  Intel does not
+// assume any responsibility for any errors which may appear in this software nor any
+// responsibility to update it.
+//
+//--------------------------------------------------------------------------------------
+
+#include "HiZBuffer.h"
+#include <float.h>
+
+HiZBuffer::HiZBuffer()
+	: mDepthBufferWidth(0),
+	  mDepthBufferHeight(0)
+{
+	for(UINT level = 0; level < HIZ_LEVELS; level++)
+	{
+		mpMinDepth[level] = NULL;
+		mpMaxDepth[level] = NULL;
+	}
+	SetSize(SCREENW, SCREENH, DEPTH_BUFFER_QUAD);
+}
+
+HiZBuffer::~HiZBuffer()
+{
+	for(UINT level = 0; level < HIZ_LEVELS; level++)
+	{
+		_aligned_free(mpMinDepth[level]);
+		_aligned_free(mpMaxDepth[level]);
+	}
+}
+
+//-------------------------------------------------------------------------------
+// The levels are allocated again when the size changes, a layout change keeps
+// them. A partial block at the bottom only covers the depth buffer rows that
+// exist
+//-------------------------------------------------------------------------------
+void HiZBuffer::SetSize(UINT width, UINT height, DEPTH_BUFFER_LAYOUT layout)
+{
+	bool resize = width != mDepthBufferWidth || height != mDepthBufferHeight;
+	mDepthBufferWidth = width;
+	mDepthBufferHeight = height;
+	mLayout = layout;
+
+	width = (width + HIZ_BLOCK_SIZE - 1) >> HIZ_BLOCK_SHIFT;
+	height = (height + HIZ_BLOCK_SIZE - 1) >> HIZ_BLOCK_SHIFT;
+	for(UINT level = 0; level < HIZ_LEVELS; level++)
+	{
+		mWidth[level] = width;
+		mHeight[level] = height;
+		if(resize)
+		{
+			_aligned_free(mpMinDepth[level]);
+			_aligned_free(mpMaxDepth[level]);
+			mpMinDepth[level] = (float*)_aligned_malloc(sizeof(float) * width * height, 16);
+			mpMaxDepth[level] = (float*)_aligned_malloc(sizeof(float) * width * height, 16);
+			ASSERT(mpMinDepth[level] != NULL && mpMaxDepth[level] != NULL, _L("Failed allocating the Hi-Z buffer"));
+			for(UINT i = 0; i < width * height; i++)
+			{
+				mpMinDepth[level][i] = 0.0f;
+				mpMaxDepth[level][i] = 0.0f;
+			}
+		}
+		width = (width + 1) >> 1;
+		height = (height + 1) >> 1;
+	}
+}
+
+//-------------------------------------------------------------------------------
+// Computes the min and max depth of the 8x8 pixel blocks in block rows startY to
+// endY of the depth buffer. The order of the pixels does not matter, only which
+// ones belong to a block, so each row pair of a block is read as four 2x2 quads
+//-------------------------------------------------------------------------------
+template<class Layout>
+void HiZBuffer::BuildBlocks(const float *pDepthBuffer, UINT startY, UINT endY)
+{
+	for(UINT blockY = startY; blockY < endY; blockY++)
+	{
+		UINT y = blockY * HIZ_BLOCK_SIZE;
+		UINT numRows = min((UINT)HIZ_BLOCK_SIZE, mDepthBufferHeight - y);
+		for(UINT blockX = 0; blockX < mWidth[0]; blockX++)
+		{
+			UINT x = blockX * HIZ_BLOCK_SIZE;
+			__m128 minDepth = _mm_set1_ps(FLT_MAX);
+			__m128 maxDepth = _mm_set1_ps(-FLT_MAX);
+			for(UINT r = 0; r < numRows; r += 2)
+			{
+				const float *pRow = &pDepthBuffer[Layout::RowPairOffset(y + r, mDepthBufferWidth)];
+				for(UINT c = 0; c < HIZ_BLOCK_SIZE; c += 2)
+				{
+					__m128 depth = Layout::LoadQuad(&pRow[Layout::QuadOffset(x + c)], mDepthBufferWidth);
+					minDepth = _mm_min_ps(minDepth, depth);
+					maxDepth = _mm_max_ps(maxDepth, depth);
+				}
+			}
+
+			minDepth = _mm_min_ps(minDepth, _mm_shuffle_ps(minDepth, minDepth, _MM_SHUFFLE(1, 0, 3, 2)));
+			minDepth = _mm_min_ps(minDepth, _mm_shuffle_ps(minDepth, minDepth, _MM_SHUFFLE(2, 3, 0, 1)));
+			maxDepth = _mm_max_ps(maxDepth, _mm_shuffle_ps(maxDepth, maxDepth, _MM_SHUFFLE(1, 0, 3, 2)));
+			maxDepth = _mm_max_ps(maxDepth, _mm_shuffle_ps(maxDepth, maxDepth, _MM_SHUFFLE(2, 3, 0, 1)));
+
+			UINT idx = blockY * mWidth[0] + blockX;
+			_mm_store_ss(&mpMinDepth[0][idx], minDepth);
+			_mm_store_ss(&mpMaxDepth[0][idx], maxDepth);
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------
+// Builds the 8x8 blocks of the strip from the depth buffer, then each coarser
+// level from the 2x2 blocks of the level below it. A strip only reads depth
+// buffer rows and blocks that belong to it, so strips can be built in parallel
+//--------------------------------------------------------------------------------
+void HiZBuffer::Build(const float *pDepthBuffer, UINT strip)
+{
+	UINT startY = strip << (HIZ_LEVELS - 1);
+	UINT endY = min(startY + (1 << (HIZ_LEVELS - 1)), mHeight[0]);
+	switch(mLayout)
+	{
+		case DEPTH_BUFFER_LINEAR:   BuildBlocks<DepthBufferLinear>(pDepthBuffer, startY, endY); break;
+		case DEPTH_BUFFER_QUAD:     BuildBlocks<DepthBufferQuad>(pDepthBuffer, startY, endY); break;
+		case DEPTH_BUFFER_BLOCK8X8: BuildBlocks<DepthBufferBlock8x8>(pDepthBuffer, startY, endY); break;
+	}
+
+	for(UINT level = 1; level < HIZ_LEVELS; level++)
+	{
+		const float *pSrcMin = mpMinDepth[level - 1];
+		const float *pSrcMax = mpMaxDepth[level - 1];
+		UINT srcWidth = mWidth[level - 1];
+		UINT srcHeight = mHeight[level - 1];
+
+		startY = strip << (HIZ_LEVELS - 1 - level);
+		endY = min(startY + (1 << (HIZ_LEVELS - 1 - level)), mHeight[level]);
+		for(UINT y = startY; y < endY; y++)
+		{
+			UINT y0 = 2 * y;
+			UINT y1 = min(y0 + 1, srcHeight - 1);
+			for(UINT x = 0; x < mWidth[level]; x++)
+			{
+				UINT x0 = 2 * x;
+				UINT x1 = min(x0 + 1, srcWidth - 1);
+
+				float minDepth = min(min(pSrcMin[y0 * srcWidth + x0], pSrcMin[y0 * srcWidth + x1]),
+									 min(pSrcMin[y1 * srcWidth + x0], pSrcMin[y1 * srcWidth + x1]));
+				float maxDepth = max(max(pSrcMax[y0 * srcWidth + x0], pSrcMax[y0 * srcWidth + x1]),
+									 max(pSrcMax[y1 * srcWidth + x0], pSrcMax[y1 * srcWidth + x1]));
+
+				mpMinDepth[level][y * mWidth[level] + x] = minDepth;
+				mpMaxDepth[level][y * mWidth[level] + x] = maxDepth;
+			}
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------
+// Returns true if every pixel in the rectangle is closer than maxDepth. Starts at
+// the coarsest level and only goes down to a finer level if the test fails, since 
+// a coarse block's min depth is never larger than the min depth of its children
+//--------------------------------------------------------------------------------
+bool HiZBuffer::IsRectOccluded(int startX, int startY, int endX, int endY, float maxDepth) const
+{
+	for(int level = HIZ_LEVELS - 1; level >= 0; level--)
+	{
+		int shift = HIZ_BLOCK_SHIFT + level;
+		int blockStartX = startX >> shift;
+		int blockEndX = endX >> shift;
+		int blockStartY = startY >> shift;
+		int blockEndY = endY >> shift;
+
+		// SSE blocks of a row are compared at a time, the rest of the row one by one
+		bool occluded = true;
+		__m128 depth = _mm_set1_ps(maxDepth);
+		for(int y = blockStartY; y <= blockEndY && occluded; y++)
+		{
+			const float *pMinDepth = &mpMinDepth[level][y * mWidth[level]];
+			int x = blockStartX;
+			for(; x + SSE - 1 <= blockEndX && occluded; x += SSE)
+			{
+				occluded = _mm_movemask_ps(_mm_cmple_ps(_mm_loadu_ps(&pMinDepth[x]), depth)) == 0;
+			}
+			for(; x <= blockEndX && occluded; x++)
+			{
+				if(pMinDepth[x] <= maxDepth)
+				{
+					occluded = false;
+				}
+			}
+		}
+
+		if(occluded)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+//--------------------------------------------------------------------------------
+// Returns true if no pixel in the rectangle is closer than minDepth. The caller
+// still has to make sure that something is rasterized inside the rectangle
+//--------------------------------------------------------------------------------
+bool HiZBuffer::IsRectVisible(int startX, int startY, int endX, int endY, float minDepth) const
+{
+	if(startX > endX || startY > endY)
+	{
+		return false;
+	}
+
+	for(int level = HIZ_LEVELS - 1; level >= 0; level--)
+	{
+		int shift = HIZ_BLOCK_SHIFT + level;
+		int blockStartX = startX >> shift;
+		int blockEndX = endX >> shift;
+		int blockStartY = startY >> shift;
+		int blockEndY = endY >> shift;
+
+		bool visible = true;
+		__m128 depth = _mm_set1_ps(minDepth);
+		for(int y = blockStartY; y <= blockEndY && visible; y++)
+		{
+			const float *pMaxDepth = &mpMaxDepth[level][y * mWidth[level]];
+			int x = blockStartX;
+			for(; x + SSE - 1 <= blockEndX && visible; x += SSE)
+			{
+				visible = _mm_movemask_ps(_mm_cmpgt_ps(_mm_loadu_ps(&pMaxDepth[x]), depth)) == 0;
+			}
+			for(; x <= blockEndX && visible; x++)
+			{
+				if(pMaxDepth[x] > minDepth)
+				{
+					visible = false;
+				}
+			}
+		}
+
+		if(visible)
+		{
+			return true;
+		}
+	}
+	return false;
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+//--------------------------------------------------------------------------------------
+// Copyright 2011 Intel Corporation
+// All Rights Reserved
+//
+// Permission is granted to use, copy, distribute and prepare derivative works of this
+// software for any purpose and without fee, provided, that the above copyright notice
+// and this statement appear in all copies.  Intel makes no representations about the
+// suitability of this software for any purpose.  THIS SOFTWARE IS PROVIDED "AS IS."
+// INTEL SPECIFICALLY DISCLAIMS ALL WARRANTIES, EXPRESS OR IMPLIED, AND ALL LIABILITY,
+// INCLUDING CONSEQUENTIAL AND OTHER INDIRECT DAMAGES, FOR THE USE OF THIS SOFTWARE,
+// INCLUDING LIABILITY FOR INFRINGEMENT OF ANY PROPRIETARY RIGHTS, AND INCLUDING THE
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  Intel does not
+// assume any responsibility for any errors which may appear in this software nor any
+// responsibility to update it.
+//
+//--------------------------------------------------------------------------------------
+
+#ifndef HIZBUFFER_H
+#define HIZBUFFER_H
+
+#include "CPUT_DX11.h"
+#include "Constants.h"
+#include "DepthBufferLayout.h"
+
+//-------------------------------------------------------------------------------
+// Hierarchical min/max depth buffer built from the CPU rasterized depth buffer.
+// Larger depth values are closer to the camera, so a region is occluded when its
+// closest depth is smaller than the min depth of the blocks it covers and it
+// passes the depth test when its farthest depth is at least their max depth
+//-------------------------------------------------------------------------------
+class HiZBuffer
+{
+	public:
+		HiZBuffer();
+		~HiZBuffer();
+
+		// Sets the size and layout of the depth buffer the pyramid is built from
+		void SetSize(UINT width, UINT height, DEPTH_BUFFER_LAYOUT layout);
+		inline UINT GetNumStrips() const {return (mDepthBufferHeight + HIZ_STRIP_HEIGHT - 1) / HIZ_STRIP_HEIGHT;}
+
+		// Builds all pyramid levels for one strip of HIZ_STRIP_HEIGHT depth buffer rows
+		void Build(const float *pDepthBuffer, UINT strip);
+
+		// Pixel rectangles are inclusive and must lie inside the screen
+		bool IsRectOccluded(int startX, int startY, int endX, int endY, float maxDepth) const;
+		bool IsRectVisible(int startX, int startY, int endX, int endY, float minDepth) const;
+
+	private:
+		float *mpMinDepth[HIZ_LEVELS];
+		float *mpMaxDepth[HIZ_LEVELS];
+		UINT mWidth[HIZ_LEVELS];
+		UINT mHeight[HIZ_LEVELS];
+		UINT mDepthBufferWidth;
+		UINT mDepthBufferHeight;
+		DEPTH_BUFFER_LAYOUT mLayout;
+
+		template<class Layout> void BuildBlocks(const float *pDepthBuffer, UINT startY, UINT endY);
+};
+
+#endif //HIZBUFFER_H
\ No newline at end of file
@@ -0,0 +1,283 @@
+//--------------------------------------------------------------------------------------
+// Copyright 2011 Intel Corporation
+// All Rights Reserved
+//
+// Permission is granted to use, copy, distribute and prepare derivative works of this
+// software for any purpose and without fee, provided, that the above copyright notice
+// and this statement appear in all copies.  Intel makes no representations about the
+// suitability of this software for any purpose.  THIS SOFTWARE IS PROVIDED "AS IS."
+// INTEL SPECIFICALLY DISCLAIMS ALL WARRANTIES, EXPRESS OR IMPLIED, AND ALL LIABILITY,
+// INCLUDING CONSEQUENTIAL AND OTHER INDIRECT DAMAGES, FOR THE USE OF THIS SOFTWARE,
+// INCLUDING LIABILITY FOR INFRINGEMENT OF ANY PROPRIETARY RIGHTS, AND INCLUDING THE
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  Intel does not
+// assume any responsibility for any errors which may appear in this software nor any
+// responsibility to update it.
+//
+//--------------------------------------------------------------------------------------
+
+#include "MaskedDepthBuffer.h"
+#include <float.h>
+
+// Integer division rounding towards negative infinity, b has to be positive
+static inline int FloorDiv(int a, int b)
+{
+	return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+static inline int CeilDiv(int a, int b)
+{
+	return -FloorDiv(-a, b);
+}
+
+// Bits lo to hi (inclusive) of a tile row, clamped to the tile
+static inline UINT SpanMask(int lo, int hi)
+{
+	lo = max(lo, 0);
+	hi = min(hi, MASKED_TILE_WIDTH - 1);
+	if(lo > hi)
+	{
+		return 0;
+	}
+	return (0xFFFFFFFF >> (MASKED_TILE_WIDTH - 1 - hi)) & (0xFFFFFFFF << lo);
+}
+
+MaskedDepthBuffer::MaskedDepthBuffer()
+	: mpTiles(NULL),
+	  mWidth(0),
+	  mHeight(0),
+	  mWidthInTiles(0)
+{
+	SetSize(SCREENW, SCREENH);
+}
+
+MaskedDepthBuffer::~MaskedDepthBuffer()
+{
+	_aligned_free(mpTiles);
+}
+
+void MaskedDepthBuffer::SetSize(int width, int height)
+{
+	if(width == mWidth && height == mHeight)
+	{
+		return;
+	}
+
+	mWidth = width;
+	mHeight = height;
+	mWidthInTiles = width / MASKED_TILE_WIDTH;
+	_aligned_free(mpTiles);
+	mpTiles = (Tile*)_aligned_malloc(sizeof(Tile) * mWidthInTiles * (height / MASKED_TILE_HEIGHT), 16);
+	ASSERT(mpTiles != NULL, _L("Failed allocating the masked depth buffer"));
+	ClearTiles(0, 0, width, height);
+}
+
+void MaskedDepthBuffer::ClearTiles(int startX, int startY, int endX, int endY)
+{
+	int tileEndY = (endY + MASKED_TILE_HEIGHT - 1) / MASKED_TILE_HEIGHT;
+	int tileEndX = (endX + MASKED_TILE_WIDTH - 1) / MASKED_TILE_WIDTH;
+	for(int ty = startY / MASKED_TILE_HEIGHT; ty < tileEndY; ty++)
+	{
+		for(int tx = startX / MASKED_TILE_WIDTH; tx < tileEndX; tx++)
+		{
+			Tile *pTile = &mpTiles[ty * mWidthInTiles + tx];
+			for(int r = 0; r < MASKED_TILE_HEIGHT; r++)
+			{
+				pTile->mMask[r] = 0;
+			}
+			pTile->mZMin[0] = 0.0f;
+			pTile->mZMin[1] = FLT_MAX;
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------
+// Writes the conservative per pixel depth of the tiles to a linear depth buffer so
+// that the masked buffer can be visualized like the float one
+//--------------------------------------------------------------------------------
+void MaskedDepthBuffer::ResolveToDepthBuffer(float *pDepthBuffer, int pitch, int startX, int startY, int endX, int endY) const
+{
+	for(int y = startY; y < endY; y++)
+	{
+		int ty = y / MASKED_TILE_HEIGHT;
+		int r = y % MASKED_TILE_HEIGHT;
+		for(int x = startX; x < endX; x++)
+		{
+			const Tile *pTile = &mpTiles[ty * mWidthInTiles + x / MASKED_TILE_WIDTH];
+			bool inMask = (pTile->mMask[r] >> (x % MASKED_TILE_WIDTH)) & 1;
+			pDepthBuffer[y * pitch + x] = inMask ? max(pTile->mZMin[0], pTile->mZMin[1]) : pTile->mZMin[0];
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------
+// Merges a triangle's coverage into a tile. zTri is the farthest depth of the 
+// triangle inside the tile
+//--------------------------------------------------------------------------------
+void MaskedDepthBuffer::UpdateTile(Tile *pTile, const UINT *pCoverage, float zTri)
+{
+	// A triangle that is not entirely in front of the reference layer cannot 
+	// improve the tile, skipping it is always conservative
+	if(zTri <= pTile->mZMin[0])
+	{
+		return;
+	}
+
+	// If the triangle is further in front of the reference layer than the working
+	// layer is, merging would pull its depth back. Drop the working layer instead,
+	// its pixels fall back to the reference layer
+	float distTri = zTri - pTile->mZMin[0];
+	float distWorking = pTile->mZMin[1] - pTile->mZMin[0];
+	if(distTri > distWorking)
+	{
+		for(int r = 0; r < MASKED_TILE_HEIGHT; r++)
+		{
+			pTile->mMask[r] = 0;
+		}
+		pTile->mZMin[1] = FLT_MAX;
+	}
+
+	pTile->mZMin[1] = min(pTile->mZMin[1], zTri);
+	
+	UINT fullMask = 0xFFFFFFFF;
+	for(int r = 0; r < MASKED_TILE_HEIGHT; r++)
+	{
+		pTile->mMask[r] |= pCoverage[r];
+		fullMask &= pTile->mMask[r];
+	}
+
+	// The working layer covers the whole tile, make it the reference layer
+	if(fullMask == 0xFFFFFFFF)
+	{
+		pTile->mZMin[0] = pTile->mZMin[1];
+		pTile->mZMin[1] = FLT_MAX;
+		for(int r = 0; r < MASKED_TILE_HEIGHT; r++)
+		{
+			pTile->mMask[r] = 0;
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------
+// Computes the span of covered pixels on each row of a tile row from the edge 
+// functions and then builds the coverage masks of the tiles one 32 pixel row at
+// a time. A pixel is covered if all three edge functions are non negative, like
+// in the float rasterizer
+//--------------------------------------------------------------------------------
+void MaskedDepthBuffer::RasterizeTriangle(const int *pA, const int *pB, const int *pC, 
+										  float z0, float zdx, float zdy, float zMin,
+										  int startX, int startY, int endX, int endY)
+{
+	if(startX >= endX || startY >= endY)
+	{
+		return;
+	}
+
+	int tileStartY = startY / MASKED_TILE_HEIGHT;
+	int tileEndY = (endY - 1) / MASKED_TILE_HEIGHT;
+	for(int ty = tileStartY; ty <= tileEndY; ty++)
+	{
+		int spanStart[MASKED_TILE_HEIGHT];
+		int spanEnd[MASKED_TILE_HEIGHT];
+		int rowStartX = endX, rowEndX = startX - 1;
+		int rowStartY = endY, rowEndY = startY - 1;
+		for(int r = 0; r < MASKED_TILE_HEIGHT; r++)
+		{
+			int y = ty * MASKED_TILE_HEIGHT + r;
+			int xl = startX;
+			int xr = (y >= startY && y < endY) ? endX - 1 : startX - 1;
+			for(int e = 0; e < 3 && xl <= xr; e++)
+			{
+				int rowC = pB[e] * (y - startY) + pC[e];
+				if(pA[e] > 0)
+				{
+					xl = max(xl, startX + CeilDiv(-rowC, pA[e]));
+				}
+				else if(pA[e] < 0)
+				{
+					xr = min(xr, startX + FloorDiv(rowC, -pA[e]));
+				}
+				else if(rowC < 0)
+				{
+					xr = xl - 1;
+				}
+			}
+
+			spanStart[r] = xl;
+			spanEnd[r] = xr;
+			if(xl <= xr)
+			{
+				rowStartX = min(rowStartX, xl);
+				rowEndX = max(rowEndX, xr);
+				rowStartY = min(rowStartY, y);
+				rowEndY = max(rowEndY, y);
+			}
+		}
+		
+		if(rowStartX > rowEndX)
+		{
+			continue;
+		}
+
+		for(int tx = rowStartX / MASKED_TILE_WIDTH; tx <= rowEndX / MASKED_TILE_WIDTH; tx++)
+		{
+			int tileX = tx * MASKED_TILE_WIDTH;
+			UINT coverage[MASKED_TILE_HEIGHT];
+			UINT anyCoverage = 0;
+			for(int r = 0; r < MASKED_TILE_HEIGHT; r++)
+			{
+				coverage[r] = SpanMask(spanStart[r] - tileX, spanEnd[r] - tileX);
+				anyCoverage |= coverage[r];
+			}
+			if(!anyCoverage)
+			{
+				continue;
+			}
+
+			// Depth is linear in screen space, so its minimum over the covered part of the
+			// tile is at one of the corners of the rectangle around it
+			float x0 = (float)(max(tileX, rowStartX) - startX);
+			float x1 = (float)(min(tileX + MASKED_TILE_WIDTH - 1, rowEndX) - startX);
+			float y0 = (float)(rowStartY - startY);
+			float y1 = (float)(rowEndY - startY);
+			float zTri = z0 + min(zdx * x0, zdx * x1) + min(zdy * y0, zdy * y1);
+
+			UpdateTile(&mpTiles[ty * mWidthInTiles + tx], coverage, max(zTri, zMin));
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------
+// Tests a rectangle against the tiles it overlaps. Pixels in a tile's mask are at
+// least as close as both layers, the other pixels as close as the reference layer
+//--------------------------------------------------------------------------------
+bool MaskedDepthBuffer::IsRectVisible(int startX, int startY, int endX, int endY, float maxDepth) const
+{
+	for(int ty = startY / MASKED_TILE_HEIGHT; ty <= endY / MASKED_TILE_HEIGHT && startX <= endX; ty++)
+	{
+		for(int tx = startX / MASKED_TILE_WIDTH; tx <= endX / MASKED_TILE_WIDTH; tx++)
+		{
+			const Tile *pTile = &mpTiles[ty * mWidthInTiles + tx];
+			if(maxDepth < pTile->mZMin[0])
+			{
+				continue;
+			}
+			if(maxDepth >= pTile->mZMin[1])
+			{
+				return true;
+			}
+
+			// Only the pixels outside the mask can be visible
+			int tileX = tx * MASKED_TILE_WIDTH;
+			UINT rectMask = SpanMask(startX - tileX, endX - tileX);
+			for(int r = 0; r < MASKED_TILE_HEIGHT; r++)
+			{
+				int y = ty * MASKED_TILE_HEIGHT + r;
+				if(y >= startY && y <= endY && (rectMask & ~pTile->mMask[r]))
+				{
+					return true;
+				}
+			}
+		}
+	}
+	return false;
+}
\ No newline at end of file
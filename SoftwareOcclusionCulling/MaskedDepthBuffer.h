@@ -0,0 +1,73 @@
+//--------------------------------------------------------------------------------------
+// Copyright 2011 Intel Corporation
+// All Rights Reserved
+//
+// Permission is granted to use, copy, distribute and prepare derivative works of this
+// software for any purpose and without fee, provided, that the above copyright notice
+// and this statement appear in all copies.  Intel makes no representations about the
+// suitability of this software for any purpose.  THIS SOFTWARE IS PROVIDED "AS IS."
+// INTEL SPECIFICALLY DISCLAIMS ALL WARRANTIES, EXPRESS OR IMPLIED, AND ALL LIABILITY,
+// INCLUDING CONSEQUENTIAL AND OTHER INDIRECT DAMAGES, FOR THE USE OF THIS SOFTWARE,
+// INCLUDING LIABILITY FOR INFRINGEMENT OF ANY PROPRIETARY RIGHTS, AND INCLUDING THE
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  Intel does not
+// assume any responsibility for any errors which may appear in this software nor any
+// responsibility to update it.
+//
+//--------------------------------------------------------------------------------------
+
+#ifndef MASKEDDEPTHBUFFER_H
+#define MASKEDDEPTHBUFFER_H
+
+#include "CPUT_DX11.h"
+#include "Constants.h"
+
+//-------------------------------------------------------------------------------------
+// Occlusion buffer that stores a coverage mask and two depth values per 32x2 pixel 
+// tile instead of one float per pixel. Larger depth values are closer to the camera.
+// mZMin[0] is the farthest depth of the whole tile (the reference layer) and mZMin[1]
+// is the farthest depth of the pixels set in the mask (the working layer). Triangles
+// are merged into the working layer, and once it covers the whole tile it becomes the
+// new reference layer
+//-------------------------------------------------------------------------------------
+class MaskedDepthBuffer
+{
+	public:
+		MaskedDepthBuffer();
+		~MaskedDepthBuffer();
+
+		// Allocates the tiles for a depth buffer of the size, cleared
+		void SetSize(int width, int height);
+
+		// Pixel rectangles are half open, [startX, endX) x [startY, endY), and have 
+		// to start on a tile. A rectangle ending inside a tile covers the whole tile
+		void ClearTiles(int startX, int startY, int endX, int endY);
+		// The rows of the depth buffer are pitch floats apart
+		void ResolveToDepthBuffer(float *pDepthBuffer, int pitch, int startX, int startY, int endX, int endY) const;
+
+		// Rasterizes a triangle given its edge functions A * x + B * y + C and its depth
+		// plane z0 + zdx * x + zdy * y, both relative to (startX, startY), clipped to 
+		// the half open pixel rectangle
+		void RasterizeTriangle(const int *pA, const int *pB, const int *pC, 
+							   float z0, float zdx, float zdy, float zMin,
+							   int startX, int startY, int endX, int endY);
+
+		// Returns true if any pixel inside the inclusive pixel rectangle might be 
+		// farther than maxDepth
+		bool IsRectVisible(int startX, int startY, int endX, int endY, float maxDepth) const;
+
+	private:
+		struct Tile
+		{
+			UINT  mMask[MASKED_TILE_HEIGHT];
+			float mZMin[2];
+		};
+
+		Tile *mpTiles;
+		int mWidth;
+		int mHeight;
+		int mWidthInTiles;
+
+		void UpdateTile(Tile *pTile, const UINT *pCoverage, float zTri);
+};
+
+#endif //MASKEDDEPTHBUFFER_H
\ No newline at end of file
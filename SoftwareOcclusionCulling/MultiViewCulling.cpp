@@ -0,0 +1,202 @@
+//--------------------------------------------------------------------------------------
+// Copyright 2011 Intel Corporation
+// All Rights Reserved
+//
+// Permission is granted to use, copy, distribute and prepare derivative works of this
+// software for any purpose and without fee, provided, that the above copyright notice
+// and this statement appear in all copies.  Intel makes no representations about the
+// suitability of this software for any purpose.  THIS SOFTWARE IS PROVIDED "AS IS."
+// INTEL SPECIFICALLY DISCLAIMS ALL WARRANTIES, EXPRESS OR IMPLIED, AND ALL LIABILITY,
+// INCLUDING CONSEQUENTIAL AND OTHER INDIRECT DAMAGES, FOR THE USE OF THIS SOFTWARE,
+// INCLUDING LIABILITY FOR INFRINGEMENT OF ANY PROPRIETARY RIGHTS, AND INCLUDING THE
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  Intel does not
+// assume any responsibility for any errors which may appear in this software nor any
+// responsibility to update it.
+//
+//--------------------------------------------------------------------------------------
+
+#include "MultiViewCulling.h"
+
+MultiViewCulling::MultiViewCulling()
+	: mNumViews(0),
+	  mIsVisible(TASKSETHANDLE_INVALID),
+	  mCullTime(0.0)
+{
+	for(UINT view = 0; view < MAX_CULLING_VIEWS; view++)
+	{
+		mpDBR[view] = NULL;
+		mpAABB[view] = NULL;
+		mpCamera[view] = NULL;
+	}
+}
+
+MultiViewCulling::~MultiViewCulling()
+{
+	ReleaseViews();
+}
+
+void MultiViewCulling::ReleaseViews()
+{
+	// The first view goes last, the others share its models and boxes
+	for(UINT view = mNumViews; view-- > 0;)
+	{
+		SAFE_DELETE(mpDBR[view]);
+		SAFE_DELETE(mpAABB[view]);
+		mpCamera[view] = NULL;
+	}
+	mNumViews = 0;
+}
+
+//--------------------------------------------------------------------------------
+// Creates the rasterizers of each view. The views after the first share the
+// meshes, occluder proxies and occludee boxes of the first view, they only
+// have their own transformed vertices, bins and depth buffers
+//--------------------------------------------------------------------------------
+void MultiViewCulling::CreateViews(UINT numViews,
+								   CPUTAssetSet **pOccluderSets, UINT numOccluderSets,
+								   CPUTAssetSet **pOccludeeSets, UINT numOccludeeSets,
+								   bool useOccluderProxies, bool useOccluderLods)
+{
+	ASSERT(numViews > 0 && numViews <= MAX_CULLING_VIEWS, _L("Invalid number of views"));
+	ReleaseViews();
+
+	mNumViews = numViews;
+	for(UINT view = 0; view < mNumViews; view++)
+	{
+		mpDBR[view] = new DepthBufferRasterizerSSEMT;
+		mpDBR[view]->SetOccluderProxies(useOccluderProxies);
+		mpDBR[view]->SetOccluderLods(useOccluderLods);
+		mpDBR[view]->CreateTransformedModels(pOccluderSets, numOccluderSets, view > 0 ? mpDBR[0] : NULL);
+
+		mpAABB[view] = new AABBoxRasterizerSSEMT;
+		mpAABB[view]->CreateTransformedAABBoxes(pOccludeeSets, numOccludeeSets, view > 0 ? mpAABB[0] : NULL);
+	}
+}
+
+void MultiViewCulling::SetDepthBufferDesc(const DepthBufferDesc &desc)
+{
+	for(UINT view = 0; view < mNumViews; view++)
+	{
+		mpDBR[view]->SetDepthBufferDesc(desc);
+		mpAABB[view]->SetDepthBufferDesc(desc);
+	}
+}
+
+void MultiViewCulling::SetOccluderSizeThreshold(float occluderSizeThreshold)
+{
+	for(UINT view = 0; view < mNumViews; view++)
+	{
+		mpDBR[view]->SetOccluderSizeThreshold(occluderSizeThreshold);
+	}
+}
+
+void MultiViewCulling::SetOccludeeSizeThreshold(float occludeeSizeThreshold)
+{
+	for(UINT view = 0; view < mNumViews; view++)
+	{
+		mpAABB[view]->SetOccludeeSizeThreshold(occludeeSizeThreshold);
+	}
+}
+
+void MultiViewCulling::SetDepthTestTasks(UINT numTasks)
+{
+	for(UINT view = 0; view < mNumViews; view++)
+	{
+		mpAABB[view]->SetDepthTestTasks(numTasks);
+	}
+}
+
+void MultiViewCulling::SetCamera(UINT view, CPUTCamera *pCamera)
+{
+	ASSERT(view < mNumViews, _L("Invalid view"));
+	mpCamera[view] = pCamera;
+	mpDBR[view]->SetCamera(pCamera);
+	mpAABB[view]->SetCamera(pCamera);
+}
+
+//-------------------------------------------------------------------------------
+// Create the task set that frustum tests the models of all the views and wait
+// for it
+//-------------------------------------------------------------------------------
+void MultiViewCulling::IsVisible()
+{
+	gTaskMgr.CreateTaskSet(&MultiViewCulling::IsVisible, this, NUM_XFORMVERTS_TASKS, NULL, 0, "Is Visible", &mIsVisible);
+	// Wait for the task set
+	gTaskMgr.WaitForSet(mIsVisible);
+	// Release the task set
+	gTaskMgr.ReleaseHandle(mIsVisible);
+	mIsVisible = TASKSETHANDLE_INVALID;
+}
+
+void MultiViewCulling::IsVisible(VOID* taskData, INT context, UINT taskId, UINT taskCount)
+{
+	MultiViewCulling *pCulling = (MultiViewCulling*)taskData;
+	pCulling->IsVisible(taskId, taskCount);
+}
+
+//-------------------------------------------------------------------------------
+// Each task frustum tests a range of the occluders and of the occludees against
+// the frustums of all the views
+//-------------------------------------------------------------------------------
+void MultiViewCulling::IsVisible(UINT taskId, UINT taskCount)
+{
+	UINT numOccluders = mpDBR[0]->GetNumOccluders();
+	UINT occludersPerTask = (numOccluders + taskCount - 1) / taskCount;
+	UINT occluderStart = min(taskId * occludersPerTask, numOccluders);
+	UINT occluderEnd = min(occluderStart + occludersPerTask, numOccluders);
+
+	UINT numOccludees = mpAABB[0]->GetNumOccludees();
+	UINT occludeesPerTask = (numOccludees + taskCount - 1) / taskCount;
+	UINT occludeeStart = min(taskId * occludeesPerTask, numOccludees);
+	UINT occludeeEnd = min(occludeeStart + occludeesPerTask, numOccludees);
+
+	for(UINT view = 0; view < mNumViews; view++)
+	{
+		mpDBR[view]->CalcInsideFrustum(mpCamera[view], occluderStart, occluderEnd);
+		mpAABB[view]->CalcInsideFrustum(&mpCamera[view]->mFrustum, occludeeStart, occludeeEnd);
+	}
+}
+
+//-------------------------------------------------------------------------------
+// Creates the occluder pass of every view and then the occludee pass of every
+// view, each waiting only for the depth buffer strips of its own view, before
+// waiting for any of them. When the task sets of all the views don't fit in the
+// task manager, the views run in groups that do, one group after another
+//-------------------------------------------------------------------------------
+void MultiViewCulling::TransformModelsAndDepthTest()
+{
+	mCullTimer.StartTimer();
+
+	UINT numViewTaskSets = mpDBR[0]->GetNumPassTaskSets() + mpAABB[0]->GetNumPassTaskSets();
+	UINT numGroupViews = max(MAX_TASKSETS / numViewTaskSets, (UINT)1);
+	for(UINT firstView = 0; firstView < mNumViews; firstView += numGroupViews)
+	{
+		UINT endView = min(firstView + numGroupViews, mNumViews);
+		for(UINT view = firstView; view < endView; view++)
+		{
+			float4x4 *pViewMatrix = mpCamera[view]->GetViewMatrix();
+			float4x4 *pProjMatrix = (float4x4*)mpCamera[view]->GetProjectionMatrix();
+			mpDBR[view]->SetViewProj(pViewMatrix, pProjMatrix);
+			mpDBR[view]->CreateTransformModelsAndRasterizeTasks();
+			mpAABB[view]->SetViewProjMatrix(pViewMatrix, pProjMatrix);
+		}
+
+		for(UINT view = firstView; view < endView; view++)
+		{
+			mpAABB[view]->SetCPURenderTargetPixels(mpDBR[view]->GetCPURenderTargetPixels());
+			mpAABB[view]->SetHiZBuffer(mpDBR[view]->GetHiZBuffer());
+			mpAABB[view]->SetTileTriangleCounts(mpDBR[view]->GetTileTriangleCounts());
+			mpAABB[view]->SetDepthStripsDone(mpDBR[view]->GetDepthStripsDone());
+			mpAABB[view]->StartTransformAABBoxAndDepthTest();
+		}
+
+		for(UINT view = firstView; view < endView; view++)
+		{
+			mpAABB[view]->WaitForDepthTest();
+			mpAABB[view]->SetDepthStripsDone(NULL);
+			mpDBR[view]->WaitForDepthBuffer();
+		}
+	}
+
+	mCullTime = mCullTimer.StopTimer();
+}
@@ -0,0 +1,81 @@
+//--------------------------------------------------------------------------------------
+// Copyright 2011 Intel Corporation
+// All Rights Reserved
+//
+// Permission is granted to use, copy, distribute and prepare derivative works of this
+// software for any purpose and without fee, provided, that the above copyright notice
+// and this statement appear in all copies.  Intel makes no representations about the
+// suitability of this software for any purpose.  THIS SOFTWARE IS PROVIDED "AS IS."
+// INTEL SPECIFICALLY DISCLAIMS ALL WARRANTIES, EXPRESS OR IMPLIED, AND ALL LIABILITY,
+// INCLUDING CONSEQUENTIAL AND OTHER INDIRECT DAMAGES, FOR THE USE OF THIS SOFTWARE,
+// INCLUDING LIABILITY FOR INFRINGEMENT OF ANY PROPRIETARY RIGHTS, AND INCLUDING THE
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  Intel does not
+// assume any responsibility for any errors which may appear in this software nor any
+// responsibility to update it.
+//
+//--------------------------------------------------------------------------------------
+
+#ifndef MULTIVIEWCULLING_H
+#define MULTIVIEWCULLING_H
+
+#include "DepthBufferRasterizerSSEMT.h"
+#include "AABBoxRasterizerSSEMT.h"
+
+//-------------------------------------------------------------------------------
+// Occlusion culls the same occluders and occludees for several views, each with
+// its own view and projection matrices, depth buffer and occludee visibility. The
+// views share the occluder meshes and proxies and the occludee boxes. The frustum
+// test of all the views is one task set over the models, and the occluder and
+// occludee passes of all the views are created as one graph of dependent task sets
+// that is waited for once at the end, so that the views run side by side instead
+// of one after another. At sizes where the task sets of all the views don't fit in
+// the task manager, the views run in groups. Uses the SSE multi-threaded rasterizers
+//-------------------------------------------------------------------------------
+class MultiViewCulling
+{
+	public:
+		MultiViewCulling();
+		~MultiViewCulling();
+
+		// Creates numViews views, up to MAX_CULLING_VIEWS, of the occluder and occludee asset sets
+		void CreateViews(UINT numViews,
+						 CPUTAssetSet **pOccluderSets, UINT numOccluderSets,
+						 CPUTAssetSet **pOccludeeSets, UINT numOccludeeSets,
+						 bool useOccluderProxies, bool useOccluderLods);
+
+		void SetDepthBufferDesc(const DepthBufferDesc &desc);
+		void SetOccluderSizeThreshold(float occluderSizeThreshold);
+		void SetOccludeeSizeThreshold(float occludeeSizeThreshold);
+		void SetDepthTestTasks(UINT numTasks);
+
+		// The camera of a view gives its frustum and field of view, and its view and
+		// projection matrices when the occluders are rasterized
+		void SetCamera(UINT view, CPUTCamera *pCamera);
+
+		// Frustum tests the occluders and occludees against the cameras of all the views
+		void IsVisible();
+		// Rasterizes the occluders and depth tests the occludees of all the views
+		void TransformModelsAndDepthTest();
+
+		inline UINT GetNumViews() {return mNumViews;}
+		inline DepthBufferRasterizerSSEMT* GetDepthBufferRasterizer(UINT view) {return mpDBR[view];}
+		inline AABBoxRasterizerSSEMT* GetAABBoxRasterizer(UINT view) {return mpAABB[view];}
+		// Time the last TransformModelsAndDepthTest() took for all the views
+		inline double GetCullTime() {return mCullTime;}
+
+	private:
+		UINT mNumViews;
+		DepthBufferRasterizerSSEMT *mpDBR[MAX_CULLING_VIEWS];
+		AABBoxRasterizerSSEMT *mpAABB[MAX_CULLING_VIEWS];
+		CPUTCamera *mpCamera[MAX_CULLING_VIEWS];
+		TASKSETHANDLE mIsVisible;
+		double mCullTime;
+		CPUTTimerWin mCullTimer;
+
+		void ReleaseViews();
+
+		static void IsVisible(VOID* taskData, INT context, UINT taskId, UINT taskCount);
+		void IsVisible(UINT taskId, UINT taskCount);
+};
+
+#endif //MULTIVIEWCULLING_H
@@ -0,0 +1,418 @@
+//--------------------------------------------------------------------------------------
+// Copyright 2011 Intel Corporation
+// All Rights Reserved
+//
+// Permission is granted to use, copy, distribute and prepare derivative works of this
+// software for any purpose and without fee, provided, that the above copyright notice
+// and this statement appear in all copies.  Intel makes no representations about the
+// suitability of this software for any purpose.  THIS SOFTWARE IS PROVIDED "AS IS."
+// INTEL SPECIFICALLY DISCLAIMS ALL WARRANTIES, EXPRESS OR IMPLIED, AND ALL LIABILITY,
+// INCLUDING CONSEQUENTIAL AND OTHER INDIRECT DAMAGES, FOR THE USE OF THIS SOFTWARE,
+// INCLUDING LIABILITY FOR INFRINGEMENT OF ANY PROPRIETARY RIGHTS, AND INCLUDING THE
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  Intel does not
+// assume any responsibility for any errors which may appear in this software nor any
+// responsibility to update it.
+//
+//--------------------------------------------------------------------------------------
+
+#include "OccluderProxy.h"
+#include <float.h>
+#include <fstream>
+
+// Cache file header, followed by the vertex positions and the indices
+struct OccluderProxyHeader
+{
+	UINT mMagic;
+	UINT mVersion;
+	UINT mNumSourceVertices;
+	UINT mNumSourceTriangles;
+	UINT mNumVertices;
+	UINT mNumTriangles;
+};
+
+static const UINT OCCLUDER_PROXY_MAGIC = 0x5043434F; // "OCCP"
+static const UINT OCCLUDER_PROXY_VERSION = 2;
+
+// The grid has one empty voxel all around the bounding box for the flood fill
+static const int GRID_SIZE = OCCLUDER_PROXY_GRID + 2;
+
+static inline UINT VoxelIndex(int x, int y, int z)
+{
+	return (z * GRID_SIZE + y) * GRID_SIZE + x;
+}
+
+// Box corners are numbered with x in bit 0, y in bit 1 and z in bit 2. Each face
+// is clockwise seen from outside the box, like the front faces of the models
+static const UINT BOX_INDICES[36] =
+{
+	0, 2, 3,  0, 3, 1,	// -z
+	4, 5, 7,  4, 7, 6,	// +z
+	4, 6, 2,  4, 2, 0,	// -x
+	1, 3, 7,  1, 7, 5,	// +x
+	1, 5, 4,  1, 4, 0,	// -y
+	2, 6, 7,  2, 7, 3,	// +y
+};
+
+OccluderProxy::OccluderProxy()
+	: mNumSourceVertices(0),
+	  mNumSourceTriangles(0),
+	  mNumVertices(0),
+	  mNumTriangles(0),
+	  mpVertices(NULL),
+	  mpIndices(NULL)
+{
+
+}
+
+OccluderProxy::~OccluderProxy()
+{
+	SAFE_DELETE_ARRAY(mpVertices);
+	SAFE_DELETE_ARRAY(mpIndices);
+}
+
+//-------------------------------------------------------------------------------
+// The cache file has the name of the .mdl file with the .occ extension. It is
+// only used when it was built from a model with the same vertex and triangle
+// counts, otherwise the proxy is built again and the file is overwritten
+//-------------------------------------------------------------------------------
+void OccluderProxy::Create(CPUTModelDX11 *pModel)
+{
+	mNumSourceVertices = mNumSourceTriangles = 0;
+	for(int i = 0; i < pModel->GetMeshCount(); i++)
+	{
+		CPUTMeshDX11 *pMesh = (CPUTMeshDX11*)pModel->GetMesh(i);
+		mNumSourceVertices += pMesh->GetVertexCount();
+		mNumSourceTriangles += pMesh->GetTriangleCount();
+	}
+
+	cString fileName = pModel->GetModelFileName();
+	size_t extension = fileName.rfind(_L('.'));
+	fileName = fileName.substr(0, extension) + _L(".occ");
+
+	if(!Load(fileName))
+	{
+		Build(pModel);
+		Save(fileName);
+
+		// A model without a proxy keeps its source triangles and shows 0 proxy triangles
+		wchar_t string[CPUT_MAX_STRING_LENGTH];
+		swprintf_s(&string[0], CPUT_MAX_STRING_LENGTH, _L("Occluder proxy %s: %d source triangles, %d proxy triangles in %d boxes\n"),
+				   fileName.c_str(), mNumSourceTriangles, mNumTriangles, GetNumBoxes());
+		TRACE(string);
+	}
+}
+
+bool OccluderProxy::Load(const cString &fileName)
+{
+	std::ifstream file(fileName.c_str(), std::ios::in | std::ios::binary);
+	if(file.fail())
+	{
+		return false;
+	}
+
+	OccluderProxyHeader header;
+	file.read((char*)&header, sizeof(header));
+	if(file.fail() ||
+	   header.mMagic != OCCLUDER_PROXY_MAGIC ||
+	   header.mVersion != OCCLUDER_PROXY_VERSION ||
+	   header.mNumSourceVertices != mNumSourceVertices ||
+	   header.mNumSourceTriangles != mNumSourceTriangles)
+	{
+		return false;
+	}
+
+	mNumVertices = header.mNumVertices;
+	mNumTriangles = header.mNumTriangles;
+	mpVertices = new float3[mNumVertices];
+	mpIndices = new UINT[mNumTriangles * 3];
+	file.read((char*)mpVertices, sizeof(float3) * mNumVertices);
+	file.read((char*)mpIndices, sizeof(UINT) * mNumTriangles * 3);
+	if(file.fail())
+	{
+		SAFE_DELETE_ARRAY(mpVertices);
+		SAFE_DELETE_ARRAY(mpIndices);
+		mNumVertices = mNumTriangles = 0;
+		return false;
+	}
+	return true;
+}
+
+// Models without a proxy are written too so that they are not voxelized again
+void OccluderProxy::Save(const cString &fileName)
+{
+	std::ofstream file(fileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if(file.fail())
+	{
+		return;
+	}
+
+	OccluderProxyHeader header = {OCCLUDER_PROXY_MAGIC, OCCLUDER_PROXY_VERSION, mNumSourceVertices, mNumSourceTriangles, mNumVertices, mNumTriangles};
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)mpVertices, sizeof(float3) * mNumVertices);
+	file.write((const char*)mpIndices, sizeof(UINT) * mNumTriangles * 3);
+}
+
+//-------------------------------------------------------------------------------
+// Voxelizes the model over its bounding box and keeps the biggest boxes merged
+// from the interior voxels, from the biggest to the smallest
+//-------------------------------------------------------------------------------
+void OccluderProxy::Build(CPUTModelDX11 *pModel)
+{
+	float3 minPos(FLT_MAX), maxPos(-FLT_MAX);
+	for(int i = 0; i < pModel->GetMeshCount(); i++)
+	{
+		CPUTMeshDX11 *pMesh = (CPUTMeshDX11*)pModel->GetMesh(i);
+		Vertex *pVertices = pMesh->GetVertices();
+		for(UINT v = 0; v < pMesh->GetVertexCount(); v++)
+		{
+			for(int axis = 0; axis < 3; axis++)
+			{
+				minPos.f[axis] = min(minPos.f[axis], pVertices[v].pos.f[axis]);
+				maxPos.f[axis] = max(maxPos.f[axis], pVertices[v].pos.f[axis]);
+			}
+		}
+	}
+
+	// A flat model has no interior
+	float3 voxelSize = (maxPos - minPos) * (1.0f / OCCLUDER_PROXY_GRID);
+	if(mNumSourceTriangles == 0 || voxelSize.x <= 0.0f || voxelSize.y <= 0.0f || voxelSize.z <= 0.0f)
+	{
+		return;
+	}
+
+	unsigned char *pVoxels = new unsigned char[GRID_SIZE * GRID_SIZE * GRID_SIZE];
+	memset(pVoxels, VOXEL_EMPTY, GRID_SIZE * GRID_SIZE * GRID_SIZE);
+
+	MarkSurface(pModel, pVoxels, minPos, voxelSize);
+	FloodOutside(pVoxels);
+
+	Box *pBoxes = new Box[OCCLUDER_PROXY_GRID * OCCLUDER_PROXY_GRID * OCCLUDER_PROXY_GRID];
+	UINT numBoxes = MergeInterior(pVoxels, pBoxes);
+	qsort(pBoxes, numBoxes, sizeof(Box), CompareBoxes);
+	numBoxes = min(numBoxes, (UINT)OCCLUDER_PROXY_MAX_BOXES);
+
+	if(numBoxes > 0)
+	{
+		mpVertices = new float3[numBoxes * 8];
+		mpIndices = new UINT[numBoxes * 36];
+		for(UINT i = 0; i < numBoxes; i++)
+		{
+			AddBox(pBoxes[i], minPos, voxelSize);
+		}
+	}
+
+	SAFE_DELETE_ARRAY(pBoxes);
+	SAFE_DELETE_ARRAY(pVoxels);
+}
+
+//-------------------------------------------------------------------------------
+// Marks the voxels each triangle may touch: the voxels in the bounding box of the
+// triangle that its plane goes through. This marks a few voxels near the edges
+// that the triangle misses, which only makes the interior smaller
+//-------------------------------------------------------------------------------
+void OccluderProxy::MarkSurface(CPUTModelDX11 *pModel, unsigned char *pVoxels, float3 gridMin, float3 voxelSize)
+{
+	for(int i = 0; i < pModel->GetMeshCount(); i++)
+	{
+		CPUTMeshDX11 *pMesh = (CPUTMeshDX11*)pModel->GetMesh(i);
+		Vertex *pVertices = pMesh->GetVertices();
+		UINT *pIndices = pMesh->GetIndices();
+		for(UINT t = 0; t < pMesh->GetTriangleCount(); t++)
+		{
+			float3 p0 = pVertices[pIndices[t * 3 + 0]].pos;
+			float3 p1 = pVertices[pIndices[t * 3 + 1]].pos;
+			float3 p2 = pVertices[pIndices[t * 3 + 2]].pos;
+			float3 normal = cross3(p1 - p0, p2 - p0);
+			float offset = dot3(normal, p0);
+
+			// The voxel range is widened by a hundredth of a voxel and the plane test by a
+			// hundredth of the radius so that rounding never leaves a touched voxel out
+			int start[3], end[3];
+			float radius = 0.0f;
+			for(int axis = 0; axis < 3; axis++)
+			{
+				float lo = min(p0.f[axis], min(p1.f[axis], p2.f[axis]));
+				float hi = max(p0.f[axis], max(p1.f[axis], p2.f[axis]));
+				start[axis] = max((int)floorf((lo - gridMin.f[axis]) / voxelSize.f[axis] - 0.01f) + 1, 1);
+				end[axis] = min((int)floorf((hi - gridMin.f[axis]) / voxelSize.f[axis] + 0.01f) + 1, OCCLUDER_PROXY_GRID);
+				radius += 0.5f * fabsf(normal.f[axis]) * voxelSize.f[axis];
+			}
+			radius *= 1.01f;
+
+			for(int z = start[2]; z <= end[2]; z++)
+			{
+				for(int y = start[1]; y <= end[1]; y++)
+				{
+					for(int x = start[0]; x <= end[0]; x++)
+					{
+						float3 center = gridMin + voxelSize * float3(x - 0.5f, y - 0.5f, z - 0.5f);
+						if(fabsf(dot3(normal, center) - offset) <= radius)
+						{
+							pVoxels[VoxelIndex(x, y, z)] = VOXEL_SURFACE;
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+//-------------------------------------------------------------------------------
+// Flood fills the voxels reachable from the border of the grid without crossing
+// the surface. A path between face neighbours that leaves a closed surface has to
+// go through a voxel the surface touches, so what is left is inside the model
+//-------------------------------------------------------------------------------
+void OccluderProxy::FloodOutside(unsigned char *pVoxels)
+{
+	UINT *pStack = new UINT[GRID_SIZE * GRID_SIZE * GRID_SIZE];
+	UINT stackSize = 0;
+
+	for(int z = 0; z < GRID_SIZE; z++)
+	{
+		for(int y = 0; y < GRID_SIZE; y++)
+		{
+			for(int x = 0; x < GRID_SIZE; x++)
+			{
+				bool border = x == 0 || y == 0 || z == 0 || x == GRID_SIZE - 1 || y == GRID_SIZE - 1 || z == GRID_SIZE - 1;
+				if(border)
+				{
+					pVoxels[VoxelIndex(x, y, z)] = VOXEL_OUTSIDE;
+					pStack[stackSize++] = VoxelIndex(x, y, z);
+				}
+			}
+		}
+	}
+
+	static const int neighbours[6][3] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+	while(stackSize > 0)
+	{
+		UINT voxel = pStack[--stackSize];
+		int x = voxel % GRID_SIZE;
+		int y = (voxel / GRID_SIZE) % GRID_SIZE;
+		int z = voxel / (GRID_SIZE * GRID_SIZE);
+		for(int i = 0; i < 6; i++)
+		{
+			int nx = x + neighbours[i][0];
+			int ny = y + neighbours[i][1];
+			int nz = z + neighbours[i][2];
+			if(nx < 0 || ny < 0 || nz < 0 || nx >= GRID_SIZE || ny >= GRID_SIZE || nz >= GRID_SIZE)
+			{
+				continue;
+			}
+			UINT neighbour = VoxelIndex(nx, ny, nz);
+			if(pVoxels[neighbour] == VOXEL_EMPTY)
+			{
+				pVoxels[neighbour] = VOXEL_OUTSIDE;
+				pStack[stackSize++] = neighbour;
+			}
+		}
+	}
+
+	for(UINT i = 0; i < GRID_SIZE * GRID_SIZE * GRID_SIZE; i++)
+	{
+		if(pVoxels[i] == VOXEL_EMPTY)
+		{
+			pVoxels[i] = VOXEL_INTERIOR;
+		}
+	}
+	SAFE_DELETE_ARRAY(pStack);
+}
+
+// True when all the voxels in the inclusive range are interior voxels not merged yet
+bool OccluderProxy::IsInterior(const unsigned char *pVoxels, const int *pMin, const int *pMax)
+{
+	for(int z = pMin[2]; z <= pMax[2]; z++)
+	{
+		for(int y = pMin[1]; y <= pMax[1]; y++)
+		{
+			for(int x = pMin[0]; x <= pMax[0]; x++)
+			{
+				if(pVoxels[VoxelIndex(x, y, z)] != VOXEL_INTERIOR)
+				{
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+//-------------------------------------------------------------------------------
+// Greedily merges the interior voxels in boxes. Each box starts at the first
+// interior voxel left and grows as far as it can along x, then y, then z
+//-------------------------------------------------------------------------------
+UINT OccluderProxy::MergeInterior(unsigned char *pVoxels, Box *pBoxes)
+{
+	UINT numBoxes = 0;
+	for(int z = 1; z <= OCCLUDER_PROXY_GRID; z++)
+	{
+		for(int y = 1; y <= OCCLUDER_PROXY_GRID; y++)
+		{
+			for(int x = 1; x <= OCCLUDER_PROXY_GRID; x++)
+			{
+				if(pVoxels[VoxelIndex(x, y, z)] != VOXEL_INTERIOR)
+				{
+					continue;
+				}
+
+				Box box = {{x, y, z}, {x, y, z}, 0};
+				for(int axis = 0; axis < 3; axis++)
+				{
+					while(box.mMax[axis] < OCCLUDER_PROXY_GRID)
+					{
+						int sliceMin[3] = {box.mMin[0], box.mMin[1], box.mMin[2]};
+						int sliceMax[3] = {box.mMax[0], box.mMax[1], box.mMax[2]};
+						sliceMin[axis] = sliceMax[axis] = box.mMax[axis] + 1;
+						if(!IsInterior(pVoxels, sliceMin, sliceMax))
+						{
+							break;
+						}
+						box.mMax[axis]++;
+					}
+				}
+
+				for(int bz = box.mMin[2]; bz <= box.mMax[2]; bz++)
+				{
+					for(int by = box.mMin[1]; by <= box.mMax[1]; by++)
+					{
+						for(int bx = box.mMin[0]; bx <= box.mMax[0]; bx++)
+						{
+							pVoxels[VoxelIndex(bx, by, bz)] = VOXEL_MERGED;
+						}
+					}
+				}
+				box.mVolume = (box.mMax[0] - box.mMin[0] + 1) * (box.mMax[1] - box.mMin[1] + 1) * (box.mMax[2] - box.mMin[2] + 1);
+				pBoxes[numBoxes++] = box;
+			}
+		}
+	}
+	return numBoxes;
+}
+
+void OccluderProxy::AddBox(const Box &box, float3 gridMin, float3 voxelSize)
+{
+	for(UINT i = 0; i < 36; i++)
+	{
+		mpIndices[mNumTriangles * 3 + i] = mNumVertices + BOX_INDICES[i];
+	}
+	mNumTriangles += 12;
+
+	// Voxel i covers gridMin + (i - 1) * voxelSize to gridMin + i * voxelSize
+	for(UINT corner = 0; corner < 8; corner++)
+	{
+		for(int axis = 0; axis < 3; axis++)
+		{
+			int voxel = (corner >> axis) & 1 ? box.mMax[axis] : box.mMin[axis] - 1;
+			mpVertices[mNumVertices].f[axis] = gridMin.f[axis] + voxel * voxelSize.f[axis];
+		}
+		mNumVertices++;
+	}
+}
+
+// Orders the boxes from the biggest to the smallest
+int OccluderProxy::CompareBoxes(const void *pBox0, const void *pBox1)
+{
+	UINT volume0 = ((const Box*)pBox0)->mVolume;
+	UINT volume1 = ((const Box*)pBox1)->mVolume;
+	return volume0 > volume1 ? -1 : (volume0 < volume1 ? 1 : 0);
+}
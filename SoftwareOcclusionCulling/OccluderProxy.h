@@ -0,0 +1,87 @@
+//--------------------------------------------------------------------------------------
+// Copyright 2011 Intel Corporation
+// All Rights Reserved
+//
+// Permission is granted to use, copy, distribute and prepare derivative works of this
+// software for any purpose and without fee, provided, that the above copyright notice
+// and this statement appear in all copies.  Intel makes no representations about the
+// suitability of this software for any purpose.  THIS SOFTWARE IS PROVIDED "AS IS."
+// INTEL SPECIFICALLY DISCLAIMS ALL WARRANTIES, EXPRESS OR IMPLIED, AND ALL LIABILITY,
+// INCLUDING CONSEQUENTIAL AND OTHER INDIRECT DAMAGES, FOR THE USE OF THIS SOFTWARE,
+// INCLUDING LIABILITY FOR INFRINGEMENT OF ANY PROPRIETARY RIGHTS, AND INCLUDING THE
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  Intel does not
+// assume any responsibility for any errors which may appear in this software nor any
+// responsibility to update it.
+//
+//--------------------------------------------------------------------------------------
+
+#ifndef OCCLUDERPROXY_H
+#define OCCLUDERPROXY_H
+
+#include "CPUT_DX11.h"
+#include "Constants.h"
+
+//-------------------------------------------------------------------------------
+// Simplified occluder mesh made of boxes that lie inside the occluder model, so it
+// never occludes more than the model does. The model is voxelized in object space,
+// the voxels the surface touches and the ones reachable from outside the bounding
+// box are removed and the remaining interior voxels are merged in boxes. Models
+// that are not closed have no interior and get no proxy. The boxes are sorted from
+// the biggest to the smallest, the first boxes are the 8 vertices and 12 triangles
+// of a coarser proxy. The proxy is cached in a file next to the .mdl and rebuilt
+// when the model's triangle count changes. The views that cull the same model
+// share its proxy, it is released rather than deleted
+//-------------------------------------------------------------------------------
+class OccluderProxy : public CPUTRefCount
+{
+	public:
+		OccluderProxy();
+
+		// Loads the proxy from the cache file or builds it and writes the cache file
+		void Create(CPUTModelDX11 *pModel);
+
+		inline UINT GetNumVertices() {return mNumVertices;}
+		inline UINT GetNumTriangles() {return mNumTriangles;}
+		inline UINT GetNumBoxes() {return mNumTriangles / 12;}
+		inline float3 *GetVertices() {return mpVertices;}
+		inline UINT *GetIndices() {return mpIndices;}
+
+	protected:
+		~OccluderProxy();
+
+	private:
+		struct Box
+		{
+			int mMin[3];
+			int mMax[3];		// inclusive voxel range
+			UINT mVolume;
+		};
+
+		enum VOXEL_STATE
+		{
+			VOXEL_EMPTY,
+			VOXEL_SURFACE,
+			VOXEL_OUTSIDE,
+			VOXEL_INTERIOR,
+			VOXEL_MERGED,
+		};
+
+		UINT mNumSourceVertices;
+		UINT mNumSourceTriangles;
+		UINT mNumVertices;
+		UINT mNumTriangles;
+		float3 *mpVertices;
+		UINT *mpIndices;
+
+		bool Load(const cString &fileName);
+		void Save(const cString &fileName);
+		void Build(CPUTModelDX11 *pModel);
+		void MarkSurface(CPUTModelDX11 *pModel, unsigned char *pVoxels, float3 gridMin, float3 voxelSize);
+		void FloodOutside(unsigned char *pVoxels);
+		UINT MergeInterior(unsigned char *pVoxels, Box *pBoxes);
+		static bool IsInterior(const unsigned char *pVoxels, const int *pMin, const int *pMax);
+		void AddBox(const Box &box, float3 gridMin, float3 voxelSize);
+		static int CompareBoxes(const void *pBox0, const void *pBox1);
+};
+
+#endif //OCCLUDERPROXY_H
@@ -47,9 +47,42 @@ void MySample::Create()
     pGUI->CreateButton(_L("Fullscreen"), ID_FULLSCREEN_BUTTON, ID_MAIN_PANEL, &pButton);
 	pGUI->CreateDropdown( L"Rasterizer Technique: SCALAR", ID_RASTERIZE_TYPE, ID_MAIN_PANEL, &mpTypeDropDown);
     mpTypeDropDown->AddSelectionItem( L"Rasterizer Technique: SSE" );
+    mpTypeDropDown->AddSelectionItem( L"Rasterizer Technique: Masked" );
+	if(HelperSSE::IsAVX2Supported())
+	{
+		mpTypeDropDown->AddSelectionItem( L"Rasterizer Technique: AVX2" );
+	}
    	mpTypeDropDown->SetSelectedItem(mSOCType + 1);
    
 	wchar_t string[CPUT_MAX_STRING_LENGTH];
+	for(UINT i = 0; i < NUM_DEPTH_BUFFER_SIZES; i++)
+	{
+		swprintf_s(&string[0], CPUT_MAX_STRING_LENGTH, _L("Depth Buffer: %dx%d"), DEPTH_BUFFER_SIZES[i][0], DEPTH_BUFFER_SIZES[i][1]);
+		if(i == 0)
+		{
+			pGUI->CreateDropdown(string, ID_DEPTH_BUFFER_SIZE, ID_MAIN_PANEL, &mpResolutionDropDown);
+		}
+		else
+		{
+			mpResolutionDropDown->AddSelectionItem(string);
+		}
+	}
+	mpResolutionDropDown->SetSelectedItem(mDepthBufferSize + 1);
+
+	for(UINT i = 0; i < NUM_DEPTH_BUFFER_LAYOUTS; i++)
+	{
+		swprintf_s(&string[0], CPUT_MAX_STRING_LENGTH, _L("Depth Buffer Layout: %s"), DEPTH_BUFFER_LAYOUT_NAMES[i]);
+		if(i == 0)
+		{
+			pGUI->CreateDropdown(string, ID_DEPTH_BUFFER_LAYOUT, ID_MAIN_PANEL, &mpLayoutDropDown);
+		}
+		else
+		{
+			mpLayoutDropDown->AddSelectionItem(string);
+		}
+	}
+	mpLayoutDropDown->SetSelectedItem(mDepthBufferLayout + 1);
+
     pGUI->CreateText(    _L("Occluders                                              \t"), ID_OCCLUDERS, ID_MAIN_PANEL, &mpOccludersText);
 	
 	swprintf_s(&string[0], CPUT_MAX_STRING_LENGTH, _L("\tNumber of Models: \t%d"), mNumOccluders);
@@ -72,6 +105,18 @@ void MySample::Create()
 	mpOccluderSizeSlider->SetScale(0, 5.0, 51);
 	mpOccluderSizeSlider->SetValue(mOccluderSizeThreshold);
 	mpOccluderSizeSlider->SetTickDrawing(false);
+
+	swprintf_s(&string[0], CPUT_MAX_STRING_LENGTH, _L("Occluder Tri Budget: %d"), mOccluderTriBudget);
+	pGUI->CreateSlider(string, ID_OCCLUDER_TRI_BUDGET, ID_MAIN_PANEL, &mpOccluderTriBudgetSlider);
+	mpOccluderTriBudgetSlider->SetScale(0, 100000.0f, 41);
+	mpOccluderTriBudgetSlider->SetValue((float)mOccluderTriBudget);
+	mpOccluderTriBudgetSlider->SetTickDrawing(false);
+
+	swprintf_s(&string[0], CPUT_MAX_STRING_LENGTH, _L("Occluder Time Budget: %0.2f ms"), mOccluderTimeBudget);
+	pGUI->CreateSlider(string, ID_OCCLUDER_TIME_BUDGET, ID_MAIN_PANEL, &mpOccluderTimeBudgetSlider);
+	mpOccluderTimeBudgetSlider->SetScale(0, 5.0f, 41);
+	mpOccluderTimeBudgetSlider->SetValue(mOccluderTimeBudget);
+	mpOccluderTimeBudgetSlider->SetTickDrawing(false);
     
 	pGUI->CreateText(_L("Occludees                                              \t"), ID_OCCLUDEES, ID_MAIN_PANEL, &mpOccludeesText);
 
@@ -96,6 +141,9 @@ void MySample::Create()
 	swprintf_s(&string[0], CPUT_MAX_STRING_LENGTH, _L("\tVisible Triangles: \t%0.2f ms"), mDepthTestTime);
 	pGUI->CreateText(string, ID_DEPTHTEST_TIME, ID_MAIN_PANEL, &mpDepthTestTimeText);
 
+	swprintf_s(&string[0], CPUT_MAX_STRING_LENGTH, _L("\tShadow casters culled: %d"), mNumShadowCulled);
+	pGUI->CreateText(string, ID_NUM_SHADOW_CULLED, ID_MAIN_PANEL, &mpShadowCulledText);
+
 	swprintf_s(&string[0], CPUT_MAX_STRING_LENGTH, _L("Occludee Size Threshold: %0.4f"), mOccludeeSizeThreshold);
 	pGUI->CreateSlider(string, ID_OCCLUDEE_SIZE, ID_MAIN_PANEL, &mpOccludeeSizeSlider);
 	mpOccludeeSizeSlider->SetScale(0, 0.1f, 41);
@@ -104,6 +152,11 @@ void MySample::Create()
 
 	pGUI->CreateCheckbox(_L("Depth Test Culling"),  ID_ENABLE_CULLING, ID_MAIN_PANEL, &mpCullingCheckBox);
 	pGUI->CreateCheckbox(_L("Frustum Culling"),  ID_ENABLE_FCULLING, ID_MAIN_PANEL, &mpFCullingCheckBox);
+	pGUI->CreateCheckbox(_L("Near Plane Clipping"),  ID_NEAR_CLIP, ID_MAIN_PANEL, &mpNearClipCheckBox);
+	pGUI->CreateCheckbox(_L("Occluder Proxies"),  ID_OCCLUDER_PROXIES, ID_MAIN_PANEL, &mpOccluderProxyCheckBox);
+	pGUI->CreateCheckbox(_L("Occluder LODs"),  ID_OCCLUDER_LODS, ID_MAIN_PANEL, &mpOccluderLodCheckBox);
+	pGUI->CreateCheckbox(_L("Depth Reprojection"),  ID_DEPTH_REPROJECTION, ID_MAIN_PANEL, &mpReprojectionCheckBox);
+	pGUI->CreateCheckbox(_L("Shadow Caster Culling"),  ID_SHADOW_CULLING, ID_MAIN_PANEL, &mpShadowCullingCheckBox);
 	pGUI->CreateCheckbox(_L("View Depth Buffer"),  ID_DEPTH_BUFFER_VISIBLE, ID_MAIN_PANEL, &mpDBCheckBox);
 	pGUI->CreateCheckbox(_L("View Bounding Box"),  ID_BOUNDING_BOX_VISIBLE, ID_MAIN_PANEL, &mpBBCheckBox);
 	pGUI->CreateCheckbox(_L("Multi Tasking"), ID_ENABLE_TASKS, ID_MAIN_PANEL, &mpTasksCheckBox);
@@ -215,6 +268,9 @@ void MySample::Create()
 
 	// For every occluder model in the sene create a place holder 
 	// for the CPU transformed vertices of the model.   
+	mpDBR->SetOccluderProxies(mUseOccluderProxies);
+	mpDBR->SetOccluderLods(mUseOccluderLods);
+	mpDBR->SetDepthReprojection(mUseDepthReprojection);
 	mpDBR->CreateTransformedModels(mpAssetSetDBR, OCCLUDER_SETS);
 	// Get number of occluders in the scene
 	mNumOccluders = mpDBR->GetNumOccluders();
@@ -267,6 +323,56 @@ void MySample::Create()
 	}
 	mpFCullingCheckBox->SetCheckboxState(state);
 
+	if(mDepthBufferDesc.mClipNearPlane)
+	{
+		state = CPUT_CHECKBOX_CHECKED;
+	}
+	else 
+	{
+		state = CPUT_CHECKBOX_UNCHECKED;
+	}
+	mpNearClipCheckBox->SetCheckboxState(state);
+
+	if(mUseOccluderProxies)
+	{
+		state = CPUT_CHECKBOX_CHECKED;
+	}
+	else 
+	{
+		state = CPUT_CHECKBOX_UNCHECKED;
+	}
+	mpOccluderProxyCheckBox->SetCheckboxState(state);
+
+	if(mUseOccluderLods)
+	{
+		state = CPUT_CHECKBOX_CHECKED;
+	}
+	else 
+	{
+		state = CPUT_CHECKBOX_UNCHECKED;
+	}
+	mpOccluderLodCheckBox->SetCheckboxState(state);
+
+	if(mUseDepthReprojection)
+	{
+		state = CPUT_CHECKBOX_CHECKED;
+	}
+	else 
+	{
+		state = CPUT_CHECKBOX_UNCHECKED;
+	}
+	mpReprojectionCheckBox->SetCheckboxState(state);
+
+	if(mCullShadowCasters)
+	{
+		state = CPUT_CHECKBOX_CHECKED;
+	}
+	else 
+	{
+		state = CPUT_CHECKBOX_UNCHECKED;
+	}
+	mpShadowCullingCheckBox->SetCheckboxState(state);
+
 	if(mViewDepthBuffer)
 	{
 		state = CPUT_CHECKBOX_CHECKED;
@@ -299,6 +405,7 @@ void MySample::Create()
 
 	// Setting occluder size threshold in DepthBufferRasterizer
 	mpDBR->SetOccluderSizeThreshold(mOccluderSizeThreshold);
+	mpDBR->SetOccluderBudget(mOccluderTriBudget, mOccluderTimeBudget / 1000.0f);
 	// Setting occludee size threshold in AABBoxRasterizer
 	mpAABB->SetOccludeeSizeThreshold(mOccludeeSizeThreshold);
 	
@@ -348,16 +455,28 @@ void MySample::Create()
     mpShadowCamera->LookAt( lookAtPoint.x, lookAtPoint.y, lookAtPoint.z );
     mpShadowCamera->Update();
 
+	// The shadow casters are occlusion culled from the shadow camera with its own depth buffer
+	mpShadowCulling = new MultiViewCulling;
+	CreateShadowCulling();
+
     mpCameraController = new CPUTCameraControllerFPS();
     mpCameraController->SetCamera(mpCamera);
     mpCameraController->SetLookSpeed(0.004f);
     mpCameraController->SetMoveSpeed(2.5f);
 
-	// Creating a render target to view the CPU rasterized depth buffer
+	SetDepthBufferSize(mDepthBufferSize);
+}
+
+// Creates the render target the CPU depth buffer is rasterized to, sized for the current depth buffer resolution
+//-----------------------------------------------------------------------------
+void MySample::CreateCPURenderTarget()
+{
+	SAFE_RELEASE(mpCPURenderTarget);
+
 	CD3D11_TEXTURE2D_DESC cpuRenderTargetDesc(
             DXGI_FORMAT_R8G8B8A8_UNORM,
-            SCREENW, // TODO: round up to full tile sizes
-            SCREENH,
+            mDepthBufferDesc.mWidth,
+            mDepthBufferDesc.mHeight,
             1, // Array Size
             1, // MIP Levels
             0, // D3D10_BIND_*
@@ -368,6 +487,65 @@ void MySample::Create()
 	ASSERT(SUCCEEDED(hr), _L("Failed creating render target."));
 }
 
+// Copies the depth buffer owned by the rasterizer to the CPU render target so it can be 
+// viewed. The culling itself never maps the texture, the mapped rows can be padded
+//-----------------------------------------------------------------------------
+void MySample::CopyDepthBufferToRenderTarget()
+{
+	D3D11_MAPPED_SUBRESOURCE depthTexture;
+	UINT mappedSubresourceIndex = D3D10CalcSubresource(0, 0, 1);
+	HRESULT hr = mpContext->Map(mpCPURenderTarget, mappedSubresourceIndex, D3D11_MAP_WRITE, 0, &depthTexture);
+	ASSERT(SUCCEEDED(hr), _L("Failed mapping render target."));
+
+	const UINT *pDepthBuffer = mpDBR->GetCPURenderTargetPixels();
+	UINT rowSize = sizeof(float) * mDepthBufferDesc.mWidth;
+	for(int y = 0; y < mDepthBufferDesc.mHeight; y++)
+	{
+		memcpy((char*)depthTexture.pData + y * depthTexture.RowPitch, pDepthBuffer + y * mDepthBufferDesc.mWidth, rowSize);
+	}
+	mpContext->Unmap(mpCPURenderTarget, mappedSubresourceIndex);
+}
+
+// Creates the shadow camera's view with the occluder proxies, levels of detail and
+// depth buffer settings of the camera's view. The sample renders no shadow map, the
+// shadow casters are only culled to count how many a shadow pass could skip
+//-----------------------------------------------------------------------------
+void MySample::CreateShadowCulling()
+{
+	mpShadowCulling->CreateViews(1, mpAssetSetDBR, OCCLUDER_SETS, mpAssetSetAABB, OCCLUDEE_SETS, mUseOccluderProxies, mUseOccluderLods);
+	mpShadowCulling->SetDepthBufferDesc(mDepthBufferDesc);
+	mpShadowCulling->SetOccluderSizeThreshold(mOccluderSizeThreshold);
+	mpShadowCulling->SetOccludeeSizeThreshold(mOccludeeSizeThreshold);
+	mpShadowCulling->SetDepthTestTasks(mNumDepthTestTasks);
+	mpShadowCulling->SetCamera(0, mpShadowCamera);
+}
+
+// Switches the occlusion culling to one of the DEPTH_BUFFER_SIZES resolutions
+//-----------------------------------------------------------------------------
+void MySample::SetDepthBufferSize(UINT sizeIndex)
+{
+	mDepthBufferSize = sizeIndex;
+	mDepthBufferDesc.Set(DEPTH_BUFFER_SIZES[sizeIndex][0], DEPTH_BUFFER_SIZES[sizeIndex][1], SCREENW_IN_TILES, SCREENH_IN_TILES);
+	CreateCPURenderTarget();
+
+	mpDBR->SetDepthBufferDesc(mDepthBufferDesc);
+	mpAABB->SetDepthBufferDesc(mDepthBufferDesc);
+	mpShadowCulling->SetDepthBufferDesc(mDepthBufferDesc);
+}
+
+// Sets the layout the SSE rasterizers store the depth buffer in. The depth buffer
+// is only viewed in the linear layout, the picked one is used again afterwards
+//-----------------------------------------------------------------------------
+void MySample::SetDepthBufferLayout(DEPTH_BUFFER_LAYOUT layout)
+{
+	mDepthBufferLayout = layout;
+	mDepthBufferDesc.mLayout = mViewDepthBuffer ? DEPTH_BUFFER_LINEAR : layout;
+
+	mpDBR->SetDepthBufferDesc(mDepthBufferDesc);
+	mpAABB->SetDepthBufferDesc(mDepthBufferDesc);
+	mpShadowCulling->SetDepthBufferDesc(mDepthBufferDesc);
+}
+
 //-----------------------------------------------------------------------------
 void MySample::Update(double deltaSeconds)
 {
@@ -497,11 +675,60 @@ void MySample::HandleCallbackEvent( CPUTEventID Event, CPUTControlID ControlID,
 			}
 
 		}
+		else if(selectedItem - 3 == 0)
+		{
+			mSOCType = MASKED_TYPE;
+			// There is no single threaded masked rasterizer, use the SSE one instead
+			if(!mEnableTasks)
+			{
+				mpDBRSSEST = new DepthBufferRasterizerSSEST;
+				mpDBR = mpDBRSSEST;
+
+				mpAABBSSEST = new AABBoxRasterizerSSEST;
+				mpAABB = mpAABBSSEST;
+			}
+			else
+			{
+				mpDBRMaskedMT = new DepthBufferRasterizerMaskedMT;
+				mpDBR = mpDBRMaskedMT;
+
+				mpAABBMaskedMT = new AABBoxRasterizerMaskedMT;
+				mpAABBMaskedMT->SetMaskedDepthBuffer(mpDBRMaskedMT->GetMaskedDepthBuffer());
+				mpAABB = mpAABBMaskedMT;
+			}
+		}
+		else if(selectedItem - 4 == 0)
+		{
+			mSOCType = AVX_TYPE;
+			// There is no single threaded AVX rasterizer, use the SSE one instead
+			if(!mEnableTasks)
+			{
+				mpDBRSSEST = new DepthBufferRasterizerSSEST;
+				mpDBR = mpDBRSSEST;
+
+				mpAABBSSEST = new AABBoxRasterizerSSEST;
+				mpAABB = mpAABBSSEST;
+			}
+			else
+			{
+				mpDBRAVXMT = new DepthBufferRasterizerAVXMT;
+				mpDBR = mpDBRAVXMT;
+
+				mpAABBAVXMT = new AABBoxRasterizerAVXMT;
+				mpAABB = mpAABBAVXMT;
+			}
+		}
+		mpDBR->SetOccluderProxies(mUseOccluderProxies);
+		mpDBR->SetOccluderLods(mUseOccluderLods);
+		mpDBR->SetDepthReprojection(mUseDepthReprojection);
 		mpDBR->CreateTransformedModels(mpAssetSetDBR, OCCLUDER_SETS);		
 		mpDBR->SetOccluderSizeThreshold(mOccluderSizeThreshold);
+		mpDBR->SetOccluderBudget(mOccluderTriBudget, mOccluderTimeBudget / 1000.0f);
 		mpAABB->CreateTransformedAABBoxes(mpAssetSetAABB, OCCLUDEE_SETS);
 		mpAABB->SetDepthTestTasks(mNumDepthTestTasks);
 		mpAABB->SetOccludeeSizeThreshold(mOccludeeSizeThreshold);
+		mpDBR->SetDepthBufferDesc(mDepthBufferDesc);
+		mpAABB->SetDepthBufferDesc(mDepthBufferDesc);
 
 		break;
 	}
@@ -525,6 +752,7 @@ void MySample::HandleCallbackEvent( CPUTEventID Event, CPUTControlID ControlID,
 			mViewDepthBuffer = false;
 			gVisualizeDepthBuffer = 0;
 		}
+		SetDepthBufferLayout(mDepthBufferLayout);
 		break;
 	}
 	case ID_BOUNDING_BOX_VISIBLE:
@@ -571,6 +799,23 @@ void MySample::HandleCallbackEvent( CPUTEventID Event, CPUTControlID ControlID,
 				mpAABBSSEMT = new AABBoxRasterizerSSEMT;
 				mpAABB = mpAABBSSEMT;
 			}
+			else if(mSOCType == AVX_TYPE)
+			{
+				mpDBRAVXMT = new DepthBufferRasterizerAVXMT;
+				mpDBR = mpDBRAVXMT;
+
+				mpAABBAVXMT = new AABBoxRasterizerAVXMT;
+				mpAABB = mpAABBAVXMT;
+			}
+			else if(mSOCType == MASKED_TYPE)
+			{
+				mpDBRMaskedMT = new DepthBufferRasterizerMaskedMT;
+				mpDBR = mpDBRMaskedMT;
+
+				mpAABBMaskedMT = new AABBoxRasterizerMaskedMT;
+				mpAABBMaskedMT->SetMaskedDepthBuffer(mpDBRMaskedMT->GetMaskedDepthBuffer());
+				mpAABB = mpAABBMaskedMT;
+			}
 			mpAABB->SetDepthTestTasks(mNumDepthTestTasks);
 		}
 		else
@@ -585,7 +830,7 @@ void MySample::HandleCallbackEvent( CPUTEventID Event, CPUTControlID ControlID,
 				mpAABBScalarST = new AABBoxRasterizerScalarST;
 				mpAABB = mpAABBScalarST;
 			}
-			else if(mSOCType == SSE_TYPE)
+			else if(mSOCType == SSE_TYPE || mSOCType == MASKED_TYPE || mSOCType == AVX_TYPE)
 			{
 				mpDBRSSEST = new DepthBufferRasterizerSSEST;
 				mpDBR = mpDBRSSEST;
@@ -594,10 +839,16 @@ void MySample::HandleCallbackEvent( CPUTEventID Event, CPUTControlID ControlID,
 				mpAABB = mpAABBSSEST;
 			}
 		}
+		mpDBR->SetOccluderProxies(mUseOccluderProxies);
+		mpDBR->SetOccluderLods(mUseOccluderLods);
+		mpDBR->SetDepthReprojection(mUseDepthReprojection);
 		mpDBR->CreateTransformedModels(mpAssetSetDBR, OCCLUDER_SETS);		
 		mpDBR->SetOccluderSizeThreshold(mOccluderSizeThreshold);
+		mpDBR->SetOccluderBudget(mOccluderTriBudget, mOccluderTimeBudget / 1000.0f);
 		mpAABB->CreateTransformedAABBoxes(mpAssetSetAABB, OCCLUDEE_SETS);
 		mpAABB->SetOccludeeSizeThreshold(mOccludeeSizeThreshold);
+		mpDBR->SetDepthBufferDesc(mDepthBufferDesc);
+		mpAABB->SetDepthBufferDesc(mDepthBufferDesc);
 		break;
 	}
 	case ID_OCCLUDER_SIZE:
@@ -610,6 +861,29 @@ void MySample::HandleCallbackEvent( CPUTEventID Event, CPUTControlID ControlID,
 		swprintf_s(&string[0], CPUT_MAX_STRING_LENGTH, _L("Occluder Size Threshold: %0.4f"), mOccluderSizeThreshold);
 		mpOccluderSizeSlider->SetText(string);
 		mpDBR->SetOccluderSizeThreshold(mOccluderSizeThreshold);
+		mpShadowCulling->SetOccluderSizeThreshold(mOccluderSizeThreshold);
+		break;
+	}
+	case ID_OCCLUDER_TRI_BUDGET:
+	{
+		float triBudget;
+		mpOccluderTriBudgetSlider->GetValue(triBudget);
+		mOccluderTriBudget = (UINT)triBudget;
+
+		wchar_t string[CPUT_MAX_STRING_LENGTH];
+		swprintf_s(&string[0], CPUT_MAX_STRING_LENGTH, _L("Occluder Tri Budget: %d"), mOccluderTriBudget);
+		mpOccluderTriBudgetSlider->SetText(string);
+		mpDBR->SetOccluderBudget(mOccluderTriBudget, mOccluderTimeBudget / 1000.0f);
+		break;
+	}
+	case ID_OCCLUDER_TIME_BUDGET:
+	{
+		mpOccluderTimeBudgetSlider->GetValue(mOccluderTimeBudget);
+
+		wchar_t string[CPUT_MAX_STRING_LENGTH];
+		swprintf_s(&string[0], CPUT_MAX_STRING_LENGTH, _L("Occluder Time Budget: %0.2f ms"), mOccluderTimeBudget);
+		mpOccluderTimeBudgetSlider->SetText(string);
+		mpDBR->SetOccluderBudget(mOccluderTriBudget, mOccluderTimeBudget / 1000.0f);
 		break;
 	}
 	case ID_OCCLUDEE_SIZE:
@@ -622,6 +896,7 @@ void MySample::HandleCallbackEvent( CPUTEventID Event, CPUTControlID ControlID,
 		swprintf_s(&string[0], CPUT_MAX_STRING_LENGTH, _L("Occludee Size Threshold: %0.4f"), mOccludeeSizeThreshold);
 		mpOccludeeSizeSlider->SetText(string);
 		mpAABB->SetOccludeeSizeThreshold(mOccludeeSizeThreshold);
+		mpShadowCulling->SetOccludeeSizeThreshold(mOccludeeSizeThreshold);
 		break;
 	}
 	case ID_DEPTH_TEST_TASKS:
@@ -634,6 +909,7 @@ void MySample::HandleCallbackEvent( CPUTEventID Event, CPUTControlID ControlID,
 		swprintf_s(&string[0], CPUT_MAX_STRING_LENGTH, _L("Depth Test Task: \t\t%d"), mNumDepthTestTasks);
 		mpDepthTestTaskSlider->SetText(string);
 		mpAABB->SetDepthTestTasks(mNumDepthTestTasks);
+		mpShadowCulling->SetDepthTestTasks(mNumDepthTestTasks);
 		break;
 	}
 
@@ -647,13 +923,8 @@ void MySample::HandleCallbackEvent( CPUTEventID Event, CPUTControlID ControlID,
 		else
 		{
 			mEnableCulling = false;
-			D3D11_MAPPED_SUBRESOURCE depthTexture;
-			UINT mappedSubresourceIndex = D3D10CalcSubresource(0, 0, 1);
-			mpContext->Map(mpCPURenderTarget, mappedSubresourceIndex, D3D11_MAP_READ_WRITE, 0, &depthTexture);
-			mpCPURenderTargetPixels = (UINT*)depthTexture.pData;
-			//TODO: clear to zero in threads instead of here 
-			memset(depthTexture.pData, 0, depthTexture.RowPitch * SCREENH);
-			mpContext->Unmap(mpCPURenderTarget, mappedSubresourceIndex);
+			memset(mpDBR->GetCPURenderTargetPixels(), 0, sizeof(float) * mDepthBufferDesc.GetNumPixels());
+			CopyDepthBufferToRenderTarget();
 
 			mpOccludersR2DBText->SetText(         _L("\tDepth rasterized models: 0"));
 			mpOccluderRasterizedTrisText->SetText(_L("\tDepth rasterized tris: \t0"));
@@ -682,6 +953,73 @@ void MySample::HandleCallbackEvent( CPUTEventID Event, CPUTControlID ControlID,
 		}	
 		break;
 	}
+	case ID_NEAR_CLIP:
+	{
+		// Occluder triangles that cross the near plane are rejected when it is off, 
+		// compare the number of culled occludees with the camera close to occluders
+		CPUTCheckboxState state = mpNearClipCheckBox->GetCheckboxState();
+		mDepthBufferDesc.mClipNearPlane = state == CPUT_CHECKBOX_CHECKED;
+		mpDBR->SetDepthBufferDesc(mDepthBufferDesc);
+		mpAABB->SetDepthBufferDesc(mDepthBufferDesc);
+		mpShadowCulling->SetDepthBufferDesc(mDepthBufferDesc);
+		break;
+	}
+	case ID_OCCLUDER_PROXIES:
+	case ID_OCCLUDER_LODS:
+	{
+		// The occluder models are created again with or without their proxies and levels
+		// of detail. The proxies are built the first time and cached next to the .mdl files
+		mUseOccluderProxies = mpOccluderProxyCheckBox->GetCheckboxState() == CPUT_CHECKBOX_CHECKED;
+		mUseOccluderLods = mpOccluderLodCheckBox->GetCheckboxState() == CPUT_CHECKBOX_CHECKED;
+		if(mSOCType != SCALAR_TYPE)
+		{
+			mpDBR->SetOccluderProxies(mUseOccluderProxies);
+			mpDBR->SetOccluderLods(mUseOccluderLods);
+			mpDBR->CreateTransformedModels(mpAssetSetDBR, OCCLUDER_SETS);
+			mpDBR->SetOccluderSizeThreshold(mOccluderSizeThreshold);
+		}
+		CreateShadowCulling();
+
+		wchar_t string[CPUT_MAX_STRING_LENGTH];
+		mNumOccluderTris = mpDBR->GetNumTriangles();
+		swprintf_s(&string[0], CPUT_MAX_STRING_LENGTH, _L("\tNumber of tris: \t\t%d"), mNumOccluderTris);
+		mpOccluderTrisText->SetText(string);
+		break;
+	}
+	case ID_DEPTH_REPROJECTION:
+	{
+		// The depth buffer is seeded with last frame's depth reprojected to the new view
+		// and only the best scored occluders are rasterized on top of it
+		mUseDepthReprojection = mpReprojectionCheckBox->GetCheckboxState() == CPUT_CHECKBOX_CHECKED;
+		mpDBR->SetDepthReprojection(mUseDepthReprojection);
+		break;
+	}
+	case ID_SHADOW_CULLING:
+	{
+		// The shadow casters are depth tested from the shadow camera and the ones whose
+		// shadow cannot reach the view frustum are dropped
+		mCullShadowCasters = mpShadowCullingCheckBox->GetCheckboxState() == CPUT_CHECKBOX_CHECKED;
+		if(!mCullShadowCasters)
+		{
+			mNumShadowCulled = 0;
+			mpShadowCulledText->SetText(_L("\tShadow casters culled: 0"));
+		}
+		break;
+	}
+	case ID_DEPTH_BUFFER_SIZE:
+	{
+		UINT selectedItem;
+		mpResolutionDropDown->GetSelectedItem(selectedItem);
+		SetDepthBufferSize(selectedItem - 1);
+		break;
+	}
+	case ID_DEPTH_BUFFER_LAYOUT:
+	{
+		UINT selectedItem;
+		mpLayoutDropDown->GetSelectedItem(selectedItem);
+		SetDepthBufferLayout((DEPTH_BUFFER_LAYOUT)(selectedItem - 1));
+		break;
+	}
 	case ID_VSYNC_ON_OFF:
 	{
 		CPUTCheckboxState state = mpVsyncCheckBox->GetCheckboxState();
@@ -700,6 +1038,18 @@ void MySample::HandleCallbackEvent( CPUTEventID Event, CPUTControlID ControlID,
     }
 }
 
+// Culls the scene along the benchmark path with the sample's size thresholds and
+// depth test task count
+//-----------------------------------------------------------------------------
+int MySample::RunBenchmark(const cString &fileName)
+{
+	CullingBenchmark benchmark(mpAssetSetDBR, mpAssetSetAABB, mpCamera, gFarClipDistance);
+	benchmark.SetOccluderSizeThreshold(mOccluderSizeThreshold);
+	benchmark.SetOccludeeSizeThreshold(mOccludeeSizeThreshold);
+	benchmark.SetDepthTestTasks(mNumDepthTestTasks);
+	return benchmark.Run(fileName.c_str()) ? 0 : 1;
+}
+
 // Handle resize events
 //-----------------------------------------------------------------------------
 void MySample::ResizeWindow(UINT width, UINT height)
@@ -768,28 +1118,53 @@ void MySample::Render(double deltaSeconds)
 		// Set the camera transforms so that the occluders can be transformed 
 		mpDBR->SetViewProj(mpCamera->GetViewMatrix(), (float4x4*)mpCamera->GetProjectionMatrix());
 	
-		D3D11_MAPPED_SUBRESOURCE depthTexture;
-		UINT mappedSubresourceIndex = D3D10CalcSubresource(0, 0, 1);
-		// Map the depth buffer to update it
-		mpContext->Map(mpCPURenderTarget, mappedSubresourceIndex, D3D11_MAP_READ_WRITE, 0, &depthTexture);
-		mpCPURenderTargetPixels = (UINT*)depthTexture.pData;
-		// Clear the depth buffer
-		memset(depthTexture.pData, 0, depthTexture.RowPitch * SCREENH);
-		mpDBR->SetCPURenderTargetPixels(mpCPURenderTargetPixels);
-		// Transform the occluder models and rasterize them to the depth buffer
-		mpDBR->TransformModelsAndRasterizeToDepthBuffer();
-		// Unmap the depth buffer after update
-		mpContext->Unmap(mpCPURenderTarget, mappedSubresourceIndex);
+		// Start transforming the occluder models and rasterizing them to the depth buffer. The 
+		// multi-threaded rasterizers return before the depth buffer is done
+		mpDBR->StartTransformModelsAndRasterizeToDepthBuffer();
 	
 		// Set the camera transforms so that the occludee abix aligned bounding boxes (AABB) can be transformed
 		mpAABB->SetViewProjMatrix(mpCamera->GetViewMatrix(), (float4x4*)mpCamera->GetProjectionMatrix());
-		mpAABB->SetCPURenderTargetPixels(mpCPURenderTargetPixels);
+		mpAABB->SetCPURenderTargetPixels(mpDBR->GetCPURenderTargetPixels());
+		mpAABB->SetHiZBuffer(mpDBR->GetHiZBuffer());
+		mpAABB->SetTileTriangleCounts(mpDBR->GetTileTriangleCounts());
+		// The occludees are depth tested as soon as the depth buffer strips they cover are done
+		mpAABB->SetDepthStripsDone(mpDBR->GetDepthStripsDone());
 		// Transform the occludee AABB, rasterize and depth test to determine is occludee is visible or occluded 
 		mpAABB->TransformAABBoxAndDepthTest();
+		mpAABB->SetDepthStripsDone(NULL);
+		mpDBR->WaitForDepthBuffer();
+		if(mViewDepthBuffer)
+		{
+			CopyDepthBufferToRenderTarget();
+		}
 				
 		mpCamera->SetNearPlaneDistance(1.0f);
 		mpCamera->SetFarPlaneDistance(gFarClipDistance);
 		mpCamera->Update();
+
+		if(mCullShadowCasters)
+		{
+			// Frustum test from the shadow camera, then rasterize the occluders and depth
+			// test the casters from it with the near and far planes swapped like above
+			float shadowNear = mpShadowCamera->GetNearPlaneDistance();
+			float shadowFar = mpShadowCamera->GetFarPlaneDistance();
+			mpShadowCulling->IsVisible();
+
+			mpShadowCamera->SetNearPlaneDistance(shadowFar);
+			mpShadowCamera->SetFarPlaneDistance(shadowNear);
+			mpShadowCamera->Update();
+			mpShadowCulling->TransformModelsAndDepthTest();
+
+			mpShadowCamera->SetNearPlaneDistance(shadowNear);
+			mpShadowCamera->SetFarPlaneDistance(shadowFar);
+			mpShadowCamera->Update();
+
+			// Drop the casters hidden from the light and those whose shadow is out of view.
+			// There is no shadow pass to skip them in, they are only counted
+			AABBoxRasterizerSSEMT *pShadowAABB = mpShadowCulling->GetAABBoxRasterizer(0);
+			pShadowAABB->CalcShadowVisible(mpShadowCamera, &mpCamera->mFrustum);
+			mNumShadowCulled = pShadowAABB->GetNumShadowCulled();
+		}
 	}
 	else
 	{
@@ -800,7 +1175,11 @@ void MySample::Render(double deltaSeconds)
 	// If mViewDepthBuffer is enabled then blit the CPU rasterized depth buffer to the frame buffer
 	if(mViewDepthBuffer)
 	{
-		mpContext->CopyResource(mpBackBuffer, mpCPURenderTarget);
+		// Copy the part of the depth buffer that fits in the back buffer to its top left corner
+		D3D11_TEXTURE2D_DESC backBufferDesc;
+		mpBackBuffer->GetDesc(&backBufferDesc);
+		D3D11_BOX srcBox = {0, 0, 0, min((UINT)mDepthBufferDesc.mWidth, backBufferDesc.Width), min((UINT)mDepthBufferDesc.mHeight, backBufferDesc.Height), 1};
+		mpContext->CopySubresourceRegion(mpBackBuffer, 0, 0, 0, 0, mpCPURenderTarget, 0, &srcBox);
 	}
 	// else render the (frustum culled) occluders and only the visible occludees
 	else
@@ -862,6 +1241,12 @@ void MySample::Render(double deltaSeconds)
 
 		swprintf_s(&string[0], CPUT_MAX_STRING_LENGTH, _L("\tDepth test time: \t%0.2f ms"), mDepthTestTime * 1000.0f);
 		mpDepthTestTimeText->SetText(string);		
+
+		if(mCullShadowCasters)
+		{
+			swprintf_s(&string[0], CPUT_MAX_STRING_LENGTH, _L("\tShadow casters culled: %d"), mNumShadowCulled);
+			mpShadowCulledText->SetText(string);
+		}
 	}
 
 	swprintf_s(&string[0], CPUT_MAX_STRING_LENGTH, _L("Number of draw calls: \t\t %d"), mNumDrawCalls);
@@ -30,11 +30,19 @@
 #include "DepthBufferRasterizerSSEST.h"
 #include "DepthBufferRasterizerSSEMT.h"
 
+#include "DepthBufferRasterizerAVXMT.h"
+#include "DepthBufferRasterizerMaskedMT.h"
+
 #include "AABBoxRasterizerScalarST.h"
 #include "AABBoxRasterizerScalarMT.h"
 
 #include "AABBoxRasterizerSSEST.h"
 #include "AABBoxRasterizerSSEMT.h"
+#include "AABBoxRasterizerAVXMT.h"
+#include "AABBoxRasterizerMaskedMT.h"
+
+#include "MultiViewCulling.h"
+#include "CullingBenchmark.h"
 
 #include "TaskMgrTBB.h"
 
@@ -42,8 +50,17 @@ enum SOC_TYPE
 {
 	SCALAR_TYPE,
 	SSE_TYPE,
+	MASKED_TYPE,
+	AVX_TYPE,
 };
 
+// Depth buffer resolutions that can be picked at runtime, the sample starts with SCREENW x SCREENH
+const UINT NUM_DEPTH_BUFFER_SIZES = 6;
+const int DEPTH_BUFFER_SIZES[NUM_DEPTH_BUFFER_SIZES][2] = {{3840, 2160}, {2560, 1440}, {1920, 1080}, {1280, 720}, {640, 360}, {320, 180}};
+const UINT DEFAULT_DEPTH_BUFFER_SIZE = 3;
+// Names of the DEPTH_BUFFER_LAYOUT values
+const wchar_t * const DEPTH_BUFFER_LAYOUT_NAMES[NUM_DEPTH_BUFFER_LAYOUTS] = {L"Linear", L"2x2 Quad", L"8x8 Block"};
+
 //-----------------------------------------------------------------------------
 class MySample : public CPUT_DX11
 {
@@ -58,6 +75,8 @@ private:
 
     CPUTText              *mpFPSCounter;
 	CPUTDropdown		  *mpTypeDropDown;
+	CPUTDropdown		  *mpResolutionDropDown;
+	CPUTDropdown		  *mpLayoutDropDown;
 
 	CPUTText			  *mpOccludersText;
 	CPUTText			  *mpNumOccludersText;
@@ -66,6 +85,8 @@ private:
 	CPUTText			  *mpOccluderRasterizedTrisText;
 	CPUTText		      *mpRasterizeTimeText;
 	CPUTSlider			  *mpOccluderSizeSlider;
+	CPUTSlider			  *mpOccluderTriBudgetSlider;
+	CPUTSlider			  *mpOccluderTimeBudgetSlider;
 
 	CPUTText			  *mpOccludeesText;
 	CPUTText			  *mpNumOccludeesText;
@@ -75,10 +96,16 @@ private:
 	CPUTText			  *mpCulledTrisText;
 	CPUTText			  *mpVisibleTrisText;
 	CPUTText			  *mpDepthTestTimeText;
+	CPUTText			  *mpShadowCulledText;
 	CPUTSlider			  *mpOccludeeSizeSlider;
 
 	CPUTCheckbox		  *mpCullingCheckBox;
 	CPUTCheckbox		  *mpFCullingCheckBox;
+	CPUTCheckbox		  *mpNearClipCheckBox;
+	CPUTCheckbox		  *mpOccluderProxyCheckBox;
+	CPUTCheckbox		  *mpOccluderLodCheckBox;
+	CPUTCheckbox		  *mpReprojectionCheckBox;
+	CPUTCheckbox		  *mpShadowCullingCheckBox;
 	CPUTCheckbox		  *mpDBCheckBox;
 	CPUTCheckbox		  *mpBBCheckBox;
 	CPUTCheckbox		  *mpTasksCheckBox;
@@ -101,12 +128,19 @@ private:
 	DepthBufferRasterizerScalarMT	*mpDBRScalarMT;
 	DepthBufferRasterizerSSEST		*mpDBRSSEST;
 	DepthBufferRasterizerSSEMT		*mpDBRSSEMT;
+	DepthBufferRasterizerAVXMT		*mpDBRAVXMT;
+	DepthBufferRasterizerMaskedMT	*mpDBRMaskedMT;
 
 	AABBoxRasterizer				*mpAABB;
 	AABBoxRasterizerScalarST		*mpAABBScalarST;
 	AABBoxRasterizerScalarMT		*mpAABBScalarMT;
 	AABBoxRasterizerSSEST			*mpAABBSSEST;
 	AABBoxRasterizerSSEMT			*mpAABBSSEMT;
+	AABBoxRasterizerAVXMT			*mpAABBAVXMT;
+	AABBoxRasterizerMaskedMT		*mpAABBMaskedMT;
+
+	// Occlusion culls the shadow casters from the shadow camera
+	MultiViewCulling				*mpShadowCulling;
 
 	UINT				mNumOccluders;
 	UINT				mNumOccludersR2DB;
@@ -114,6 +148,11 @@ private:
 	UINT    			mNumOccluderRasterizedTris;
 	double				mRasterizeTime;
 	float				mOccluderSizeThreshold;
+	UINT				mOccluderTriBudget;
+	float				mOccluderTimeBudget;
+	bool				mUseOccluderProxies;
+	bool				mUseOccluderLods;
+	bool				mUseDepthReprojection;
 	
 	UINT				mNumOccludees;
 	UINT				mNumCulled;
@@ -123,6 +162,8 @@ private:
 	UINT    			mNumOccludeeVisibleTris;
 	double				mDepthTestTime;
 	float				mOccludeeSizeThreshold;
+	bool				mCullShadowCasters;
+	UINT				mNumShadowCulled;
 
 	bool				mEnableCulling;
 	bool				mEnableFCulling;
@@ -133,6 +174,16 @@ private:
 	UINT				mNumDrawCalls;
 	UINT				mNumDepthTestTasks;
 
+	DepthBufferDesc		mDepthBufferDesc;
+	UINT				mDepthBufferSize;
+	DEPTH_BUFFER_LAYOUT	mDepthBufferLayout;
+
+	void CreateCPURenderTarget();
+	void SetDepthBufferSize(UINT sizeIndex);
+	void CopyDepthBufferToRenderTarget();
+	void SetDepthBufferLayout(DEPTH_BUFFER_LAYOUT layout);
+	void CreateShadowCulling();
+
 public:
     MySample() :
         mpCameraController(NULL),
@@ -141,6 +192,8 @@ public:
         mpShadowRenderTarget(NULL),
         mpFPSCounter(NULL),
 		mpTypeDropDown(NULL),
+		mpResolutionDropDown(NULL),
+		mpLayoutDropDown(NULL),
 		mpOccludersText(NULL),
 		mpNumOccludersText(NULL),
 		mpOccludersR2DBText(NULL),
@@ -148,6 +201,8 @@ public:
 		mpOccluderRasterizedTrisText(NULL),
 		mpRasterizeTimeText(NULL),
 		mpOccluderSizeSlider(NULL),
+		mpOccluderTriBudgetSlider(NULL),
+		mpOccluderTimeBudgetSlider(NULL),
 		mpOccludeesText(NULL),
 		mpNumOccludeesText(NULL),
 		mpCulledText(NULL),
@@ -156,9 +211,15 @@ public:
 		mpCulledTrisText(NULL),
 		mpVisibleTrisText(NULL),
 		mpDepthTestTimeText(NULL),
+		mpShadowCulledText(NULL),
 		mpOccludeeSizeSlider(NULL),
 		mpCullingCheckBox(NULL),
 		mpFCullingCheckBox(NULL),
+		mpNearClipCheckBox(NULL),
+		mpOccluderProxyCheckBox(NULL),
+		mpOccluderLodCheckBox(NULL),
+		mpReprojectionCheckBox(NULL),
+		mpShadowCullingCheckBox(NULL),
 		mpDBCheckBox(NULL),
 		mpBBCheckBox(NULL),
 		mpTasksCheckBox(NULL),
@@ -169,12 +230,18 @@ public:
 		mpBackBuffer(NULL),
 		mpRTView(NULL),
 		mSOCType(SSE_TYPE),
+		mpShadowCulling(NULL),
 		mNumOccluders(0),
 		mNumOccludersR2DB(0),
 		mNumOccluderTris(0),
 		mNumOccluderRasterizedTris(0),
 		mRasterizeTime(0.0),
 		mOccluderSizeThreshold(1.5f),
+		mOccluderTriBudget(0),
+		mOccluderTimeBudget(0.0f),
+		mUseOccluderProxies(false),
+		mUseOccluderLods(false),
+		mUseDepthReprojection(false),
 		mNumCulled(0),
 		mNumVisible(0),
 		mNumOccludeeTris(0),
@@ -182,13 +249,17 @@ public:
 		mNumOccludeeVisibleTris(0),
 		mDepthTestTime(0.0),
 		mOccludeeSizeThreshold(0.01f),
+		mCullShadowCasters(false),
+		mNumShadowCulled(0),
 		mEnableCulling(true),
 		mEnableFCulling(true),
 		mViewDepthBuffer(false),
 		mViewBoundingBox(false),
 		mEnableTasks(true),
 		mNumDrawCalls(0),
-		mNumDepthTestTasks(20)
+		mNumDepthTestTasks(20),
+		mDepthBufferSize(DEFAULT_DEPTH_BUFFER_SIZE),
+		mDepthBufferLayout(DEPTH_BUFFER_QUAD)
     {
 		for(UINT i = 0; i < OCCLUDER_SETS; i++)
 		{
@@ -218,7 +289,7 @@ public:
 			mpAABBScalarMT = new AABBoxRasterizerScalarMT;
 			mpAABB = mpAABBScalarMT;
 		}
-		else if((mSOCType == SSE_TYPE) && !mEnableTasks)
+		else if((mSOCType == SSE_TYPE || mSOCType == MASKED_TYPE || mSOCType == AVX_TYPE) && !mEnableTasks)
 		{
 			mpDBRSSEST = new DepthBufferRasterizerSSEST;
 			mpDBR = mpDBRSSEST;
@@ -233,7 +304,24 @@ public:
 
 			mpAABBSSEMT = new AABBoxRasterizerSSEMT;
 			mpAABB = mpAABBSSEMT;
-		}	
+		}
+		else if((mSOCType == AVX_TYPE) && mEnableTasks)
+		{
+			mpDBRAVXMT = new DepthBufferRasterizerAVXMT;
+			mpDBR = mpDBRAVXMT;
+
+			mpAABBAVXMT = new AABBoxRasterizerAVXMT;
+			mpAABB = mpAABBAVXMT;
+		}
+		else if((mSOCType == MASKED_TYPE) && mEnableTasks)
+		{
+			mpDBRMaskedMT = new DepthBufferRasterizerMaskedMT;
+			mpDBR = mpDBRMaskedMT;
+
+			mpAABBMaskedMT = new AABBoxRasterizerMaskedMT;
+			mpAABBMaskedMT->SetMaskedDepthBuffer(mpDBRMaskedMT->GetMaskedDepthBuffer());
+			mpAABB = mpAABBMaskedMT;
+		}
 	}
     virtual ~MySample()
     {
@@ -250,6 +338,7 @@ public:
 
 		SAFE_DELETE(mpDBR);
 		SAFE_DELETE(mpAABB);
+		SAFE_DELETE(mpShadowCulling);
 
 		for(UINT i = 0; i < OCCLUDER_SETS; i++)
 		{
@@ -266,8 +355,6 @@ public:
         CPUTModel::ReleaseStaticResources();
     }
 
-	UINT			*mpCPURenderTargetPixels;
-
     virtual CPUTEventHandledCode HandleKeyboardEvent(CPUTKey key);
     virtual CPUTEventHandledCode HandleMouseEvent(int x, int y, int wheel, CPUTMouseState state);
     virtual void                 HandleCallbackEvent( CPUTEventID Event, CPUTControlID ControlID, CPUTControl *pControl );
@@ -277,6 +364,10 @@ public:
     virtual void Update(double deltaSeconds);
     virtual void ResizeWindow(UINT width, UINT height);
 
+	// Runs the culling benchmark on the loaded scene instead of the message loop and
+	// writes its results to the file, see CullingBenchmark. Returns the exit code
+	int RunBenchmark(const cString &fileName);
+
 	// define some controls
 	static const CPUTControlID ID_MAIN_PANEL = 10;
 	static const CPUTControlID ID_SECONDARY_PANEL = 20;
@@ -294,6 +385,8 @@ public:
 	static const CPUTControlID ID_NUM_OCCLUDER_RASTERIZED_TRIS = 1600;
 	static const CPUTControlID ID_RASTERIZE_TIME = 1700;
 	static const CPUTControlID ID_OCCLUDER_SIZE = 1800;
+	static const CPUTControlID ID_OCCLUDER_TRI_BUDGET = 1820;
+	static const CPUTControlID ID_OCCLUDER_TIME_BUDGET = 1840;
 
 	static const CPUTControlID ID_OCCLUDEES = 1900;
 	static const CPUTControlID ID_NUM_OCCLUDEES = 2000;
@@ -313,5 +406,13 @@ public:
 	static const CPUTControlID ID_NUM_DRAW_CALLS = 3100;
 	static const CPUTControlID ID_DEPTH_TEST_TASKS = 3200;
 	static const CPUTControlID ID_VSYNC_ON_OFF = 3300;
+	static const CPUTControlID ID_DEPTH_BUFFER_SIZE = 3400;
+	static const CPUTControlID ID_DEPTH_BUFFER_LAYOUT = 3900;
+	static const CPUTControlID ID_NEAR_CLIP = 4200;
+	static const CPUTControlID ID_OCCLUDER_PROXIES = 4300;
+	static const CPUTControlID ID_OCCLUDER_LODS = 4400;
+	static const CPUTControlID ID_DEPTH_REPROJECTION = 4500;
+	static const CPUTControlID ID_SHADOW_CULLING = 4600;
+	static const CPUTControlID ID_NUM_SHADOW_CULLED = 4700;
 };
 #endif // __CPUT_SAMPLESTARTDX11_H__
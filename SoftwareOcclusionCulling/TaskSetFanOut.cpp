@@ -0,0 +1,65 @@
+//--------------------------------------------------------------------------------------
+// Copyright 2011 Intel Corporation
+// All Rights Reserved
+//
+// Permission is granted to use, copy, distribute and prepare derivative works of this
+// software for any purpose and without fee, provided, that the above copyright notice
+// and this statement appear in all copies.  Intel makes no representations about the
+// suitability of this software for any purpose.  THIS SOFTWARE IS PROVIDED "AS IS."
+// INTEL SPECIFICALLY DISCLAIMS ALL WARRANTIES, EXPRESS OR IMPLIED, AND ALL LIABILITY,
+// INCLUDING CONSEQUENTIAL AND OTHER INDIRECT DAMAGES, FOR THE USE OF THIS SOFTWARE,
+// INCLUDING LIABILITY FOR INFRINGEMENT OF ANY PROPRIETARY RIGHTS, AND INCLUDING THE
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  Intel does not
+// assume any responsibility for any errors which may appear in this software nor any
+// responsibility to update it.
+//
+//--------------------------------------------------------------------------------------
+
+#include "TaskSetFanOut.h"
+
+TaskSetFanOut::TaskSetFanOut()
+	: mTaskSet(TASKSETHANDLE_INVALID),
+	  mNumRelays(0)
+{
+	for(UINT i = 0; i < MAX_FAN_OUT_RELAYS; i++)
+	{
+		mRelays[i] = TASKSETHANDLE_INVALID;
+	}
+}
+
+void TaskSetFanOut::Relay(VOID* taskData, INT context, UINT taskId, UINT taskCount)
+{
+}
+
+//-------------------------------------------------------------------------------
+// The task set and the relays form a tree in which node i has the successors
+// MAX_SUCCESSORS * i + 1 to MAX_SUCCESSORS * (i + 1). The relays are the first
+// successors, the dependents take the ones after them. Each relay uses up one
+// successor and brings MAX_SUCCESSORS, so numDependents needs
+// (numDependents - MAX_SUCCESSORS) / (MAX_SUCCESSORS - 1) relays rounded up,
+// which is (numDependents - 2) / (MAX_SUCCESSORS - 1)
+//-------------------------------------------------------------------------------
+void TaskSetFanOut::Create(TASKSETHANDLE taskSet, UINT numDependents)
+{
+	mTaskSet = taskSet;
+	mNumRelays = GetNumRelays(numDependents);
+	ASSERT(mNumRelays <= MAX_FAN_OUT_RELAYS, _L("Too many dependents for the task set fan out"));
+
+	for(UINT i = 0; i < mNumRelays; i++)
+	{
+		UINT parent = i / MAX_SUCCESSORS;
+		TASKSETHANDLE dependency = parent == 0 ? mTaskSet : mRelays[parent - 1];
+		gTaskMgr.CreateTaskSet(&TaskSetFanOut::Relay, NULL, 1, &dependency, 1, "Fan Out", &mRelays[i]);
+	}
+}
+
+void TaskSetFanOut::Release()
+{
+	for(UINT i = 0; i < mNumRelays; i++)
+	{
+		gTaskMgr.ReleaseHandle(mRelays[i]);
+		mRelays[i] = TASKSETHANDLE_INVALID;
+	}
+	mNumRelays = 0;
+	mTaskSet = TASKSETHANDLE_INVALID;
+}
@@ -0,0 +1,71 @@
+//--------------------------------------------------------------------------------------
+// Copyright 2011 Intel Corporation
+// All Rights Reserved
+//
+// Permission is granted to use, copy, distribute and prepare derivative works of this
+// software for any purpose and without fee, provided, that the above copyright notice
+// and this statement appear in all copies.  Intel makes no representations about the
+// suitability of this software for any purpose.  THIS SOFTWARE IS PROVIDED "AS IS."
+// INTEL SPECIFICALLY DISCLAIMS ALL WARRANTIES, EXPRESS OR IMPLIED, AND ALL LIABILITY,
+// INCLUDING CONSEQUENTIAL AND OTHER INDIRECT DAMAGES, FOR THE USE OF THIS SOFTWARE,
+// INCLUDING LIABILITY FOR INFRINGEMENT OF ANY PROPRIETARY RIGHTS, AND INCLUDING THE
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  Intel does not
+// assume any responsibility for any errors which may appear in this software nor any
+// responsibility to update it.
+//
+//--------------------------------------------------------------------------------------
+
+#ifndef TASKSETFANOUT_H
+#define TASKSETFANOUT_H
+
+#include "CPUT_DX11.h"
+#include "TaskMgrTBB.h"
+
+// Relay task sets a fan out can create. Each relay adds MAX_SUCCESSORS - 1
+// dependents to the MAX_SUCCESSORS of the task set
+const UINT MAX_FAN_OUT_RELAYS = 16;
+
+// Task sets the occluder pass or the occludee pass of a view can hold at once.
+// The two passes run side by side and have to fit in the MAX_TASKSETS handles
+// of the task manager, which waits for a free handle forever when there is none
+const UINT MAX_PASS_TASKSETS = MAX_TASKSETS / 2;
+
+//-------------------------------------------------------------------------------
+// The task manager keeps at most MAX_SUCCESSORS successors per task set. When
+// more task sets have to wait for one, the fan out chains empty relay task sets
+// to it, each relay waiting for the task set or for an earlier relay, so that no
+// task set gets more than MAX_SUCCESSORS successors. The dependents then wait for
+// the handle Get() gives them instead of the task set
+//-------------------------------------------------------------------------------
+class TaskSetFanOut
+{
+	public:
+		TaskSetFanOut();
+
+		// Creates the relays numDependents task sets need to wait for the task set
+		void Create(TASKSETHANDLE taskSet, UINT numDependents);
+		// Releases the relays, once the dependents are created
+		void Release();
+
+		// Relays Create makes for numDependents dependents
+		static inline UINT GetNumRelays(UINT numDependents)
+		{
+			return numDependents > MAX_SUCCESSORS ? (numDependents - 2) / (MAX_SUCCESSORS - 1) : 0;
+		}
+
+		// Handle the dependent has to wait for
+		inline TASKSETHANDLE Get(UINT dependent) const
+		{
+			UINT node = (mNumRelays + dependent) / MAX_SUCCESSORS;
+			return node == 0 ? mTaskSet : mRelays[node - 1];
+		}
+
+	private:
+		TASKSETHANDLE mTaskSet;
+		TASKSETHANDLE mRelays[MAX_FAN_OUT_RELAYS];
+		UINT mNumRelays;
+
+		static void Relay(VOID* taskData, INT context, UINT taskId, UINT taskCount);
+};
+
+#endif //TASKSETFANOUT_H
@@ -18,24 +18,14 @@
 #include "TransformedAABBoxSSE.h"
 
 UINT	TransformedAABBoxSSE::mBBIndexList[AABB_INDICES] = {};
+UINT	TransformedAABBoxSSE::mBBIndexListAVX[2 * 3 * AVX] = {};
 
 TransformedAABBoxSSE::TransformedAABBoxSSE()
-	: mpCPUTModel(NULL),
+	: mpXformedPos(NULL),
+	  mpXformedPosAVX(NULL),
 	  mVisible(NULL),
-	  mOccludeeSizeThreshold(0.0f),
 	  mInsideViewFrustum(true)
 {
-	mWorldMatrix = (__m128*)_aligned_malloc(sizeof(float) * 4 * 4, 16);
-	mpBBVertexList = (__m128*)_aligned_malloc(sizeof(float) * 4 * AABB_VERTICES, 16);
-	mpXformedPos =  (__m128*)_aligned_malloc(sizeof(float) * 4 * AABB_VERTICES, 16);
-	mViewPortMatrix = (__m128*)_aligned_malloc(sizeof(float) * 4 * 4, 16);
-	mCumulativeMatrix = (__m128*)_aligned_malloc(sizeof(float) * 4 * 4, 16); 
-
-	mViewPortMatrix[0] = _mm_loadu_ps((float*)&viewportMatrix.r0);
-	mViewPortMatrix[1] = _mm_loadu_ps((float*)&viewportMatrix.r1);
-	mViewPortMatrix[2] = _mm_loadu_ps((float*)&viewportMatrix.r2);
-	mViewPortMatrix[3] = _mm_loadu_ps((float*)&viewportMatrix.r3);
-
 	// index for top 
 	mBBIndexList[0]  = 1;
 	mBBIndexList[1]  = 3;
@@ -83,136 +73,232 @@ TransformedAABBoxSSE::TransformedAABBoxSSE()
 	mBBIndexList[33] = 1;
 	mBBIndexList[34] = 6;
 	mBBIndexList[35] = 0;
+
+	// 12 triangles in two batches of 8. The unused lanes of the second batch
+	// repeat its first 4 triangles
+	for(UINT batch = 0; batch < 2; batch++)
+	{
+		for(UINT vv = 0; vv < 3; vv++)
+		{
+			for(UINT lane = 0; lane < AVX; lane++)
+			{
+				UINT tri = batch * AVX + lane;
+				tri = tri < AABB_TRIANGLES ? tri : tri - SSE;
+				mBBIndexListAVX[(batch * 3 + vv) * AVX + lane] = mBBIndexList[tri * 3 + vv];
+			}
+		}
+	}
 }
 
 TransformedAABBoxSSE::~TransformedAABBoxSSE()
 {
-	_aligned_free(mWorldMatrix);
-	_aligned_free(mpBBVertexList);
-	_aligned_free(mpXformedPos);
-	_aligned_free(mViewPortMatrix);
-	_aligned_free(mCumulativeMatrix);
+
 }
 
-//--------------------------------------------------------------------------
-// Get the bounding box center and half vector
-// Create the vertex and index list for the triangles that make up the bounding box
-//--------------------------------------------------------------------------
-void TransformedAABBoxSSE::CreateAABBVertexIndexList(CPUTModelDX11 *pModel)
+void TransformedAABBoxSSE::Gather(vFloat4 pOut[3], UINT triId)
 {
-	mpCPUTModel = pModel;
-	pModel->GetBoundsWorldSpace(&mBBCenterWS, &mBBHalfWS);
-
-	float* world = (float*)pModel->GetWorldMatrix();
-
-	mWorldMatrix[0] = _mm_loadu_ps(world + 0);
-	mWorldMatrix[1] = _mm_loadu_ps(world + 4);
-	mWorldMatrix[2] = _mm_loadu_ps(world + 8);
-	mWorldMatrix[3] = _mm_loadu_ps(world + 12);
-
-	pModel->GetBoundsObjectSpace(&mBBCenter, &mBBHalf);
-
-	float3 min = mBBCenter - mBBHalf;
-	float3 max = mBBCenter + mBBHalf;
-	
-	//Top 4 vertices in BB
-	mpBBVertexList[0] = _mm_set_ps(1.0f, max.z, max.y, max.x);
-	mpBBVertexList[1] = _mm_set_ps(1.0f, max.z, max.y, min.x); 
-	mpBBVertexList[2] = _mm_set_ps(1.0f, min.z, max.y, min.x);
-	mpBBVertexList[3] = _mm_set_ps(1.0f, min.z, max.y, max.x);
-	// Bottom 4 vertices in BB
-	mpBBVertexList[4] = _mm_set_ps(1.0f, min.z, min.y, max.x);
-	mpBBVertexList[5] = _mm_set_ps(1.0f, max.z, min.y, max.x);
-	mpBBVertexList[6] = _mm_set_ps(1.0f, max.z, min.y, min.x);
-	mpBBVertexList[7] = _mm_set_ps(1.0f, min.z, min.y, min.x);
+	for(int lane = 0; lane < SSE; lane++)
+	{
+		for(int i = 0; i < 3; i++)
+		{
+			UINT index = mBBIndexList[(triId * 3) + (lane * 3) + i];
+			pOut[i].X.m128_f32[lane] = mpXformedPos[index].m128_f32[0];
+			pOut[i].Y.m128_f32[lane] = mpXformedPos[index].m128_f32[1];
+			pOut[i].Z.m128_f32[lane] = mpXformedPos[index].m128_f32[2];
+			pOut[i].W.m128_f32[lane] = mpXformedPos[index].m128_f32[3];
+		}
+	}
 }
 
-//----------------------------------------------------------------
-// Determine is model is inside view frustum
-//----------------------------------------------------------------
-void TransformedAABBoxSSE::IsInsideViewFrustum(CPUTCamera *pCamera)
+//-----------------------------------------------------------------------------------------
+// Converts screen space bounds to an inclusive pixel rectangle clamped to the screen.
+// Clamping is done in float as the bounds can be far outside the screen. An empty
+// rectangle means no pixel would be rasterized
+//-----------------------------------------------------------------------------------------
+void TransformedAABBoxSSE::CalcScreenRect(const DepthBufferDesc &desc, float minX, float minY, float maxX, float maxY, int *pStartX, int *pStartY, int *pEndX, int *pEndY)
 {
-	mInsideViewFrustum = pCamera->mFrustum.IsVisible(mBBCenterWS, mBBHalfWS);
+	*pStartX = (int)min(max(floor(minX), 0.0f), (float)desc.mWidth);
+	*pStartY = (int)min(max(floor(minY), 0.0f), (float)desc.mHeight);
+	*pEndX   = (int)min(max(ceil(maxX), -1.0f), (float)(desc.mWidth - 1));
+	*pEndY   = (int)min(max(ceil(maxY), -1.0f), (float)(desc.mHeight - 1));
 }
 
-//----------------------------------------------------------------------------
-// Determine if the occluddee size is too small and if so avoid drawing it
-//----------------------------------------------------------------------------
-bool TransformedAABBoxSSE::IsTooSmall(__m128 *pViewMatrix, __m128 *pProjMatrix, CPUTCamera *pCamera)
+//-----------------------------------------------------------------------------------------
+// Returns true if the box covers a pixel of a tile that no occluder triangle was binned to.
+// The depth buffer of such a tile is still at the far plane, so the depth test of the box
+// would find that pixel visible. In each empty tile the screen bounds touch, only the pixel
+// nearest to the center of the projected box is tried. The box triangles are set up and
+// the pixel is sampled the way DepthTestTriangles does, in 32 bit integers that wrap the
+// same way, so a box is only accepted when its depth test would find it visible. The
+// vertices are the AABB_VERTICES transformed ones in X, Y, Z
+//-----------------------------------------------------------------------------------------
+bool TransformedAABBoxSSE::CoversEmptyTile(const UINT *pTileTriangleCounts, const DepthBufferDesc &desc, const float *pX, const float *pY, const float *pZ, float minX, float minY, float maxX, float maxY)
 {
-	float radius = mBBHalf.lengthSq(); // Use length-squared to avoid sqrt().  Relative comparissons hold.
-	float fov = pCamera->GetFov();
-	float tanOfHalfFov = tanf(fov * 0.5f);
-	bool TooSmall = false;
-
-	MatrixMultiply(mWorldMatrix, pViewMatrix, mCumulativeMatrix);
-	MatrixMultiply(mCumulativeMatrix, pProjMatrix, mCumulativeMatrix);
-	MatrixMultiply(mCumulativeMatrix, mViewPortMatrix, mCumulativeMatrix);
-
-	__m128 center = _mm_set_ps(1.0f, mBBCenter.z, mBBCenter.y, mBBCenter.x);
-	__m128 mBBCenterOSxForm = TransformCoords(&center, mCumulativeMatrix);
-    float w = mBBCenterOSxForm.m128_f32[3];
-	if( w > 1.0f )
-	{
-		float radiusDivW = radius / w;
-		float r2DivW2DivTanFov = radiusDivW / tanOfHalfFov;
-
-		TooSmall = r2DivW2DivTanFov < (mOccludeeSizeThreshold * mOccludeeSizeThreshold) ?  true : false;
-	}
-	else
+	int startX, startY, endX, endY;
+	CalcScreenRect(desc, minX, minY, maxX, maxY, &startX, &startY, &endX, &endY);
+	if(startX > endX || startY > endY)
 	{
-		TooSmall = false;
+		return false;
 	}
-	return TooSmall;
-}
 
-//----------------------------------------------------------------
-// Trasforms the AABB vertices to screen space once every frame
-//----------------------------------------------------------------
-void TransformedAABBoxSSE::TransformAABBox()
-{
+	float centerX = 0.0f, centerY = 0.0f;
 	for(UINT i = 0; i < AABB_VERTICES; i++)
 	{
-		mpXformedPos[i] = TransformCoords(&mpBBVertexList[i], mCumulativeMatrix);
-		float oneOverW = 1.0f/max(mpXformedPos[i].m128_f32[3], 0.0000001f);
-		mpXformedPos[i] = mpXformedPos[i] * oneOverW;
-		mpXformedPos[i].m128_f32[3] = oneOverW;
+		centerX += pX[i];
+		centerY += pY[i];
 	}
-}
-
-void TransformedAABBoxSSE::Gather(vFloat4 pOut[3], UINT triId)
-{
-	for(int lane = 0; lane < SSE; lane++)
+	int pixelX = (int)floor(min(max(centerX / AABB_VERTICES, (float)startX), (float)endX) + 0.5f);
+	int pixelY = (int)floor(min(max(centerY / AABB_VERTICES, (float)startY), (float)endY) + 0.5f);
+
+	bool setUp = false;
+	bool frontFacing[AABB_TRIANGLES];
+	UINT A[AABB_TRIANGLES][3], B[AABB_TRIANGLES][3], C[AABB_TRIANGLES][3];
+	float zz[AABB_TRIANGLES][3];
+	for(int tileY = startY / desc.mTileHeight; tileY <= endY / desc.mTileHeight; tileY++)
 	{
-		for(int i = 0; i < 3; i++)
+		for(int tileX = startX / desc.mTileWidth; tileX <= endX / desc.mTileWidth; tileX++)
 		{
-			UINT index = mBBIndexList[(triId * 3) + (lane * 3) + i];
-			pOut[i].X.m128_f32[lane] = mpXformedPos[index].m128_f32[0];
-			pOut[i].Y.m128_f32[lane] = mpXformedPos[index].m128_f32[1];
-			pOut[i].Z.m128_f32[lane] = mpXformedPos[index].m128_f32[2];
-			pOut[i].W.m128_f32[lane] = mpXformedPos[index].m128_f32[3];
+			if(pTileTriangleCounts[tileY * desc.mWidthInTiles + tileX] != 0)
+			{
+				continue;
+			}
+
+			// Same edge functions as the rasterizer, with the vertices rounded to pixels.
+			// The triangles facing away get no edge functions and are never rasterized
+			if(!setUp)
+			{
+				for(UINT tri = 0; tri < AABB_TRIANGLES; tri++)
+				{
+					UINT x[3], y[3];
+					for(UINT vv = 0; vv < 3; vv++)
+					{
+						UINT index = mBBIndexList[tri * 3 + vv];
+						x[vv] = (UINT)_mm_cvtss_si32(_mm_set_ss(pX[index]));
+						y[vv] = (UINT)_mm_cvtss_si32(_mm_set_ss(pY[index]));
+					}
+					for(UINT vv = 0; vv < 3; vv++)
+					{
+						UINT a = vv == 2 ? 0 : vv + 1;
+						UINT b = a == 2 ? 0 : a + 1;
+						A[tri][vv] = y[a] - y[b];
+						B[tri][vv] = x[b] - x[a];
+						C[tri][vv] = x[a] * y[b] - x[b] * y[a];
+					}
+
+					int triArea = (int)(A[tri][0] * x[0] + B[tri][0] * y[0] + C[tri][0]);
+					frontFacing[tri] = triArea > 0;
+					float oneOverTriArea = 1.0f / (float)triArea;
+					for(UINT vv = 0; vv < 3; vv++)
+					{
+						zz[tri][vv] = pZ[mBBIndexList[tri * 3 + vv]] * oneOverTriArea;
+					}
+				}
+				setUp = true;
+			}
+
+			UINT x = (UINT)min(max(pixelX, max(tileX * desc.mTileWidth, startX)), min((tileX + 1) * desc.mTileWidth - 1, endX));
+			UINT y = (UINT)min(max(pixelY, max(tileY * desc.mTileHeight, startY)), min((tileY + 1) * desc.mTileHeight - 1, endY));
+			for(UINT tri = 0; tri < AABB_TRIANGLES; tri++)
+			{
+				int alpha = (int)(A[tri][0] * x + B[tri][0] * y + C[tri][0]);
+				int beta  = (int)(A[tri][1] * x + B[tri][1] * y + C[tri][1]);
+				int gama  = (int)(A[tri][2] * x + B[tri][2] * y + C[tri][2]);
+				if(frontFacing[tri] && (alpha | beta | gama) > 0)
+				{
+					float depth = (float)alpha * zz[tri][0];
+					depth = depth + (float)beta * zz[tri][1];
+					depth = depth + (float)gama * zz[tri][2];
+					// The tile is cleared to 0
+					if(depth >= 0.0f)
+					{
+						return true;
+					}
+				}
+			}
 		}
 	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------------------
+bool TransformedAABBoxSSE::IsOccludedHiZ(const HiZBuffer *pHiZBuffer, const DepthBufferDesc &desc, float minX, float minY, float maxX, float maxY, float maxZ)
+{
+	int startX, startY, endX, endY;
+	CalcScreenRect(desc, minX, minY, maxX, maxY, &startX, &startY, &endX, &endY);
+	return pHiZBuffer->IsRectOccluded(startX, startY, endX, endY, maxZ);
 }
 
 //-----------------------------------------------------------------------------------------
 // Rasterize the occludee AABB and depth test it against the CPU rasterized depth buffer
 // If any of the rasterized AABB pixels passes the depth test exit early and mark the occludee
-// as visible. If all rasterized AABB pixels are occluded then the occludee is culled
+// as visible. If all rasterized AABB pixels are occluded then the occludee is culled.
+// When a Hi-Z buffer is given the whole box and then each triangle is first tested against
+// it, and only the triangles it cannot decide are rasterized. When the tile triangle counts
+// are given a box that covers a pixel of a tile without occluders is visible without a depth test
 //-----------------------------------------------------------------------------------------
-void TransformedAABBoxSSE::RasterizeAndDepthTestAABBox(UINT *pRenderTargetPixels)
+void TransformedAABBoxSSE::RasterizeAndDepthTestAABBox(UINT *pRenderTargetPixels, const HiZBuffer *pHiZBuffer, const UINT *pTileTriangleCounts, const DepthBufferDesc &desc)
 {
 	// Set DAZ and FZ MXCSR bits to flush denormals to zero (i.e., make it faster)
 	// Denormal are zero (DAZ) is bit 6 and Flush to zero (FZ) is bit 15. 
 	// so to enable the two to have to set bits 6 and 15 which 1000 0000 0100 0000 = 0x8040
 	_mm_setcsr( _mm_getcsr() | 0x8040 );
 
+	__m128 minPos = mpXformedPos[0];
+	__m128 maxPos = mpXformedPos[0];
+	for(UINT i = 1; i < AABB_VERTICES; i++)
+	{
+		minPos = _mm_min_ps(minPos, mpXformedPos[i]);
+		maxPos = _mm_max_ps(maxPos, mpXformedPos[i]);
+	}
+
+	// If W (holding 1/w in our case) is not between 0 and 1,
+	// then a vertex is behind near clip plane (1.0 in our case).
+	if(minPos.m128_f32[3] <= 0.0f || maxPos.m128_f32[3] >= 1.0f)
+	{
+		*mVisible = true;
+		return;
+	}
+
+	if(pTileTriangleCounts)
+	{
+		float x[AABB_VERTICES], y[AABB_VERTICES], z[AABB_VERTICES];
+		for(UINT i = 0; i < AABB_VERTICES; i++)
+		{
+			x[i] = mpXformedPos[i].m128_f32[0];
+			y[i] = mpXformedPos[i].m128_f32[1];
+			z[i] = mpXformedPos[i].m128_f32[2];
+		}
+		if(CoversEmptyTile(pTileTriangleCounts, desc, x, y, z, minPos.m128_f32[0], minPos.m128_f32[1], maxPos.m128_f32[0], maxPos.m128_f32[1]))
+		{
+			*mVisible = true;
+			return;
+		}
+	}
+
+	if(pHiZBuffer && IsOccludedHiZ(pHiZBuffer, desc, minPos.m128_f32[0], minPos.m128_f32[1], maxPos.m128_f32[0], maxPos.m128_f32[1], maxPos.m128_f32[2]))
+	{
+		return;
+	}
+	
+	switch(desc.mLayout)
+	{
+		case DEPTH_BUFFER_LINEAR:   DepthTestTriangles<DepthBufferLinear>((const float*)pRenderTargetPixels, pHiZBuffer, desc); break;
+		case DEPTH_BUFFER_QUAD:     DepthTestTriangles<DepthBufferQuad>((const float*)pRenderTargetPixels, pHiZBuffer, desc); break;
+		case DEPTH_BUFFER_BLOCK8X8: DepthTestTriangles<DepthBufferBlock8x8>((const float*)pRenderTargetPixels, pHiZBuffer, desc); break;
+	}
+}
+
+//-----------------------------------------------------------------------------------------
+// Rasterizes the AABB triangles and depth tests them, specialized for the depth buffer layout
+//-----------------------------------------------------------------------------------------
+template<class Layout>
+void TransformedAABBoxSSE::DepthTestTriangles(const float *pDepthBuffer, const HiZBuffer *pHiZBuffer, const DepthBufferDesc &desc)
+{
 	__m128i colOffset = _mm_set_epi32(0, 1, 0, 1);
 	__m128i rowOffset = _mm_set_epi32(0, 0, 1, 1);
 
 	__m128i fxptZero = _mm_setzero_si128();
-	float* pDepthBuffer = (float*)pRenderTargetPixels; 
-	
+
 	// Rasterize the AABB triangles 4 at a time
 	for(UINT i = 0; i < AABB_TRIANGLES; i += SSE)
 	{
@@ -255,27 +341,10 @@ void TransformedAABBoxSSE::RasterizeAndDepthTestAABBox(UINT *pRenderTargetPixels
 
 		// Use bounding box traversal strategy to determine which pixels to rasterize 
 		__m128i startX = _mm_and_si128(Max(Min(Min(xFormedFxPtPos[0].X, xFormedFxPtPos[1].X), xFormedFxPtPos[2].X), _mm_set1_epi32(0)), _mm_set1_epi32(0xFFFFFFFE));
-		__m128i endX   = Min(_mm_add_epi32(Max(Max(xFormedFxPtPos[0].X, xFormedFxPtPos[1].X), xFormedFxPtPos[2].X), _mm_set1_epi32(1)), _mm_set1_epi32(SCREENW));
+		__m128i endX   = Min(_mm_add_epi32(Max(Max(xFormedFxPtPos[0].X, xFormedFxPtPos[1].X), xFormedFxPtPos[2].X), _mm_set1_epi32(1)), _mm_set1_epi32(desc.mWidth));
 
 		__m128i startY = _mm_and_si128(Max(Min(Min(xFormedFxPtPos[0].Y, xFormedFxPtPos[1].Y), xFormedFxPtPos[2].Y), _mm_set1_epi32(0)), _mm_set1_epi32(0xFFFFFFFE));
-		__m128i endY   = Min(_mm_add_epi32(Max(Max(xFormedFxPtPos[0].Y, xFormedFxPtPos[1].Y), xFormedFxPtPos[2].Y), _mm_set1_epi32(1)), _mm_set1_epi32(SCREENH));
-
-		for(int vv = 0; vv < 3; vv++) 
-		{
-            // If W (holding 1/w in our case) is not between 0 and 1,
-            // then vertex is behind near clip plane (1.0 in our case.
-            // If W < 1, then verify 1/W > 1 (for W>0), and 1/W < 0 (for W < 0).
-		    __m128 nearClipMask0 = _mm_cmple_ps(xformedPos[vv].W, _mm_set1_ps(0.0f));
-		    __m128 nearClipMask1 = _mm_cmpge_ps(xformedPos[vv].W, _mm_set1_ps(1.0f));
-            __m128 nearClipMask  = _mm_or_ps(nearClipMask0, nearClipMask1);
-
-			if(!_mm_test_all_zeros(*(__m128i*)&nearClipMask, *(__m128i*)&nearClipMask))
-			{
-                // All four vertices are behind the near plane (we're processing four triangles at a time w/ SSE)
-                *mVisible = true;
-                return;
-			}
-		}
+		__m128i endY   = Min(_mm_add_epi32(Max(Max(xFormedFxPtPos[0].Y, xFormedFxPtPos[1].Y), xFormedFxPtPos[2].Y), _mm_set1_epi32(1)), _mm_set1_epi32(desc.mHeight));
 
 		// Now we have 4 triangles set up.  Rasterize them each individually.
         for(int lane=0; lane < SSE; lane++)
@@ -303,6 +372,25 @@ void TransformedAABBoxSSE::RasterizeAndDepthTestAABBox(UINT *pRenderTargetPixels
 			int endXx	= endX.m128i_i32[lane];
 			int startYy = startY.m128i_i32[lane];
 			int endYy	= endY.m128i_i32[lane];
+
+			if(pHiZBuffer)
+			{
+				float minZ = min(min(xformedPos[0].Z.m128_f32[lane], xformedPos[1].Z.m128_f32[lane]), xformedPos[2].Z.m128_f32[lane]);
+				float maxZ = max(max(xformedPos[0].Z.m128_f32[lane], xformedPos[1].Z.m128_f32[lane]), xformedPos[2].Z.m128_f32[lane]);
+
+				// Every pixel of the triangle fails the depth test
+				if(pHiZBuffer->IsRectOccluded(startXx, startYy, endXx - 1, endYy - 1, maxZ))
+				{
+					continue;
+				}
+
+				// Every pixel of the triangle passes the depth test
+				if(pHiZBuffer->IsRectVisible(startXx, startYy, endXx - 1, endYy - 1, minZ))
+				{
+					*mVisible = true;
+					return;
+				}
+			}
 		
 			__m128i aa0 = _mm_set1_epi32(A0.m128i_i32[lane]);
 			__m128i aa1 = _mm_set1_epi32(A1.m128i_i32[lane]);
@@ -322,20 +410,6 @@ void TransformedAABBoxSSE::RasterizeAndDepthTestAABBox(UINT *pRenderTargetPixels
 
 			__m128i row, col;
 
-			int rowIdx;
-			// To avoid this branching, choose one method to traverse and store the pixel depth
-			if(gVisualizeDepthBuffer)
-			{
-				// Sequentially traverse and store pixel depths contiguously
-				rowIdx = (startYy * SCREENW + startXx);
-			}
-			else
-			{
-				// Tranverse pixels in 2x2 blocks and store 2x2 pixel quad depths contiguously in memory ==> 2*X
-				// This method provides better perfromance
-				rowIdx = (startYy * SCREENW + 2 * startXx);
-			}
-
 			col = _mm_add_epi32(colOffset, _mm_set1_epi32(startXx));
 			__m128i aa0Col = _mm_mullo_epi32(aa0, col);
 			__m128i aa1Col = _mm_mullo_epi32(aa1, col);
@@ -353,29 +427,17 @@ void TransformedAABBoxSSE::RasterizeAndDepthTestAABBox(UINT *pRenderTargetPixels
 			// Incrementally compute Fab(x, y) for all the pixels inside the bounding box formed by (startX, endX) and (startY, endY)
 			for(int r = startYy; r < endYy; r += 2,
 											row  = _mm_add_epi32(row, _mm_set1_epi32(2)),
-											rowIdx = rowIdx + 2 * SCREENW,
 											bb0Row = _mm_add_epi32(bb0Row, bb0Inc),
 											bb1Row = _mm_add_epi32(bb1Row, bb1Inc),
 											bb2Row = _mm_add_epi32(bb2Row, bb2Inc))
 			{
 				// Compute barycentric coordinates 
-				int idx = rowIdx;
+				const float *pRow = &pDepthBuffer[Layout::RowPairOffset(r, desc.mWidth)];
 				__m128i alpha = _mm_add_epi32(aa0Col, bb0Row);
 				__m128i beta = _mm_add_epi32(aa1Col, bb1Row);
 				__m128i gama = _mm_add_epi32(aa2Col, bb2Row);
 
-				int idxIncr;
-				if(gVisualizeDepthBuffer)
-				{ 
-					idxIncr = 2;
-				}
-				else
-				{
-					idxIncr = 4;
-				}
-
 				for(int c = startXx; c < endXx; c += 2,
-												idx = idx + idxIncr,
 												alpha = _mm_add_epi32(alpha, aa0Inc),
 												beta  = _mm_add_epi32(beta, aa1Inc),
 												gama  = _mm_add_epi32(gama, aa2Inc))
@@ -394,19 +456,254 @@ void TransformedAABBoxSSE::RasterizeAndDepthTestAABBox(UINT *pRenderTargetPixels
 					depth = _mm_add_ps(depth, _mm_mul_ps(_mm_cvtepi32_ps(beta), zz[1]));
 					depth = _mm_add_ps(depth, _mm_mul_ps(_mm_cvtepi32_ps(gama), zz[2]));
 
-					__m128 previousDepthValue;
-					if(gVisualizeDepthBuffer)
+					const float *pQuad = &pRow[Layout::QuadOffset(c)];
+					__m128 previousDepthValue = Layout::LoadQuad(pQuad, desc.mWidth);
+
+					__m128 depthMask  = _mm_cmpge_ps( depth, previousDepthValue);
+					__m128i finalMask = _mm_and_si128( mask, _mm_castps_si128(depthMask));
+					if(!_mm_test_all_zeros(finalMask, finalMask))
 					{
-						previousDepthValue = _mm_set_ps(pDepthBuffer[idx], pDepthBuffer[idx + 1], pDepthBuffer[idx + SCREENW], pDepthBuffer[idx + SCREENW + 1]);
+						*mVisible = true;
+						return; //early exit
 					}
-					else
+				}//for each column											
+			}// for each row
+		}// for each triangle
+	}// for each set of SIMD# triangles
+}
+
+//-----------------------------------------------------------------------------------------
+// AVX version of RasterizeAndDepthTestAABBox. Sets up 8 of the AABB triangles at a time 
+// and depth tests 4x2 pixel blocks. Exits early as soon as one pixel passes the depth test
+//-----------------------------------------------------------------------------------------
+void TransformedAABBoxSSE::RasterizeAndDepthTestAABBoxAVX(UINT *pRenderTargetPixels, const HiZBuffer *pHiZBuffer, const UINT *pTileTriangleCounts, const DepthBufferDesc &desc)
+{
+	// Set DAZ and FZ MXCSR bits to flush denormals to zero (i.e., make it faster)
+	// Denormal are zero (DAZ) is bit 6 and Flush to zero (FZ) is bit 15. 
+	// so to enable the two to have to set bits 6 and 15 which 1000 0000 0100 0000 = 0x8040
+	_mm_setcsr( _mm_getcsr() | 0x8040 );
+
+	// If W (holding 1/w in our case) is not between 0 and 1,
+	// then a vertex is behind near clip plane (1.0 in our case).
+	__m256 nearClipMask = _mm256_or_ps(_mm256_cmp_ps(mpXformedPosAVX[3], _mm256_setzero_ps(), _CMP_LE_OQ),
+									   _mm256_cmp_ps(mpXformedPosAVX[3], _mm256_set1_ps(1.0f), _CMP_GE_OQ));
+	if(_mm256_movemask_ps(nearClipMask))
+	{
+		*mVisible = true;
+		return;
+	}
+
+	if(pHiZBuffer || pTileTriangleCounts)
+	{
+		__m256 minXY = _mm256_min_ps(_mm256_permute2f128_ps(mpXformedPosAVX[0], mpXformedPosAVX[1], 0x20), _mm256_permute2f128_ps(mpXformedPosAVX[0], mpXformedPosAVX[1], 0x31));
+		__m256 maxXY = _mm256_max_ps(_mm256_permute2f128_ps(mpXformedPosAVX[0], mpXformedPosAVX[1], 0x20), _mm256_permute2f128_ps(mpXformedPosAVX[0], mpXformedPosAVX[1], 0x31));
+		__m128 maxZ  = _mm_max_ps(_mm256_castps256_ps128(mpXformedPosAVX[2]), _mm256_extractf128_ps(mpXformedPosAVX[2], 1));
+		minXY = _mm256_min_ps(minXY, _mm256_shuffle_ps(minXY, minXY, _MM_SHUFFLE(1, 0, 3, 2)));
+		minXY = _mm256_min_ps(minXY, _mm256_shuffle_ps(minXY, minXY, _MM_SHUFFLE(2, 3, 0, 1)));
+		maxXY = _mm256_max_ps(maxXY, _mm256_shuffle_ps(maxXY, maxXY, _MM_SHUFFLE(1, 0, 3, 2)));
+		maxXY = _mm256_max_ps(maxXY, _mm256_shuffle_ps(maxXY, maxXY, _MM_SHUFFLE(2, 3, 0, 1)));
+		maxZ  = _mm_max_ps(maxZ, _mm_shuffle_ps(maxZ, maxZ, _MM_SHUFFLE(1, 0, 3, 2)));
+		maxZ  = _mm_max_ps(maxZ, _mm_shuffle_ps(maxZ, maxZ, _MM_SHUFFLE(2, 3, 0, 1)));
+
+		// X in the low half and Y in the high half
+		if(pTileTriangleCounts && CoversEmptyTile(pTileTriangleCounts, desc, (const float*)&mpXformedPosAVX[0], (const float*)&mpXformedPosAVX[1], (const float*)&mpXformedPosAVX[2],
+												  minXY.m256_f32[0], minXY.m256_f32[4], maxXY.m256_f32[0], maxXY.m256_f32[4]))
+		{
+			*mVisible = true;
+			return;
+		}
+		if(pHiZBuffer && IsOccludedHiZ(pHiZBuffer, desc, minXY.m256_f32[0], minXY.m256_f32[4], maxXY.m256_f32[0], maxXY.m256_f32[4], _mm_cvtss_f32(maxZ)))
+		{
+			return;
+		}
+	}
+
+	switch(desc.mLayout)
+	{
+		case DEPTH_BUFFER_LINEAR:   DepthTestTrianglesAVX<DepthBufferLinear>((const float*)pRenderTargetPixels, pHiZBuffer, desc); break;
+		case DEPTH_BUFFER_QUAD:     DepthTestTrianglesAVX<DepthBufferQuad>((const float*)pRenderTargetPixels, pHiZBuffer, desc); break;
+		case DEPTH_BUFFER_BLOCK8X8: DepthTestTrianglesAVX<DepthBufferBlock8x8>((const float*)pRenderTargetPixels, pHiZBuffer, desc); break;
+	}
+}
+
+//-----------------------------------------------------------------------------------------
+// AVX version of DepthTestTriangles, specialized for the depth buffer layout
+//-----------------------------------------------------------------------------------------
+template<class Layout>
+void TransformedAABBoxSSE::DepthTestTrianglesAVX(const float *pDepthBuffer, const HiZBuffer *pHiZBuffer, const DepthBufferDesc &desc)
+{
+	__m256i colOffset = _mm256_set_epi32(2, 3, 2, 3, 0, 1, 0, 1);
+	__m256i rowOffset = _mm256_set_epi32(0, 0, 1, 1, 0, 0, 1, 1);
+
+	__m256i fxptZero = _mm256_setzero_si256();
+
+	// Rasterize the AABB triangles 8 at a time
+	for(UINT batch = 0; batch < 2; batch++)
+	{
+		int numLanes = min((int)AVX, (int)AABB_TRIANGLES - (int)(batch * AVX));
+
+		// Gather the triangle vertices straight from the SoA vertex registers
+		vFloat8 xformedPos[3];
+		for(int vv = 0; vv < 3; vv++)
+		{
+			__m256i index = _mm256_loadu_si256((__m256i*)&mBBIndexListAVX[(batch * 3 + vv) * AVX]);
+			xformedPos[vv].X = _mm256_permutevar8x32_ps(mpXformedPosAVX[0], index);
+			xformedPos[vv].Y = _mm256_permutevar8x32_ps(mpXformedPosAVX[1], index);
+			xformedPos[vv].Z = _mm256_permutevar8x32_ps(mpXformedPosAVX[2], index);
+		}
+
+		// use fixed-point only for X and Y.  Avoid work for Z and W.
+        vFxPt8 xFormedFxPtPos[3];
+		for(int m = 0; m < 3; m++)
+		{
+			xFormedFxPtPos[m].X = _mm256_cvtps_epi32(xformedPos[m].X);
+			xFormedFxPtPos[m].Y = _mm256_cvtps_epi32(xformedPos[m].Y);
+		}
+
+		// Fab(x, y) =     Ax       +       By     +      C              = 0
+		// Fab(x, y) = (ya - yb)x   +   (xb - xa)y + (xa * yb - xb * ya) = 0
+		// Compute A = (ya - yb) for the 3 line segments that make up each triangle
+		__m256i A0 = _mm256_sub_epi32(xFormedFxPtPos[1].Y, xFormedFxPtPos[2].Y);
+		__m256i A1 = _mm256_sub_epi32(xFormedFxPtPos[2].Y, xFormedFxPtPos[0].Y);
+		__m256i A2 = _mm256_sub_epi32(xFormedFxPtPos[0].Y, xFormedFxPtPos[1].Y);
+
+		// Compute B = (xb - xa) for the 3 line segments that make up each triangle
+		__m256i B0 = _mm256_sub_epi32(xFormedFxPtPos[2].X, xFormedFxPtPos[1].X);
+		__m256i B1 = _mm256_sub_epi32(xFormedFxPtPos[0].X, xFormedFxPtPos[2].X);
+		__m256i B2 = _mm256_sub_epi32(xFormedFxPtPos[1].X, xFormedFxPtPos[0].X);
+
+		// Compute C = (xa * yb - xb * ya) for the 3 line segments that make up each triangle
+		__m256i C0 = _mm256_sub_epi32(_mm256_mullo_epi32(xFormedFxPtPos[1].X, xFormedFxPtPos[2].Y), _mm256_mullo_epi32(xFormedFxPtPos[2].X, xFormedFxPtPos[1].Y));
+		__m256i C1 = _mm256_sub_epi32(_mm256_mullo_epi32(xFormedFxPtPos[2].X, xFormedFxPtPos[0].Y), _mm256_mullo_epi32(xFormedFxPtPos[0].X, xFormedFxPtPos[2].Y));
+		__m256i C2 = _mm256_sub_epi32(_mm256_mullo_epi32(xFormedFxPtPos[0].X, xFormedFxPtPos[1].Y), _mm256_mullo_epi32(xFormedFxPtPos[1].X, xFormedFxPtPos[0].Y));
+
+		// Compute triangle area
+		__m256i triArea = _mm256_mullo_epi32(A0, xFormedFxPtPos[0].X);
+		triArea = _mm256_add_epi32(triArea, _mm256_mullo_epi32(B0, xFormedFxPtPos[0].Y));
+		triArea = _mm256_add_epi32(triArea, C0);
+
+		__m256 oneOverTriArea = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_cvtepi32_ps(triArea));
+
+		// Z setup, pre-divided by the triangle area
+		__m256 zz0 = _mm256_mul_ps(xformedPos[0].Z, oneOverTriArea);
+		__m256 zz1 = _mm256_mul_ps(xformedPos[1].Z, oneOverTriArea);
+		__m256 zz2 = _mm256_mul_ps(xformedPos[2].Z, oneOverTriArea);
+
+		// Use bounding box traversal strategy to determine which pixels to rasterize 
+		__m256i startX = _mm256_and_si256(Max(Min(Min(xFormedFxPtPos[0].X, xFormedFxPtPos[1].X), xFormedFxPtPos[2].X), _mm256_set1_epi32(0)), _mm256_set1_epi32(0xFFFFFFFC));
+		__m256i endX   = Min(_mm256_add_epi32(Max(Max(xFormedFxPtPos[0].X, xFormedFxPtPos[1].X), xFormedFxPtPos[2].X), _mm256_set1_epi32(1)), _mm256_set1_epi32(desc.mWidth));
+
+		__m256i startY = _mm256_and_si256(Max(Min(Min(xFormedFxPtPos[0].Y, xFormedFxPtPos[1].Y), xFormedFxPtPos[2].Y), _mm256_set1_epi32(0)), _mm256_set1_epi32(0xFFFFFFFE));
+		__m256i endY   = Min(_mm256_add_epi32(Max(Max(xFormedFxPtPos[0].Y, xFormedFxPtPos[1].Y), xFormedFxPtPos[2].Y), _mm256_set1_epi32(1)), _mm256_set1_epi32(desc.mHeight));
+
+		// Now we have 8 triangles set up.  Rasterize them each individually.
+        for(int lane=0; lane < numLanes; lane++)
+        {
+			// Skip triangle if area is zero 
+			if(triArea.m256i_i32[lane] <= 0)
+			{
+				continue;
+			}
+
+			// Extract this triangle's properties from the SIMD versions
+			__m256 zz[3];
+			zz[0] = _mm256_set1_ps(zz0.m256_f32[lane]);
+			zz[1] = _mm256_set1_ps(zz1.m256_f32[lane]);
+			zz[2] = _mm256_set1_ps(zz2.m256_f32[lane]);
+			
+			int startXx = startX.m256i_i32[lane];
+			int endXx	= endX.m256i_i32[lane];
+			int startYy = startY.m256i_i32[lane];
+			int endYy	= endY.m256i_i32[lane];
+
+			if(pHiZBuffer)
+			{
+				float minZ = min(min(xformedPos[0].Z.m256_f32[lane], xformedPos[1].Z.m256_f32[lane]), xformedPos[2].Z.m256_f32[lane]);
+				float maxZ = max(max(xformedPos[0].Z.m256_f32[lane], xformedPos[1].Z.m256_f32[lane]), xformedPos[2].Z.m256_f32[lane]);
+
+				// Every pixel of the triangle fails the depth test
+				if(pHiZBuffer->IsRectOccluded(startXx, startYy, endXx - 1, endYy - 1, maxZ))
+				{
+					continue;
+				}
+
+				// Every pixel of the triangle passes the depth test
+				if(pHiZBuffer->IsRectVisible(startXx, startYy, endXx - 1, endYy - 1, minZ))
+				{
+					*mVisible = true;
+					return;
+				}
+			}
+		
+			__m256i aa0 = _mm256_set1_epi32(A0.m256i_i32[lane]);
+			__m256i aa1 = _mm256_set1_epi32(A1.m256i_i32[lane]);
+			__m256i aa2 = _mm256_set1_epi32(A2.m256i_i32[lane]);
+
+			__m256i bb0 = _mm256_set1_epi32(B0.m256i_i32[lane]);
+			__m256i bb1 = _mm256_set1_epi32(B1.m256i_i32[lane]);
+			__m256i bb2 = _mm256_set1_epi32(B2.m256i_i32[lane]);
+
+			__m256i cc0 = _mm256_set1_epi32(C0.m256i_i32[lane]);
+			__m256i cc1 = _mm256_set1_epi32(C1.m256i_i32[lane]);
+			__m256i cc2 = _mm256_set1_epi32(C2.m256i_i32[lane]);
+
+			__m256i aa0Inc = _mm256_slli_epi32(aa0, 2);
+			__m256i aa1Inc = _mm256_slli_epi32(aa1, 2);
+			__m256i aa2Inc = _mm256_slli_epi32(aa2, 2);
+
+			__m256i row, col;
+
+			col = _mm256_add_epi32(colOffset, _mm256_set1_epi32(startXx));
+			__m256i aa0Col = _mm256_mullo_epi32(aa0, col);
+			__m256i aa1Col = _mm256_mullo_epi32(aa1, col);
+			__m256i aa2Col = _mm256_mullo_epi32(aa2, col);
+
+			row = _mm256_add_epi32(rowOffset, _mm256_set1_epi32(startYy));
+			__m256i bb0Row = _mm256_add_epi32(_mm256_mullo_epi32(bb0, row), cc0);
+			__m256i bb1Row = _mm256_add_epi32(_mm256_mullo_epi32(bb1, row), cc1);
+			__m256i bb2Row = _mm256_add_epi32(_mm256_mullo_epi32(bb2, row), cc2);
+
+			__m256i bb0Inc = _mm256_slli_epi32(bb0, 1);
+			__m256i bb1Inc = _mm256_slli_epi32(bb1, 1);
+			__m256i bb2Inc = _mm256_slli_epi32(bb2, 1);
+
+			// Incrementally compute Fab(x, y) for all the pixels inside the bounding box formed by (startX, endX) and (startY, endY)
+			for(int r = startYy; r < endYy; r += 2,
+											bb0Row = _mm256_add_epi32(bb0Row, bb0Inc),
+											bb1Row = _mm256_add_epi32(bb1Row, bb1Inc),
+											bb2Row = _mm256_add_epi32(bb2Row, bb2Inc))
+			{
+				// Compute barycentric coordinates 
+				const float *pRow = &pDepthBuffer[Layout::RowPairOffset(r, desc.mWidth)];
+				__m256i alpha = _mm256_add_epi32(aa0Col, bb0Row);
+				__m256i beta = _mm256_add_epi32(aa1Col, bb1Row);
+				__m256i gama = _mm256_add_epi32(aa2Col, bb2Row);
+
+				for(int c = startXx; c < endXx; c += 4,
+												alpha = _mm256_add_epi32(alpha, aa0Inc),
+												beta  = _mm256_add_epi32(beta, aa1Inc),
+												gama  = _mm256_add_epi32(gama, aa2Inc))
+				{
+					//Test Pixel inside triangle
+					__m256i mask = _mm256_cmpgt_epi32(_mm256_or_si256(_mm256_or_si256(alpha, beta), gama), fxptZero);
+					
+					// Early out if all of this block's pixels are outside the triangle.
+					if(_mm256_testz_si256(mask, mask))
 					{
-						previousDepthValue = *(__m128*)&pDepthBuffer[idx];
+						continue;
 					}
 
-					__m128 depthMask  = _mm_cmpge_ps( depth, previousDepthValue);
-					__m128i finalMask = _mm_and_si128( mask, _mm_castps_si128(depthMask));
-					if(!_mm_test_all_zeros(finalMask, finalMask))
+					// Compute barycentric-interpolated depth
+			        __m256 depth = _mm256_mul_ps(_mm256_cvtepi32_ps(alpha), zz[0]);
+					depth = _mm256_add_ps(depth, _mm256_mul_ps(_mm256_cvtepi32_ps(beta), zz[1]));
+					depth = _mm256_add_ps(depth, _mm256_mul_ps(_mm256_cvtepi32_ps(gama), zz[2]));
+
+					const float *pQuads = &pRow[Layout::QuadOffset(c)];
+					__m256 previousDepthValue = Layout::Load2Quads(pQuads, desc.mWidth);
+
+					__m256 depthMask  = _mm256_cmp_ps(depth, previousDepthValue, _CMP_GE_OQ);
+					__m256i finalMask = _mm256_and_si256(mask, _mm256_castps_si256(depthMask));
+					if(!_mm256_testz_si256(finalMask, finalMask))
 					{
 						*mVisible = true;
 						return; //early exit
@@ -415,4 +712,35 @@ void TransformedAABBoxSSE::RasterizeAndDepthTestAABBox(UINT *pRenderTargetPixels
 			}// for each row
 		}// for each triangle
 	}// for each set of SIMD# triangles
+}
+
+//-----------------------------------------------------------------------------------------
+// Depth tests the screen space bounding rectangle of the AABB against the masked depth
+// buffer, using the closest depth of the box. This is more conservative than rasterizing
+// the box triangles but only touches one tile per 32x2 pixels
+//-----------------------------------------------------------------------------------------
+void TransformedAABBoxSSE::DepthTestAABBoxMasked(const MaskedDepthBuffer *pMaskedDepthBuffer, const DepthBufferDesc &desc)
+{
+	__m128 minPos = mpXformedPos[0];
+	__m128 maxPos = mpXformedPos[0];
+	for(UINT i = 1; i < AABB_VERTICES; i++)
+	{
+		minPos = _mm_min_ps(minPos, mpXformedPos[i]);
+		maxPos = _mm_max_ps(maxPos, mpXformedPos[i]);
+	}
+
+	// If W (holding 1/w in our case) is not between 0 and 1,
+	// then a vertex is behind near clip plane (1.0 in our case).
+	if(minPos.m128_f32[3] <= 0.0f || maxPos.m128_f32[3] >= 1.0f)
+	{
+		*mVisible = true;
+		return;
+	}
+
+	int startX, startY, endX, endY;
+	CalcScreenRect(desc, minPos.m128_f32[0], minPos.m128_f32[1], maxPos.m128_f32[0], maxPos.m128_f32[1], &startX, &startY, &endX, &endY);
+	if(pMaskedDepthBuffer->IsRectVisible(startX, startY, endX, endY, maxPos.m128_f32[2]))
+	{
+		*mVisible = true;
+	}
 }
\ No newline at end of file
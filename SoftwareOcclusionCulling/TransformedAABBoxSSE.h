@@ -22,46 +22,51 @@
 #include "CPUT_DX11.h"
 #include "Constants.h"
 #include "HelperSSE.h"
+#include "HiZBuffer.h"
+#include "MaskedDepthBuffer.h"
+#include "DepthBufferDesc.h"
 
 class TransformedAABBoxSSE : public HelperSSE
 {
 	public:
 		TransformedAABBoxSSE();
 		~TransformedAABBoxSSE();
-		void CreateAABBVertexIndexList(CPUTModelDX11 *pModel);
-		void IsInsideViewFrustum(CPUTCamera *pCamera);
 		void TransformAABBoxAndDepthTest();
 
-		bool IsTooSmall(__m128 *pViewMatrix, __m128 *pProjMatrix, CPUTCamera *pCamera);
+		void RasterizeAndDepthTestAABBox(UINT *pRenderTargetPixels, const HiZBuffer *pHiZBuffer, const UINT *pTileTriangleCounts, const DepthBufferDesc &desc);
 
-		void TransformAABBox();
+		void RasterizeAndDepthTestAABBoxAVX(UINT *pRenderTargetPixels, const HiZBuffer *pHiZBuffer, const UINT *pTileTriangleCounts, const DepthBufferDesc &desc);
 
-		void RasterizeAndDepthTestAABBox(UINT *pRenderTargetPixels);
+		void DepthTestAABBoxMasked(const MaskedDepthBuffer *pMaskedDepthBuffer, const DepthBufferDesc &desc);
 
 		inline void SetInsideViewFrustum(bool insideVF){mInsideViewFrustum = insideVF;}
 		inline bool IsInsideViewFrustum(){ return mInsideViewFrustum;}
 		inline void SetVisible(bool *visible){mVisible = visible;}
-		inline void SetOccludeeSizeThreshold(float occludeeSizeThreshold){mOccludeeSizeThreshold = occludeeSizeThreshold;}
+		// The box is transformed by the rasterizer that owns it, 8 vertices as X, Y, Z, 1/W for
+		// the SSE depth test or 4 rows of X, Y, Z, 1/W for the 8 vertices for the AVX depth test.
+		// A rasterizer only uses one of the two so they share the same storage
+		inline void SetXformedPos(__m128 *pXformedPos)
+		{
+			mpXformedPos = pXformedPos;
+			mpXformedPosAVX = (__m256*)pXformedPos;
+		}
 
 	private:
 		static UINT	mBBIndexList[AABB_INDICES];
+		// vertex indices of the box triangles laid out for 8-wide permutes, [batch][vertex][lane]
+		static UINT mBBIndexListAVX[2 * 3 * AVX];
 
-		CPUTModelDX11 *mpCPUTModel;
-		__m128 *mWorldMatrix;
-		__m128 *mpBBVertexList;
 		__m128 *mpXformedPos;
-		__m128 *mCumulativeMatrix; 
+		__m256 *mpXformedPosAVX;   // X, Y, Z, W of the 8 transformed box vertices
 		bool   *mVisible;
-		float   mOccludeeSizeThreshold;
-		__m128 *mViewPortMatrix; 
-
-		float3 mBBCenterWS;
-		float3 mBBHalfWS;
 		bool    mInsideViewFrustum;
-		float3 mBBCenter;
-		float3 mBBHalf;
 
 		void Gather(vFloat4 pOut[3], UINT triId);
+		void CalcScreenRect(const DepthBufferDesc &desc, float minX, float minY, float maxX, float maxY, int *pStartX, int *pStartY, int *pEndX, int *pEndY);
+		bool CoversEmptyTile(const UINT *pTileTriangleCounts, const DepthBufferDesc &desc, const float *pX, const float *pY, const float *pZ, float minX, float minY, float maxX, float maxY);
+		bool IsOccludedHiZ(const HiZBuffer *pHiZBuffer, const DepthBufferDesc &desc, float minX, float minY, float maxX, float maxY, float maxZ);
+		template<class Layout> void DepthTestTriangles(const float *pDepthBuffer, const HiZBuffer *pHiZBuffer, const DepthBufferDesc &desc);
+		template<class Layout> void DepthTestTrianglesAVX(const float *pDepthBuffer, const HiZBuffer *pHiZBuffer, const DepthBufferDesc &desc);
 };
 
 
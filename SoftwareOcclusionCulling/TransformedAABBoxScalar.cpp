@@ -24,7 +24,7 @@ TransformedAABBoxScalar::TransformedAABBoxScalar()
 	  mOccludeeSizeThreshold(0.0f),
 	  mTooSmall(false)
 {
-
+	mViewPortMatrix = DepthBufferDesc().mViewportMatrix;
 }
 
 TransformedAABBoxScalar::~TransformedAABBoxScalar()
@@ -128,7 +128,7 @@ bool TransformedAABBoxScalar::IsTooSmall(float4x4 *pViewMatrix, float4x4 *pProjM
 
 	mCumulativeMatrix = mWorldMatrix * *pViewMatrix;
 	mCumulativeMatrix = mCumulativeMatrix * *pProjMatrix;
-	mCumulativeMatrix = mCumulativeMatrix * viewportMatrix;
+	mCumulativeMatrix = mCumulativeMatrix * mViewPortMatrix;
 	float4 mBBCenterOSxForm = TransformCoords(float4(mBBCenter, 1.0f), mCumulativeMatrix);
 
 	float w = mBBCenterOSxForm.w;
@@ -173,7 +173,7 @@ void TransformedAABBoxScalar::Gather(float4 pOut[3], UINT triId)
 // If any of the rasterized AABB pixels passes the depth test exit early and mark the occludee
 // as visible. If all rasterized AABB pixels are occluded then the occludee is culled
 //-----------------------------------------------------------------------------------------
-void TransformedAABBoxScalar::RasterizeAndDepthTestAABBox(UINT *mpRenderTargetPixels)
+void TransformedAABBoxScalar::RasterizeAndDepthTestAABBox(UINT *mpRenderTargetPixels, const DepthBufferDesc &desc)
 {
 	int fxptZero = 0;
 	float* pDepthBuffer = (float*)mpRenderTargetPixels; 
@@ -214,10 +214,10 @@ void TransformedAABBoxScalar::RasterizeAndDepthTestAABBox(UINT *mpRenderTargetPi
 
 		// Use bounding box traversal strategy to determine which pixels to rasterize 
 		int startX = max(min(min(xformedFxPtPos[0].x, xformedFxPtPos[1].x), xformedFxPtPos[2].x), 0) & int(0xFFFFFFFE);
-		int endX   = min(max(max(xformedFxPtPos[0].x, xformedFxPtPos[1].x), xformedFxPtPos[2].x) + 1, SCREENW);
+		int endX   = min(max(max(xformedFxPtPos[0].x, xformedFxPtPos[1].x), xformedFxPtPos[2].x) + 1, desc.mWidth);
 
 		int startY = max(min(min(xformedFxPtPos[0].y, xformedFxPtPos[1].y), xformedFxPtPos[2].y), 0) & int(0xFFFFFFFE);
-		int endY   = min(max(max(xformedFxPtPos[0].y, xformedFxPtPos[1].y), xformedFxPtPos[2].y) + 1, SCREENH);
+		int endY   = min(max(max(xformedFxPtPos[0].y, xformedFxPtPos[1].y), xformedFxPtPos[2].y) + 1, desc.mHeight);
 
 		float zz[3];
 		for(UINT vv = 0; vv < 3; vv++)
@@ -243,7 +243,7 @@ void TransformedAABBoxScalar::RasterizeAndDepthTestAABBox(UINT *mpRenderTargetPi
 		zz[1] *= oneOverTriArea;
 		zz[2] *= oneOverTriArea;
 			
-		int rowIdx = (startY * SCREENW + startX);
+		int rowIdx = (startY * desc.mWidth + startX);
 		int col = startX;
 		int row = startY;
 		
@@ -254,7 +254,7 @@ void TransformedAABBoxScalar::RasterizeAndDepthTestAABBox(UINT *mpRenderTargetPi
 		// Incrementally compute Fab(x, y) for all the pixels inside the bounding box formed by (startX, endX) and (startY, endY)
 		for(int r = startY; r < endY; r++,
 									  row++,
-									  rowIdx = rowIdx + SCREENW,
+									  rowIdx = rowIdx + desc.mWidth,
 									  alpha0 += B0,
 									  beta0 += B1,
 									  gama0 += B2)									 
@@ -21,6 +21,7 @@
 
 #include "CPUT_DX11.h"
 #include "Constants.h"
+#include "DepthBufferDesc.h"
 #include "HelperScalar.h"
 
 class TransformedAABBoxScalar : public HelperScalar
@@ -31,7 +32,7 @@ class TransformedAABBoxScalar : public HelperScalar
 		void CreateAABBVertexIndexList(CPUTModelDX11 *pModel);
 		void IsInsideViewFrustum(CPUTCamera *pcamera);
 		void TransformAABBox();
-		void RasterizeAndDepthTestAABBox(UINT *mpRenderTargetPixels);
+		void RasterizeAndDepthTestAABBox(UINT *mpRenderTargetPixels, const DepthBufferDesc &desc);
 
 		bool IsTooSmall(float4x4 *pViewMatrix, float4x4 *pProjMatrix, CPUTCamera *pCamera);
 
@@ -39,6 +40,7 @@ class TransformedAABBoxScalar : public HelperScalar
 		inline bool IsInsideViewFrustum(){ return mInsideViewFrustum;}
 		inline void SetVisible(bool *visible){mVisible = visible;}
 		inline void SetOccludeeSizeThreshold(float occludeeSizeThreshold){mOccludeeSizeThreshold = occludeeSizeThreshold;}
+		inline void SetViewportMatrix(const float4x4 &viewportMatrix){mViewPortMatrix = viewportMatrix;}
 
 	private:
 		CPUTModelDX11 *mpCPUTModel;
@@ -46,6 +48,7 @@ class TransformedAABBoxScalar : public HelperScalar
 		float3  mBBCenter;
 		float3  mBBHalf;
 		float4x4 mCumulativeMatrix;
+		float4x4 mViewPortMatrix;
 
 
 		float4  mBBVertexList[AABB_VERTICES];
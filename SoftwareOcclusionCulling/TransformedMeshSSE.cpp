@@ -21,7 +21,10 @@ TransformedMeshSSE::TransformedMeshSSE()
 	: mNumVertices(0),
 	  mNumIndices(0),
 	  mNumTriangles(0),
-	  mpVertices(NULL),
+	  mpVertexData(NULL),
+	  mpVertexX(NULL),
+	  mpVertexY(NULL),
+	  mpVertexZ(NULL),
 	  mpIndices(NULL),
 	  mpXformedPos(NULL),
 	  mVertexStart(0)
@@ -31,33 +34,194 @@ TransformedMeshSSE::TransformedMeshSSE()
 
 TransformedMeshSSE::~TransformedMeshSSE()
 {
-
+	_aligned_free(mpVertexData);
 }
 
+//-------------------------------------------------------------------------------
+// Copies the vertex positions of the mesh in SoA streams so that the transform
+// loads the same coordinate of 4 or 8 vertices at once
+//-------------------------------------------------------------------------------
 void TransformedMeshSSE::Initialize(CPUTMeshDX11* pMesh)
 {
 	mNumVertices = pMesh->GetVertexCount();
 	mNumIndices  = pMesh->GetIndexCount();
 	mNumTriangles = pMesh->GetTriangleCount();
-	mpVertices   = pMesh->GetVertices();
 	mpIndices    = pMesh->GetIndices();
+
+	UINT numPadded = (mNumVertices + AVX - 1) & ~(AVX - 1);
+	mpVertexData = (float*)_aligned_malloc(sizeof(float) * 3 * numPadded, 32);
+	mpVertexX = mpVertexData;
+	mpVertexY = mpVertexX + numPadded;
+	mpVertexZ = mpVertexY + numPadded;
+
+	Vertex *pVertices = pMesh->GetVertices();
+	for(UINT i = 0; i < numPadded; i++)
+	{
+		bool valid = i < mNumVertices;
+		mpVertexX[i] = valid ? pVertices[i].pos.x : 0.0f;
+		mpVertexY[i] = valid ? pVertices[i].pos.y : 0.0f;
+		mpVertexZ[i] = valid ? pVertices[i].pos.z : 0.0f;
+	}
+}
+
+//-------------------------------------------------------------------------------
+// Same as above for a mesh that is not a CPUT mesh, the indices are referenced
+// and have to outlive the transformed mesh
+//-------------------------------------------------------------------------------
+void TransformedMeshSSE::Initialize(const float3 *pVertices, UINT numVertices, UINT *pIndices, UINT numTriangles)
+{
+	mNumVertices = numVertices;
+	mNumIndices  = numTriangles * 3;
+	mNumTriangles = numTriangles;
+	mpIndices    = pIndices;
+
+	UINT numPadded = (mNumVertices + AVX - 1) & ~(AVX - 1);
+	mpVertexData = (float*)_aligned_malloc(sizeof(float) * 3 * numPadded, 32);
+	mpVertexX = mpVertexData;
+	mpVertexY = mpVertexX + numPadded;
+	mpVertexZ = mpVertexY + numPadded;
+
+	for(UINT i = 0; i < numPadded; i++)
+	{
+		bool valid = i < mNumVertices;
+		mpVertexX[i] = valid ? pVertices[i].x : 0.0f;
+		mpVertexY[i] = valid ? pVertices[i].y : 0.0f;
+		mpVertexZ[i] = valid ? pVertices[i].z : 0.0f;
+	}
 }
 
-//-------------------------------------------------------------------
-// Trasforms the occluder vertices to screen space once every frame
-//-------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+// Uses the SoA streams and the indices of a mesh of another view, they have to
+// outlive the transformed mesh. Only the transformed vertices are its own
+//-------------------------------------------------------------------------------
+void TransformedMeshSSE::Initialize(const TransformedMeshSSE &source)
+{
+	mNumVertices = source.mNumVertices;
+	mNumIndices  = source.mNumIndices;
+	mNumTriangles = source.mNumTriangles;
+	mpIndices    = source.mpIndices;
+
+	mpVertexX = source.mpVertexX;
+	mpVertexY = source.mpVertexY;
+	mpVertexZ = source.mpVertexZ;
+}
+
+//-------------------------------------------------------------------------------
+// Trasforms the occluder vertices to screen space once every frame. Transforms 4
+// vertices per iteration from the SoA streams, divides by w and transposes them
+// to the x/w, y/w, z/w, 1/w layout the bin stage gathers from
+//-------------------------------------------------------------------------------
 void TransformedMeshSSE::TransformVertices(__m128 *cumulativeMatrix, 
 										   UINT start, 
 										   UINT end)
 {
-	UINT i;
-	for(i = start; i <= end; i++)
+	const float *pMatrix = (const float*)cumulativeMatrix;
+	__m128 m[16];
+	for(UINT i = 0; i < 16; i++)
+	{
+		m[i] = _mm_set1_ps(pMatrix[i]);
+	}
+
+	for(UINT i = start; i <= end; i += SSE)
+	{
+		__m128 x = _mm_loadu_ps(&mpVertexX[i]);
+		__m128 y = _mm_loadu_ps(&mpVertexY[i]);
+		__m128 z = _mm_loadu_ps(&mpVertexZ[i]);
+
+		__m128 xformX = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m[0]), _mm_mul_ps(y, m[4])), _mm_mul_ps(z, m[8])), m[12]);
+		__m128 xformY = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m[1]), _mm_mul_ps(y, m[5])), _mm_mul_ps(z, m[9])), m[13]);
+		__m128 xformZ = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m[2]), _mm_mul_ps(y, m[6])), _mm_mul_ps(z, m[10])), m[14]);
+		__m128 xformW = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m[3]), _mm_mul_ps(y, m[7])), _mm_mul_ps(z, m[11])), m[15]);
+
+		__m128 oneOverW = _mm_div_ps(_mm_set1_ps(1.0f), _mm_max_ps(xformW, _mm_set1_ps(0.0000001f)));
+		xformX = _mm_mul_ps(xformX, oneOverW);
+		xformY = _mm_mul_ps(xformY, oneOverW);
+		xformZ = _mm_mul_ps(xformZ, oneOverW);
+
+		_MM_TRANSPOSE4_PS(xformX, xformY, xformZ, oneOverW);
+
+		// The transformed vertices are only read back by the bin stage, keep them out of the cache
+		if(i + SSE - 1 <= end)
+		{
+			_mm_stream_ps((float*)&mpXformedPos[i],     xformX);
+			_mm_stream_ps((float*)&mpXformedPos[i + 1], xformY);
+			_mm_stream_ps((float*)&mpXformedPos[i + 2], xformZ);
+			_mm_stream_ps((float*)&mpXformedPos[i + 3], oneOverW);
+		}
+		else
+		{
+			// Last vertices, don't write past the end of the range
+			__m128 xform[SSE] = {xformX, xformY, xformZ, oneOverW};
+			for(UINT j = 0; j <= end - i; j++)
+			{
+				mpXformedPos[i + j] = xform[j];
+			}
+		}
+	}
+	_mm_sfence();
+}
+
+//-------------------------------------------------------------------------------
+// AVX version of TransformVertices. Transforms 8 vertices per iteration, the
+// transpose leaves vertex j and j + 4 in the two 128-bit halves of a register
+//-------------------------------------------------------------------------------
+void TransformedMeshSSE::TransformVerticesAVX(__m128 *cumulativeMatrix, 
+											  UINT start, 
+											  UINT end)
+{
+	const float *pMatrix = (const float*)cumulativeMatrix;
+	__m256 m[16];
+	for(UINT i = 0; i < 16; i++)
+	{
+		m[i] = _mm256_set1_ps(pMatrix[i]);
+	}
+
+	for(UINT i = start; i <= end; i += AVX)
 	{
-		mpXformedPos[i] = TransformCoords(&mpVertices[i].position, cumulativeMatrix);
-		float oneOverW = 1.0f/max(mpXformedPos[i].m128_f32[3], 0.0000001f);
-		mpXformedPos[i] = _mm_mul_ps(mpXformedPos[i], _mm_set1_ps(oneOverW));
-		mpXformedPos[i].m128_f32[3] = oneOverW;
+		__m256 x = _mm256_loadu_ps(&mpVertexX[i]);
+		__m256 y = _mm256_loadu_ps(&mpVertexY[i]);
+		__m256 z = _mm256_loadu_ps(&mpVertexZ[i]);
+
+		__m256 xformX = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m[0]), _mm256_mul_ps(y, m[4])), _mm256_mul_ps(z, m[8])), m[12]);
+		__m256 xformY = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m[1]), _mm256_mul_ps(y, m[5])), _mm256_mul_ps(z, m[9])), m[13]);
+		__m256 xformZ = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m[2]), _mm256_mul_ps(y, m[6])), _mm256_mul_ps(z, m[10])), m[14]);
+		__m256 xformW = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m[3]), _mm256_mul_ps(y, m[7])), _mm256_mul_ps(z, m[11])), m[15]);
+
+		__m256 oneOverW = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_max_ps(xformW, _mm256_set1_ps(0.0000001f)));
+		xformX = _mm256_mul_ps(xformX, oneOverW);
+		xformY = _mm256_mul_ps(xformY, oneOverW);
+		xformZ = _mm256_mul_ps(xformZ, oneOverW);
+
+		__m256 xy0 = _mm256_unpacklo_ps(xformX, xformY);
+		__m256 zw0 = _mm256_unpacklo_ps(xformZ, oneOverW);
+		__m256 xy1 = _mm256_unpackhi_ps(xformX, xformY);
+		__m256 zw1 = _mm256_unpackhi_ps(xformZ, oneOverW);
+
+		__m256 v[4];
+		v[0] = _mm256_shuffle_ps(xy0, zw0, _MM_SHUFFLE(1,0,1,0));
+		v[1] = _mm256_shuffle_ps(xy0, zw0, _MM_SHUFFLE(3,2,3,2));
+		v[2] = _mm256_shuffle_ps(xy1, zw1, _MM_SHUFFLE(1,0,1,0));
+		v[3] = _mm256_shuffle_ps(xy1, zw1, _MM_SHUFFLE(3,2,3,2));
+
+		// The transformed vertices are only read back by the bin stage, keep them out of the cache
+		if(i + AVX - 1 <= end)
+		{
+			for(UINT j = 0; j < 4; j++)
+			{
+				_mm_stream_ps((float*)&mpXformedPos[i + j],     _mm256_castps256_ps128(v[j]));
+				_mm_stream_ps((float*)&mpXformedPos[i + j + 4], _mm256_extractf128_ps(v[j], 1));
+			}
+		}
+		else
+		{
+			// Last vertices, don't write past the end of the range
+			for(UINT j = 0; j <= end - i; j++)
+			{
+				mpXformedPos[i + j] = j < 4 ? _mm256_castps256_ps128(v[j]) : _mm256_extractf128_ps(v[j - 4], 1);
+			}
+		}
 	}
+	_mm_sfence();
 }
 
 void TransformedMeshSSE::Gather(vFloat4 pOut[3], UINT triId, UINT numLanes)
@@ -76,18 +240,31 @@ void TransformedMeshSSE::Gather(vFloat4 pOut[3], UINT triId, UINT numLanes)
 	}
 }
 
+void TransformedMeshSSE::GatherAVX(vFloat8 pOut[3], UINT triId, UINT numLanes)
+{
+	for(UINT l = 0; l < numLanes; l++)
+	{
+		for(UINT i = 0; i < 3; i++)
+		{
+			UINT index = mpIndices[(triId * 3) + (l * 3) + i];
+			pOut[i].X.m256_f32[l] = mpXformedPos[index].m128_f32[0];
+			pOut[i].Y.m256_f32[l] = mpXformedPos[index].m128_f32[1];
+			pOut[i].Z.m256_f32[l] = mpXformedPos[index].m128_f32[2];
+			pOut[i].W.m256_f32[l] = mpXformedPos[index].m128_f32[3];
+		}
+	}
+}
+
 //--------------------------------------------------------------------------------
-// Bin the screen space transformed triangles into tiles. For single threaded version
+// Bin the screen space transformed triangles into tiles
 //--------------------------------------------------------------------------------
-void TransformedMeshSSE::BinTransformedTrianglesST(UINT taskId,
-												   UINT modelId,
-												   UINT meshId,
-												   UINT start,
-												   UINT end,
-												   UINT* pBin,
-												   USHORT* pBinModel,
-												   USHORT* pBinMesh,
-												   USHORT* pNumTrisInBin)
+void TransformedMeshSSE::BinTransformedTriangles(UINT taskId,
+												 __m128 *cumulativeMatrix,
+												 UINT start,
+												 UINT end,
+												 TriangleSetupSlots &slots,
+												 TriangleBins* pBins,
+												 const DepthBufferDesc &desc)
 {
 	int numLanes = SSE;
 	// working on 4 triangles at a time
@@ -101,183 +278,407 @@ void TransformedMeshSSE::BinTransformedTrianglesST(UINT taskId,
 		// storing x,y,z,w for the 3 vertices of 4 triangles = 4*3*4 = 48
 		vFloat4 xformedPos[3];		
 		Gather(xformedPos, index, numLanes);
-		
-		// TODO: Maybe convert to Fixed pt and store it once so that dont have to convert to fixedPt again during rasterization
-		vFxPt4 xFormedFxPtPos[3];
+
+		UINT clipMask = SetupAndBinTriangles(taskId, xformedPos, numLanes, false, slots, pBins, desc);
+		if(clipMask)
+		{
+			ClipAndBinTriangles(taskId, cumulativeMatrix, index, clipMask, slots, pBins, desc);
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------
+// Sets up 4 screen space triangles and adds them to the bins of the tiles their
+// bounding box overlaps. Triangles with a vert behind the near clip plane or 
+// outside the guard band are not binned, they are returned as a mask of lanes to
+// clip. The ones behind the near clip plane are only clipped when near clipping
+// is on, otherwise they are rejected
+//--------------------------------------------------------------------------------
+UINT TransformedMeshSSE::SetupAndBinTriangles(UINT taskId,
+											  vFloat4 xformedPos[3],
+											  UINT numLanes,
+											  bool clipped,
+											  TriangleSetupSlots &slots,
+											  TriangleBins* pBins,
+											  const DepthBufferDesc &desc)
+{
+	// Snap X and Y to fixed point with SUBPIXEL_BITS fractional bits. Avoid work for Z and W.
+	__m128 fxptScale = _mm_set1_ps((float)(1 << SUBPIXEL_BITS));
+	vFxPt4 xFormedFxPtPos[3];
+	for(int i = 0; i < 3; i++)
+	{
+		xFormedFxPtPos[i].X = _mm_cvtps_epi32(_mm_mul_ps(xformedPos[i].X, fxptScale));
+		xFormedFxPtPos[i].Y = _mm_cvtps_epi32(_mm_mul_ps(xformedPos[i].Y, fxptScale));
+	}
+
+	// Compute twice the triangle area from the fixed point verts. The products don't
+	// fit in 32 bit, in float the sign is only off for slivers far off screen which
+	// are then dropped or not rasterized
+	__m128 dx1 = _mm_cvtepi32_ps(_mm_sub_epi32(xFormedFxPtPos[1].X, xFormedFxPtPos[0].X));
+	__m128 dy1 = _mm_cvtepi32_ps(_mm_sub_epi32(xFormedFxPtPos[1].Y, xFormedFxPtPos[0].Y));
+	__m128 dx2 = _mm_cvtepi32_ps(_mm_sub_epi32(xFormedFxPtPos[2].X, xFormedFxPtPos[0].X));
+	__m128 dy2 = _mm_cvtepi32_ps(_mm_sub_epi32(xFormedFxPtPos[2].Y, xFormedFxPtPos[0].Y));
+	__m128 triArea = _mm_sub_ps(_mm_mul_ps(dx1, dy2), _mm_mul_ps(dx2, dy1));
+
+	// Depth plane through the snapped verts, with steps per pixel
+	__m128 oneOverTriArea = _mm_div_ps(fxptScale, triArea);
+	__m128 dz1 = _mm_sub_ps(xformedPos[1].Z, xformedPos[0].Z);
+	__m128 dz2 = _mm_sub_ps(xformedPos[2].Z, xformedPos[0].Z);
+	__m128 zdx = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(dz1, dy2), _mm_mul_ps(dz2, dy1)), oneOverTriArea);
+	__m128 zdy = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(dz2, dx1), _mm_mul_ps(dz1, dx2)), oneOverTriArea);
+	__m128 x0 = _mm_div_ps(_mm_cvtepi32_ps(xFormedFxPtPos[0].X), fxptScale);
+	__m128 y0 = _mm_div_ps(_mm_cvtepi32_ps(xFormedFxPtPos[0].Y), fxptScale);
+	__m128 z0 = _mm_sub_ps(xformedPos[0].Z, _mm_add_ps(_mm_mul_ps(zdx, x0), _mm_mul_ps(zdy, y0)));
+	__m128 zMin = _mm_min_ps(_mm_min_ps(xformedPos[0].Z, xformedPos[1].Z), xformedPos[2].Z);
+	
+	// Find bounding box for screen space triangle in terms of pixels, the pixels at integer positions inside it
+	__m128i subpixelMask = _mm_set1_epi32((1 << SUBPIXEL_BITS) - 1);
+	__m128i vStartX = Max(_mm_srai_epi32(_mm_add_epi32(Min(Min(xFormedFxPtPos[0].X, xFormedFxPtPos[1].X), xFormedFxPtPos[2].X), subpixelMask), SUBPIXEL_BITS), _mm_set1_epi32(0));
+	__m128i vEndX   = Min(_mm_add_epi32(_mm_srai_epi32(Max(Max(xFormedFxPtPos[0].X, xFormedFxPtPos[1].X), xFormedFxPtPos[2].X), SUBPIXEL_BITS), _mm_set1_epi32(1)), _mm_set1_epi32(desc.mWidth));
+
+	__m128i vStartY = Max(_mm_srai_epi32(_mm_add_epi32(Min(Min(xFormedFxPtPos[0].Y, xFormedFxPtPos[1].Y), xFormedFxPtPos[2].Y), subpixelMask), SUBPIXEL_BITS), _mm_set1_epi32(0));
+	__m128i vEndY   = Min(_mm_add_epi32(_mm_srai_epi32(Max(Max(xFormedFxPtPos[0].Y, xFormedFxPtPos[1].Y), xFormedFxPtPos[2].Y), SUBPIXEL_BITS), _mm_set1_epi32(1)), _mm_set1_epi32(desc.mHeight));
+
+	// Find the triangles that have a vert behind the near clip plane, their screen
+	// space position is meaningless, and the ones that have a vert outside the guard
+	// band. The parts of clipped triangles are inside both
+	UINT nearClipMask = 0;
+	UINT guardBandMask = 0;
+	if(!clipped)
+	{
+		__m128 nearClip = _mm_setzero_ps();
+		__m128 guardBand = _mm_setzero_ps();
+		__m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
 		for(int i = 0; i < 3; i++)
 		{
-			xFormedFxPtPos[i].X = _mm_cvtps_epi32(xformedPos[i].X);
-			xFormedFxPtPos[i].Y = _mm_cvtps_epi32(xformedPos[i].Y);
-			xFormedFxPtPos[i].Z = _mm_cvtps_epi32(xformedPos[i].Z);
-			xFormedFxPtPos[i].W = _mm_cvtps_epi32(xformedPos[i].W);
+			nearClip = _mm_or_ps(nearClip, _mm_cmpgt_ps(xformedPos[i].W, _mm_set1_ps(1.0f)));
+			guardBand = _mm_or_ps(guardBand, _mm_cmpgt_ps(_mm_and_ps(xformedPos[i].X, absMask), _mm_set1_ps(GUARD_BAND)));
+			guardBand = _mm_or_ps(guardBand, _mm_cmpgt_ps(_mm_and_ps(xformedPos[i].Y, absMask), _mm_set1_ps(GUARD_BAND)));
 		}
+		nearClipMask = _mm_movemask_ps(nearClip) & ((1 << numLanes) - 1);
+		guardBandMask = _mm_movemask_ps(guardBand) & ~nearClipMask & ((1 << numLanes) - 1);
+	}
 
-		// Compute triangle are
-		__m128i A0 = _mm_sub_epi32(xFormedFxPtPos[1].Y, xFormedFxPtPos[2].Y);
-		__m128i B0 = _mm_sub_epi32(xFormedFxPtPos[2].X, xFormedFxPtPos[1].X);
-		__m128i C0 = _mm_sub_epi32(_mm_mullo_epi32(xFormedFxPtPos[1].X, xFormedFxPtPos[2].Y), _mm_mullo_epi32(xFormedFxPtPos[2].X, xFormedFxPtPos[1].Y));
+	// The parts of clipped triangles go to the chunk's clip setups
+	UINT &setupIdx = clipped ? slots.mClipIdx : slots.mIdx;
 
-		__m128i triArea = _mm_mullo_epi32(A0, xFormedFxPtPos[0].X);
-		triArea = _mm_add_epi32(triArea, _mm_mullo_epi32(B0, xFormedFxPtPos[0].Y));
-		triArea = _mm_add_epi32(triArea, C0);
+	for(UINT i = 0; i < numLanes; i++)
+	{
+		if((nearClipMask | guardBandMask) & (1 << i)) continue;
 
-		// Find bounding box for screen space triangle in terms of pixels
-		__m128 oneOverTriArea = _mm_div_ps(_mm_set1_ps(1.0f), _mm_cvtepi32_ps(triArea));
+		// Skip triangle if area is zero 
+		if(triArea.m128_f32[i] <= 0.0f) continue;
 
-		__m128i vStartX = Max(Min(Min(xFormedFxPtPos[0].X, xFormedFxPtPos[1].X), xFormedFxPtPos[2].X), _mm_set1_epi32(0));
-		__m128i vEndX   = Min(_mm_add_epi32(Max(Max(xFormedFxPtPos[0].X, xFormedFxPtPos[1].X), xFormedFxPtPos[2].X), _mm_set1_epi32(1)), _mm_set1_epi32(SCREENW));
+		// Convert bounding box in terms of pixels to bounding box in terms of tiles
+		int startX = max(vStartX.m128i_i32[i]/desc.mTileWidth, 0);
+		int endX   = min((vEndX.m128i_i32[i] - 1)/desc.mTileWidth, desc.mWidthInTiles-1);
 
-        __m128i vStartY = Max(Min(Min(xFormedFxPtPos[0].Y, xFormedFxPtPos[1].Y), xFormedFxPtPos[2].Y), _mm_set1_epi32(0));
-        __m128i vEndY   = Min(_mm_add_epi32(Max(Max(xFormedFxPtPos[0].Y, xFormedFxPtPos[1].Y), xFormedFxPtPos[2].Y), _mm_set1_epi32(1)), _mm_set1_epi32(SCREENH));
+		int startY = max(vStartY.m128i_i32[i]/desc.mTileHeight, 0);
+		int endY   = min((vEndY.m128i_i32[i] - 1)/desc.mTileHeight, desc.mHeightInTiles-1);
 
+		// Skip triangle if it does not cover any pixel
+		if(vStartX.m128i_i32[i] >= vEndX.m128i_i32[i] || vStartY.m128i_i32[i] >= vEndY.m128i_i32[i]) continue;
 
-		for(int i = 0; i < numLanes; i++)
+		// Drop the clipped triangles that don't fit in the chunk's clip setups
+		if(clipped && setupIdx == slots.mClipEnd)
 		{
-			// Skip triangle if area is zero 
-			if(triArea.m128i_i32[i] <= 0) continue;
-			
-			float oneOverW[3];
-			for(int j = 0; j < 3; j++)
+			slots.mNumDropped++;
+			continue;
+		}
+
+		// Store the setup once, the tiles only reference it
+		TriangleSetup &setup = slots.mpSetup[setupIdx];
+		for(int j = 0; j < 3; j++)
+		{
+			setup.mX[j] = xFormedFxPtPos[j].X.m128i_i32[i];
+			setup.mY[j] = xFormedFxPtPos[j].Y.m128i_i32[i];
+		}
+		setup.mZ[0] = z0.m128_f32[i];
+		setup.mZ[1] = zdx.m128_f32[i];
+		setup.mZ[2] = zdy.m128_f32[i];
+		setup.mZMin = zMin.m128_f32[i];
+		setup.mStartX = (short)vStartX.m128i_i32[i];
+		setup.mEndX   = (short)vEndX.m128i_i32[i];
+		setup.mStartY = (short)vStartY.m128i_i32[i];
+		setup.mEndY   = (short)vEndY.m128i_i32[i];
+
+		// Add triangle to the tiles or bins that the bounding box covers
+		int row, col;
+		for(row = startY; row <= endY; row++)
+		{
+			for(col = startX; col <= endX; col++)
 			{
-				oneOverW[j] = xformedPos[j].W.m128_f32[i];
+				pBins->Add(row * desc.mWidthInTiles + col, taskId, setupIdx);
 			}
+		}
+		setupIdx++;
+	}
+	return desc.mClipNearPlane ? nearClipMask | guardBandMask : guardBandMask;
+}
 
-			// Reject the triangle if any of its verts is behind the nearclip plane
-			if(oneOverW[0] > 1.0f || oneOverW[1] > 1.0f || oneOverW[2] > 1.0f) continue;
+//--------------------------------------------------------------------------------
+// Clips the triangles of a batch that cross the near plane or leave the guard band
+// and bins the parts of them that are inside. The transform only keeps the verts divided by w,
+// so the verts of these few triangles are transformed to clip space again. The
+// clipped polygons are fanned into triangles that are set up 4 at a time
+//--------------------------------------------------------------------------------
+void TransformedMeshSSE::ClipAndBinTriangles(UINT taskId,
+											 __m128 *cumulativeMatrix,
+											 UINT triId,
+											 UINT clipMask,
+											 TriangleSetupSlots &slots,
+											 TriangleBins* pBins,
+											 const DepthBufferDesc &desc)
+{
+	vFloat4 xformedPos[3];
+	UINT numLanes = 0;
+	while(clipMask)
+	{
+		DWORD lane;
+		_BitScanForward(&lane, clipMask);
+		clipMask &= clipMask - 1;
 
-			// Convert bounding box in terms of pixels to bounding box in terms of tiles
-			int startX = max(vStartX.m128i_i32[i]/TILE_WIDTH_IN_PIXELS, 0);
-			int endX   = min(vEndX.m128i_i32[i]/TILE_WIDTH_IN_PIXELS, SCREENW_IN_TILES-1);
+		__m128 poly[NUM_CLIP_PLANES + 3];
+		for(UINT i = 0; i < 3; i++)
+		{
+			UINT index = mpIndices[(triId + lane) * 3 + i];
+			__m128 pos = _mm_setr_ps(mpVertexX[index], mpVertexY[index], mpVertexZ[index], 1.0f);
+			poly[i] = TransformCoords(&pos, cumulativeMatrix);
+		}
 
-			int startY = max(vStartY.m128i_i32[i]/TILE_HEIGHT_IN_PIXELS, 0);
-			int endY   = min(vEndY.m128i_i32[i]/TILE_HEIGHT_IN_PIXELS, SCREENH_IN_TILES-1);
+		UINT numVerts = ClipPolygon(poly, 3);
+		for(UINT i = 2; i < numVerts; i++)
+		{
+			__m128 tri[3] = {poly[0], poly[i - 1], poly[i]};
+			for(UINT j = 0; j < 3; j++)
+			{
+				__m128 oneOverW = _mm_div_ps(_mm_set1_ps(1.0f), _mm_shuffle_ps(tri[j], tri[j], _MM_SHUFFLE(3,3,3,3)));
+				__m128 pos = _mm_mul_ps(tri[j], oneOverW);
+				xformedPos[j].X.m128_f32[numLanes] = pos.m128_f32[0];
+				xformedPos[j].Y.m128_f32[numLanes] = pos.m128_f32[1];
+				xformedPos[j].Z.m128_f32[numLanes] = pos.m128_f32[2];
+				xformedPos[j].W.m128_f32[numLanes] = oneOverW.m128_f32[0];
+			}
 
-			// Add triangle to the tiles or bins that the bounding box covers
-			int row, col;
-			for(row = startY; row <= endY; row++)
+			if(++numLanes == SSE)
 			{
-				int offset1 = YOFFSET1_ST * row;
-				int offset2 = YOFFSET2_ST * row;
-				for(col = startX; col <= endX; col++)
+				SetupAndBinTriangles(taskId, xformedPos, numLanes, true, slots, pBins, desc);
+				numLanes = 0;
+			}
+		}
+	}
+
+	if(numLanes > 0)
+	{
+		SetupAndBinTriangles(taskId, xformedPos, numLanes, true, slots, pBins, desc);
+	}
+}
+
+//--------------------------------------------------------------------------------
+// Clips a convex clip space polygon against the near plane and the guard band, one
+// plane after the other. Each plane adds one vert at most so pVerts has room for
+// NUM_CLIP_PLANES more verts than the polygon has. Returns the number of verts
+// left, less than 3 if the polygon is clipped away
+//--------------------------------------------------------------------------------
+UINT TransformedMeshSSE::ClipPolygon(__m128 *pVerts, UINT numVerts)
+{
+	// Plane equations ax + by + cz + dw + e >= 0. The near plane is at w = 1, the
+	// guard band keeps the screen space verts of clipped triangles in GUARD_BAND
+	static const float planes[NUM_CLIP_PLANES][5] = 
+	{
+		{ 0.0f,  0.0f, 0.0f, 1.0f,       -1.0f},
+		{ 1.0f,  0.0f, 0.0f, GUARD_BAND,  0.0f},
+		{-1.0f,  0.0f, 0.0f, GUARD_BAND,  0.0f},
+		{ 0.0f,  1.0f, 0.0f, GUARD_BAND,  0.0f},
+		{ 0.0f, -1.0f, 0.0f, GUARD_BAND,  0.0f},
+	};
+
+	__m128 temp[NUM_CLIP_PLANES + 3];
+	__m128 *pIn = pVerts;
+	__m128 *pOut = temp;
+	for(UINT p = 0; p < NUM_CLIP_PLANES && numVerts >= 3; p++)
+	{
+		__m128 plane = _mm_loadu_ps(planes[p]);
+		float dist[NUM_CLIP_PLANES + 3];
+		UINT numInside = 0;
+		for(UINT i = 0; i < numVerts; i++)
+		{
+			dist[i] = _mm_cvtss_f32(_mm_dp_ps(pIn[i], plane, 0xF1)) + planes[p][4];
+			numInside += dist[i] >= 0.0f ? 1 : 0;
+		}
+
+		// Nothing to clip against this plane
+		if(numInside == numVerts) continue;
+
+		UINT numOut = 0;
+		for(UINT i = 0; i < numVerts; i++)
+		{
+			UINT next = i + 1 < numVerts ? i + 1 : 0;
+			if(dist[i] >= 0.0f)
+			{
+				pOut[numOut++] = pIn[i];
+			}
+			if((dist[i] >= 0.0f) != (dist[next] >= 0.0f))
+			{
+				// Vert where the edge crosses the plane, computed from the inside vert
+				UINT in = dist[i] >= 0.0f ? i : next;
+				UINT out = in == i ? next : i;
+				__m128 t = _mm_set1_ps(dist[in] / (dist[in] - dist[out]));
+				__m128 v = _mm_add_ps(pIn[in], _mm_mul_ps(t, _mm_sub_ps(pIn[out], pIn[in])));
+
+				// Put the vert exactly on the near plane so that it is not clipped again
+				if(p == 0)
 				{
-					int idx1 = offset1 + (XOFFSET1_ST * col) + taskId;
-					int idx2 = offset2 + (XOFFSET2_ST * col) + (taskId * MAX_TRIS_IN_BIN_ST) + pNumTrisInBin[idx1];
-					pBin[idx2] = index + i;
-					pBinModel[idx2] = modelId;
-					pBinMesh[idx2] = meshId;
-					pNumTrisInBin[idx1] += 1;
+					v = _mm_blend_ps(v, _mm_set1_ps(1.0f), 0x8);
 				}
+				pOut[numOut++] = v;
 			}
 		}
+
+		__m128 *pTemp = pIn;
+		pIn = pOut;
+		pOut = pTemp;
+		numVerts = numOut;
+	}
+
+	if(pIn != pVerts)
+	{
+		for(UINT i = 0; i < numVerts; i++)
+		{
+			pVerts[i] = pIn[i];
+		}
 	}
+	return numVerts < 3 ? 0 : numVerts;
 }
 
 //--------------------------------------------------------------------------------
-// Bin the screen space transformed triangles into tiles. For multi threaded version
+// Bin the screen space transformed triangles into tiles. AVX version of
+// BinTransformedTriangles, sets up 8 triangles at a time
 //--------------------------------------------------------------------------------
-void TransformedMeshSSE::BinTransformedTrianglesMT(UINT taskId,
-												   UINT modelId,
-												   UINT meshId,
-												   UINT start,
-												   UINT end,
-												   UINT* pBin,
-												   USHORT* pBinModel,
-												   USHORT* pBinMesh,
-												   USHORT* pNumTrisInBin)
+void TransformedMeshSSE::BinTransformedTrianglesAVX(UINT taskId,
+													__m128 *cumulativeMatrix,
+													UINT start,
+													UINT end,
+													TriangleSetupSlots &slots,
+													TriangleBins* pBins,
+													const DepthBufferDesc &desc)
 {
-	int numLanes = SSE;
-	// working on 4 triangles at a time
-	for(UINT index = start; index <= end; index += SSE)
+	int numLanes = AVX;
+	// working on 8 triangles at a time
+	for(UINT index = start; index <= end; index += AVX)
 	{
-		if(index + SSE > end)
+		if(index + AVX > end)
 		{
 			numLanes = end - index + 1;
 		}
 		
-		// storing x,y,z,w for the 3 vertices of 4 triangles = 4*3*4 = 48
-		vFloat4 xformedPos[3];		
-		Gather(xformedPos, index, numLanes);
+		// storing x,y,z,w for the 3 vertices of 8 triangles = 8*3*4 = 96
+		vFloat8 xformedPos[3];		
+		GatherAVX(xformedPos, index, numLanes);
 		
-		// TODO: Maybe convert to Fixed pt and store it once so that dont have to convert to fixedPt again during rasterization
-		vFxPt4 xFormedFxPtPos[3];
+		__m256 fxptScale = _mm256_set1_ps((float)(1 << SUBPIXEL_BITS));
+		vFxPt8 xFormedFxPtPos[3];
 		for(int i = 0; i < 3; i++)
 		{
-			xFormedFxPtPos[i].X = _mm_cvtps_epi32(xformedPos[i].X);
-			xFormedFxPtPos[i].Y = _mm_cvtps_epi32(xformedPos[i].Y);
-			xFormedFxPtPos[i].Z = _mm_cvtps_epi32(xformedPos[i].Z);
-			xFormedFxPtPos[i].W = _mm_cvtps_epi32(xformedPos[i].W);
+			xFormedFxPtPos[i].X = _mm256_cvtps_epi32(_mm256_mul_ps(xformedPos[i].X, fxptScale));
+			xFormedFxPtPos[i].Y = _mm256_cvtps_epi32(_mm256_mul_ps(xformedPos[i].Y, fxptScale));
 		}
 
-		// Compute triangle are
-		__m128i A0 = _mm_sub_epi32(xFormedFxPtPos[1].Y, xFormedFxPtPos[2].Y);
-		__m128i B0 = _mm_sub_epi32(xFormedFxPtPos[2].X, xFormedFxPtPos[1].X);
-		__m128i C0 = _mm_sub_epi32(_mm_mullo_epi32(xFormedFxPtPos[1].X, xFormedFxPtPos[2].Y), _mm_mullo_epi32(xFormedFxPtPos[2].X, xFormedFxPtPos[1].Y));
+		// Compute twice the triangle area from the fixed point verts
+		__m256 dx1 = _mm256_cvtepi32_ps(_mm256_sub_epi32(xFormedFxPtPos[1].X, xFormedFxPtPos[0].X));
+		__m256 dy1 = _mm256_cvtepi32_ps(_mm256_sub_epi32(xFormedFxPtPos[1].Y, xFormedFxPtPos[0].Y));
+		__m256 dx2 = _mm256_cvtepi32_ps(_mm256_sub_epi32(xFormedFxPtPos[2].X, xFormedFxPtPos[0].X));
+		__m256 dy2 = _mm256_cvtepi32_ps(_mm256_sub_epi32(xFormedFxPtPos[2].Y, xFormedFxPtPos[0].Y));
+		__m256 triArea = _mm256_sub_ps(_mm256_mul_ps(dx1, dy2), _mm256_mul_ps(dx2, dy1));
+
+		// Depth plane through the snapped verts, with steps per pixel
+		__m256 oneOverTriArea = _mm256_div_ps(fxptScale, triArea);
+		__m256 dz1 = _mm256_sub_ps(xformedPos[1].Z, xformedPos[0].Z);
+		__m256 dz2 = _mm256_sub_ps(xformedPos[2].Z, xformedPos[0].Z);
+		__m256 zdx = _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(dz1, dy2), _mm256_mul_ps(dz2, dy1)), oneOverTriArea);
+		__m256 zdy = _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(dz2, dx1), _mm256_mul_ps(dz1, dx2)), oneOverTriArea);
+		__m256 x0 = _mm256_div_ps(_mm256_cvtepi32_ps(xFormedFxPtPos[0].X), fxptScale);
+		__m256 y0 = _mm256_div_ps(_mm256_cvtepi32_ps(xFormedFxPtPos[0].Y), fxptScale);
+		__m256 z0 = _mm256_sub_ps(xformedPos[0].Z, _mm256_add_ps(_mm256_mul_ps(zdx, x0), _mm256_mul_ps(zdy, y0)));
+		__m256 zMin = _mm256_min_ps(_mm256_min_ps(xformedPos[0].Z, xformedPos[1].Z), xformedPos[2].Z);
+
+		// Find bounding box for screen space triangle in terms of pixels, the pixels at integer positions inside it
+		__m256i subpixelMask = _mm256_set1_epi32((1 << SUBPIXEL_BITS) - 1);
+		__m256i vStartX = Max(_mm256_srai_epi32(_mm256_add_epi32(Min(Min(xFormedFxPtPos[0].X, xFormedFxPtPos[1].X), xFormedFxPtPos[2].X), subpixelMask), SUBPIXEL_BITS), _mm256_set1_epi32(0));
+		__m256i vEndX   = Min(_mm256_add_epi32(_mm256_srai_epi32(Max(Max(xFormedFxPtPos[0].X, xFormedFxPtPos[1].X), xFormedFxPtPos[2].X), SUBPIXEL_BITS), _mm256_set1_epi32(1)), _mm256_set1_epi32(desc.mWidth));
+
+		__m256i vStartY = Max(_mm256_srai_epi32(_mm256_add_epi32(Min(Min(xFormedFxPtPos[0].Y, xFormedFxPtPos[1].Y), xFormedFxPtPos[2].Y), subpixelMask), SUBPIXEL_BITS), _mm256_set1_epi32(0));
+		__m256i vEndY   = Min(_mm256_add_epi32(_mm256_srai_epi32(Max(Max(xFormedFxPtPos[0].Y, xFormedFxPtPos[1].Y), xFormedFxPtPos[2].Y), SUBPIXEL_BITS), _mm256_set1_epi32(1)), _mm256_set1_epi32(desc.mHeight));
+
+		// Find the triangles that have a vert behind the near clip plane or outside the
+		// guard band, they are clipped after the others are binned
+		__m256 nearClip = _mm256_setzero_ps();
+		__m256 guardBand = _mm256_setzero_ps();
+		__m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+		for(int i = 0; i < 3; i++)
+		{
+			nearClip = _mm256_or_ps(nearClip, _mm256_cmp_ps(xformedPos[i].W, _mm256_set1_ps(1.0f), _CMP_GT_OQ));
+			guardBand = _mm256_or_ps(guardBand, _mm256_cmp_ps(_mm256_and_ps(xformedPos[i].X, absMask), _mm256_set1_ps(GUARD_BAND), _CMP_GT_OQ));
+			guardBand = _mm256_or_ps(guardBand, _mm256_cmp_ps(_mm256_and_ps(xformedPos[i].Y, absMask), _mm256_set1_ps(GUARD_BAND), _CMP_GT_OQ));
+		}
 
-		__m128i triArea = _mm_mullo_epi32(A0, xFormedFxPtPos[0].X);
-		triArea = _mm_add_epi32(triArea, _mm_mullo_epi32(B0, xFormedFxPtPos[0].Y));
-		triArea = _mm_add_epi32(triArea, C0);
+		// Skip triangles with zero area too
+		UINT triMask = ~_mm256_movemask_ps(_mm256_or_ps(_mm256_or_ps(nearClip, guardBand), _mm256_cmp_ps(triArea, _mm256_setzero_ps(), _CMP_LE_OQ)));
+		triMask &= (1 << numLanes) - 1;
+		UINT nearClipMask = _mm256_movemask_ps(nearClip) & ((1 << numLanes) - 1);
+		UINT clipMask = _mm256_movemask_ps(guardBand) & ~nearClipMask & ((1 << numLanes) - 1);
+		if(desc.mClipNearPlane)
+		{
+			clipMask |= nearClipMask;
+		}
 
-		__m128 oneOverTriArea = _mm_div_ps(_mm_set1_ps(1.0f), _mm_cvtepi32_ps(triArea));
-		
-		// Find bounding box for screen space triangle in terms of pixels
-		__m128i vStartX = Max(Min(Min(xFormedFxPtPos[0].X, xFormedFxPtPos[1].X), xFormedFxPtPos[2].X), _mm_set1_epi32(0));
-		__m128i vEndX   = Min(_mm_add_epi32(Max(Max(xFormedFxPtPos[0].X, xFormedFxPtPos[1].X), xFormedFxPtPos[2].X), _mm_set1_epi32(1)), _mm_set1_epi32(SCREENW));
+		while(triMask)
+		{
+			DWORD i;
+			_BitScanForward(&i, triMask);
+			triMask &= triMask - 1;
 
-        __m128i vStartY = Max(Min(Min(xFormedFxPtPos[0].Y, xFormedFxPtPos[1].Y), xFormedFxPtPos[2].Y), _mm_set1_epi32(0));
-        __m128i vEndY   = Min(_mm_add_epi32(Max(Max(xFormedFxPtPos[0].Y, xFormedFxPtPos[1].Y), xFormedFxPtPos[2].Y), _mm_set1_epi32(1)), _mm_set1_epi32(SCREENH));
+			// Skip triangle if it does not cover any pixel
+			if(vStartX.m256i_i32[i] >= vEndX.m256i_i32[i] || vStartY.m256i_i32[i] >= vEndY.m256i_i32[i]) continue;
 
+			// Convert bounding box in terms of pixels to bounding box in terms of tiles
+			int startX = max(vStartX.m256i_i32[i]/desc.mTileWidth, 0);
+			int endX   = min((vEndX.m256i_i32[i] - 1)/desc.mTileWidth, desc.mWidthInTiles-1);
 
-		for(int i = 0; i < numLanes; i++)
-		{
-			// Skip triangle if area is zero 
-			if(triArea.m128i_i32[i] <= 0) continue;
-			
-			float oneOverW[3];
+			int startY = max(vStartY.m256i_i32[i]/desc.mTileHeight, 0);
+			int endY   = min((vEndY.m256i_i32[i] - 1)/desc.mTileHeight, desc.mHeightInTiles-1);
+
+			// Store the setup once, the tiles only reference it
+			TriangleSetup &setup = slots.mpSetup[slots.mIdx];
 			for(int j = 0; j < 3; j++)
 			{
-				oneOverW[j] = xformedPos[j].W.m128_f32[i];
+				setup.mX[j] = xFormedFxPtPos[j].X.m256i_i32[i];
+				setup.mY[j] = xFormedFxPtPos[j].Y.m256i_i32[i];
 			}
-			
-			// Reject the triangle if any of its verts is behind the nearclip plane
-			if(oneOverW[0] > 1.0f || oneOverW[1] > 1.0f || oneOverW[2] > 1.0f) continue;
-
-			// Convert bounding box in terms of pixels to bounding box in terms of tiles
-			int startX = max(vStartX.m128i_i32[i]/TILE_WIDTH_IN_PIXELS, 0);
-			int endX   = min(vEndX.m128i_i32[i]/TILE_WIDTH_IN_PIXELS, SCREENW_IN_TILES-1);
-
-			int startY = max(vStartY.m128i_i32[i]/TILE_HEIGHT_IN_PIXELS, 0);
-			int endY   = min(vEndY.m128i_i32[i]/TILE_HEIGHT_IN_PIXELS, SCREENH_IN_TILES-1);
+			setup.mZ[0] = z0.m256_f32[i];
+			setup.mZ[1] = zdx.m256_f32[i];
+			setup.mZ[2] = zdy.m256_f32[i];
+			setup.mZMin = zMin.m256_f32[i];
+			setup.mStartX = (short)vStartX.m256i_i32[i];
+			setup.mEndX   = (short)vEndX.m256i_i32[i];
+			setup.mStartY = (short)vStartY.m256i_i32[i];
+			setup.mEndY   = (short)vEndY.m256i_i32[i];
 
 			// Add triangle to the tiles or bins that the bounding box covers
 			int row, col;
 			for(row = startY; row <= endY; row++)
 			{
-				int offset1 = YOFFSET1_MT * row;
-				int offset2 = YOFFSET2_MT * row;
 				for(col = startX; col <= endX; col++)
 				{
-					int idx1 = offset1 + (XOFFSET1_MT * col) + taskId;
-					int idx2 = offset2 + (XOFFSET2_MT * col) + (taskId * MAX_TRIS_IN_BIN_MT) + pNumTrisInBin[idx1];
-					pBin[idx2] = index + i;
-					pBinModel[idx2] = modelId;
-					pBinMesh[idx2] = meshId;
-					pNumTrisInBin[idx1] += 1;
+					pBins->Add(row * desc.mWidthInTiles + col, taskId, slots.mIdx);
 				}
 			}
+			slots.mIdx++;
 		}
-	}
-}
 
-
-void TransformedMeshSSE::GetOneTriangleData(float* xformedPos, UINT triId, UINT lane)
-{
-	vFloat4* pOut = (vFloat4*) xformedPos;
-	for(int i = 0; i < 3; i++)
-	{
-		UINT index = mpIndices[(triId * 3) + i];
-		(pOut + i)->X.m128_f32[lane] = mpXformedPos[index].m128_f32[0];
-		(pOut + i)->Y.m128_f32[lane] = mpXformedPos[index].m128_f32[1];
-		(pOut + i)->Z.m128_f32[lane] = mpXformedPos[index].m128_f32[2];
-		(pOut + i)->W.m128_f32[lane] = mpXformedPos[index].m128_f32[3];
+		if(clipMask)
+		{
+			ClipAndBinTriangles(taskId, cumulativeMatrix, index, clipMask, slots, pBins, desc);
+		}
 	}
 }
\ No newline at end of file
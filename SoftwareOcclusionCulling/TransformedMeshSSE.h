@@ -20,7 +20,84 @@
 
 #include "CPUT_DX11.h"
 #include "Constants.h"
+#include "DepthBufferDesc.h"
 #include "HelperSSE.h"
+#include "TriangleBins.h"
+
+//-------------------------------------------------------------------------------
+// Setup of a binned triangle, written once by the bin stage and read by every
+// tile the triangle overlaps. The verts are in fixed point with SUBPIXEL_BITS 
+// fractional bits, the edge functions are only set up per tile so that they are
+// relative to the tile. mZ holds the depth plane, the depth at pixel (0, 0) and
+// its x and y steps. The bounding box is clipped to the depth buffer and half 
+// open. Pixels are sampled at integer positions. Padded to one cache line
+//-------------------------------------------------------------------------------
+struct TriangleSetup
+{
+	int   mX[3];
+	int   mY[3];
+	float mZ[3];
+	float mZMin;
+	short mStartX, mEndX;
+	short mStartY, mEndY;
+	int   mPad[4];
+
+	//---------------------------------------------------------------------------
+	// Sets up the edge functions A * (x - startX) + B * (y - startY) + C over the
+	// inclusive pixel rectangle [startX, endX] x [startY, endY]. A pixel is inside
+	// the triangle if all three are non negative, the top-left fill rule is folded
+	// into C. They are evaluated in 64 bit at the corners of the rectangle, returns
+	// false if an edge is negative over all of it. An edge that is non negative 
+	// over all of it is zeroed, the others are 0 somewhere in the rectangle so 
+	// their values fit in 32 bit as long as the verts are inside the guard band
+	//---------------------------------------------------------------------------
+	inline bool GetEdges(int startX, int startY, int endX, int endY, int *pA, int *pB, int *pC) const
+	{
+		for(int i = 0; i < 3; i++)
+		{
+			// Edge from vert a to vert b, opposite to vert i
+			int a = i == 2 ? 0 : i + 1;
+			int b = a == 2 ? 0 : a + 1;
+			int A = mY[a] - mY[b];
+			int B = mX[b] - mX[a];
+
+			// Pixels exactly on an edge belong to the triangle if it is a top or a left edge
+			bool topLeft = A > 0 || (A == 0 && B > 0);
+			long long c = (long long)A * ((startX << SUBPIXEL_BITS) - mX[a]) + (long long)B * ((startY << SUBPIXEL_BITS) - mY[a]);
+			c = (c - (topLeft ? 0 : 1)) >> SUBPIXEL_BITS;
+
+			long long dx = (long long)A * (endX - startX);
+			long long dy = (long long)B * (endY - startY);
+			if(c + max(dx, 0LL) + max(dy, 0LL) < 0)
+			{
+				return false;
+			}
+
+			bool inside = c + min(dx, 0LL) + min(dy, 0LL) >= 0;
+			pA[i] = inside ? 0 : A;
+			pB[i] = inside ? 0 : B;
+			pC[i] = inside ? 0 : (int)c;
+		}
+		return true;
+	}
+};
+
+//-------------------------------------------------------------------------------
+// Triangle setups a bin chunk writes to. The triangles of the chunk have one 
+// setup at most, stored from mIdx on. The parts of the triangles the near plane
+// or the guard band clip go to the chunk's clip setups from mClipIdx to mClipEnd,
+// NUM_CLIP_PLANES per triangle of the chunk. A clipped triangle can be fanned into
+// one part more than that, so the parts that don't fit are dropped, which only
+// costs occlusion, and counted in mNumDropped
+//-------------------------------------------------------------------------------
+struct TriangleSetupSlots
+{
+	TriangleSetup *mpSetup;
+	UINT mIdx;
+	UINT mClipIdx;
+	UINT mClipEnd;
+	UINT mNumDropped;
+};
 
 class TransformedMeshSSE : public HelperSSE
 {
@@ -28,31 +105,31 @@ class TransformedMeshSSE : public HelperSSE
 		TransformedMeshSSE();
 		~TransformedMeshSSE();
 		void Initialize(CPUTMeshDX11* pMesh);
+		void Initialize(const float3 *pVertices, UINT numVertices, UINT *pIndices, UINT numTriangles);
+		void Initialize(const TransformedMeshSSE &source);
 		void TransformVertices(__m128 *cumulativeMatrix, 
 							   UINT start, 
 							   UINT end);
 
-		void BinTransformedTrianglesST(UINT taskId,
-									   UINT modelId,
-									   UINT meshId,
-									   UINT start,
-									   UINT end,
-									   UINT* pBin,
-									   USHORT* pBinModel,
-									   USHORT* pBinMesh,
-									   USHORT* pNumTrisInBin);
-
-		void BinTransformedTrianglesMT(UINT taskId,
-									   UINT modelId,
-									   UINT meshId,
-									   UINT start,
-									   UINT end,
-									   UINT* pBin,
-									   USHORT* pBinModel,
-									   USHORT* pBinMesh,
-									   USHORT* pNumTrisInBin);
-
-		void GetOneTriangleData(float* xformedPos, UINT triId, UINT lane);
+		void TransformVerticesAVX(__m128 *cumulativeMatrix, 
+								  UINT start, 
+								  UINT end);
+
+		void BinTransformedTriangles(UINT taskId,
+									 __m128 *cumulativeMatrix,
+									 UINT start,
+									 UINT end,
+									 TriangleSetupSlots &slots,
+									 TriangleBins* pBins,
+									 const DepthBufferDesc &desc);
+
+		void BinTransformedTrianglesAVX(UINT taskId,
+										__m128 *cumulativeMatrix,
+										UINT start,
+										UINT end,
+										TriangleSetupSlots &slots,
+										TriangleBins* pBins,
+										const DepthBufferDesc &desc);
 
 		inline UINT GetNumTriangles() {return mNumTriangles;}
 		inline UINT GetNumVertices() {return mNumVertices;}
@@ -63,12 +140,34 @@ class TransformedMeshSSE : public HelperSSE
 		UINT mNumVertices;
 		UINT mNumIndices;
 		UINT mNumTriangles;
-		Vertex *mpVertices;
+		float *mpVertexData;		// NULL when the streams are another mesh's
+		float *mpVertexX;			// object space positions in SoA streams,
+		float *mpVertexY;			// padded to a multiple of AVX vertices
+		float *mpVertexZ;
 		UINT *mpIndices;
 		__m128 *mpXformedPos; 
 		UINT mVertexStart;
 
 		void Gather(vFloat4 pOut[3], UINT triId, UINT numLanes);
+		void GatherAVX(vFloat8 pOut[3], UINT triId, UINT numLanes);
+
+		UINT SetupAndBinTriangles(UINT taskId,
+								  vFloat4 xformedPos[3],
+								  UINT numLanes,
+								  bool clipped,
+								  TriangleSetupSlots &slots,
+								  TriangleBins* pBins,
+								  const DepthBufferDesc &desc);
+
+		void ClipAndBinTriangles(UINT taskId,
+								 __m128 *cumulativeMatrix,
+								 UINT triId,
+								 UINT clipMask,
+								 TriangleSetupSlots &slots,
+								 TriangleBins* pBins,
+								 const DepthBufferDesc &desc);
+
+		UINT ClipPolygon(__m128 *pVerts, UINT numVerts);
 };
 
 
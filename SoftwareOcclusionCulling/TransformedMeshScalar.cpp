@@ -79,7 +79,8 @@ void TransformedMeshScalar::BinTransformedTrianglesST(UINT taskId,
 													  UINT* pBin,
 												      USHORT* pBinModel,
 													  USHORT* pBinMesh,
-													  USHORT* pNumTrisInBin)
+													  USHORT* pNumTrisInBin,
+													  const DepthBufferDesc &desc)
 {
 	// working on one triangle at a time
 	for(UINT index = start; index <= end; index++)
@@ -102,10 +103,10 @@ void TransformedMeshScalar::BinTransformedTrianglesST(UINT taskId,
 		
 		// Find bounding box for screen space triangle in terms of pixels
 		int startX = max(min(min(xFormedFxPtPos[0].x, xFormedFxPtPos[1].x), xFormedFxPtPos[2].x), 0); 
-        int endX   = min(max(max(xFormedFxPtPos[0].x, xFormedFxPtPos[1].x), xFormedFxPtPos[2].x) + 1, SCREENW);
+        int endX   = min(max(max(xFormedFxPtPos[0].x, xFormedFxPtPos[1].x), xFormedFxPtPos[2].x) + 1, desc.mWidth);
 
         int startY = max(min(min(xFormedFxPtPos[0].y, xFormedFxPtPos[1].y), xFormedFxPtPos[2].y), 0 );
-        int endY   = min(max(max(xFormedFxPtPos[0].y, xFormedFxPtPos[1].y), xFormedFxPtPos[2].y) + 1, SCREENH);
+        int endY   = min(max(max(xFormedFxPtPos[0].y, xFormedFxPtPos[1].y), xFormedFxPtPos[2].y) + 1, desc.mHeight);
 
 		// Skip triangle if area is zero 
 		if(triArea <= 0) continue;
@@ -120,11 +121,11 @@ void TransformedMeshScalar::BinTransformedTrianglesST(UINT taskId,
 		if(oneOverW[0] > 1.0f || oneOverW[1] > 1.0f || oneOverW[2] > 1.0f) continue;
 
 		// Convert bounding box in terms of pixels to bounding box in terms of tiles
-		int startXx = max(startX/TILE_WIDTH_IN_PIXELS, 0);
-		int endXx   = min(endX/TILE_WIDTH_IN_PIXELS, SCREENW_IN_TILES-1);
+		int startXx = max(startX/desc.mTileWidth, 0);
+		int endXx   = min(endX/desc.mTileWidth, desc.mWidthInTiles-1);
 
-		int startYy = max(startY/TILE_HEIGHT_IN_PIXELS, 0);
-		int endYy   = min(endY/TILE_HEIGHT_IN_PIXELS, SCREENH_IN_TILES-1);
+		int startYy = max(startY/desc.mTileHeight, 0);
+		int endYy   = min(endY/desc.mTileHeight, desc.mHeightInTiles-1);
 
 		// Add triangle to the tiles or bins that the bounding box covers
 		int row, col;
@@ -156,7 +157,8 @@ void TransformedMeshScalar::BinTransformedTrianglesMT(UINT taskId,
 													  UINT* pBin,
 												      USHORT* pBinModel,
 													  USHORT* pBinMesh,
-													  USHORT* pNumTrisInBin)
+													  USHORT* pNumTrisInBin,
+													  const DepthBufferDesc &desc)
 {
 	// working on 4 triangles at a time
 	for(UINT index = start; index <= end; index++)
@@ -179,10 +181,10 @@ void TransformedMeshScalar::BinTransformedTrianglesMT(UINT taskId,
 		
 		// Find bounding box for screen space triangle in terms of pixels
 		int startX = max(min(min(xFormedFxPtPos[0].x, xFormedFxPtPos[1].x), xFormedFxPtPos[2].x), 0);
-        int endX   = min(max(max(xFormedFxPtPos[0].x, xFormedFxPtPos[1].x), xFormedFxPtPos[2].x) + 1, SCREENW);
+        int endX   = min(max(max(xFormedFxPtPos[0].x, xFormedFxPtPos[1].x), xFormedFxPtPos[2].x) + 1, desc.mWidth);
 
         int startY = max(min(min(xFormedFxPtPos[0].y, xFormedFxPtPos[1].y), xFormedFxPtPos[2].y), 0 );
-        int endY   = min(max(max(xFormedFxPtPos[0].y, xFormedFxPtPos[1].y), xFormedFxPtPos[2].y) + 1, SCREENH);
+        int endY   = min(max(max(xFormedFxPtPos[0].y, xFormedFxPtPos[1].y), xFormedFxPtPos[2].y) + 1, desc.mHeight);
 
 		// Skip triangle if area is zero 
 		if(triArea <= 0) continue;
@@ -197,11 +199,11 @@ void TransformedMeshScalar::BinTransformedTrianglesMT(UINT taskId,
 		if(oneOverW[0] > 1.0f || oneOverW[1] > 1.0f || oneOverW[2] > 1.0f) continue;
 
 		// Convert bounding box in terms of pixels to bounding box in terms of tiles
-		int startXx = max(startX/TILE_WIDTH_IN_PIXELS, 0);
-		int endXx   = min(endX/TILE_WIDTH_IN_PIXELS, SCREENW_IN_TILES-1);
+		int startXx = max(startX/desc.mTileWidth, 0);
+		int endXx   = min(endX/desc.mTileWidth, desc.mWidthInTiles-1);
 
-		int startYy = max(startY/TILE_HEIGHT_IN_PIXELS, 0);
-		int endYy   = min(endY/TILE_HEIGHT_IN_PIXELS, SCREENH_IN_TILES-1);
+		int startYy = max(startY/desc.mTileHeight, 0);
+		int endYy   = min(endY/desc.mTileHeight, desc.mHeightInTiles-1);
 
 		// Add triangle to the tiles or bins that the bounding box covers
 		int row, col;
@@ -20,6 +20,7 @@
 
 #include "CPUT_DX11.h"
 #include "Constants.h"
+#include "DepthBufferDesc.h"
 #include "HelperScalar.h"
 
 class TransformedMeshScalar : public HelperScalar
@@ -40,7 +41,8 @@ class TransformedMeshScalar : public HelperScalar
 									   UINT* pBin,
 									   USHORT* pBinModel,
 									   USHORT* pBinMesh,
-									   USHORT* pNumTrisInBin);
+									   USHORT* pNumTrisInBin,
+									   const DepthBufferDesc &desc);
 
 		void BinTransformedTrianglesMT(UINT taskId,
 									   UINT modelId,
@@ -50,7 +52,8 @@ class TransformedMeshScalar : public HelperScalar
 									   UINT* pBin,
 									   USHORT* pBinModel,
 									   USHORT* pBinMesh,
-									   USHORT* pNumTrisInBin);
+									   USHORT* pNumTrisInBin,
+									   const DepthBufferDesc &desc);
 
 		void GetOneTriangleData(float* xformedPos, UINT triId, UINT lane);
 
@@ -15,6 +15,7 @@
 //
 //--------------------------------------------------------------------------------------
 #include "TransformedModelSSE.h"
+#include <float.h>
 
 TransformedModelSSE::TransformedModelSSE()
 	: mpCPUTModel(NULL),
@@ -23,36 +24,56 @@ TransformedModelSSE::TransformedModelSSE()
 	  mViewMatrix(NULL),
 	  mProjMatrix(NULL),
 	  mViewPortMatrix(NULL),
+	  mCumulativeMatrix(NULL),
 	  mVisible(false),
 	  mTooSmall(false),
+	  mOverBudget(false),
+	  mRasterizedLastFrame(false),
+	  mFramesNotRasterized(REPROJECTION_MAX_AGE),
 	  mOccluderSizeThreshold(0.0),
+	  mScore(0.0f),
 	  mpMeshes(NULL),
+	  mNumLods(0),
+	  mpProxy(NULL),
 	  mpXformedPos(NULL)
 {
 	mWorldMatrix = (__m128*)_aligned_malloc(sizeof(float) * 4 * 4, 16);
 	mViewMatrix = (__m128*)_aligned_malloc(sizeof(float) * 4 * 4, 16);
 	mProjMatrix = (__m128*)_aligned_malloc(sizeof(float) * 4 * 4, 16);
 	mViewPortMatrix = (__m128*)_aligned_malloc(sizeof(float) * 4 * 4, 16);
+	mCumulativeMatrix = (__m128*)_aligned_malloc(sizeof(float) * 4 * 4, 16);
+
+	for(UINT lod = 0; lod < OCCLUDER_LODS; lod++)
+	{
+		mpLodMeshes[lod] = NULL;
+		mNumLodMeshes[lod] = 0;
+	}
 	
-	mViewPortMatrix[0] = _mm_loadu_ps((float*)&viewportMatrix.r0);
-	mViewPortMatrix[1] = _mm_loadu_ps((float*)&viewportMatrix.r1);
-	mViewPortMatrix[2] = _mm_loadu_ps((float*)&viewportMatrix.r2);
-	mViewPortMatrix[3] = _mm_loadu_ps((float*)&viewportMatrix.r3);	
+	SetViewportMatrix(DepthBufferDesc().mViewportMatrix);
 }
 
 TransformedModelSSE::~TransformedModelSSE()
 {
-	SAFE_DELETE_ARRAY(mpMeshes);
+	for(UINT lod = 0; lod < mNumLods; lod++)
+	{
+		SAFE_DELETE_ARRAY(mpLodMeshes[lod]);
+	}
+	SAFE_RELEASE(mpProxy);
 	_aligned_free(mWorldMatrix);
 	_aligned_free(mViewMatrix);
 	_aligned_free(mProjMatrix);
 	_aligned_free(mViewPortMatrix);
+	_aligned_free(mCumulativeMatrix);
 }
 
 //--------------------------------------------------------------------
-// Create place holder for the transformed meshes for each model
+// Create place holder for the transformed meshes for each model. With
+// useProxy the model's occluder proxy replaces its meshes when it has
+// fewer triangles, with useLods the coarser levels of detail are made
+// of the biggest boxes of the proxy. pSource is the same model in
+// another view, its meshes and levels of detail are shared instead
 //---------------------------------------------------------------------
-void TransformedModelSSE::CreateTransformedMeshes(CPUTModelDX11 *pModel)
+void TransformedModelSSE::CreateTransformedMeshes(CPUTModelDX11 *pModel, bool useProxy, bool useLods, const TransformedModelSSE *pSource)
 {
 	mpCPUTModel = pModel;
 	mNumMeshes = pModel->GetMeshCount();
@@ -69,13 +90,103 @@ void TransformedModelSSE::CreateTransformedMeshes(CPUTModelDX11 *pModel)
 	mBBCenterOS = float4(center, 1.0f);
 	mBBHalfOS = float4(half, 0.0f);
 
-	mpMeshes = new TransformedMeshSSE[mNumMeshes];
+	if(pSource)
+	{
+		ShareTransformedMeshes(pSource);
+		return;
+	}
 
+	UINT numVertices = 0, numTriangles = 0;
 	for(UINT i = 0; i < mNumMeshes; i++)
 	{
 		CPUTMeshDX11* pMesh = (CPUTMeshDX11*)pModel->GetMesh(i);
-		mpMeshes[i].Initialize(pMesh);
+		numVertices += pMesh->GetVertexCount();
+		numTriangles += pMesh->GetTriangleCount();
+	}
+
+	UINT numBoxes = 0;
+	if(useProxy || useLods)
+	{
+		mpProxy = new OccluderProxy;
+		mpProxy->Create(pModel);
+		numBoxes = mpProxy->GetNumBoxes();
+	}
+
+	UINT numProxyBoxes = useProxy ? min(numBoxes, (numTriangles - 1) / 12) : 0;
+	if(numProxyBoxes > 0)
+	{
+		CreateProxyLod(numProxyBoxes);
+		numVertices = numProxyBoxes * 8;
+		numTriangles = numProxyBoxes * 12;
+		numBoxes = numProxyBoxes / 4;
+	}
+	else
+	{
+		mNumLodMeshes[0] = mNumMeshes;
+		mpLodMeshes[0] = new TransformedMeshSSE[mNumMeshes];
+		for(UINT i = 0; i < mNumMeshes; i++)
+		{
+			CPUTMeshDX11* pMesh = (CPUTMeshDX11*)pModel->GetMesh(i);
+			mpLodMeshes[0][i].Initialize(pMesh);
+		}
+		mNumLods = 1;
+	}
+
+	// A coarser level needs fewer triangles than the previous one and at most the
+	// vertices of the finest level, which sets the size of the transformed vertices
+	for(; useLods && numBoxes > 0 && mNumLods < OCCLUDER_LODS; numBoxes /= 4)
+	{
+		if(numBoxes * 12 < numTriangles && numBoxes * 8 <= numVertices)
+		{
+			CreateProxyLod(numBoxes);
+			numTriangles = numBoxes * 12;
+		}
 	}
+
+	if(mNumLods == 1 && numProxyBoxes == 0)
+	{
+		SAFE_RELEASE(mpProxy);
+	}
+
+	mpMeshes = mpLodMeshes[0];
+	mNumMeshes = mNumLodMeshes[0];
+}
+
+//--------------------------------------------------------------------
+// Same levels of detail as pSource, on its SoA streams and proxy. The
+// transformed vertices are set per model with SetXformedPos
+//--------------------------------------------------------------------
+void TransformedModelSSE::ShareTransformedMeshes(const TransformedModelSSE *pSource)
+{
+	mpProxy = pSource->mpProxy;
+	if(mpProxy)
+	{
+		mpProxy->AddRef();
+	}
+
+	for(mNumLods = 0; mNumLods < pSource->mNumLods; mNumLods++)
+	{
+		mNumLodMeshes[mNumLods] = pSource->mNumLodMeshes[mNumLods];
+		mpLodMeshes[mNumLods] = new TransformedMeshSSE[mNumLodMeshes[mNumLods]];
+		for(UINT i = 0; i < mNumLodMeshes[mNumLods]; i++)
+		{
+			mpLodMeshes[mNumLods][i].Initialize(pSource->mpLodMeshes[mNumLods][i]);
+		}
+	}
+
+	mpMeshes = mpLodMeshes[0];
+	mNumMeshes = mNumLodMeshes[0];
+}
+
+//--------------------------------------------------------------------
+// Adds a level of detail made of the first boxes of the proxy
+//--------------------------------------------------------------------
+void TransformedModelSSE::CreateProxyLod(UINT numBoxes)
+{
+	mNumLodMeshes[mNumLods] = 1;
+	mpLodMeshes[mNumLods] = new TransformedMeshSSE[1];
+	mpLodMeshes[mNumLods][0].Initialize(mpProxy->GetVertices(), numBoxes * 8, mpProxy->GetIndices(), numBoxes * 12);
+	mNumLods++;
 }
 
 //------------------------------------------------------------------
@@ -89,74 +200,116 @@ void TransformedModelSSE::IsVisible(CPUTCamera* pCamera)
 
 //---------------------------------------------------------------------------------------------------
 // Determine if the occluder size is sufficiently large enough to occlude other object sin the scene
-// If so transform the occluder to screen space so that it can be rasterized to the cPU depth buffer
+// and compute the object to screen space matrix used to transform the occluder vertices, pick the
+// level of detail from the size and score the occluder for the budget. Runs once per frame for every
+// occluder in the view frustum, before the transform
 //---------------------------------------------------------------------------------------------------
-void TransformedModelSSE::TransformMeshes(__m128 *viewMatrix, 
-										  __m128 *projMatrix,
-										  UINT start, 
-										  UINT end,
-										  CPUTCamera* pCamera)
+void TransformedModelSSE::CalcCumulativeMatrixAndSize(__m128 *viewMatrix, 
+													  __m128 *projMatrix,
+													  CPUTCamera *pCamera)
 {
-	if(mVisible)
+	if(!mVisible)
 	{
-		__m128 centerOS = _mm_set_ps(mBBCenterOS.w, mBBCenterOS.z, mBBCenterOS.y, mBBCenterOS.x);
+		return;
+	}
+
+	__m128 centerOS = _mm_set_ps(mBBCenterOS.w, mBBCenterOS.z, mBBCenterOS.y, mBBCenterOS.x);
 	
-		float radius = float3(mBBHalfOS.x, mBBHalfOS.y, mBBHalfOS.z).lengthSq();
-		float fov = pCamera->GetFov();
-		float tanOfHalfFov = tanf(fov * 0.5f);
+	float radius = float3(mBBHalfOS.x, mBBHalfOS.y, mBBHalfOS.z).lengthSq();
+	float fov = pCamera->GetFov();
+	float tanOfHalfFov = tanf(fov * 0.5f);
 	
-		__m128 cumulativeMatrix[4];
-		MatrixMultiply(mWorldMatrix, viewMatrix, cumulativeMatrix);
-		MatrixMultiply(cumulativeMatrix, projMatrix, cumulativeMatrix);
-		MatrixMultiply(cumulativeMatrix, mViewPortMatrix, cumulativeMatrix);
+	MatrixMultiply(mWorldMatrix, viewMatrix, mCumulativeMatrix);
+	MatrixMultiply(mCumulativeMatrix, projMatrix, mCumulativeMatrix);
+	MatrixMultiply(mCumulativeMatrix, mViewPortMatrix, mCumulativeMatrix);
+
+	__m128 centerOSxForm = TransformCoords(&centerOS, mCumulativeMatrix);
 
-		__m128 centerOSxForm = TransformCoords(&centerOS, cumulativeMatrix);
+	float w = centerOSxForm.m128_f32[3];
+	if(w > 1.0f)
+	{
+		float radiusDivW = radius / w;
+		float radiusDivWDivTanFov = radiusDivW / tanOfHalfFov;
+		mTooSmall = radiusDivWDivTanFov < (mOccluderSizeThreshold * mOccluderSizeThreshold) ? true : false;
 
-		float w = centerOSxForm.m128_f32[3];
-		if(w > 1.0f)
+		// The coarsest level of detail is rasterized down to the size threshold, each finer
+		// level from OCCLUDER_LOD_SIZE_STEP times the size the previous level starts at
+		UINT lod = mNumLods - 1;
+		float lodSize = mOccluderSizeThreshold * mOccluderSizeThreshold * OCCLUDER_LOD_SIZE_STEP;
+		while(lod > 0 && radiusDivWDivTanFov >= lodSize)
 		{
-			float radiusDivW = radius / w;
-			float radiusDivWDivTanFov = radiusDivW / tanOfHalfFov;
-			mTooSmall = radiusDivWDivTanFov < (mOccluderSizeThreshold * mOccluderSizeThreshold) ? true : false;
+			lod--;
+			lodSize *= OCCLUDER_LOD_SIZE_STEP;
 		}
-		else
+		mpMeshes = mpLodMeshes[lod];
+		mNumMeshes = mNumLodMeshes[lod];
+
+		// Score the occluder by the screen area of its bounding sphere per triangle. The
+		// area falls off with the square of the depth, and occluders made of few large
+		// triangles fill more of the depth buffer per triangle rasterized
+		mScore = radiusDivWDivTanFov / (w * tanOfHalfFov) / (float)GetNumTriangles();
+		mScore *= mRasterizedLastFrame ? OCCLUDER_SCORE_HYSTERESIS : 1.0f;
+	}
+	else
+	{
+		// BB center is behind the near clip plane, making screen-space radius meaningless.
+        // Assume visible.  This should be a safe assumption, as the frustum test says the bbox is visible.
+        mTooSmall = false;
+		mpMeshes = mpLodMeshes[0];
+		mNumMeshes = mNumLodMeshes[0];
+
+		// The camera is at or inside the occluder, rasterize it before any other
+		mScore = FLT_MAX;
+    }
+}
+
+//---------------------------------------------------------------------------------------------------
+// Transform the occluder to screen space so that it can be rasterized to the cPU depth buffer.
+// Only called for occluders that passed the frustum and size tests this frame
+//---------------------------------------------------------------------------------------------------
+void TransformedModelSSE::TransformMeshes(UINT start, UINT end)
+{
+	UINT totalNumVertices = 0;
+	for(UINT meshId = 0; meshId < mNumMeshes; meshId++)
+	{
+		totalNumVertices +=  mpMeshes[meshId].GetNumVertices();
+		if(totalNumVertices < start)
 		{
-			// BB center is behind the near clip plane, making screen-space radius meaningless.
-            // Assume visible.  This should be a safe assumption, as the frustum test says the bbox is visible.
-            mTooSmall = false;
-        }
+			continue;
+		}
+		mpMeshes[meshId].TransformVertices(mCumulativeMatrix, start, end);
+	}
+}
 
-		if(!mTooSmall)
+//---------------------------------------------------------------------------------------------------
+// AVX version of TransformMeshes
+//---------------------------------------------------------------------------------------------------
+void TransformedModelSSE::TransformMeshesAVX(UINT start, UINT end)
+{
+	UINT totalNumVertices = 0;
+	for(UINT meshId = 0; meshId < mNumMeshes; meshId++)
+	{
+		totalNumVertices +=  mpMeshes[meshId].GetNumVertices();
+		if(totalNumVertices < start)
 		{
-			UINT totalNumVertices = 0;
-			for(UINT meshId = 0; meshId < mNumMeshes; meshId++)
-			{
-				totalNumVertices +=  mpMeshes[meshId].GetNumVertices();
-				if(totalNumVertices < start)
-				{
-					continue;
-				}
-				mpMeshes[meshId].TransformVertices(cumulativeMatrix, start, end);
-			}
+			continue;
 		}
-	}	
+		mpMeshes[meshId].TransformVerticesAVX(mCumulativeMatrix, start, end);
+	}
 }
 
 //------------------------------------------------------------------------------------
 // If the occluder is sufficiently large enough to occlude other objects in the scene 
 // bin the triangles that make up the occluder into tiles to speed up rateraization
-// Single threaded version
 //------------------------------------------------------------------------------------
-void TransformedModelSSE::BinTransformedTrianglesST(UINT taskId,
-												    UINT modelId,
-											        UINT start,
-											        UINT end,
-												    UINT* pBin,
-												    USHORT* pBinModel,
-												    USHORT* pBinMesh,
-												    USHORT* pNumTrisInBin)
+void TransformedModelSSE::BinTransformedTriangles(UINT taskId,
+												  UINT start,
+												  UINT end,
+												  TriangleSetupSlots &slots,
+												  TriangleBins* pBins,
+												  const DepthBufferDesc &desc)
 {
-	if(mVisible && !mTooSmall)
+	if(IsRasterized2DB())
 	{
 		UINT totalNumTris = 0;
 		for(UINT meshId = 0; meshId < mNumMeshes; meshId++)
@@ -167,7 +320,7 @@ void TransformedModelSSE::BinTransformedTrianglesST(UINT taskId,
 				continue;
 			}
 
-			mpMeshes[meshId].BinTransformedTrianglesST(taskId, modelId, meshId, start, end, pBin, pBinModel, pBinMesh, pNumTrisInBin);
+			mpMeshes[meshId].BinTransformedTriangles(taskId, mCumulativeMatrix, start, end, slots, pBins, desc);
 		}
 	}
 }
@@ -175,18 +328,16 @@ void TransformedModelSSE::BinTransformedTrianglesST(UINT taskId,
 //------------------------------------------------------------------------------------
 // If the occluder is sufficiently large enough to occlude other objects in the scene 
 // bin the triangles that make up the occluder into tiles to speed up rateraization
-// Multi threaded version
+// AVX version
 //------------------------------------------------------------------------------------
-void TransformedModelSSE::BinTransformedTrianglesMT(UINT taskId,
-												    UINT modelId,
-											        UINT start,
-											        UINT end,
-												    UINT* pBin,
-												    USHORT* pBinModel,
-												    USHORT* pBinMesh,
-												    USHORT* pNumTrisInBin)
+void TransformedModelSSE::BinTransformedTrianglesAVX(UINT taskId,
+													 UINT start,
+													 UINT end,
+													 TriangleSetupSlots &slots,
+													 TriangleBins* pBins,
+													 const DepthBufferDesc &desc)
 {
-	if(mVisible && !mTooSmall)
+	if(IsRasterized2DB())
 	{
 		UINT totalNumTris = 0;
 		for(UINT meshId = 0; meshId < mNumMeshes; meshId++)
@@ -197,15 +348,7 @@ void TransformedModelSSE::BinTransformedTrianglesMT(UINT taskId,
 				continue;
 			}
 
-			mpMeshes[meshId].BinTransformedTrianglesMT(taskId, modelId, meshId, start, end, pBin, pBinModel, pBinMesh, pNumTrisInBin);
+			mpMeshes[meshId].BinTransformedTrianglesAVX(taskId, mCumulativeMatrix, start, end, slots, pBins, desc);
 		}
 	}
-}
-
-void TransformedModelSSE::Gather(float* xformedPos,
-								 UINT meshId, 
-								 UINT triId, 
-								 UINT lane)
-{
-	mpMeshes[meshId].GetOneTriangleData(xformedPos, triId, lane); 
 }
\ No newline at end of file
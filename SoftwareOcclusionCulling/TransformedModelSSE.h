@@ -20,6 +20,7 @@
 
 #include "CPUT_DX11.h"
 #include "TransformedMeshSSE.h"
+#include "OccluderProxy.h"
 #include "HelperSSE.h"
 
 class TransformedModelSSE : public HelperSSE
@@ -27,36 +28,28 @@ class TransformedModelSSE : public HelperSSE
 	public:
 		TransformedModelSSE();
 		~TransformedModelSSE();
-		void CreateTransformedMeshes(CPUTModelDX11 *pModel);
+		void CreateTransformedMeshes(CPUTModelDX11 *pModel, bool useProxy, bool useLods, const TransformedModelSSE *pSource = NULL);
 		void IsVisible(CPUTCamera *pCamera);
-		void TransformMeshes(__m128 *viewMatrix, 
-					    	 __m128 *projMatrix,
-							 UINT start, 
-							 UINT end,
-							 CPUTCamera *pCamera);
-
-		void BinTransformedTrianglesST(UINT taskId,
-									   UINT modelId,
-									   UINT start,
-									   UINT end,
-									   UINT* pBin,
-									   USHORT* pBinModel,
-									   USHORT* pBinMesh,
-									   USHORT* pNumTrisInBin);
-
-		void BinTransformedTrianglesMT(UINT taskId,
-									   UINT modelId,
-									   UINT start,
-									   UINT end,
-									   UINT* pBin,
-									   USHORT* pBinModel,
-									   USHORT* pBinMesh,
-									   USHORT* pNumTrisInBin);
-
-		void Gather(float* xformedPos,
-			        UINT meshId, 
-					UINT triId, 
-					UINT lane);
+		void CalcCumulativeMatrixAndSize(__m128 *viewMatrix, 
+										 __m128 *projMatrix,
+										 CPUTCamera *pCamera);
+
+		void TransformMeshes(UINT start, UINT end);
+		void TransformMeshesAVX(UINT start, UINT end);
+
+		void BinTransformedTriangles(UINT taskId,
+									 UINT start,
+									 UINT end,
+									 TriangleSetupSlots &slots,
+									 TriangleBins* pBins,
+									 const DepthBufferDesc &desc);
+
+		void BinTransformedTrianglesAVX(UINT taskId,
+										UINT start,
+										UINT end,
+										TriangleSetupSlots &slots,
+										TriangleBins* pBins,
+										const DepthBufferDesc &desc);
 
 		inline UINT GetNumVertices()
 		{
@@ -78,21 +71,27 @@ class TransformedModelSSE : public HelperSSE
 			return numTriangles;
 		}
 
+		// The levels of detail share the transformed vertices of the model, the finest
+		// level has the most vertices
 		inline void SetXformedPos(__m128 *pXformedPos, UINT modelStart)
 		{
 			mpXformedPos = pXformedPos;
 
-			mpMeshes[0].SetXformedPos(mpXformedPos);
-			mpMeshes[0].SetVertexStart(modelStart);
+			for(UINT lod = 0; lod < mNumLods; lod++)
+			{
+				TransformedMeshSSE *pMeshes = mpLodMeshes[lod];
+				pMeshes[0].SetXformedPos(mpXformedPos);
+				pMeshes[0].SetVertexStart(modelStart);
 			
-			UINT numVertices = 0;
-			numVertices += mpMeshes[0].GetNumVertices();
+				UINT numVertices = 0;
+				numVertices += pMeshes[0].GetNumVertices();
 			
-			for(UINT i = 1; i < mNumMeshes; i++)
-			{
-				mpMeshes[i].SetXformedPos((mpXformedPos + numVertices));
-				mpMeshes[i].SetVertexStart(modelStart + numVertices);
-				numVertices += mpMeshes[i].GetNumVertices(); 
+				for(UINT i = 1; i < mNumLodMeshes[lod]; i++)
+				{
+					pMeshes[i].SetXformedPos((mpXformedPos + numVertices));
+					pMeshes[i].SetVertexStart(modelStart + numVertices);
+					numVertices += pMeshes[i].GetNumVertices(); 
+				}
 			}
 		}
 
@@ -101,11 +100,31 @@ class TransformedModelSSE : public HelperSSE
 			mOccluderSizeThreshold = occluderSizeThreshold;
 		}
 
+		inline void SetViewportMatrix(const float4x4 &viewportMatrix)
+		{
+			mViewPortMatrix[0] = _mm_loadu_ps((float*)&viewportMatrix.r0);
+			mViewPortMatrix[1] = _mm_loadu_ps((float*)&viewportMatrix.r1);
+			mViewPortMatrix[2] = _mm_loadu_ps((float*)&viewportMatrix.r2);
+			mViewPortMatrix[3] = _mm_loadu_ps((float*)&viewportMatrix.r3);
+		}
+
 		inline void SetVisible(bool visible){mVisible = visible;}
 
+		// Importance of the occluder this frame, valid for the occluders that passed
+		// the size test. Occluders that are skipped to stay in the budget are over it
+		inline float GetScore(){return mScore;}
+		inline void SetOverBudget(bool overBudget){mOverBudget = overBudget;}
+		inline void SetRasterizedLastFrame(bool rasterized)
+		{
+			mRasterizedLastFrame = rasterized;
+			mFramesNotRasterized = rasterized ? 0 : min(mFramesNotRasterized + 1, (UINT)REPROJECTION_MAX_AGE);
+		}
+		// Frames since the occluder was last rasterized, up to REPROJECTION_MAX_AGE
+		inline UINT GetFramesNotRasterized(){return mFramesNotRasterized;}
+
 		inline bool IsRasterized2DB()
 		{
-			return (mVisible && !mTooSmall);
+			return (mVisible && !mTooSmall && !mOverBudget);
 		}
 
 	private:
@@ -115,17 +134,29 @@ class TransformedModelSSE : public HelperSSE
 		__m128 *mViewMatrix;
 		__m128 *mProjMatrix;
 		__m128 *mViewPortMatrix;
+		__m128 *mCumulativeMatrix;
 				
 		float3 mBBCenterWS;
 		float3 mBBHalfWS;
 		bool mVisible;
 		bool mTooSmall;
+		bool mOverBudget;
+		bool mRasterizedLastFrame;
+		UINT mFramesNotRasterized;
 		float mOccluderSizeThreshold;
+		float mScore;
 
 		float4 mBBCenterOS;
 		float4 mBBHalfOS;
-		TransformedMeshSSE *mpMeshes;
+		TransformedMeshSSE *mpMeshes;		// meshes of the level of detail picked this frame
+		TransformedMeshSSE *mpLodMeshes[OCCLUDER_LODS];
+		UINT mNumLodMeshes[OCCLUDER_LODS];
+		UINT mNumLods;
+		OccluderProxy *mpProxy;
 		__m128 *mpXformedPos;
+
+		void CreateProxyLod(UINT numBoxes);
+		void ShareTransformedMeshes(const TransformedModelSSE *pSource);
 };
 
 #endif
\ No newline at end of file
@@ -25,7 +25,7 @@ TransformedModelScalar::TransformedModelScalar()
 	  mpMeshes(NULL),
 	  mpXformedPos(NULL)
 {
-
+	mViewPortMatrix = DepthBufferDesc().mViewportMatrix;
 }
 
 TransformedModelScalar::~TransformedModelScalar()
@@ -84,7 +84,7 @@ void TransformedModelScalar::TransformMeshes(float4x4 *viewMatrix,
 
 		float4x4 cumulativeMatrix = mWorldMatrix * *viewMatrix;
 		cumulativeMatrix = cumulativeMatrix * *projMatrix;
-		cumulativeMatrix = cumulativeMatrix * viewportMatrix;
+		cumulativeMatrix = cumulativeMatrix * mViewPortMatrix;
 		
 		float4 mBBCenterOSxForm = TransformCoords(mBBCenterOS,cumulativeMatrix);
 	
@@ -130,7 +130,8 @@ void TransformedModelScalar::BinTransformedTrianglesST(UINT taskId,
 													   UINT* pBin,
 													   USHORT* pBinModel,
 													   USHORT* pBinMesh,
-													   USHORT* pNumTrisInBin)
+													   USHORT* pNumTrisInBin,
+													   const DepthBufferDesc &desc)
 {
 	if(mVisible && !mTooSmall)
 	{
@@ -142,7 +143,7 @@ void TransformedModelScalar::BinTransformedTrianglesST(UINT taskId,
 			{
 				continue;
 			}
-			mpMeshes[meshId].BinTransformedTrianglesST(taskId, modelId, meshId, start, end, pBin, pBinModel, pBinMesh, pNumTrisInBin);
+			mpMeshes[meshId].BinTransformedTrianglesST(taskId, modelId, meshId, start, end, pBin, pBinModel, pBinMesh, pNumTrisInBin, desc);
 		}
 	}
 }
@@ -159,7 +160,8 @@ void TransformedModelScalar::BinTransformedTrianglesMT(UINT taskId,
 													   UINT* pBin,
 													   USHORT* pBinModel,
 													   USHORT* pBinMesh,
-													   USHORT* pNumTrisInBin)
+													   USHORT* pNumTrisInBin,
+													   const DepthBufferDesc &desc)
 {
 	if(mVisible && !mTooSmall)
 	{
@@ -171,7 +173,7 @@ void TransformedModelScalar::BinTransformedTrianglesMT(UINT taskId,
 			{
 				continue;
 			}
-			mpMeshes[meshId].BinTransformedTrianglesMT(taskId, modelId, meshId, start, end, pBin, pBinModel, pBinMesh, pNumTrisInBin);
+			mpMeshes[meshId].BinTransformedTrianglesMT(taskId, modelId, meshId, start, end, pBin, pBinModel, pBinMesh, pNumTrisInBin, desc);
 		}
 	}
 }
@@ -42,7 +42,8 @@ class TransformedModelScalar : public HelperScalar
 									   UINT* pBin,
 									   USHORT* pBinModel,
 									   USHORT* pBinMesh,
-									   USHORT* pNumTrisInBin);
+									   USHORT* pNumTrisInBin,
+									   const DepthBufferDesc &desc);
 
 		void BinTransformedTrianglesMT(UINT taskId,
 			   					       UINT modelId,
@@ -51,7 +52,8 @@ class TransformedModelScalar : public HelperScalar
 									   UINT* pBin,
 									   USHORT* pBinModel,
 									   USHORT* pBinMesh,
-									   USHORT* pNumTrisInBin);
+									   USHORT* pNumTrisInBin,
+									   const DepthBufferDesc &desc);
 
 		void Gather(float* xformedPos,
 					UINT meshId, 
@@ -101,6 +103,8 @@ class TransformedModelScalar : public HelperScalar
 			mOccluderSizeThreshold = occluderSizeThreshold;
 		}
 
+		inline void SetViewportMatrix(const float4x4 &viewportMatrix){mViewPortMatrix = viewportMatrix;}
+
 		inline void SetVisible(bool visible){mVisible = visible;}
 
 		inline bool IsRasterized2DB()
@@ -112,6 +116,7 @@ class TransformedModelScalar : public HelperScalar
 		CPUTModelDX11 *mpCPUTModel;
 		UINT mNumMeshes;
 		float4x4 mWorldMatrix;
+		float4x4 mViewPortMatrix;
 
 		float3 mBBCenterWS;
 		float3 mBBHalfWS;
@@ -0,0 +1,108 @@
+//--------------------------------------------------------------------------------------
+// Copyright 2011 Intel Corporation
+// All Rights Reserved
+//
+// Permission is granted to use, copy, distribute and prepare derivative works of this
+// software for any purpose and without fee, provided, that the above copyright notice
+// and this statement appear in all copies.  Intel makes no representations about the
+// suitability of this software for any purpose.  THIS SOFTWARE IS PROVIDED "AS IS."
+// INTEL SPECIFICALLY DISCLAIMS ALL WARRANTIES, EXPRESS OR IMPLIED, AND ALL LIABILITY,
+// INCLUDING CONSEQUENTIAL AND OTHER INDIRECT DAMAGES, FOR THE USE OF THIS SOFTWARE,
+// INCLUDING LIABILITY FOR INFRINGEMENT OF ANY PROPRIETARY RIGHTS, AND INCLUDING THE
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  Intel does not
+// assume any responsibility for any errors which may appear in this software nor any
+// responsibility to update it.
+//
+//--------------------------------------------------------------------------------------
+
+#include "TriangleBins.h"
+
+TriangleBins::TriangleBins(UINT numTasks, UINT numTiles)
+	: mNumTasks(numTasks),
+	  mNumTiles(0)
+{
+	mppBins = new Bin*[numTasks];
+	mpPools = (Pool*)_aligned_malloc(sizeof(Pool) * numTasks, CACHE_LINE_SIZE);
+	ASSERT(mpPools != NULL, _L("Failed allocating the triangle bin pools"));
+	for(UINT i = 0; i < numTasks; i++)
+	{
+		mppBins[i] = NULL;
+		mpPools[i].mpFirst = mpPools[i].mpLast = mpPools[i].mpNextFree = NULL;
+	}
+	SetNumTiles(numTiles);
+}
+
+TriangleBins::~TriangleBins()
+{
+	for(UINT i = 0; i < mNumTasks; i++)
+	{
+		Chunk *pChunk = mpPools[i].mpFirst;
+		while(pChunk != NULL)
+		{
+			Chunk *pNext = pChunk->mpNextInPool;
+			_aligned_free(pChunk);
+			pChunk = pNext;
+		}
+		_aligned_free(mppBins[i]);
+	}
+	SAFE_DELETE_ARRAY(mppBins);
+	_aligned_free(mpPools);
+}
+
+//--------------------------------------------------------------------------------
+// The pools keep their chunks, they do not depend on the tile grid
+//--------------------------------------------------------------------------------
+void TriangleBins::SetNumTiles(UINT numTiles)
+{
+	mNumTiles = numTiles;
+	for(UINT i = 0; i < mNumTasks; i++)
+	{
+		_aligned_free(mppBins[i]);
+		mppBins[i] = (Bin*)_aligned_malloc(sizeof(Bin) * numTiles, CACHE_LINE_SIZE);
+		ASSERT(mppBins[i] != NULL, _L("Failed allocating the triangle bins"));
+		Reset(i);
+	}
+}
+
+void TriangleBins::Reset(UINT taskId)
+{
+	Bin *pBins = mppBins[taskId];
+	for(UINT tileId = 0; tileId < mNumTiles; tileId++)
+	{
+		pBins[tileId].mpFirst = pBins[tileId].mpLast = NULL;
+		pBins[tileId].mNumTris = 0;
+	}
+	mpPools[taskId].mpNextFree = mpPools[taskId].mpFirst;
+}
+
+//--------------------------------------------------------------------------------
+// Takes the next unused chunk of the task's pool, the pool only allocates a new
+// chunk once all of its chunks are in use
+//--------------------------------------------------------------------------------
+TriangleBins::Chunk* TriangleBins::AllocChunk(UINT taskId)
+{
+	Pool &pool = mpPools[taskId];
+	Chunk *pChunk = pool.mpNextFree;
+	if(pChunk != NULL)
+	{
+		pool.mpNextFree = pChunk->mpNextInPool;
+	}
+	else
+	{
+		pChunk = (Chunk*)_aligned_malloc(sizeof(Chunk), CACHE_LINE_SIZE);
+		ASSERT(pChunk != NULL, _L("Failed allocating a triangle bin chunk"));
+		pChunk->mpNextInPool = NULL;
+		if(pool.mpLast == NULL)
+		{
+			pool.mpFirst = pChunk;
+		}
+		else
+		{
+			pool.mpLast->mpNextInPool = pChunk;
+		}
+		pool.mpLast = pChunk;
+	}
+	pChunk->mpNext = NULL;
+	pChunk->mNumTris = 0;
+	return pChunk;
+}
\ No newline at end of file
@@ -0,0 +1,102 @@
+//--------------------------------------------------------------------------------------
+// Copyright 2011 Intel Corporation
+// All Rights Reserved
+//
+// Permission is granted to use, copy, distribute and prepare derivative works of this
+// software for any purpose and without fee, provided, that the above copyright notice
+// and this statement appear in all copies.  Intel makes no representations about the
+// suitability of this software for any purpose.  THIS SOFTWARE IS PROVIDED "AS IS."
+// INTEL SPECIFICALLY DISCLAIMS ALL WARRANTIES, EXPRESS OR IMPLIED, AND ALL LIABILITY,
+// INCLUDING CONSEQUENTIAL AND OTHER INDIRECT DAMAGES, FOR THE USE OF THIS SOFTWARE,
+// INCLUDING LIABILITY FOR INFRINGEMENT OF ANY PROPRIETARY RIGHTS, AND INCLUDING THE
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  Intel does not
+// assume any responsibility for any errors which may appear in this software nor any
+// responsibility to update it.
+//
+//--------------------------------------------------------------------------------------
+
+#ifndef TRIANGLEBINS_H
+#define TRIANGLEBINS_H
+
+#include "CPUT_DX11.h"
+#include "Constants.h"
+
+//-------------------------------------------------------------------------------
+// Bins of the triangles that overlap each tile. Every bin task has its own bin
+// in every tile, a list of fixed size chunks of triangle setup indices. The chunks
+// come from a pool owned by the task, so binning needs no locks. The pools grow
+// on demand and keep their chunks from frame to frame, so the memory follows the
+// load of the scene and a bin cannot overflow.
+// The bins are laid out task by task, each task's bins and pool start on their
+// own cache line so the bin tasks never write to a line another task writes to.
+// The raster tasks merge the bins of all the tasks for their tile
+//-------------------------------------------------------------------------------
+class TriangleBins
+{
+	public:
+		struct Chunk
+		{
+			Chunk *mpNext;			// next chunk of the bin
+			Chunk *mpNextInPool;	// next chunk owned by the same pool
+			UINT   mNumTris;
+			UINT   mTris[BIN_CHUNK_SIZE];
+		};
+
+		TriangleBins(UINT numTasks, UINT numTiles);
+		~TriangleBins();
+
+		// Allocates the bins of every task for a tile grid of another size, emptied
+		void SetNumTiles(UINT numTiles);
+
+		// Empties the task's bins in all the tiles and returns its chunks to its pool
+		void Reset(UINT taskId);
+
+		inline void Add(UINT tileId, UINT taskId, UINT setupIdx)
+		{
+			Bin &bin = mppBins[taskId][tileId];
+			if(bin.mpLast == NULL || bin.mpLast->mNumTris == BIN_CHUNK_SIZE)
+			{
+				Chunk *pChunk = AllocChunk(taskId);
+				if(bin.mpLast == NULL)
+				{
+					bin.mpFirst = pChunk;
+				}
+				else
+				{
+					bin.mpLast->mpNext = pChunk;
+				}
+				bin.mpLast = pChunk;
+			}
+			bin.mpLast->mTris[bin.mpLast->mNumTris++] = setupIdx;
+			bin.mNumTris++;
+		}
+
+		inline UINT GetNumTasks() const {return mNumTasks;}
+		inline UINT GetNumTris(UINT tileId, UINT taskId) const {return mppBins[taskId][tileId].mNumTris;}
+		inline const Chunk* GetFirstChunk(UINT tileId, UINT taskId) const {return mppBins[taskId][tileId].mpFirst;}
+
+	private:
+		struct Bin
+		{
+			Chunk *mpFirst;
+			Chunk *mpLast;
+			UINT   mNumTris;
+		};
+
+		struct Pool
+		{
+			Chunk *mpFirst;			// all the chunks of the pool, linked with mpNextInPool
+			Chunk *mpLast;
+			Chunk *mpNextFree;		// first chunk not in use this frame
+			char   mPad[CACHE_LINE_SIZE - 3 * sizeof(Chunk*)];
+		};
+
+		UINT mNumTasks;
+		UINT mNumTiles;
+		Bin **mppBins;				// mNumTiles bins per task
+		Pool *mpPools;
+
+		Chunk* AllocChunk(UINT taskId);
+};
+
+#endif //TRIANGLEBINS_H
\ No newline at end of file
@@ -58,6 +58,28 @@ int WINAPI wWinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdL
     cString CommandLine(lpCmdLine);
     pSample->CPUTParseCommandLine(CommandLine, &params, &AssetFilename);       
 
+    // -benchmark <file> runs the culling benchmark and writes its results to the file
+    // instead of starting the message loop. The file name keeps its case
+    cString BenchmarkFilename;
+    cString BenchmarkParams(CommandLine);
+    wchar_t separators[] = L" \t\n";
+    wchar_t *nextToken = NULL;
+    wchar_t *token = wcstok_s((wchar_t*)BenchmarkParams.c_str(), separators, &nextToken);
+    while(token)
+    {
+        if(0 == _wcsicmp(token, L"-benchmark"))
+        {
+            token = wcstok_s(NULL, separators, &nextToken);
+            ASSERT(token, _L("-benchmark command line parameter missing required file name"));
+            if(!token)
+            {
+                break;
+            }
+            BenchmarkFilename.assign(token);
+        }
+        token = wcstok_s(NULL, separators, &nextToken);
+    }
+
     // create the window and device context
     result = pSample->CPUTCreateWindowAndContext(_L("CPUTWindow DirectX 11"), params);
     ASSERT( CPUTSUCCESS(result), _L("CPUT Error creating window and context.") );
@@ -65,8 +87,15 @@ int WINAPI wWinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdL
 	// initialize the task manager
     gTaskMgr.Init();
 
-    // start the main message loop
-    returnCode = pSample->CPUTMessageLoop();
+    if(BenchmarkFilename.size() > 0)
+    {
+        returnCode = pSample->RunBenchmark(BenchmarkFilename);
+    }
+    else
+    {
+        // start the main message loop
+        returnCode = pSample->CPUTMessageLoop();
+    }
 
 	pSample->DeviceShutdown();
 